@@ -0,0 +1,309 @@
+/*
+ * Keyframe Animation Playback - implementation
+ */
+
+#include "animation.h"
+#include "clipfile.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Longest stretch of wall-clock time consumed in one update; larger gaps
+// (debugger breaks, suspended window) are dropped instead of fast-forwarded
+static const float MAX_CATCH_UP = 0.25f;
+
+static bool keyBeforeTime(float time, const Keyframe &key)
+{
+    return time < key.time;
+}
+
+static float lerp(float a, float b, float t)
+{
+    return a + (b - a) * t;
+}
+
+/**
+ * Uniform Catmull-Rom spline between p1 (t = 0) and p2 (t = 1)
+ */
+static float catmullRom(float p0, float p1, float p2, float p3, float t)
+{
+    float t2 = t * t;
+    float t3 = t2 * t;
+    return 0.5f * (2.0f * p1 + (p2 - p0) * t +
+                   (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t2 +
+                   (3.0f * p1 - p0 - 3.0f * p2 + p3) * t3);
+}
+
+/**
+ * Length of a clip in seconds (time of its last keyframe)
+ */
+float clipDuration(const AnimationClip &clip)
+{
+    if (clip.binary != NULL)
+    {
+        return clip.binary->duration;
+    }
+    return clip.keyframes.empty() ? 0.0f : clip.keyframes.back().time;
+}
+
+static float channelValue(const ClipChannel &channel, const uint16_t *values, int key)
+{
+    return channel.valueBase + values[key] * channel.valueStep;
+}
+
+/**
+ * Evaluate one channel of a mapped clip, with the same rules as the
+ * keyframe path below
+ * The time index gives a segment at or before the answer; the scan from
+ * there is bounded by the keys, so a damaged index cannot read past them.
+ * @param header - Start of the mapped file
+ * @param channel - Channel of that file
+ * @param time - Seconds from clip start, already wrapped for loops
+ * @return Joint angle in degrees
+ */
+static float sampleBinaryChannel(const ClipFileHeader &header, const ClipChannel &channel, float time,
+                                 Interpolation mode, bool looping)
+{
+    const char *base = (const char *)&header;
+    const float *times = (const float *)(base + channel.timesOffset);
+    const uint16_t *values = (const uint16_t *)(base + channel.valuesOffset);
+    const uint32_t *index = (const uint32_t *)(base + channel.indexOffset);
+    int count = (int)channel.keyCount;
+
+    if (count == 1 || time <= times[0])
+    {
+        return channelValue(channel, values, 0);
+    }
+    if (time >= times[count - 1])
+    {
+        return channelValue(channel, values, count - 1);
+    }
+
+    // Clamped before converting, so that no interval overflows the integer;
+    // the entry is clamped unsigned, so a damaged one cannot turn negative
+    float position = fminf(fmaxf(time / header.indexInterval, 0.0f), (float)(header.indexCount - 1));
+    uint32_t entry = std::min((uint32_t)position, header.indexCount - 1);
+    int i = (int)std::min<uint32_t>(index[entry], (uint32_t)(count - 2));
+    while (i > 0 && times[i] > time)
+    {
+        i--;
+    }
+    while (i < count - 2 && times[i + 1] <= time)
+    {
+        i++;
+    }
+    float t = (time - times[i]) / (times[i + 1] - times[i]);
+    float p1 = channelValue(channel, values, i);
+    float p2 = channelValue(channel, values, i + 1);
+
+    if (mode == INTERPOLATE_LINEAR)
+    {
+        return lerp(p1, p2, t);
+    }
+
+    int i0 = i - 1;
+    int i3 = i + 2;
+    if (i0 < 0)
+    {
+        i0 = looping ? count - 2 : 0;
+    }
+    if (i3 >= count)
+    {
+        i3 = looping ? 1 : count - 1;
+    }
+    return catmullRom(channelValue(channel, values, i0), p1, p2, channelValue(channel, values, i3), t);
+}
+
+/**
+ * Evaluate a clip at an arbitrary time
+ * Looping clips wrap the time; others hold their first/last pose outside
+ * the clip range. Mapped clips are sampled channel by channel. Cubic
+ * results are clamped to the joint limits since the spline may overshoot
+ * between keys.
+ * @param clip - Clip to sample (at least one keyframe)
+ * @param time - Seconds from clip start
+ * @param mode - Linear or cubic interpolation
+ * @param joints - Receives the interpolated pose
+ */
+void sampleClip(const AnimationClip &clip, float time, Interpolation mode, LampJoints &joints)
+{
+    const std::vector<Keyframe> &keys = clip.keyframes;
+    int count = (int)keys.size();
+    float duration = clipDuration(clip);
+
+    if (clip.looping && duration > 0.0f)
+    {
+        time = fmodf(time, duration);
+        if (time < 0.0f)
+        {
+            time += duration;
+        }
+    }
+
+    if (clip.binary != NULL)
+    {
+        for (int channel = 0; channel < CLIP_CHANNEL_COUNT; channel++)
+        {
+            clipChannelValue(joints, channel) =
+                sampleBinaryChannel(*clip.binary, clip.binary->channels[channel], time, mode, clip.looping);
+        }
+        if (mode == INTERPOLATE_CUBIC)
+        {
+            clampLampJoints(joints);
+        }
+        return;
+    }
+
+    if (count == 1 || time <= keys.front().time)
+    {
+        joints = keys.front().joints;
+        return;
+    }
+    if (time >= keys.back().time)
+    {
+        joints = keys.back().joints;
+        return;
+    }
+
+    // Binary search for the segment [i, i + 1] containing time
+    int i = (int)(std::upper_bound(keys.begin(), keys.end(), time, keyBeforeTime) - keys.begin()) - 1;
+    const Keyframe &k1 = keys[i];
+    const Keyframe &k2 = keys[i + 1];
+    float t = (time - k1.time) / (k2.time - k1.time);
+
+    if (mode == INTERPOLATE_LINEAR)
+    {
+        joints.baseRotation = lerp(k1.joints.baseRotation, k2.joints.baseRotation, t);
+        joints.lowerArmAngle = lerp(k1.joints.lowerArmAngle, k2.joints.lowerArmAngle, t);
+        joints.upperArmAngle = lerp(k1.joints.upperArmAngle, k2.joints.upperArmAngle, t);
+        joints.lampshadeAngle = lerp(k1.joints.lampshadeAngle, k2.joints.lampshadeAngle, t);
+        joints.lampshadeRotation = lerp(k1.joints.lampshadeRotation, k2.joints.lampshadeRotation, t);
+        return;
+    }
+
+    // Outer control points: wrap around for loops (skipping the duplicated
+    // end key), otherwise repeat the end keys
+    int i0 = i - 1;
+    int i3 = i + 2;
+    if (i0 < 0)
+    {
+        i0 = clip.looping ? count - 2 : 0;
+    }
+    if (i3 >= count)
+    {
+        i3 = clip.looping ? 1 : count - 1;
+    }
+    const LampJoints &p0 = keys[i0].joints;
+    const LampJoints &p1 = k1.joints;
+    const LampJoints &p2 = k2.joints;
+    const LampJoints &p3 = keys[i3].joints;
+
+    joints.baseRotation = catmullRom(p0.baseRotation, p1.baseRotation, p2.baseRotation, p3.baseRotation, t);
+    joints.lowerArmAngle = catmullRom(p0.lowerArmAngle, p1.lowerArmAngle, p2.lowerArmAngle, p3.lowerArmAngle, t);
+    joints.upperArmAngle = catmullRom(p0.upperArmAngle, p1.upperArmAngle, p2.upperArmAngle, p3.upperArmAngle, t);
+    joints.lampshadeAngle = catmullRom(p0.lampshadeAngle, p1.lampshadeAngle, p2.lampshadeAngle, p3.lampshadeAngle, t);
+    joints.lampshadeRotation =
+        catmullRom(p0.lampshadeRotation, p1.lampshadeRotation, p2.lampshadeRotation, p3.lampshadeRotation, t);
+    clampLampJoints(joints);
+}
+
+/**
+ * Start playing a clip from the beginning
+ */
+void startPlayback(AnimationPlayer &player, const AnimationClip *clip)
+{
+    player.clip = clip;
+    player.time = 0.0f;
+    player.accumulator = 0.0f;
+    player.playing = clip != NULL && (clip->binary != NULL || !clip->keyframes.empty());
+}
+
+/**
+ * Advance playback by elapsed wall-clock time in fixed ANIMATION_TIMESTEP
+ * increments. Leftover time is carried to the next update, so the motion
+ * does not depend on how often this is called.
+ * @param player - Playback state
+ * @param elapsedSeconds - Wall-clock time since the previous update
+ * @return Number of fixed steps taken (0 means the pose did not change)
+ */
+int advancePlayback(AnimationPlayer &player, float elapsedSeconds)
+{
+    if (!player.playing)
+    {
+        return 0;
+    }
+
+    player.accumulator += std::min(elapsedSeconds, MAX_CATCH_UP);
+
+    int steps = 0;
+    while (player.accumulator >= ANIMATION_TIMESTEP)
+    {
+        player.accumulator -= ANIMATION_TIMESTEP;
+        player.time += ANIMATION_TIMESTEP;
+        steps++;
+    }
+
+    // Keep loop time small to preserve float precision on long runs
+    float duration = clipDuration(*player.clip);
+    if (player.clip->looping && duration > 0.0f)
+    {
+        player.time = fmodf(player.time, duration);
+    }
+    else if (player.time >= duration)
+    {
+        player.time = duration;
+        player.playing = false;
+    }
+    return steps;
+}
+
+/**
+ * Add a keyframe to a clip (keys must be added in time order)
+ */
+static void addKeyframe(AnimationClip &clip, float time, float baseRotation, float lowerArmAngle,
+                        float upperArmAngle, float lampshadeAngle, float lampshadeRotation)
+{
+    Keyframe key;
+    key.time = time;
+    key.joints.baseRotation = baseRotation;
+    key.joints.lowerArmAngle = lowerArmAngle;
+    key.joints.upperArmAngle = upperArmAngle;
+    key.joints.lampshadeAngle = lampshadeAngle;
+    key.joints.lampshadeRotation = lampshadeRotation;
+    clip.keyframes.push_back(key);
+}
+
+/**
+ * Crouch, spring up and settle back, starting from the default pose
+ */
+AnimationClip createHopClip()
+{
+    AnimationClip clip;
+    clip.name = "Hop";
+    clip.looping = true;
+    clip.binary = NULL;
+    addKeyframe(clip, 0.0f, 0.0f, 30.0f, -60.0f, -90.0f, 0.0f);
+    addKeyframe(clip, 0.4f, 0.0f, 5.0f, -110.0f, -60.0f, 0.0f); // Crouch
+    addKeyframe(clip, 0.7f, 0.0f, 75.0f, -20.0f, -75.0f, 0.0f); // Spring up
+    addKeyframe(clip, 1.0f, 0.0f, 50.0f, -40.0f, -85.0f, 0.0f); // Recoil
+    addKeyframe(clip, 1.6f, 0.0f, 30.0f, -60.0f, -90.0f, 0.0f);
+    return clip;
+}
+
+/**
+ * Sweep the base left and right while the lampshade peeks up and down
+ */
+AnimationClip createLookAroundClip()
+{
+    AnimationClip clip;
+    clip.name = "Look Around";
+    clip.looping = true;
+    clip.binary = NULL;
+    addKeyframe(clip, 0.0f, 0.0f, 30.0f, -60.0f, -90.0f, 0.0f);
+    addKeyframe(clip, 1.5f, 60.0f, 35.0f, -55.0f, -60.0f, 20.0f);   // Look left
+    addKeyframe(clip, 3.0f, 60.0f, 40.0f, -70.0f, -30.0f, -10.0f);  // Peek up
+    addKeyframe(clip, 4.5f, -60.0f, 35.0f, -55.0f, -60.0f, -20.0f); // Look right
+    addKeyframe(clip, 6.0f, -60.0f, 40.0f, -70.0f, -30.0f, 10.0f);  // Peek up
+    addKeyframe(clip, 7.5f, 0.0f, 30.0f, -60.0f, -90.0f, 0.0f);
+    return clip;
+}
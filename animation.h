@@ -0,0 +1,65 @@
+/*
+ * Keyframe Animation Playback
+ *
+ * A clip is a time-sorted list of LampJoints keyframes. Sampling a clip
+ * at any time interpolates between the surrounding keyframes (linear or
+ * Catmull-Rom cubic) without allocating, so it is cheap enough for
+ * scrubbing. Playback advances in fixed time steps from wall-clock time,
+ * which keeps motion independent of the frame rate.
+ *
+ * A clip can also be backed by a memory-mapped binary clip file
+ * (clipfile.h) instead of keyframes; sampling is the same either way.
+ */
+
+#ifndef ANIMATION_H
+#define ANIMATION_H
+
+#include "lamp.h"
+
+#include <vector>
+
+// Fixed simulation step used by playback (seconds)
+const float ANIMATION_TIMESTEP = 1.0f / 120.0f;
+
+enum Interpolation
+{
+    INTERPOLATE_LINEAR = 0, // Straight blend between neighbouring keys
+    INTERPOLATE_CUBIC = 1   // Catmull-Rom spline through the keys
+};
+
+struct Keyframe
+{
+    float time;        // Seconds from clip start
+    LampJoints joints; // Pose at this time
+};
+
+struct ClipFileHeader;
+
+struct AnimationClip
+{
+    const char *name;
+    std::vector<Keyframe> keyframes; // Sorted by time, first key at t = 0
+    bool looping;                    // Last key must match the first when looping
+    const ClipFileHeader *binary;    // Mapped clip sampled instead of keyframes, or NULL
+};
+
+struct AnimationPlayer
+{
+    const AnimationClip *clip;
+    Interpolation interpolation;
+    float time;        // Clip-local playback time (seconds)
+    float accumulator; // Elapsed time not yet consumed by fixed steps
+    bool playing;
+};
+
+float clipDuration(const AnimationClip &clip);
+void sampleClip(const AnimationClip &clip, float time, Interpolation mode, LampJoints &joints);
+
+void startPlayback(AnimationPlayer &player, const AnimationClip *clip);
+int advancePlayback(AnimationPlayer &player, float elapsedSeconds);
+
+// Built-in clips
+AnimationClip createHopClip();
+AnimationClip createLookAroundClip();
+
+#endif // ANIMATION_H
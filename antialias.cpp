@@ -0,0 +1,517 @@
+/*
+ * Anti-Aliasing and Adaptive Render Quality - implementation
+ */
+
+#include "antialias.h"
+
+#include "shader.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+// Internal resolutions of the quality ladder, after the sample counts
+static const float SCALE_STEPS[] = {1.0f, 0.85f, 0.7f, 0.5f};
+static const int SCALE_STEP_COUNT = sizeof(SCALE_STEPS) / sizeof(SCALE_STEPS[0]);
+
+// Jitter pattern length (Halton 2,3 points)
+static const int JITTER_COUNT = 8;
+
+// Share of the history in each TAA output pixel
+static const float TAA_HISTORY_WEIGHT = 0.9f;
+
+// Adaptive controller: step down after a few frames over the budget,
+// step up only after a long run with clear headroom, since the next
+// level up costs more than this one
+static const double ADAPTIVE_SMOOTHING = 0.2;   // Weight of the newest sample
+static const double ADAPTIVE_HEADROOM = 0.6;    // Budget share that counts as headroom
+static const int ADAPTIVE_STEP_DOWN_FRAMES = 5;
+static const int ADAPTIVE_STEP_UP_FRAMES = 60;
+
+/**
+ * Halton low-discrepancy sequence
+ * @param index - Position in the sequence, from 1
+ * @param base - Prime base
+ * @return Value in (0, 1)
+ */
+static float halton(int index, int base)
+{
+    float result = 0.0f;
+    float fraction = 1.0f / base;
+    while (index > 0)
+    {
+        result += fraction * (index % base);
+        index /= base;
+        fraction /= base;
+    }
+    return result;
+}
+
+/**
+ * Create an uninitialized, clamped texture for a render target
+ * @param internalFormat - GL_RGBA8 or GL_DEPTH_COMPONENT24
+ * @param filter - GL_LINEAR for color that gets scaled, GL_NEAREST for depth
+ */
+static GLuint createTargetTexture(GLenum internalFormat, GLenum format, GLenum type, GLenum filter, int width,
+                                  int height)
+{
+    GLuint texture = 0;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return texture;
+}
+
+static void deleteSceneAttachments(AntialiasTarget &target)
+{
+    glDeleteFramebuffers(1, &target.multisampleFramebuffer);
+    glDeleteRenderbuffers(1, &target.multisampleColor);
+    glDeleteRenderbuffers(1, &target.multisampleDepth);
+    glDeleteFramebuffers(1, &target.sceneFramebuffer);
+    glDeleteTextures(1, &target.sceneColor);
+    glDeleteTextures(1, &target.sceneDepth);
+    target.multisampleFramebuffer = target.multisampleColor = target.multisampleDepth = 0;
+    target.sceneFramebuffer = target.sceneColor = target.sceneDepth = 0;
+    target.width = target.height = 0;
+}
+
+static void deleteHistory(AntialiasTarget &target)
+{
+    glDeleteFramebuffers(2, target.historyFramebuffers);
+    glDeleteTextures(2, target.historyTextures);
+    for (int i = 0; i < 2; i++)
+    {
+        target.historyFramebuffers[i] = target.historyTextures[i] = 0;
+    }
+    target.historyWidth = target.historyHeight = 0;
+    target.historyValid = false;
+}
+
+/**
+ * (Re)allocate the scene attachments at the internal resolution
+ * Under MSAA the scene is drawn into multisampled renderbuffers and the
+ * textures receive the resolve; otherwise it is drawn into the textures.
+ */
+static void allocateSceneAttachments(AntialiasTarget &target, int width, int height)
+{
+    deleteSceneAttachments(target);
+    target.width = width;
+    target.height = height;
+    target.allocatedSamples = target.samples;
+
+    target.sceneColor = createTargetTexture(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, GL_LINEAR, width, height);
+    target.sceneDepth =
+        createTargetTexture(GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, GL_NEAREST, width, height);
+    glGenFramebuffers(1, &target.sceneFramebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, target.sceneFramebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target.sceneColor, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, target.sceneDepth, 0);
+
+    if (target.samples > 0)
+    {
+        glGenRenderbuffers(1, &target.multisampleColor);
+        glBindRenderbuffer(GL_RENDERBUFFER, target.multisampleColor);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, target.samples, GL_RGBA8, width, height);
+        glGenRenderbuffers(1, &target.multisampleDepth);
+        glBindRenderbuffer(GL_RENDERBUFFER, target.multisampleDepth);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, target.samples, GL_DEPTH_COMPONENT24, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        glGenFramebuffers(1, &target.multisampleFramebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, target.multisampleFramebuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, target.multisampleColor);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, target.multisampleDepth);
+    }
+}
+
+/**
+ * (Re)allocate both history textures at the output resolution
+ */
+static void allocateHistory(AntialiasTarget &target)
+{
+    deleteHistory(target);
+    target.historyWidth = target.outputWidth;
+    target.historyHeight = target.outputHeight;
+    glGenFramebuffers(2, target.historyFramebuffers);
+    for (int i = 0; i < 2; i++)
+    {
+        target.historyTextures[i] = createTargetTexture(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, GL_LINEAR,
+                                                        target.historyWidth, target.historyHeight);
+        glBindFramebuffer(GL_FRAMEBUFFER, target.historyFramebuffers[i]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target.historyTextures[i], 0);
+    }
+    target.history = 0;
+}
+
+bool createAntialiasTarget(AntialiasTarget &target, bool coreProfile, int maxSamples)
+{
+    target.mode = ANTIALIAS_OFF;
+    target.samples = 0;
+    target.scale = 1.0f;
+    target.outputWidth = target.outputHeight = 1;
+    target.width = target.height = 0;
+    target.allocatedSamples = 0;
+    target.multisampleFramebuffer = target.multisampleColor = target.multisampleDepth = 0;
+    target.sceneFramebuffer = target.sceneColor = target.sceneDepth = 0;
+    for (int i = 0; i < 2; i++)
+    {
+        target.historyFramebuffers[i] = target.historyTextures[i] = 0;
+    }
+    target.historyWidth = target.historyHeight = 0;
+    target.history = 0;
+    target.historyValid = false;
+    target.jitterIndex = 0;
+    target.jitter[0] = target.jitter[1] = 0.0f;
+    target.previousViewProjection = mat4Identity();
+    target.resolveProgram = 0;
+    target.screenQuad.vertexBuffer = target.screenQuad.indexBuffer = target.screenQuad.vertexArray = 0;
+    target.active = false;
+    target.outputFramebuffer = 0;
+
+    if (!isGLVersionAtLeast(3, 0))
+    {
+        return false;
+    }
+    GLint driverSamples = 0;
+    glGetIntegerv(GL_MAX_SAMPLES, &driverSamples);
+    target.maxSamples = std::min(maxSamples, (int)driverSamples);
+
+    target.resolveProgram = createTemporalResolveProgram(coreProfile);
+    if (target.resolveProgram == 0)
+    {
+        return false;
+    }
+    glUseProgram(target.resolveProgram);
+    glUniform1i(glGetUniformLocation(target.resolveProgram, "currentColor"), TAA_COLOR_TEXTURE_UNIT);
+    glUniform1i(glGetUniformLocation(target.resolveProgram, "currentDepth"), TAA_DEPTH_TEXTURE_UNIT);
+    glUniform1i(glGetUniformLocation(target.resolveProgram, "historyColor"), TAA_HISTORY_TEXTURE_UNIT);
+    glUseProgram(0);
+    target.reprojectionLocation = glGetUniformLocation(target.resolveProgram, "reprojection");
+    target.jitterLocation = glGetUniformLocation(target.resolveProgram, "jitter");
+    target.historyWeightLocation = glGetUniformLocation(target.resolveProgram, "historyWeight");
+
+    // The grid mesh spans [-1, 1] in x and z: the whole screen
+    target.screenQuad = createGridMesh(2.0f, 1);
+    return true;
+}
+
+void deleteAntialiasTarget(AntialiasTarget &target)
+{
+    deleteSceneAttachments(target);
+    deleteHistory(target);
+    deleteMesh(target.screenQuad);
+    glDeleteProgram(target.resolveProgram);
+    target.resolveProgram = 0;
+}
+
+/**
+ * Steps of the ladder that lower the sample count: maxSamples, half of
+ * it, ... down to 2x under MSAA; a single step otherwise
+ */
+static int sampleStepCount(const AntialiasTarget &target)
+{
+    int steps = 1;
+    if (target.mode == ANTIALIAS_MSAA)
+    {
+        for (int samples = target.maxSamples; samples > 2; samples /= 2)
+        {
+            steps++;
+        }
+    }
+    return steps;
+}
+
+static int qualityLevelCount(const AntialiasTarget &target)
+{
+    return sampleStepCount(target) + SCALE_STEP_COUNT - 1;
+}
+
+/**
+ * Set samples and scale for a ladder level: the sample steps at full
+ * resolution, then the fewest samples at each smaller scale
+ * @param level - 0 for the best quality
+ */
+static void applyQualityLevel(AntialiasTarget &target, int level)
+{
+    int sampleSteps = sampleStepCount(target);
+    int sampleStep = std::min(level, sampleSteps - 1);
+    target.samples = target.mode == ANTIALIAS_MSAA && target.maxSamples >= 2 ? target.maxSamples >> sampleStep : 0;
+    target.scale = SCALE_STEPS[std::max(0, level - sampleSteps + 1)];
+}
+
+/**
+ * Switch mode and restart the ladder at its top
+ * The TAA history is dropped, so the first frame blends nothing stale.
+ */
+void setAntialiasMode(AntialiasTarget &target, AdaptiveQuality &quality, AntialiasMode mode)
+{
+    target.mode = mode;
+    target.historyValid = false;
+    quality.level = 0;
+    quality.levelSamples = 0;
+    quality.overBudget = quality.withHeadroom = 0;
+    applyQualityLevel(target, 0);
+}
+
+void resizeAntialiasTarget(AntialiasTarget &target, int width, int height)
+{
+    target.outputWidth = width;
+    target.outputHeight = height;
+}
+
+/**
+ * Bind the target the scene is drawn into and clear it
+ * Without anti-aliasing at full resolution the output framebuffer itself
+ * is used, so that path draws exactly as it did without the target.
+ */
+void beginAntialiasFrame(AntialiasTarget &target)
+{
+    target.active = target.mode != ANTIALIAS_OFF || target.scale < 1.0f;
+    if (!target.active)
+    {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        return;
+    }
+
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &target.outputFramebuffer);
+    int width = std::max(1, (int)lroundf(target.outputWidth * target.scale));
+    int height = std::max(1, (int)lroundf(target.outputHeight * target.scale));
+    if (width != target.width || height != target.height || target.samples != target.allocatedSamples)
+    {
+        allocateSceneAttachments(target, width, height);
+    }
+    if (target.mode == ANTIALIAS_TAA)
+    {
+        if (target.historyWidth != target.outputWidth || target.historyHeight != target.outputHeight)
+        {
+            allocateHistory(target);
+        }
+        target.jitterIndex = (target.jitterIndex + 1) % JITTER_COUNT;
+        target.jitter[0] = halton(target.jitterIndex + 1, 2) - 0.5f;
+        target.jitter[1] = halton(target.jitterIndex + 1, 3) - 0.5f;
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, target.samples > 0 ? target.multisampleFramebuffer : target.sceneFramebuffer);
+    glViewport(0, 0, target.width, target.height);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+int antialiasRenderWidth(const AntialiasTarget &target)
+{
+    return target.active ? target.width : target.outputWidth;
+}
+
+int antialiasRenderHeight(const AntialiasTarget &target)
+{
+    return target.active ? target.height : target.outputHeight;
+}
+
+/**
+ * Offset the projection by this frame's jitter: a translation in
+ * normalized device coordinates, applied after the projection
+ */
+Mat4 antialiasProjection(const AntialiasTarget &target, const Mat4 &projection)
+{
+    if (!target.active || target.mode != ANTIALIAS_TAA)
+    {
+        return projection;
+    }
+    Mat4 offset = mat4Identity();
+    offset.m[12] = 2.0f * target.jitter[0] / target.width;
+    offset.m[13] = 2.0f * target.jitter[1] / target.height;
+    return mat4Multiply(offset, projection);
+}
+
+/**
+ * Blend the jittered frame into the history with the resolve program
+ * @param viewProjection - This frame's unjittered world-to-clip matrix
+ * @param inverseViewProjection - Its inverse
+ */
+static void resolveTemporal(AntialiasTarget &target, const Mat4 &viewProjection, const Mat4 &inverseViewProjection)
+{
+    int next = 1 - target.history;
+    glBindFramebuffer(GL_FRAMEBUFFER, target.historyFramebuffers[next]);
+    glViewport(0, 0, target.historyWidth, target.historyHeight);
+
+    GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+    GLboolean blend = glIsEnabled(GL_BLEND);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_BLEND);
+
+    const GLenum units[3] = {TAA_COLOR_TEXTURE_UNIT, TAA_DEPTH_TEXTURE_UNIT, TAA_HISTORY_TEXTURE_UNIT};
+    const GLuint textures[3] = {target.sceneColor, target.sceneDepth, target.historyTextures[target.history]};
+    for (int i = 0; i < 3; i++)
+    {
+        glActiveTexture(GL_TEXTURE0 + units[i]);
+        glBindTexture(GL_TEXTURE_2D, textures[i]);
+    }
+    glActiveTexture(GL_TEXTURE0);
+
+    Mat4 reprojection = mat4Multiply(target.previousViewProjection, inverseViewProjection);
+    glUseProgram(target.resolveProgram);
+    glUniformMatrix4fv(target.reprojectionLocation, 1, GL_FALSE, reprojection.m);
+    glUniform2f(target.jitterLocation, target.jitter[0] / target.width, target.jitter[1] / target.height);
+    glUniform1f(target.historyWeightLocation, target.historyValid ? TAA_HISTORY_WEIGHT : 0.0f);
+    drawMesh(target.screenQuad);
+    glUseProgram(0);
+
+    for (int i = 0; i < 3; i++)
+    {
+        glActiveTexture(GL_TEXTURE0 + units[i]);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+    glActiveTexture(GL_TEXTURE0);
+    if (depthTest)
+    {
+        glEnable(GL_DEPTH_TEST);
+    }
+    if (blend)
+    {
+        glEnable(GL_BLEND);
+    }
+
+    target.previousViewProjection = viewProjection;
+    target.history = next;
+    target.historyValid = true;
+}
+
+/**
+ * MSAA: resolve the samples into the scene texture. TAA: blend into the
+ * history. Then copy the result onto the output, scaled up with linear
+ * filtering if drawn below the output resolution.
+ */
+void resolveAntialiasFrame(AntialiasTarget &target, const Mat4 &projection, const Mat4 &view)
+{
+    if (!target.active)
+    {
+        return;
+    }
+
+    if (target.samples > 0)
+    {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, target.multisampleFramebuffer);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target.sceneFramebuffer);
+        glBlitFramebuffer(0, 0, target.width, target.height, 0, 0, target.width, target.height,
+                          GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    }
+
+    GLuint source = target.sceneFramebuffer;
+    int sourceWidth = target.width;
+    int sourceHeight = target.height;
+    if (target.mode == ANTIALIAS_TAA)
+    {
+        Mat4 viewProjection = mat4Multiply(projection, view);
+        Mat4 inverse = mat4Multiply(mat4InverseRigid(view), mat4InversePerspective(projection));
+        resolveTemporal(target, viewProjection, inverse);
+        source = target.historyFramebuffers[target.history];
+        sourceWidth = target.historyWidth;
+        sourceHeight = target.historyHeight;
+    }
+
+    bool scaled = sourceWidth != target.outputWidth || sourceHeight != target.outputHeight;
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, source);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target.outputFramebuffer);
+    glBlitFramebuffer(0, 0, sourceWidth, sourceHeight, 0, 0, target.outputWidth, target.outputHeight,
+                      GL_COLOR_BUFFER_BIT, scaled ? GL_LINEAR : GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, target.outputFramebuffer);
+    glViewport(0, 0, target.outputWidth, target.outputHeight);
+}
+
+void initAdaptiveQuality(AdaptiveQuality &quality, double budgetMs)
+{
+    quality.enabled = false;
+    quality.budgetMs = budgetMs;
+    quality.smoothedMs = 0.0;
+    quality.levelSamples = 0;
+    quality.lastFrame = 0;
+    quality.sampled = false;
+    quality.overBudget = 0;
+    quality.withHeadroom = 0;
+    quality.level = 0;
+}
+
+/**
+ * Average the frame's cost into the current level and step the ladder
+ * A frame costs the longer of its CPU and GPU time, which is what has to
+ * fit between two vsyncs. The average restarts on every step, so frames
+ * drawn at the old quality do not trigger another one.
+ * @param sample - Newest completed frame sample (lastFrameSample())
+ */
+bool updateAdaptiveQuality(AdaptiveQuality &quality, AntialiasTarget &target, const FrameSample &sample)
+{
+    if (!quality.enabled || (quality.sampled && sample.frame == quality.lastFrame))
+    {
+        return false;
+    }
+    quality.sampled = true;
+    quality.lastFrame = sample.frame;
+
+    double ms = std::max(sample.cpuMs, sample.gpuMs);
+    quality.smoothedMs =
+        quality.levelSamples == 0 ? ms : quality.smoothedMs + ADAPTIVE_SMOOTHING * (ms - quality.smoothedMs);
+    quality.levelSamples++;
+    if (quality.smoothedMs > quality.budgetMs)
+    {
+        quality.overBudget++;
+        quality.withHeadroom = 0;
+    }
+    else if (quality.smoothedMs < ADAPTIVE_HEADROOM * quality.budgetMs)
+    {
+        quality.withHeadroom++;
+        quality.overBudget = 0;
+    }
+    else
+    {
+        quality.overBudget = quality.withHeadroom = 0;
+    }
+
+    int level = quality.level;
+    if (quality.overBudget >= ADAPTIVE_STEP_DOWN_FRAMES && level < qualityLevelCount(target) - 1)
+    {
+        level++;
+    }
+    else if (quality.withHeadroom >= ADAPTIVE_STEP_UP_FRAMES && level > 0)
+    {
+        level--;
+    }
+    if (level == quality.level)
+    {
+        return false;
+    }
+    quality.level = level;
+    quality.levelSamples = 0;
+    quality.overBudget = quality.withHeadroom = 0;
+    applyQualityLevel(target, level);
+    return true;
+}
+
+const char *antialiasModeName(AntialiasMode mode)
+{
+    static const char *NAMES[ANTIALIAS_MODE_COUNT] = {"off", "MSAA", "TAA"};
+    return NAMES[mode];
+}
+
+std::string describeAntialias(const AntialiasTarget &target)
+{
+    char buffer[64];
+    if (target.mode == ANTIALIAS_MSAA)
+    {
+        snprintf(buffer, sizeof(buffer), "MSAA %dx", target.samples);
+    }
+    else
+    {
+        snprintf(buffer, sizeof(buffer), "%s", antialiasModeName(target.mode));
+    }
+    std::string description = buffer;
+    if (target.scale < 1.0f)
+    {
+        snprintf(buffer, sizeof(buffer), ", %d%% resolution", (int)lroundf(100.0f * target.scale));
+        description += buffer;
+    }
+    return description;
+}
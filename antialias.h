@@ -0,0 +1,142 @@
+/*
+ * Anti-Aliasing and Adaptive Render Quality
+ *
+ * The window is created without multisampling, so thin arm silhouettes
+ * crawl as the lamp turns. With anti-aliasing on, the scene is drawn
+ * into an offscreen target and resolved onto the window (or benchmark
+ * target) before the overlay, which stays sharp at full resolution:
+ * - MSAA: multisampled color and depth, resolved with a blit.
+ * - TAA: one sample per pixel, but every frame's projection is offset by
+ *   a different sub-pixel jitter (Halton 2,3) and blended into a history
+ *   at output resolution. The history is reprojected through the depth
+ *   buffer, so a moving camera keeps it; clamping it to the current
+ *   frame's neighborhood keeps moving lamps from ghosting.
+ *
+ * The target can also render below the output resolution and scale up.
+ * The adaptive controller walks a quality ladder - fewer MSAA samples
+ * first, then a smaller internal resolution - down when frames miss the
+ * vsync budget and back up when there is headroom again. It reads the
+ * frame-time instrumentation of stats.h, so it only reacts to frames that
+ * were actually drawn; an idle scene keeps its quality.
+ */
+
+#ifndef ANTIALIAS_H
+#define ANTIALIAS_H
+
+#include "opengl.h"
+#include "matrix.h"
+#include "mesh.h"
+#include "stats.h"
+
+#include <string>
+
+enum AntialiasMode
+{
+    ANTIALIAS_OFF = 0,
+    ANTIALIAS_MSAA,
+    ANTIALIAS_TAA,
+    ANTIALIAS_MODE_COUNT
+};
+
+// Texture units of the TAA resolve (after those of shadow.h and lights.h)
+const GLenum TAA_COLOR_TEXTURE_UNIT = 5;
+const GLenum TAA_DEPTH_TEXTURE_UNIT = 6;
+const GLenum TAA_HISTORY_TEXTURE_UNIT = 7;
+
+// Frames the TAA history needs to converge on a still image
+const int TAA_SETTLE_FRAMES = 16;
+
+struct AntialiasTarget
+{
+    AntialiasMode mode;
+    int maxSamples; // MSAA samples at full quality
+    int samples;    // MSAA samples now (fewer when the controller steps down)
+    float scale;    // Internal resolution / output resolution
+    int outputWidth;
+    int outputHeight;
+
+    // Attachments at the internal resolution; reallocated when it or the
+    // sample count changes
+    int width;
+    int height;
+    int allocatedSamples;
+    GLuint multisampleFramebuffer; // Only with samples > 0
+    GLuint multisampleColor;
+    GLuint multisampleDepth;
+    GLuint sceneFramebuffer; // Single-sample scene, or the MSAA resolve
+    GLuint sceneColor;       // RGBA8 texture
+    GLuint sceneDepth;       // Depth texture, read by the TAA resolve
+
+    // TAA at output resolution: the newest history and the one before
+    GLuint historyFramebuffers[2];
+    GLuint historyTextures[2];
+    int historyWidth; // Size the history was allocated at
+    int historyHeight;
+    int history; // Index of the newest
+    bool historyValid;
+    int jitterIndex;
+    float jitter[2]; // This frame's offset, in internal pixels
+    Mat4 previousViewProjection;
+    GLuint resolveProgram;
+    GLint reprojectionLocation;
+    GLint jitterLocation;
+    GLint historyWeightLocation;
+    Mesh screenQuad;
+
+    bool active; // This frame is drawn through the target
+    GLint outputFramebuffer;
+};
+
+// Frame-time driven quality ladder over an AntialiasTarget
+struct AdaptiveQuality
+{
+    bool enabled;
+    double budgetMs;         // Frame time that keeps up with vsync
+    double smoothedMs;       // Average of the frame times at this level
+    int levelSamples;        // Samples averaged into smoothedMs
+    unsigned long lastFrame; // Newest sample already taken into account
+    bool sampled;            // lastFrame is valid
+    int overBudget;          // Consecutive samples over the budget
+    int withHeadroom;        // Consecutive samples well under it
+    int level;               // 0 = best quality of the ladder
+};
+
+// Build the TAA program and screen quad (GL 3.0+ for framebuffer objects);
+// false if anti-aliasing is unavailable. maxSamples is clamped to the
+// driver's limit.
+bool createAntialiasTarget(AntialiasTarget &target, bool coreProfile, int maxSamples);
+void deleteAntialiasTarget(AntialiasTarget &target);
+
+// Switch mode; the quality ladder restarts at its top
+void setAntialiasMode(AntialiasTarget &target, AdaptiveQuality &quality, AntialiasMode mode);
+
+// Output size (the window or benchmark target), from reshape()
+void resizeAntialiasTarget(AntialiasTarget &target, int width, int height);
+
+// Bind the scene target (if this frame needs one), set the viewport to
+// the internal resolution and clear color and depth
+void beginAntialiasFrame(AntialiasTarget &target);
+
+// Internal resolution of the frame being drawn
+int antialiasRenderWidth(const AntialiasTarget &target);
+int antialiasRenderHeight(const AntialiasTarget &target);
+
+// Projection to draw the frame with: the camera's, jittered under TAA
+Mat4 antialiasProjection(const AntialiasTarget &target, const Mat4 &projection);
+
+// Resolve the frame onto the output framebuffer and restore the output
+// viewport; projection and view are the frame's unjittered camera
+void resolveAntialiasFrame(AntialiasTarget &target, const Mat4 &projection, const Mat4 &view);
+
+// Start the controller on a budget (milliseconds per frame)
+void initAdaptiveQuality(AdaptiveQuality &quality, double budgetMs);
+
+// Feed the newest frame sample; steps the ladder and returns true if the
+// target's samples or scale changed
+bool updateAdaptiveQuality(AdaptiveQuality &quality, AntialiasTarget &target, const FrameSample &sample);
+
+// E.g. "MSAA 4x", "TAA, 70% resolution"; for the overlay and console
+std::string describeAntialias(const AntialiasTarget &target);
+const char *antialiasModeName(AntialiasMode mode);
+
+#endif // ANTIALIAS_H
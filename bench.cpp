@@ -0,0 +1,468 @@
+/*
+ * Headless Benchmark Support - implementation
+ */
+
+#include "bench.h"
+
+#include "animation.h"
+#include "kinematics.h"
+#include "physics.h"
+#include "posebatch.h"
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+static EGLDisplay headlessDisplay = EGL_NO_DISPLAY;
+static EGLContext headlessContext = EGL_NO_CONTEXT;
+static EGLSurface headlessSurface = EGL_NO_SURFACE;
+
+/**
+ * Open an EGL display that works without a display server
+ * The default display covers GPU drivers; Mesa needs its surfaceless
+ * platform when neither X11 nor Wayland is available.
+ */
+static EGLDisplay openHeadlessDisplay()
+{
+    EGLint major = 0;
+    EGLint minor = 0;
+    EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (display != EGL_NO_DISPLAY && eglInitialize(display, &major, &minor))
+    {
+        return display;
+    }
+
+    const char *extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    if (extensions == NULL || strstr(extensions, "EGL_MESA_platform_surfaceless") == NULL)
+    {
+        return EGL_NO_DISPLAY;
+    }
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (getPlatformDisplay == NULL)
+    {
+        return EGL_NO_DISPLAY;
+    }
+    display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    if (display != EGL_NO_DISPLAY && eglInitialize(display, &major, &minor))
+    {
+        return display;
+    }
+    return EGL_NO_DISPLAY;
+}
+
+/**
+ * Create a desktop OpenGL context and make it current
+ * A 1x1 pbuffer is bound as the default surface; rendering goes to an
+ * OffscreenTarget so the benchmark resolution is not limited by it.
+ * @param coreProfile - Request a 3.3 core profile instead of the default
+ *                      compatibility context
+ */
+bool createHeadlessContext(bool coreProfile)
+{
+    headlessDisplay = openHeadlessDisplay();
+    if (headlessDisplay == EGL_NO_DISPLAY)
+    {
+        std::cerr << "Headless: no usable EGL display" << std::endl;
+        return false;
+    }
+
+    const EGLint configAttributes[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE, 8,
+        EGL_DEPTH_SIZE, 24,
+        EGL_NONE};
+    EGLConfig config;
+    EGLint configCount = 0;
+    if (!eglChooseConfig(headlessDisplay, configAttributes, &config, 1, &configCount) || configCount == 0)
+    {
+        std::cerr << "Headless: no EGL config for desktop OpenGL pbuffers" << std::endl;
+        destroyHeadlessContext();
+        return false;
+    }
+
+    if (!eglBindAPI(EGL_OPENGL_API))
+    {
+        std::cerr << "Headless: EGL cannot create desktop OpenGL contexts" << std::endl;
+        destroyHeadlessContext();
+        return false;
+    }
+
+    // No attributes: the default is a compatibility context, which the
+    // fixed-function renderer requires; the core renderer asks for 3.3 core
+    const EGLint coreAttributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE};
+    headlessContext = eglCreateContext(headlessDisplay, config, EGL_NO_CONTEXT, coreProfile ? coreAttributes : NULL);
+    const EGLint surfaceAttributes[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+    headlessSurface = eglCreatePbufferSurface(headlessDisplay, config, surfaceAttributes);
+    if (headlessContext == EGL_NO_CONTEXT || headlessSurface == EGL_NO_SURFACE ||
+        !eglMakeCurrent(headlessDisplay, headlessSurface, headlessSurface, headlessContext))
+    {
+        std::cerr << "Headless: failed to create EGL context (error 0x" << std::hex << eglGetError() << std::dec
+                  << ")" << std::endl;
+        destroyHeadlessContext();
+        return false;
+    }
+    return true;
+}
+
+void destroyHeadlessContext()
+{
+    if (headlessDisplay == EGL_NO_DISPLAY)
+    {
+        return;
+    }
+    eglMakeCurrent(headlessDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (headlessSurface != EGL_NO_SURFACE)
+    {
+        eglDestroySurface(headlessDisplay, headlessSurface);
+    }
+    if (headlessContext != EGL_NO_CONTEXT)
+    {
+        eglDestroyContext(headlessDisplay, headlessContext);
+    }
+    eglTerminate(headlessDisplay);
+    headlessDisplay = EGL_NO_DISPLAY;
+    headlessContext = EGL_NO_CONTEXT;
+    headlessSurface = EGL_NO_SURFACE;
+}
+
+/**
+ * Create an RGBA8 + depth framebuffer object and bind it for drawing
+ * @param target - Receives the handles
+ * @param width - Width in pixels
+ * @param height - Height in pixels
+ * @return false (with nothing bound) if the framebuffer is incomplete
+ */
+bool createOffscreenTarget(OffscreenTarget &target, int width, int height)
+{
+    target.width = width;
+    target.height = height;
+
+    glGenRenderbuffers(1, &target.colorBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, target.colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+    glGenRenderbuffers(1, &target.depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, target.depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &target.framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, target.colorBuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, target.depthBuffer);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        std::cerr << "Headless: offscreen framebuffer " << width << "x" << height << " is incomplete" << std::endl;
+        deleteOffscreenTarget(target);
+        return false;
+    }
+    return true;
+}
+
+void deleteOffscreenTarget(OffscreenTarget &target)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &target.framebuffer);
+    glDeleteRenderbuffers(1, &target.colorBuffer);
+    glDeleteRenderbuffers(1, &target.depthBuffer);
+    target.framebuffer = 0;
+    target.colorBuffer = 0;
+    target.depthBuffer = 0;
+}
+
+/**
+ * Report the distribution of frame times on stdout
+ * @param frameMs - One entry per measured frame (copied, then sorted)
+ */
+void printFrameTimeSummary(std::vector<double> frameMs)
+{
+    if (frameMs.empty())
+    {
+        std::cout << "No frames measured" << std::endl;
+        return;
+    }
+
+    std::sort(frameMs.begin(), frameMs.end());
+    size_t count = frameMs.size();
+    double total = 0.0;
+    for (size_t i = 0; i < count; i++)
+    {
+        total += frameMs[i];
+    }
+
+    // Nearest-rank percentiles
+    size_t p99Rank = (count * 99 + 99) / 100;
+    char line[160];
+    snprintf(line, sizeof(line), "Frame time (ms): min %.3f  median %.3f  p99 %.3f  mean %.3f  (%zu frames)",
+             frameMs.front(), frameMs[(count - 1) / 2], frameMs[p99Rank - 1], total / count, count);
+    std::cout << line << std::endl;
+}
+
+// Everything one kinematics benchmark size works on
+struct KinematicsBenchData
+{
+    std::vector<Mat4> placements;
+    std::vector<LampJoints> joints;
+    std::vector<LampPose> perLampPoses;
+    LampBatch batch;
+    LampPoseBatch batchPoses;
+};
+
+// Shortest time each strategy is repeated for, per lamp count
+static const double KINEMATICS_BENCH_SECONDS = 0.2;
+
+static float uniform(unsigned int &state, float low, float high)
+{
+    state = state * 1664525u + 1013904223u;
+    return low + (high - low) * (float)(state >> 8) / (float)0x1000000;
+}
+
+/**
+ * Random lamps within the joint limits, stored both ways
+ */
+static void fillKinematicsBench(KinematicsBenchData &data, size_t count)
+{
+    unsigned int state = 12345u;
+    data.placements.resize(count);
+    data.joints.resize(count);
+    data.perLampPoses.resize(count);
+    resizeLampBatch(data.batch, count);
+    for (size_t i = 0; i < count; i++)
+    {
+        float x = uniform(state, -50.0f, 50.0f);
+        float z = uniform(state, -50.0f, 50.0f);
+        float heading = uniform(state, 0.0f, 360.0f);
+        float scale = uniform(state, 0.2f, 0.5f);
+        data.placements[i] = mat4Identity();
+        mat4Translate(data.placements[i], x, 0.0f, z);
+        mat4Rotate(data.placements[i], heading, 0.0f, 1.0f, 0.0f);
+        mat4Scale(data.placements[i], scale, scale, scale);
+        setLampBatchPlacement(data.batch, i, x, z, heading, scale);
+
+        LampJoints &joints = data.joints[i];
+        joints.baseRotation = uniform(state, -180.0f, 180.0f);
+        joints.lowerArmAngle = uniform(state, LOWER_ARM_MIN, LOWER_ARM_MAX);
+        joints.upperArmAngle = uniform(state, UPPER_ARM_MIN, UPPER_ARM_MAX);
+        joints.lampshadeAngle = uniform(state, LAMPSHADE_MIN, LAMPSHADE_MAX);
+        joints.lampshadeRotation = uniform(state, 0.0f, 360.0f);
+        setLampBatchJoints(data.batch, i, joints);
+    }
+}
+
+/**
+ * The path the crowd used before batching: computeLampPose() per lamp,
+ * then every part matrix and the spotlight moved by the placement
+ */
+static void evaluatePerLamp(KinematicsBenchData &data)
+{
+    for (size_t i = 0; i < data.joints.size(); i++)
+    {
+        const Mat4 &placement = data.placements[i];
+        LampPose local;
+        computeLampPose(data.joints[i], local);
+
+        LampPose &pose = data.perLampPoses[i];
+        pose.base = mat4Multiply(placement, local.base);
+        pose.lowerJoint = mat4Multiply(placement, local.lowerJoint);
+        pose.lowerArm = mat4Multiply(placement, local.lowerArm);
+        pose.upperJoint = mat4Multiply(placement, local.upperJoint);
+        pose.upperArm = mat4Multiply(placement, local.upperArm);
+        pose.shadeJoint = mat4Multiply(placement, local.shadeJoint);
+        pose.lampshade = mat4Multiply(placement, local.lampshade);
+        mat4TransformPoint(placement, local.spotPosition, pose.spotPosition);
+        mat4TransformDirection(placement, local.spotDirection, pose.spotDirection);
+    }
+}
+
+/**
+ * Time one strategy, keeping the fastest of repeated runs
+ * @param kernel - Batch kernel, or POSE_KERNEL_COUNT for the per-lamp path
+ * @return Nanoseconds per lamp
+ */
+static double timeKinematics(KinematicsBenchData &data, int kernel)
+{
+    typedef std::chrono::steady_clock Clock;
+    double best = 0.0;
+    double total = 0.0;
+    for (int run = 0; run < 3 || total < KINEMATICS_BENCH_SECONDS; run++)
+    {
+        Clock::time_point start = Clock::now();
+        if (kernel == POSE_KERNEL_COUNT)
+        {
+            evaluatePerLamp(data);
+        }
+        else
+        {
+            computeLampPosesWith((PoseKernel)kernel, data.batch, data.batchPoses);
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        best = run == 0 ? seconds : std::min(best, seconds);
+        total += seconds;
+    }
+    return best * 1e9 / data.joints.size();
+}
+
+/**
+ * Largest difference between the batch results and the per-lamp path
+ * (spot directions compared as unit vectors)
+ */
+static float maxKinematicsError(const KinematicsBenchData &data)
+{
+    float error = 0.0f;
+    for (size_t i = 0; i < data.joints.size(); i++)
+    {
+        const LampPose &pose = data.perLampPoses[i];
+        const Mat4 *parts[POSE_PART_COUNT] = {&pose.base,     &pose.lowerJoint, &pose.lowerArm, &pose.upperJoint,
+                                              &pose.upperArm, &pose.shadeJoint, &pose.lampshade};
+        for (int part = 0; part < POSE_PART_COUNT; part++)
+        {
+            Mat4 batched = lampPoseMatrix(data.batchPoses, (PosePart)part, i);
+            for (int k = 0; k < 16; k++)
+            {
+                error = std::max(error, fabsf(batched.m[k] - parts[part]->m[k]));
+            }
+        }
+
+        const float *direction = pose.spotDirection;
+        float length = sqrtf(direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2]);
+        for (int axis = 0; axis < 3; axis++)
+        {
+            error = std::max(error, fabsf(data.batchPoses.spotPosition[axis][i] - pose.spotPosition[axis]));
+            error = std::max(error, fabsf(data.batchPoses.spotDirection[axis][i] - direction[axis] / length));
+        }
+    }
+    return error;
+}
+
+/**
+ * Per-lamp vs batched kinematics at three crowd sizes
+ * Prints nanoseconds per lamp and the speedup over the per-lamp path,
+ * then the largest deviation of each kernel from it.
+ */
+int runKinematicsBenchmark()
+{
+    static const size_t counts[] = {1000, 10000, 100000};
+
+    std::vector<int> kernels;
+    for (int kernel = 0; kernel < POSE_KERNEL_COUNT; kernel++)
+    {
+        if (poseKernelSupported((PoseKernel)kernel))
+        {
+            kernels.push_back(kernel);
+        }
+    }
+
+    char line[200];
+    std::cout << "Lamp kinematics, ns per lamp (speedup over per-lamp)" << std::endl;
+    int length = snprintf(line, sizeof(line), "%8s %10s", "lamps", "per-lamp");
+    for (size_t k = 0; k < kernels.size(); k++)
+    {
+        length += snprintf(line + length, sizeof(line) - length, " %16s", poseKernelName((PoseKernel)kernels[k]));
+    }
+    std::cout << line << std::endl;
+
+    std::vector<float> errors(kernels.size(), 0.0f);
+    for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++)
+    {
+        KinematicsBenchData data;
+        fillKinematicsBench(data, counts[c]);
+        double perLamp = timeKinematics(data, POSE_KERNEL_COUNT);
+
+        length = snprintf(line, sizeof(line), "%8zu %10.1f", counts[c], perLamp);
+        for (size_t k = 0; k < kernels.size(); k++)
+        {
+            double batched = timeKinematics(data, kernels[k]);
+            errors[k] = std::max(errors[k], maxKinematicsError(data));
+            length += snprintf(line + length, sizeof(line) - length, " %8.1f (%4.1fx)", batched, perLamp / batched);
+        }
+        std::cout << line << std::endl;
+    }
+
+    length = snprintf(line, sizeof(line), "Max error vs per-lamp:");
+    for (size_t k = 0; k < kernels.size(); k++)
+    {
+        length += snprintf(line + length, sizeof(line) - length, "  %s %.1e", poseKernelName((PoseKernel)kernels[k]),
+                           errors[k]);
+    }
+    std::cout << line << std::endl;
+    std::cout << "Default kernel: " << poseKernelName(bestPoseKernel()) << std::endl;
+    return 0;
+}
+
+// Simulated time per hop physics benchmark size
+static const float PHYSICS_BENCH_SECONDS = 4.0f;
+
+/**
+ * Hop physics at three crowd sizes
+ * Every lamp plays the Hop clip from its own phase, sampled at each
+ * substep as in the application, so the time includes the clip lookups.
+ */
+int runPhysicsBenchmark()
+{
+    typedef std::chrono::steady_clock Clock;
+    static const size_t counts[] = {100, 1000, 10000};
+    const AnimationClip clip = createHopClip();
+    const float duration = clipDuration(clip);
+    const int substeps = (int)(PHYSICS_BENCH_SECONDS / PHYSICS_TIMESTEP);
+
+    char line[160];
+    snprintf(line, sizeof(line), "Hop physics at %.0f Hz, %.0f s of the %s clip", 1.0f / PHYSICS_TIMESTEP,
+             PHYSICS_BENCH_SECONDS, clip.name);
+    std::cout << line << std::endl;
+    snprintf(line, sizeof(line), "%8s %14s %16s %16s %14s", "lamps", "ns per step", "ms per second", "lamps per core",
+             "landings each");
+    std::cout << line << std::endl;
+
+    for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++)
+    {
+        size_t count = counts[c];
+        unsigned int state = 12345u;
+        std::vector<LampBody> bodies(count);
+        std::vector<float> phases(count);
+        LampJoints target;
+        for (size_t i = 0; i < count; i++)
+        {
+            phases[i] = uniform(state, 0.0f, duration);
+            sampleClip(clip, phases[i], INTERPOLATE_CUBIC, target);
+            resetLampBody(bodies[i], target, 0.0f, 0.0f, 1e6f);
+        }
+
+        Clock::time_point start = Clock::now();
+        for (int step = 1; step <= substeps; step++)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                sampleClip(clip, phases[i] + step * PHYSICS_TIMESTEP, INTERPOLATE_CUBIC, target);
+                stepLampBody(bodies[i], target);
+            }
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        int landings = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            landings += bodies[i].landings;
+        }
+        double perStep = seconds * 1e9 / ((double)count * substeps);
+        double perSecond = perStep * count / PHYSICS_TIMESTEP * 1e-6;
+        snprintf(line, sizeof(line), "%8zu %14.1f %16.3f %16.0f %14.1f", count, perStep, perSecond,
+                 1e9 * PHYSICS_TIMESTEP / perStep, (double)landings / count);
+        std::cout << line << std::endl;
+    }
+    return 0;
+}
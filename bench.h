@@ -0,0 +1,49 @@
+/*
+ * Headless Benchmark Support
+ *
+ * Creates an OpenGL context through EGL with no window or display
+ * server, plus an offscreen framebuffer to render into, so frame times
+ * can be measured on machines without a desktop (e.g. CI GPU nodes).
+ *
+ * Also home to the CPU-only kinematics and hop physics microbenchmarks
+ * (--bench-fk, --bench-physics).
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "opengl.h"
+
+#include <vector>
+
+// Framebuffer object with color and depth renderbuffers
+struct OffscreenTarget
+{
+    GLuint framebuffer;
+    GLuint colorBuffer;
+    GLuint depthBuffer;
+    int width;
+    int height;
+};
+
+// Make a compatibility-profile (or 3.3 core-profile) context current
+// without a window; returns false and logs the reason on failure
+bool createHeadlessContext(bool coreProfile);
+void destroyHeadlessContext();
+
+// Create and bind an offscreen target (needs a current context)
+bool createOffscreenTarget(OffscreenTarget &target, int width, int height);
+void deleteOffscreenTarget(OffscreenTarget &target);
+
+// Print min/median/p99/mean of per-frame times in milliseconds
+void printFrameTimeSummary(std::vector<double> frameMs);
+
+// Time per-lamp computeLampPose() against every supported batch kernel at
+// 1k, 10k and 100k lamps and print a table; needs no GL context
+int runKinematicsBenchmark();
+
+// Simulate 100, 1k and 10k lamps hopping through the Hop clip and print
+// the cost per lamp and how many lamps one core keeps in real time
+int runPhysicsBenchmark();
+
+#endif // BENCH_H
@@ -0,0 +1,293 @@
+/*
+ * Frame Sequence Capture - implementation
+ *
+ * Pixel storage is a fixed pool of CAPTURE_WRITE_QUEUE frame buffers
+ * handed back and forth between the render thread (which fills them
+ * from mapped pixel buffers) and the I/O thread (which writes them out),
+ * so a long sequence allocates nothing per frame.
+ */
+
+#include "capture.h"
+
+#include "opengl.h"
+
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct CapturedFrame
+{
+    int frame;
+    std::vector<unsigned char> *pixels; // RGBA, bottom row first
+};
+
+static GLuint pixelBuffers[CAPTURE_RING_SIZE];
+static int slotFrames[CAPTURE_RING_SIZE]; // Frame read into each buffer, -1 if free
+static int nextSlot = 0;
+static int captureWidth = 0;
+static int captureHeight = 0;
+static std::string filePattern;
+
+// Shared with the I/O thread, guarded by writerMutex
+static std::mutex writerMutex;
+static std::condition_variable framesQueued;
+static std::condition_variable bufferFreed;
+static std::deque<CapturedFrame> writeQueue;
+static std::vector<std::vector<unsigned char> *> freeBuffers;
+static bool writerStopping = false;
+static int writeFailures = 0;
+static int writerStalls = 0; // Readbacks that had to wait for the disk
+
+static std::vector<std::vector<unsigned char> > pixelPool;
+static std::thread writer;
+
+/**
+ * True if a file name pattern has exactly one integer conversion
+ * ("%d", optionally zero-padded to a width, e.g. "%04d"); "%%" is allowed
+ */
+static bool isFramePattern(const char *pattern)
+{
+    int conversions = 0;
+    for (const char *c = pattern; *c != '\0'; c++)
+    {
+        if (*c != '%')
+        {
+            continue;
+        }
+        c++;
+        if (*c == '%')
+        {
+            continue;
+        }
+        while (*c >= '0' && *c <= '9')
+        {
+            c++;
+        }
+        if (*c != 'd')
+        {
+            return false;
+        }
+        conversions++;
+    }
+    return conversions == 1;
+}
+
+/**
+ * Encode one frame as a binary PPM (top row first) and write it
+ * @param encoded - Scratch buffer reused between frames
+ * @return false if the file cannot be written
+ */
+static bool writeImage(const CapturedFrame &captured, std::vector<unsigned char> &encoded)
+{
+    char name[1024];
+    snprintf(name, sizeof(name), filePattern.c_str(), captured.frame);
+
+    char header[64];
+    int headerSize = snprintf(header, sizeof(header), "P6\n%d %d\n255\n", captureWidth, captureHeight);
+    encoded.resize(headerSize + (size_t)captureWidth * captureHeight * 3);
+    memcpy(&encoded[0], header, headerSize);
+
+    unsigned char *out = &encoded[headerSize];
+    const std::vector<unsigned char> &pixels = *captured.pixels;
+    for (int y = captureHeight - 1; y >= 0; y--)
+    {
+        const unsigned char *in = &pixels[(size_t)y * captureWidth * 4];
+        for (int x = 0; x < captureWidth; x++, in += 4)
+        {
+            *out++ = in[0];
+            *out++ = in[1];
+            *out++ = in[2];
+        }
+    }
+
+    FILE *file = fopen(name, "wb");
+    bool written = file != NULL && fwrite(&encoded[0], 1, encoded.size(), file) == encoded.size();
+    if (file != NULL && fclose(file) != 0)
+    {
+        written = false;
+    }
+    return written;
+}
+
+static void writerMain()
+{
+    std::vector<unsigned char> encoded;
+    std::unique_lock<std::mutex> lock(writerMutex);
+    for (;;)
+    {
+        framesQueued.wait(lock, [] { return writerStopping || !writeQueue.empty(); });
+        if (writeQueue.empty())
+        {
+            return; // Stopping, and everything is written
+        }
+        CapturedFrame captured = writeQueue.front();
+        writeQueue.pop_front();
+
+        lock.unlock();
+        bool written = writeImage(captured, encoded);
+        lock.lock();
+
+        if (!written && writeFailures++ == 0)
+        {
+            std::cerr << "Cannot write frame " << captured.frame << " to " << filePattern << std::endl;
+        }
+        freeBuffers.push_back(captured.pixels);
+        bufferFreed.notify_one();
+    }
+}
+
+/**
+ * Create the pixel buffer ring and the frame pool, and start the I/O thread
+ * @param pattern - printf file name pattern with one integer (frame number)
+ * @param width, height - Size of the frames to capture
+ */
+bool startFrameCapture(const char *pattern, int width, int height)
+{
+    if (!isGLVersionAtLeast(2, 1))
+    {
+        std::cerr << "Frame capture requires OpenGL 2.1 pixel buffer objects" << std::endl;
+        return false;
+    }
+    if (!isFramePattern(pattern))
+    {
+        std::cerr << "Output pattern " << pattern << " needs exactly one frame number (%d or e.g. %04d)" << std::endl;
+        return false;
+    }
+
+    filePattern = pattern;
+    captureWidth = width;
+    captureHeight = height;
+    size_t frameBytes = (size_t)width * height * 4;
+
+    glGenBuffers(CAPTURE_RING_SIZE, pixelBuffers);
+    for (int i = 0; i < CAPTURE_RING_SIZE; i++)
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffers[i]);
+        glBufferData(GL_PIXEL_PACK_BUFFER, frameBytes, NULL, GL_STREAM_READ);
+        slotFrames[i] = -1;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    nextSlot = 0;
+
+    pixelPool.assign(CAPTURE_WRITE_QUEUE, std::vector<unsigned char>(frameBytes));
+    freeBuffers.clear();
+    for (int i = 0; i < CAPTURE_WRITE_QUEUE; i++)
+    {
+        freeBuffers.push_back(&pixelPool[i]);
+    }
+    writeQueue.clear();
+    writerStopping = false;
+    writeFailures = 0;
+    writerStalls = 0;
+    writer = std::thread(writerMain);
+    return true;
+}
+
+/**
+ * Copy a finished readback out of its pixel buffer and queue it for
+ * writing; waits only if the I/O thread has fallen a whole pool behind
+ */
+static void retireSlot(int slot)
+{
+    if (slotFrames[slot] < 0)
+    {
+        return;
+    }
+
+    CapturedFrame captured;
+    captured.frame = slotFrames[slot];
+    slotFrames[slot] = -1;
+    {
+        std::unique_lock<std::mutex> lock(writerMutex);
+        if (freeBuffers.empty())
+        {
+            writerStalls++;
+            bufferFreed.wait(lock, [] { return !freeBuffers.empty(); });
+        }
+        captured.pixels = freeBuffers.back();
+        freeBuffers.pop_back();
+    }
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffers[slot]);
+    const void *mapped = glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+    if (mapped != NULL)
+    {
+        memcpy(&(*captured.pixels)[0], mapped, captured.pixels->size());
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    {
+        std::lock_guard<std::mutex> lock(writerMutex);
+        if (mapped != NULL)
+        {
+            writeQueue.push_back(captured);
+        }
+        else
+        {
+            if (writeFailures++ == 0)
+            {
+                std::cerr << "Frame " << captured.frame << ": pixel buffer could not be mapped" << std::endl;
+            }
+            freeBuffers.push_back(captured.pixels);
+        }
+    }
+    framesQueued.notify_one();
+}
+
+/**
+ * Start an asynchronous readback of the frame just rendered
+ * The buffer it goes into held the frame CAPTURE_RING_SIZE frames back,
+ * which is handed to the I/O thread first.
+ * @param frame - Frame number for the file name
+ * @return false once any earlier frame has failed to be written
+ */
+bool captureFrame(int frame)
+{
+    retireSlot(nextSlot);
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffers[nextSlot]);
+    glReadPixels(0, 0, captureWidth, captureHeight, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    slotFrames[nextSlot] = frame;
+    nextSlot = (nextSlot + 1) % CAPTURE_RING_SIZE;
+
+    std::lock_guard<std::mutex> lock(writerMutex);
+    return writeFailures == 0;
+}
+
+/**
+ * Drain the ring oldest first, let the I/O thread finish and free everything
+ */
+bool finishFrameCapture()
+{
+    for (int i = 0; i < CAPTURE_RING_SIZE; i++)
+    {
+        retireSlot((nextSlot + i) % CAPTURE_RING_SIZE);
+    }
+    {
+        std::lock_guard<std::mutex> lock(writerMutex);
+        writerStopping = true;
+    }
+    framesQueued.notify_one();
+    writer.join();
+
+    glDeleteBuffers(CAPTURE_RING_SIZE, pixelBuffers);
+    pixelPool.clear();
+    freeBuffers.clear();
+    if (writerStalls > 0)
+    {
+        std::cout << "Capture: rendering waited for the disk " << writerStalls << " times" << std::endl;
+    }
+    if (writeFailures > 0)
+    {
+        std::cerr << "Capture: " << writeFailures << " frames were not written" << std::endl;
+    }
+    return writeFailures == 0;
+}
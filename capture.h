@@ -0,0 +1,35 @@
+/*
+ * Frame Sequence Capture
+ *
+ * Saves rendered frames as numbered image files for video export. The
+ * pixels of each frame are read into one of a ring of pixel buffer
+ * objects, so glReadPixels() returns at once and the copy happens on the
+ * GPU; a buffer is mapped only when the ring comes back round to it,
+ * frames later. A separate I/O thread flips, encodes (binary PPM) and
+ * writes the images, so neither the disk nor the readback holds up
+ * rendering while the GPU has work queued.
+ */
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+// Pixel buffers in flight: a frame is mapped this many frames after its readback
+const int CAPTURE_RING_SIZE = 3;
+
+// Frames read back but not yet written; rendering waits for the disk beyond this
+const int CAPTURE_WRITE_QUEUE = 4;
+
+// Start capturing frames of the given size (GL 2.1 pixel buffers).
+// pattern names the files, with one printf integer for the frame number,
+// e.g. "frames/lamp_%04d.ppm". Returns false (with a message) on error.
+bool startFrameCapture(const char *pattern, int width, int height);
+
+// Read back the current read framebuffer as the given frame; false once
+// an earlier frame could not be written
+bool captureFrame(int frame);
+
+// Write out every frame still in flight and stop the I/O thread;
+// returns false if any file could not be written
+bool finishFrameCapture();
+
+#endif // CAPTURE_H
@@ -0,0 +1,349 @@
+/*
+ * Binary Animation Clips - implementation
+ *
+ * Opening maps the file read-only and validates only the header and the
+ * array bounds, never the keys themselves; the sampler in animation.cpp
+ * is written to stay in bounds whatever the key data holds.
+ */
+
+#include "clipfile.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+static const char CLIP_MAGIC[4] = {'L', 'C', 'L', 'P'};
+static const float QUANTIZED_STEPS = 65535.0f;
+
+float &clipChannelValue(LampJoints &joints, int channel)
+{
+    switch (channel)
+    {
+    case CHANNEL_BASE_ROTATION:
+        return joints.baseRotation;
+    case CHANNEL_LOWER_ARM:
+        return joints.lowerArmAngle;
+    case CHANNEL_UPPER_ARM:
+        return joints.upperArmAngle;
+    case CHANNEL_LAMPSHADE_ANGLE:
+        return joints.lampshadeAngle;
+    default:
+        return joints.lampshadeRotation;
+    }
+}
+
+float clipChannelValue(const LampJoints &joints, int channel)
+{
+    return clipChannelValue(const_cast<LampJoints &>(joints), channel);
+}
+
+/**
+ * True if an array of count elements at offset lies inside the file and
+ * is aligned for its element type
+ */
+static bool arrayInFile(uint32_t offset, uint32_t count, size_t elementSize, size_t fileSize)
+{
+    return offset % 4 == 0 && offset >= sizeof(ClipFileHeader) && offset <= fileSize &&
+           count <= (fileSize - offset) / elementSize;
+}
+
+/**
+ * Map a binary clip file and check that it can be sampled safely
+ * @param path - File written by writeClipFile()
+ * @param file - Receives the mapping and a clip referring into it
+ * @return false (after printing why) if the file is missing or malformed
+ */
+bool openClipFile(const char *path, ClipFile &file)
+{
+    file.mapping = NULL;
+    file.size = 0;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        std::cerr << "Cannot open clip " << path << std::endl;
+        return false;
+    }
+    struct stat info;
+    void *mapping = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && (size_t)info.st_size >= sizeof(ClipFileHeader))
+    {
+        mapping = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd); // The mapping keeps the file alive
+    if (mapping == MAP_FAILED)
+    {
+        std::cerr << "Cannot map clip " << path << std::endl;
+        return false;
+    }
+
+    size_t size = (size_t)info.st_size;
+    const ClipFileHeader &header = *(const ClipFileHeader *)mapping;
+    bool valid = memcmp(header.magic, CLIP_MAGIC, sizeof(CLIP_MAGIC)) == 0 && header.version == CLIP_FILE_VERSION &&
+                 header.fileSize == size && header.indexCount > 0 && std::isfinite(header.indexInterval) &&
+                 header.indexInterval > 0.0f && std::isfinite(header.duration) && header.duration >= 0.0f &&
+                 (double)(header.indexCount - 1) * header.indexInterval >= header.duration &&
+                 memchr(header.name, '\0', CLIP_NAME_LENGTH) != NULL;
+    for (int channel = 0; valid && channel < CLIP_CHANNEL_COUNT; channel++)
+    {
+        const ClipChannel &c = header.channels[channel];
+        valid = c.keyCount > 0 && arrayInFile(c.timesOffset, c.keyCount, sizeof(float), size) &&
+                arrayInFile(c.valuesOffset, c.keyCount, sizeof(uint16_t), size) &&
+                arrayInFile(c.indexOffset, header.indexCount, sizeof(uint32_t), size);
+    }
+    if (!valid)
+    {
+        std::cerr << path << " is not a version " << CLIP_FILE_VERSION << " lamp clip" << std::endl;
+        munmap(mapping, size);
+        return false;
+    }
+
+    file.mapping = mapping;
+    file.size = size;
+    file.clip.name = header.name;
+    file.clip.keyframes.clear();
+    file.clip.looping = (header.flags & CLIP_FILE_LOOPING) != 0;
+    file.clip.binary = &header;
+    return true;
+}
+
+void closeClipFile(ClipFile &file)
+{
+    if (file.mapping != NULL)
+    {
+        munmap(file.mapping, file.size);
+    }
+    file.mapping = NULL;
+    file.size = 0;
+    file.clip.binary = NULL;
+}
+
+/**
+ * Read an authoring text clip
+ * Keys must start at 0 s and strictly increase in time up to
+ * CLIP_MAX_DURATION; a looping clip must end on its first pose.
+ * @param path - Text clip (format in clipfile.h)
+ * @param clip - Receives the keyframes
+ * @param name - Storage for the clip name ("Imported" if none is given)
+ * @return false (after printing the offending line) on any error
+ */
+bool importClipText(const char *path, AnimationClip &clip, std::string &name)
+{
+    FILE *in = fopen(path, "r");
+    if (in == NULL)
+    {
+        std::cerr << "Cannot open " << path << std::endl;
+        return false;
+    }
+
+    name = "Imported";
+    clip.keyframes.clear();
+    clip.looping = false;
+    clip.binary = NULL;
+
+    char line[256];
+    int lineNumber = 0;
+    const char *error = NULL;
+    while (error == NULL && fgets(line, sizeof(line), in) != NULL)
+    {
+        lineNumber++;
+        line[strcspn(line, "\r\n")] = '\0';
+        char *text = line + strspn(line, " \t");
+        if (*text == '\0' || *text == '#')
+        {
+            continue;
+        }
+
+        Keyframe key;
+        LampJoints &j = key.joints;
+        char extra;
+        if (strncmp(text, "name ", 5) == 0)
+        {
+            name = text + 5;
+            if (name.size() >= (size_t)CLIP_NAME_LENGTH)
+            {
+                error = "name too long";
+            }
+        }
+        else if (strcmp(text, "loop") == 0)
+        {
+            clip.looping = true;
+        }
+        else if (sscanf(text, "key %f %f %f %f %f %f %c", &key.time, &j.baseRotation, &j.lowerArmAngle,
+                        &j.upperArmAngle, &j.lampshadeAngle, &j.lampshadeRotation, &extra) == 6)
+        {
+            LampJoints clamped = j;
+            clampLampJoints(clamped);
+            if (!lampJointsEqual(clamped, j))
+            {
+                error = "joint angle outside the lamp's limits";
+            }
+            else if (!std::isfinite(key.time) || key.time > CLIP_MAX_DURATION)
+            {
+                error = "key time must be a number of seconds up to one day";
+            }
+            else if (clip.keyframes.empty() ? key.time != 0.0f : key.time <= clip.keyframes.back().time)
+            {
+                error = "keys must start at 0 and increase in time";
+            }
+            else
+            {
+                clip.keyframes.push_back(key);
+            }
+        }
+        else
+        {
+            error = "expected 'name <text>', 'loop' or 'key <time> <5 angles>'";
+        }
+    }
+    fclose(in);
+
+    if (error == NULL && clip.keyframes.empty())
+    {
+        error = "no keys";
+    }
+    else if (error == NULL && clip.looping &&
+             !lampJointsEqual(clip.keyframes.front().joints, clip.keyframes.back().joints))
+    {
+        error = "a looping clip must end on its first pose";
+    }
+    if (error != NULL)
+    {
+        std::cerr << path << ":" << lineNumber << ": " << error << std::endl;
+        return false;
+    }
+    clip.name = name.c_str();
+    return true;
+}
+
+static uint32_t appendArray(std::vector<char> &bytes, const void *data, size_t size)
+{
+    uint32_t offset = (uint32_t)bytes.size();
+    bytes.insert(bytes.end(), (const char *)data, (const char *)data + size);
+    bytes.resize((bytes.size() + 3) & ~(size_t)3); // Keep the next array aligned
+    return offset;
+}
+
+/**
+ * Convert a keyframe clip into a binary clip file
+ * Every channel is quantized to 16 bits over its own range. A key is
+ * left out of a channel only when it holds the same value as the two
+ * keys on either side, which changes neither linear nor cubic sampling.
+ * @param path - Output file
+ * @param clip - Clip with keyframes
+ * @return false (after printing why) if the clip is too long for the
+ *         format or the file cannot be written
+ */
+bool writeClipFile(const char *path, const AnimationClip &clip)
+{
+    const std::vector<Keyframe> &keys = clip.keyframes;
+    if (keys.empty())
+    {
+        std::cerr << "Clip " << clip.name << " has no keys" << std::endl;
+        return false;
+    }
+
+    // Also rules out a NaN duration, which the loader would refuse
+    float duration = clipDuration(clip);
+    if (!(duration >= 0.0f && duration <= CLIP_MAX_DURATION))
+    {
+        std::cerr << "Clip " << clip.name << " must last 0 to " << CLIP_MAX_DURATION << " s" << std::endl;
+        return false;
+    }
+
+    ClipFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CLIP_MAGIC, sizeof(CLIP_MAGIC));
+    header.version = CLIP_FILE_VERSION;
+    header.flags = clip.looping ? CLIP_FILE_LOOPING : 0;
+    header.duration = duration;
+    header.indexInterval = CLIP_INDEX_INTERVAL;
+    header.indexCount = (uint32_t)ceilf(header.duration / CLIP_INDEX_INTERVAL) + 1; // Last entry at or past the end
+    strncpy(header.name, clip.name, CLIP_NAME_LENGTH - 1);
+
+    std::vector<char> bytes(sizeof(header));
+    std::vector<float> times;
+    std::vector<uint16_t> values;
+    std::vector<uint32_t> index(header.indexCount);
+    for (int channel = 0; channel < CLIP_CHANNEL_COUNT; channel++)
+    {
+        std::vector<uint16_t> quantized(keys.size());
+        float low = clipChannelValue(keys[0].joints, channel);
+        float high = low;
+        for (size_t k = 0; k < keys.size(); k++)
+        {
+            float value = clipChannelValue(keys[k].joints, channel);
+            low = std::min(low, value);
+            high = std::max(high, value);
+        }
+        ClipChannel &c = header.channels[channel];
+        c.valueBase = low;
+        c.valueStep = (high - low) / QUANTIZED_STEPS;
+        for (size_t k = 0; k < keys.size(); k++)
+        {
+            float value = clipChannelValue(keys[k].joints, channel);
+            quantized[k] = c.valueStep > 0.0f ? (uint16_t)((value - low) / c.valueStep + 0.5f) : 0;
+        }
+
+        times.clear();
+        values.clear();
+        int count = (int)keys.size();
+        for (int k = 0; k < count; k++)
+        {
+            bool flat = k >= 2 && k + 2 < count;
+            for (int n = k - 2; flat && n <= k + 2; n++)
+            {
+                flat = quantized[n] == quantized[k];
+            }
+            if (!flat)
+            {
+                times.push_back(keys[k].time);
+                values.push_back(quantized[k]);
+            }
+        }
+
+        size_t segment = 0;
+        for (uint32_t entry = 0; entry < header.indexCount; entry++)
+        {
+            while (segment + 2 < times.size() && times[segment + 1] <= entry * CLIP_INDEX_INTERVAL)
+            {
+                segment++;
+            }
+            index[entry] = (uint32_t)segment;
+        }
+
+        // Offsets and the file size are 32-bit; arrays pad by up to 3 bytes
+        size_t arrayBytes = times.size() * sizeof(float) + values.size() * sizeof(uint16_t) +
+                            index.size() * sizeof(uint32_t) + 3 * 3;
+        if (bytes.size() + arrayBytes > UINT32_MAX)
+        {
+            std::cerr << "Clip " << clip.name << " has too many keys for a clip file" << std::endl;
+            return false;
+        }
+        c.keyCount = (uint32_t)times.size();
+        c.timesOffset = appendArray(bytes, &times[0], times.size() * sizeof(float));
+        c.valuesOffset = appendArray(bytes, &values[0], values.size() * sizeof(uint16_t));
+        c.indexOffset = appendArray(bytes, &index[0], index.size() * sizeof(uint32_t));
+    }
+    header.fileSize = (uint32_t)bytes.size();
+    memcpy(&bytes[0], &header, sizeof(header));
+
+    FILE *out = fopen(path, "wb");
+    bool written = out != NULL && fwrite(&bytes[0], 1, bytes.size(), out) == bytes.size();
+    if (out != NULL && fclose(out) != 0)
+    {
+        written = false;
+    }
+    if (!written)
+    {
+        std::cerr << "Cannot write " << path << std::endl;
+    }
+    return written;
+}
@@ -0,0 +1,95 @@
+/*
+ * Binary Animation Clips
+ *
+ * Long show sequences are stored in a compact binary file that is
+ * memory-mapped and sampled in place: opening one only checks the
+ * header, so startup costs the same for a one-hour show as for a hop.
+ *
+ * Layout (host byte order, every array 4-byte aligned):
+ *   ClipFileHeader
+ *   per channel: float key times, uint16 quantized values, uint32 index
+ * Each joint channel has its own keys, so a joint that holds still
+ * costs nothing. The index stores, every indexInterval seconds, the key
+ * segment containing that time, so sampling starts a few keys before
+ * the answer instead of searching the whole channel.
+ *
+ * Clips are authored as text and converted with importClipText() and
+ * writeClipFile():
+ *   # comment
+ *   name Hop
+ *   loop
+ *   key <time> <base> <lower arm> <upper arm> <lampshade> <lampshade rotation>
+ */
+
+#ifndef CLIPFILE_H
+#define CLIPFILE_H
+
+#include "animation.h"
+
+#include <cstddef>
+#include <stdint.h>
+#include <string>
+
+const uint32_t CLIP_FILE_VERSION = 1;
+const uint32_t CLIP_FILE_LOOPING = 1; // Header flag
+const int CLIP_NAME_LENGTH = 32;
+const float CLIP_INDEX_INTERVAL = 0.5f; // Seconds between index entries
+const float CLIP_MAX_DURATION = 86400.0f; // Seconds; keeps the index of every clip small
+
+// One channel per LampJoints member, in declaration order
+enum ClipChannelId
+{
+    CHANNEL_BASE_ROTATION = 0,
+    CHANNEL_LOWER_ARM,
+    CHANNEL_UPPER_ARM,
+    CHANNEL_LAMPSHADE_ANGLE,
+    CHANNEL_LAMPSHADE_ROTATION,
+    CLIP_CHANNEL_COUNT
+};
+
+struct ClipChannel
+{
+    uint32_t keyCount;
+    uint32_t timesOffset;  // float[keyCount], seconds, strictly increasing
+    uint32_t valuesOffset; // uint16_t[keyCount]; angle = valueBase + q * valueStep
+    uint32_t indexOffset;  // uint32_t[indexCount]; key segment at i * indexInterval
+    float valueBase;
+    float valueStep;
+};
+
+struct ClipFileHeader
+{
+    char magic[4]; // "LCLP"
+    uint32_t version;
+    uint32_t flags;
+    uint32_t fileSize;
+    float duration;      // Time of the last key of every channel
+    float indexInterval; // Seconds between index entries
+    uint32_t indexCount;
+    char name[CLIP_NAME_LENGTH]; // NUL-terminated
+    ClipChannel channels[CLIP_CHANNEL_COUNT];
+};
+
+// A mapped clip file; clip refers into the mapping until closeClipFile()
+struct ClipFile
+{
+    void *mapping;
+    size_t size;
+    AnimationClip clip;
+};
+
+// Map a binary clip and check its header; false (with a message) if invalid
+bool openClipFile(const char *path, ClipFile &file);
+void closeClipFile(ClipFile &file);
+
+// Read a text clip into keyframes; clip.name points into name
+bool importClipText(const char *path, AnimationClip &clip, std::string &name);
+
+// Quantize a keyframe clip into the binary format
+bool writeClipFile(const char *path, const AnimationClip &clip);
+
+// Angle of a joint channel
+float &clipChannelValue(LampJoints &joints, int channel);
+float clipChannelValue(const LampJoints &joints, int channel);
+
+#endif // CLIPFILE_H
@@ -0,0 +1,155 @@
+/*
+ * Core-Profile Renderer - implementation
+ */
+
+#include "corerenderer.h"
+
+#include "material.h"
+#include "shader.h"
+
+#include <cmath>
+#include <iostream>
+#include <string>
+
+/**
+ * Look up the uniforms of lightSource[index] in the core program
+ */
+static CoreLightUniforms getLightUniforms(GLuint program, int index)
+{
+    std::string prefix = "lightSource[" + std::to_string(index) + "].";
+    CoreLightUniforms uniforms;
+    uniforms.ambient = glGetUniformLocation(program, (prefix + "ambient").c_str());
+    uniforms.diffuse = glGetUniformLocation(program, (prefix + "diffuse").c_str());
+    uniforms.specular = glGetUniformLocation(program, (prefix + "specular").c_str());
+    uniforms.position = glGetUniformLocation(program, (prefix + "position").c_str());
+    uniforms.spotDirection = glGetUniformLocation(program, (prefix + "spotDirection").c_str());
+    uniforms.spotExponent = glGetUniformLocation(program, (prefix + "spotExponent").c_str());
+    uniforms.spotCutoff = glGetUniformLocation(program, (prefix + "spotCutoff").c_str());
+    uniforms.spotCosCutoff = glGetUniformLocation(program, (prefix + "spotCosCutoff").c_str());
+    uniforms.attenuation[0] = glGetUniformLocation(program, (prefix + "constantAttenuation").c_str());
+    uniforms.attenuation[1] = glGetUniformLocation(program, (prefix + "linearAttenuation").c_str());
+    uniforms.attenuation[2] = glGetUniformLocation(program, (prefix + "quadraticAttenuation").c_str());
+    return uniforms;
+}
+
+bool createCoreRenderer(CoreRenderer &renderer)
+{
+    renderer.program = createCoreLightingProgram();
+    if (renderer.program == 0)
+    {
+        return false;
+    }
+    if (!bindMaterialBlock(renderer.program))
+    {
+        std::cerr << "Core profile: the material uniform buffer is unavailable" << std::endl;
+        deleteCoreRenderer(renderer);
+        return false;
+    }
+
+    renderer.modelViewLocation = glGetUniformLocation(renderer.program, "modelViewMatrix");
+    renderer.projectionLocation = glGetUniformLocation(renderer.program, "projectionMatrix");
+    renderer.sceneAmbientLocation = glGetUniformLocation(renderer.program, "sceneAmbient");
+    renderer.spotlightEnabledLocation = glGetUniformLocation(renderer.program, "spotlightEnabled");
+    renderer.litLocation = glGetUniformLocation(renderer.program, "lit");
+    renderer.unlitColorLocation = glGetUniformLocation(renderer.program, "unlitColor");
+    renderer.materialIndexLocation = glGetUniformLocation(renderer.program, "materialIndex");
+    renderer.highlightLocation = glGetUniformLocation(renderer.program, "highlightEmission");
+    for (int i = 0; i < SCENE_LIGHT_COUNT; i++)
+    {
+        renderer.lights[i] = getLightUniforms(renderer.program, i);
+    }
+    renderer.view = mat4Identity();
+    return true;
+}
+
+void deleteCoreRenderer(CoreRenderer &renderer)
+{
+    glDeleteProgram(renderer.program);
+    renderer.program = 0;
+}
+
+/**
+ * Upload one light the way glLightfv() stores it: position and direction
+ * in eye space, and the cutoff's cosine next to the angle
+ * @param uniforms - Locations of the light's fields
+ * @param light - World-space parameters
+ * @param view - World-to-eye matrix
+ */
+static void setLightUniforms(const CoreLightUniforms &uniforms, const SceneLight &light, const Mat4 &view)
+{
+    float position[4];
+    if (light.position[3] == 0.0f)
+    {
+        mat4TransformDirection(view, light.position, position);
+    }
+    else
+    {
+        mat4TransformPoint(view, light.position, position);
+    }
+    position[3] = light.position[3];
+    float spotDirection[3];
+    mat4TransformDirection(view, light.spotDirection, spotDirection);
+
+    glUniform4fv(uniforms.ambient, 1, light.ambient);
+    glUniform4fv(uniforms.diffuse, 1, light.diffuse);
+    glUniform4fv(uniforms.specular, 1, light.specular);
+    glUniform4fv(uniforms.position, 1, position);
+    glUniform3fv(uniforms.spotDirection, 1, spotDirection);
+    glUniform1f(uniforms.spotExponent, light.spotExponent);
+    glUniform1f(uniforms.spotCutoff, light.spotCutoff);
+    glUniform1f(uniforms.spotCosCutoff, cosf(light.spotCutoff * (float)M_PI / 180.0f));
+    for (int i = 0; i < 3; i++)
+    {
+        glUniform1f(uniforms.attenuation[i], light.attenuation[i]);
+    }
+}
+
+/**
+ * Bind the program and set the per-frame uniforms
+ * @param projection - Eye-to-clip matrix
+ * @param view - World-to-eye matrix, kept for drawCoreMesh()
+ * @param sceneAmbient - Global ambient light (GL_LIGHT_MODEL_AMBIENT)
+ * @param lights - Fill light and spotlight, world space
+ * @param spotlight - Light the scene with the spotlight
+ */
+void beginCoreFrame(CoreRenderer &renderer, const Mat4 &projection, const Mat4 &view, const float sceneAmbient[4],
+                    const SceneLight lights[SCENE_LIGHT_COUNT], bool spotlight)
+{
+    renderer.view = view;
+    glUseProgram(renderer.program);
+    glUniformMatrix4fv(renderer.projectionLocation, 1, GL_FALSE, projection.m);
+    glUniform4fv(renderer.sceneAmbientLocation, 1, sceneAmbient);
+    glUniform1i(renderer.spotlightEnabledLocation, spotlight ? 1 : 0);
+    for (int i = 0; i < SCENE_LIGHT_COUNT; i++)
+    {
+        if (i == 0 || spotlight)
+        {
+            setLightUniforms(renderer.lights[i], lights[i], view);
+        }
+    }
+    setCoreLighting(renderer, true);
+    setMaterialIndexUniform(renderer.materialIndexLocation);
+    setHighlightUniform(renderer.highlightLocation);
+}
+
+void setCoreLighting(const CoreRenderer &renderer, bool lit)
+{
+    glUniform1i(renderer.litLocation, lit ? 1 : 0);
+}
+
+void setCoreColor(const CoreRenderer &renderer, const float color[4])
+{
+    glUniform4fv(renderer.unlitColorLocation, 1, color);
+}
+
+/**
+ * Draw a mesh with view * model as its modelview matrix
+ * @param mesh - Mesh with a vertex array object (created in a core context)
+ * @param model - Mesh-to-world matrix
+ */
+void drawCoreMesh(const CoreRenderer &renderer, const Mesh &mesh, const Mat4 &model)
+{
+    Mat4 modelView = mat4Multiply(renderer.view, model);
+    glUniformMatrix4fv(renderer.modelViewLocation, 1, GL_FALSE, modelView.m);
+    drawMesh(mesh);
+}
@@ -0,0 +1,88 @@
+/*
+ * Core-Profile Renderer
+ *
+ * Draws the scene through an OpenGL 3.3 core context (--core-profile),
+ * which has no matrix stack, no glLight/glMaterial state and no client
+ * arrays. Every draw gets its modelview matrix as a uniform, composed on
+ * the CPU from the camera and the part's world matrix (matrix.h); meshes
+ * are drawn from their vertex array objects (mesh.h); and one GLSL 3.30
+ * program lights every fragment with the same equation as the per-pixel
+ * program, from light parameters passed as uniforms and materials from
+ * the material uniform buffer.
+ *
+ * main.cpp draws the same table and lamp through either renderer; only
+ * the innermost calls (transform, lighting on/off, unlit color) differ,
+ * so the two can be compared frame for frame.
+ */
+
+#ifndef CORERENDERER_H
+#define CORERENDERER_H
+
+#include "opengl.h"
+#include "matrix.h"
+#include "mesh.h"
+
+// Parameters of one light in the terms of glLight*(), in world space
+struct SceneLight
+{
+    float ambient[4];
+    float diffuse[4];
+    float specular[4];
+    float position[4];    // w = 0 for a directional light
+    float spotDirection[3];
+    float spotExponent;
+    float spotCutoff;     // Cone half-angle in degrees, 180 for none
+    float attenuation[3]; // Constant, linear, quadratic
+};
+
+// Fill light and lampshade spotlight, as GL_LIGHT0 and GL_LIGHT1
+const int SCENE_LIGHT_COUNT = 2;
+
+// Uniform locations of one light in the core program
+struct CoreLightUniforms
+{
+    GLint ambient;
+    GLint diffuse;
+    GLint specular;
+    GLint position;
+    GLint spotDirection;
+    GLint spotExponent;
+    GLint spotCutoff;
+    GLint spotCosCutoff;
+    GLint attenuation[3];
+};
+
+struct CoreRenderer
+{
+    GLuint program;
+    GLint modelViewLocation;
+    GLint projectionLocation;
+    GLint sceneAmbientLocation;
+    GLint spotlightEnabledLocation;
+    GLint litLocation;
+    GLint unlitColorLocation;
+    GLint materialIndexLocation;
+    GLint highlightLocation;
+    CoreLightUniforms lights[SCENE_LIGHT_COUNT];
+    Mat4 view; // World-to-eye matrix of the frame being drawn
+};
+
+// Build the program (needs a 3.3 context and the material buffer of
+// createMaterials()); returns false and logs the reason on failure
+bool createCoreRenderer(CoreRenderer &renderer);
+void deleteCoreRenderer(CoreRenderer &renderer);
+
+// Bind the program for a frame: camera matrices, the scene ambient term
+// and the lights, which are moved into eye space here. The spotlight
+// (light 1) is only read if enabled. Draws start lit.
+void beginCoreFrame(CoreRenderer &renderer, const Mat4 &projection, const Mat4 &view, const float sceneAmbient[4],
+                    const SceneLight lights[SCENE_LIGHT_COUNT], bool spotlight);
+
+// Lit draws use the bound material (material.h), unlit ones the color
+void setCoreLighting(const CoreRenderer &renderer, bool lit);
+void setCoreColor(const CoreRenderer &renderer, const float color[4]);
+
+// Draw a mesh with a model-to-world matrix and the frame's camera
+void drawCoreMesh(const CoreRenderer &renderer, const Mesh &mesh, const Mat4 &model);
+
+#endif // CORERENDERER_H
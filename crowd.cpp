@@ -0,0 +1,685 @@
+/*
+ * Instanced Lamp Crowd - implementation
+ */
+
+#include "crowd.h"
+
+#include "material.h"
+#include "shader.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+
+// Floats per instance: column-major matrix, RGBA color, and the
+// instance's index in lamp order (kept through the LOD sort for picking)
+static const int INSTANCE_FLOATS = 16 + 4 + 1;
+static const GLsizei INSTANCE_STRIDE = INSTANCE_FLOATS * sizeof(GLfloat);
+
+// Material of each part, as used by the single lamp in main.cpp; parts
+// are ordered so that parts sharing a material are drawn back to back
+static const MaterialId PART_MATERIALS[CROWD_PART_COUNT] = {
+    MATERIAL_BASE, MATERIAL_BASE, MATERIAL_JOINT, MATERIAL_ARM, MATERIAL_ARM, MATERIAL_SHADE, MATERIAL_SHADE};
+
+// Instances of each part per lamp
+static const int PART_INSTANCES[CROWD_PART_COUNT] = {1, 1, 3, 1, 1, 1, 1};
+
+// Joint that moves each part (its first instance, for the joints), as
+// picking.h numbers them: base, lower arm, upper arm, lampshade
+static const int PART_JOINTS[CROWD_PART_COUNT] = {0, 0, 1, 1, 2, 3, 3};
+
+// Crowd lamp spotlights: narrower and shorter than the main lamp's, so
+// each lights a small pool around its own base
+static const float CROWD_LIGHT_CUTOFF = 35.0f; // Cone half-angle (degrees)
+static const float CROWD_LIGHT_EXPONENT = 8.0f;
+static const float CROWD_LIGHT_RANGE = 1.8f;
+static const float CROWD_LIGHT_INTENSITY = 1.2f; // Times the lamp's color
+
+/**
+ * Deterministic pseudo-random value in [0, 1) so every run looks the same
+ */
+static float hashToUnit(unsigned int value)
+{
+    value ^= value >> 16;
+    value *= 0x7feb352dU;
+    value ^= value >> 15;
+    value *= 0x846ca68bU;
+    value ^= value >> 16;
+    return (float)(value & 0xffffff) / (float)0x1000000;
+}
+
+/**
+ * Append one instance (matrix + color) at the given float offset
+ * @return Offset of the next instance
+ */
+static size_t writeInstance(std::vector<GLfloat> &data, size_t offset, const Mat4 &matrix, const float color[4])
+{
+    for (int i = 0; i < 16; i++)
+    {
+        data[offset + i] = matrix.m[i];
+    }
+    for (int i = 0; i < 4; i++)
+    {
+        data[offset + 16 + i] = color[i];
+    }
+    return offset + INSTANCE_FLOATS;
+}
+
+bool createCrowd(Crowd &crowd, int rows, int columns, float spacing, float lampScale, float clearRadius)
+{
+    crowd.lamps.clear();
+    crowd.program = 0;
+    crowd.posed = false;
+    crowd.drawnFrame = 0;
+    crowd.updateJob.state = JOB_IDLE;
+    crowd.prefetching = false;
+    crowd.jobMeshes = NULL;
+    for (int f = 0; f < 2; f++)
+    {
+        CrowdFrame &frame = crowd.frames[f];
+        frame.valid = false;
+        frame.moved = false;
+        frame.culledLamps = 0;
+        frame.aimStats.iterations = 0;
+        frame.aimStats.unreachable = 0;
+        frame.updateMicroseconds = 0.0;
+        for (int part = 0; part < CROWD_PART_COUNT; part++)
+        {
+            for (int level = 0; level < LOD_COUNT; level++)
+            {
+                frame.lodCounts[part][level] = 0;
+                frame.culledLodCounts[part][level] = 0;
+            }
+        }
+    }
+    for (int part = 0; part < CROWD_PART_COUNT; part++)
+    {
+        crowd.instanceBuffers[part] = 0;
+    }
+
+    // Instanced arrays (glVertexAttribDivisor) are core in GL 3.3
+    if (!isGLVersionAtLeast(3, 3))
+    {
+        return false;
+    }
+    crowd.program = createInstancedLightingProgram(hasMaterialBuffer());
+    if (crowd.program == 0)
+    {
+        return false;
+    }
+    crowd.matrixLocation = glGetAttribLocation(crowd.program, "instanceMatrix");
+    crowd.colorLocation = glGetAttribLocation(crowd.program, "instanceColor");
+    crowd.spotlightEnabledLocation = glGetUniformLocation(crowd.program, "spotlightEnabled");
+    crowd.materialIndexLocation =
+        bindMaterialBlock(crowd.program) ? glGetUniformLocation(crowd.program, "materialIndex") : -1;
+
+    // Grid of lamps centered on the origin; the batch is trimmed to the
+    // lamps actually placed below
+    resizeLampBatch(crowd.batch, (size_t)rows * columns);
+    crowd.poses.count = 0;
+    float startX = -0.5f * spacing * (columns - 1);
+    float startZ = -0.5f * spacing * (rows - 1);
+    for (int row = 0; row < rows; row++)
+    {
+        for (int column = 0; column < columns; column++)
+        {
+            float x = startX + column * spacing;
+            float z = startZ + row * spacing;
+            if (x * x + z * z < clearRadius * clearRadius)
+            {
+                continue;
+            }
+
+            unsigned int seed = (unsigned int)(row * columns + column) * 4u;
+            CrowdLamp lamp;
+            float heading = 360.0f * hashToUnit(seed);
+            lamp.placement = mat4Identity();
+            mat4Translate(lamp.placement, x, 0.0f, z);
+            mat4Rotate(lamp.placement, heading, 0.0f, 1.0f, 0.0f);
+            mat4Scale(lamp.placement, lampScale, lampScale, lampScale);
+            setLampBatchPlacement(crowd.batch, crowd.lamps.size(), x, z, heading, lampScale);
+            lamp.phase = 10.0f * hashToUnit(seed + 1);
+
+            // Saturated colors from a pseudo-random hue
+            float hue = 6.0f * hashToUnit(seed + 2);
+            lamp.color[0] = 0.3f + 0.6f * fmaxf(0.0f, fminf(1.0f, fabsf(hue - 3.0f) - 1.0f));
+            lamp.color[1] = 0.3f + 0.6f * fmaxf(0.0f, fminf(1.0f, 2.0f - fabsf(hue - 2.0f)));
+            lamp.color[2] = 0.3f + 0.6f * fmaxf(0.0f, fminf(1.0f, 2.0f - fabsf(hue - 4.0f)));
+            lamp.color[3] = 1.0f;
+            crowd.lamps.push_back(lamp);
+        }
+    }
+
+    resizeLampBatch(crowd.batch, crowd.lamps.size());
+    resizeLampPoseBatch(crowd.poses, crowd.lamps.size());
+    crowd.lampCulled.assign(crowd.lamps.size(), 0);
+
+    // The spotlight keeps its lamp's color; position and axis follow the pose
+    SpotLight light;
+    for (int i = 0; i < 3; i++)
+    {
+        light.position[i] = 0.0f;
+        light.direction[i] = i == 1 ? -1.0f : 0.0f;
+    }
+    light.cosCutoff = cosf(CROWD_LIGHT_CUTOFF * (float)M_PI / 180.0f);
+    light.exponent = CROWD_LIGHT_EXPONENT;
+    light.range = CROWD_LIGHT_RANGE;
+    crowd.lights.assign(crowd.lamps.size(), light);
+    for (size_t i = 0; i < crowd.lamps.size(); i++)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            crowd.lights[i].color[c] = CROWD_LIGHT_INTENSITY * crowd.lamps[i].color[c];
+        }
+    }
+    crowd.frames[0].lights = crowd.lights;
+    crowd.frames[1].lights = crowd.lights;
+
+    // Size the instance arrays once; updates rewrite them in place
+    for (int part = 0; part < CROWD_PART_COUNT; part++)
+    {
+        size_t instances = crowd.lamps.size() * PART_INSTANCES[part];
+        crowd.instanceData[part].assign(instances * INSTANCE_FLOATS, 0.0f);
+        for (size_t i = 0; i < instances; i++)
+        {
+            // Constant: updates only write the matrix and color
+            crowd.instanceData[part][i * INSTANCE_FLOATS + 20] = (GLfloat)i;
+        }
+        crowd.instanceLods[part].assign(instances, 0);
+        crowd.frames[0].uploadData[part].assign(instances * INSTANCE_FLOATS, 0.0f);
+        crowd.frames[1].uploadData[part].assign(instances * INSTANCE_FLOATS, 0.0f);
+        glGenBuffers(1, &crowd.instanceBuffers[part]);
+        glBindBuffer(GL_ARRAY_BUFFER, crowd.instanceBuffers[part]);
+        glBufferData(GL_ARRAY_BUFFER, instances * INSTANCE_STRIDE, NULL, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return true;
+}
+
+/**
+ * Post-multiply by a -90 degree rotation about X (maps the +Z-built
+ * cylinder and disk meshes onto +Y) by swapping columns, which is exact
+ * and skips mat4Rotate()'s trigonometry
+ */
+static void rotateXMinus90(Mat4 &matrix)
+{
+    for (int row = 0; row < 4; row++)
+    {
+        float y = matrix.m[4 + row];
+        matrix.m[4 + row] = -matrix.m[8 + row];
+        matrix.m[8 + row] = y;
+    }
+}
+
+// Lamps per parallelFor() chunk; a multiple of 8 so the pose kernel
+// always runs on whole SIMD vectors
+static const size_t CROWD_CHUNK_LAMPS = 64;
+
+// Shared state of one update's parallel pass
+struct CrowdPass
+{
+    Crowd *crowd;
+    const CrowdUpdate *inputs;
+    const LodMesh *partMeshes[CROWD_PART_COUNT];
+    bool pose; // Re-pose the lamps; otherwise only re-select LODs and cull
+    std::atomic<int> iterations;
+    std::atomic<int> unreachable;
+    std::atomic<bool> moved;
+};
+
+/**
+ * Into a lamp's frame: placement is translate * rotate * uniform scale,
+ * so its inverse is the transposed 3x3 over scale squared
+ */
+static void worldToLamp(const CrowdLamp &lamp, const float world[3], float local[3])
+{
+    const float *m = lamp.placement.m;
+    float offset[3] = {world[0] - m[12], world[1] - m[13], world[2] - m[14]};
+    float scaleSquared = m[0] * m[0] + m[1] * m[1] + m[2] * m[2];
+    for (int axis = 0; axis < 3; axis++)
+    {
+        local[axis] =
+            (m[axis * 4] * offset[0] + m[axis * 4 + 1] * offset[1] + m[axis * 4 + 2] * offset[2]) / scaleSquared;
+    }
+}
+
+/**
+ * Write lamp i's instances of every part (same per-part local transforms
+ * as the single-lamp draw functions)
+ */
+static void writeLampInstances(Crowd &crowd, size_t i)
+{
+    const float *color = crowd.lamps[i].color;
+    std::vector<GLfloat> *data = crowd.instanceData;
+
+    Mat4 base = lampPoseMatrix(crowd.poses, POSE_BASE, i);
+    rotateXMinus90(base);
+    writeInstance(data[CROWD_BASE_SIDE], i * INSTANCE_FLOATS, base, color);
+    mat4Translate(base, 0.0f, 0.0f, lampDimensions.baseHeight);
+    writeInstance(data[CROWD_BASE_CAP], i * INSTANCE_FLOATS, base, color);
+
+    const PosePart joints[3] = {POSE_LOWER_JOINT, POSE_UPPER_JOINT, POSE_SHADE_JOINT};
+    size_t offset = i * PART_INSTANCES[CROWD_JOINT] * INSTANCE_FLOATS;
+    for (int j = 0; j < 3; j++)
+    {
+        offset = writeInstance(data[CROWD_JOINT], offset, lampPoseMatrix(crowd.poses, joints[j], i), color);
+    }
+
+    Mat4 lowerArm = lampPoseMatrix(crowd.poses, POSE_LOWER_ARM, i);
+    rotateXMinus90(lowerArm);
+    writeInstance(data[CROWD_LOWER_ARM], i * INSTANCE_FLOATS, lowerArm, color);
+
+    Mat4 upperArm = lampPoseMatrix(crowd.poses, POSE_UPPER_ARM, i);
+    rotateXMinus90(upperArm);
+    writeInstance(data[CROWD_UPPER_ARM], i * INSTANCE_FLOATS, upperArm, color);
+
+    Mat4 shade = lampPoseMatrix(crowd.poses, POSE_LAMPSHADE, i);
+    mat4Translate(shade, 0.0f, lampJointRadius(lampDimensions), 0.0f);
+    rotateXMinus90(shade);
+    writeInstance(data[CROWD_SHADE_CONE], i * INSTANCE_FLOATS, shade, color);
+    writeInstance(data[CROWD_SHADE_CAP], i * INSTANCE_FLOATS, shade, color);
+}
+
+/**
+ * One chunk of lamps, start to finish: joints from the clip or the IK
+ * solver, batched kinematics, instance data, per-instance LOD and
+ * frustum culling
+ * @param context - The CrowdPass
+ */
+static void updateCrowdChunk(size_t begin, size_t end, void *context)
+{
+    CrowdPass &pass = *(CrowdPass *)context;
+    Crowd &crowd = *pass.crowd;
+    const CrowdUpdate &inputs = *pass.inputs;
+
+    if (pass.pose)
+    {
+        int iterations = 0;
+        int unreachable = 0;
+        bool moved = false;
+        for (size_t i = begin; i < end; i++)
+        {
+            CrowdLamp &lamp = crowd.lamps[i];
+            if (inputs.aim)
+            {
+                float local[3];
+                worldToLamp(lamp, inputs.target, local);
+                LampJoints previous = lamp.joints;
+                LookAtResult result = solveLookAt(local, lamp.joints);
+                iterations += result.iterations;
+                unreachable += result.converged ? 0 : 1;
+                moved = moved || !lampJointsEqual(previous, lamp.joints);
+            }
+            else
+            {
+                sampleClip(*inputs.clip, inputs.time + lamp.phase, inputs.mode, lamp.joints);
+            }
+            setLampBatchJoints(crowd.batch, i, lamp.joints);
+        }
+        pass.iterations += iterations;
+        pass.unreachable += unreachable;
+        if (moved)
+        {
+            pass.moved = true;
+        }
+
+        computeLampPosesRange(crowd.batch, crowd.poses, begin, end);
+        for (size_t i = begin; i < end; i++)
+        {
+            writeLampInstances(crowd, i);
+            SpotLight &light = crowd.lights[i];
+            for (int c = 0; c < 3; c++)
+            {
+                light.position[c] = crowd.poses.spotPosition[c][i];
+                light.direction[c] = crowd.poses.spotDirection[c][i];
+            }
+        }
+    }
+
+    for (int part = 0; part < CROWD_PART_COUNT; part++)
+    {
+        const std::vector<GLfloat> &data = crowd.instanceData[part];
+        for (size_t i = begin * PART_INSTANCES[part]; i < end * PART_INSTANCES[part]; i++)
+        {
+            Mat4 matrix;
+            for (int c = 0; c < 16; c++)
+            {
+                matrix.m[c] = data[i * INSTANCE_FLOATS + c];
+            }
+            crowd.instanceLods[part][i] = (unsigned char)selectLod(*pass.partMeshes[part], matrix, inputs.view);
+        }
+    }
+
+    // The bounding sphere covers every pose, so only the placement matters
+    float localCenter[3];
+    float radius;
+    lampBoundingSphere(localCenter, radius);
+    for (size_t i = begin; i < end; i++)
+    {
+        float center[3];
+        mat4TransformPoint(crowd.lamps[i].placement, localCenter, center);
+        bool visible = sphereInFrustum(inputs.frustum, center, radius * crowd.batch.scale[i]);
+        crowd.lampCulled[i] = visible ? 0 : 1;
+    }
+}
+
+static bool sameLodView(const LodView &a, const LodView &b)
+{
+    return a.eye[0] == b.eye[0] && a.eye[1] == b.eye[1] && a.eye[2] == b.eye[2] &&
+           a.pixelsPerUnit == b.pixelsPerUnit;
+}
+
+// True if both inputs give every lamp the same joints
+static bool samePose(const CrowdUpdate &a, const CrowdUpdate &b)
+{
+    if (a.aim != b.aim)
+    {
+        return false;
+    }
+    if (a.aim)
+    {
+        return a.target[0] == b.target[0] && a.target[1] == b.target[1] && a.target[2] == b.target[2];
+    }
+    return a.clip == b.clip && a.time == b.time && a.mode == b.mode;
+}
+
+static bool sameUpdate(const CrowdUpdate &a, const CrowdUpdate &b)
+{
+    return samePose(a, b) && sameLodView(a.view, b.view) && frustumsEqual(a.frustum, b.frustum);
+}
+
+/**
+ * Compute a complete frame for the given inputs
+ * Runs on whichever thread calls it (the render thread or a worker); the
+ * per-lamp work is spread over the job system, then each part's
+ * instances are grouped by visibility and LOD with a counting sort,
+ * keeping their order within a group so drawCrowd() draws every group
+ * as one contiguous range of the buffer.
+ */
+static void computeCrowdFrame(Crowd &crowd, const LampMeshes &meshes, const CrowdUpdate &inputs,
+                              CrowdFrame &frame)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    CrowdPass pass;
+    pass.crowd = &crowd;
+    pass.inputs = &inputs;
+    const LodMesh *partMeshes[CROWD_PART_COUNT] = {
+        &meshes.baseSide, &meshes.baseCap, &meshes.joint, &meshes.lowerArm,
+        &meshes.upperArm, &meshes.shadeCone, &meshes.shadeCap};
+    for (int part = 0; part < CROWD_PART_COUNT; part++)
+    {
+        pass.partMeshes[part] = partMeshes[part];
+    }
+    pass.pose = !crowd.posed || !samePose(crowd.posedInputs, inputs);
+    pass.iterations = 0;
+    pass.unreachable = 0;
+    pass.moved = false;
+    parallelFor(crowd.lamps.size(), CROWD_CHUNK_LAMPS, updateCrowdChunk, &pass);
+    crowd.posed = true;
+    crowd.posedInputs = inputs;
+
+    frame.culledLamps = 0;
+    for (size_t i = 0; i < crowd.lamps.size(); i++)
+    {
+        frame.culledLamps += crowd.lampCulled[i];
+    }
+    frame.lights = crowd.lights;
+
+    // Groups: visible instances by LOD, then culled instances by LOD
+    const int GROUP_COUNT = 2 * LOD_COUNT;
+    for (int part = 0; part < CROWD_PART_COUNT; part++)
+    {
+        const std::vector<GLfloat> &data = crowd.instanceData[part];
+        const std::vector<unsigned char> &lods = crowd.instanceLods[part];
+        std::vector<GLfloat> &sorted = frame.uploadData[part];
+        size_t instances = lods.size();
+        size_t perLamp = PART_INSTANCES[part];
+
+        int counts[GROUP_COUNT] = {0};
+        for (size_t i = 0; i < instances; i++)
+        {
+            counts[lods[i] + crowd.lampCulled[i / perLamp] * LOD_COUNT]++;
+        }
+
+        size_t next[GROUP_COUNT];
+        next[0] = 0;
+        for (int group = 1; group < GROUP_COUNT; group++)
+        {
+            next[group] = next[group - 1] + counts[group - 1];
+        }
+        for (size_t i = 0; i < instances; i++)
+        {
+            size_t target = next[lods[i] + crowd.lampCulled[i / perLamp] * LOD_COUNT]++;
+            for (int f = 0; f < INSTANCE_FLOATS; f++)
+            {
+                sorted[target * INSTANCE_FLOATS + f] = data[i * INSTANCE_FLOATS + f];
+            }
+        }
+
+        for (int level = 0; level < LOD_COUNT; level++)
+        {
+            frame.lodCounts[part][level] = counts[level];
+            frame.culledLodCounts[part][level] = counts[LOD_COUNT + level];
+        }
+    }
+
+    frame.valid = true;
+    frame.inputs = inputs;
+    // Clip updates always move the lamps; aiming may not
+    frame.moved = pass.pose && (!inputs.aim || pass.moved);
+    frame.aimStats.iterations = inputs.aim ? pass.iterations.load() : 0;
+    frame.aimStats.unreachable = inputs.aim ? pass.unreachable.load() : 0;
+    frame.updateMicroseconds =
+        std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Background half of prefetchCrowdUpdate()
+static void crowdUpdateJob(void *context)
+{
+    Crowd &crowd = *(Crowd *)context;
+    CrowdFrame &frame = crowd.frames[1 - crowd.drawnFrame];
+    computeCrowdFrame(crowd, *crowd.jobMeshes, frame.inputs, frame);
+}
+
+/**
+ * Make the spare frame the drawn one and upload it
+ * Orphans and refills each buffer so the driver never waits on the GPU.
+ */
+static void showCrowdFrame(Crowd &crowd)
+{
+    crowd.drawnFrame = 1 - crowd.drawnFrame;
+    const CrowdFrame &frame = crowd.frames[crowd.drawnFrame];
+    for (int part = 0; part < CROWD_PART_COUNT; part++)
+    {
+        const std::vector<GLfloat> &data = frame.uploadData[part];
+        GLsizeiptr size = data.size() * sizeof(GLfloat);
+        glBindBuffer(GL_ARRAY_BUFFER, crowd.instanceBuffers[part]);
+        glBufferData(GL_ARRAY_BUFFER, size, NULL, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, size, data.empty() ? NULL : &data[0]);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+bool updateCrowd(Crowd &crowd, const LampMeshes &meshes, const CrowdUpdate &inputs)
+{
+    if (crowd.program == 0)
+    {
+        return false;
+    }
+
+    // The prefetch (if any) must finish before anything else touches the
+    // lamps; its frame is used only if it guessed the inputs right
+    CrowdFrame &spare = crowd.frames[1 - crowd.drawnFrame];
+    bool prefetched = crowd.prefetching;
+    waitJob(crowd.updateJob);
+    crowd.prefetching = false;
+
+    const CrowdFrame &drawn = crowd.frames[crowd.drawnFrame];
+    if (drawn.valid && sameUpdate(drawn.inputs, inputs))
+    {
+        return false;
+    }
+    if (!prefetched || !sameUpdate(spare.inputs, inputs))
+    {
+        computeCrowdFrame(crowd, meshes, inputs, spare);
+    }
+    showCrowdFrame(crowd);
+    return crowd.frames[crowd.drawnFrame].moved;
+}
+
+void prefetchCrowdUpdate(Crowd &crowd, const LampMeshes &meshes, const CrowdUpdate &inputs)
+{
+    const CrowdFrame &drawn = crowd.frames[crowd.drawnFrame];
+    if (crowd.program == 0 || jobWorkerCount() == 0 || crowd.prefetching ||
+        (drawn.valid && sameUpdate(drawn.inputs, inputs)))
+    {
+        return;
+    }
+    crowd.frames[1 - crowd.drawnFrame].inputs = inputs;
+    crowd.jobMeshes = &meshes;
+    crowd.prefetching = true;
+    startJob(crowd.updateJob, crowdUpdateJob, &crowd);
+}
+
+void resetCrowdFrames(Crowd &crowd)
+{
+    waitJob(crowd.updateJob);
+    crowd.prefetching = false;
+    crowd.posed = false;
+    crowd.frames[0].valid = false;
+    crowd.frames[1].valid = false;
+}
+
+const CrowdFrame &drawnCrowdFrame(const Crowd &crowd)
+{
+    return crowd.frames[crowd.drawnFrame];
+}
+
+/**
+ * Bind one part's instance buffer to instanced vertex attributes
+ * @param matrix - Location of the mat4 attribute (four locations)
+ * @param color - Location of the color attribute, -1 to leave it out
+ * @param index - Location of the instance index attribute, -1 to leave it out
+ * @param firstInstance - Instance the attributes start at
+ * @param enable - true to set up before drawing, false to tear down
+ */
+static void bindInstanceAttributes(GLint matrix, GLint color, GLint index, GLuint buffer, size_t firstInstance,
+                                   bool enable)
+{
+    const GLint locations[6] = {matrix, matrix + 1, matrix + 2, matrix + 3, color, index};
+    const GLint sizes[6] = {4, 4, 4, 4, 4, 1};
+    size_t start = firstInstance * INSTANCE_STRIDE;
+    const size_t offsets[6] = {0, 4, 8, 12, 16, 20};
+    if (enable)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    }
+    for (int i = 0; i < 6; i++)
+    {
+        if (locations[i] < 0)
+        {
+            continue;
+        }
+        GLuint location = (GLuint)locations[i];
+        if (!enable)
+        {
+            glVertexAttribDivisor(location, 0);
+            glDisableVertexAttribArray(location);
+            continue;
+        }
+        glEnableVertexAttribArray(location);
+        glVertexAttribPointer(location, sizes[i], GL_FLOAT, GL_FALSE, INSTANCE_STRIDE,
+                              (const GLvoid *)(start + offsets[i] * sizeof(GLfloat)));
+        glVertexAttribDivisor(location, 1);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/**
+ * Draw the crowd with one instanced call per primitive and detail level
+ * Draws the frame updateCrowd() last uploaded. Leaves the instanced
+ * program unbound (current program = 0).
+ * @param includeCulled - Also draw lamps outside the camera frustum
+ */
+void drawCrowd(const Crowd &crowd, const LampMeshes &meshes, bool spotlightEnabled, bool includeCulled)
+{
+    if (crowd.program == 0 || crowd.lamps.empty())
+    {
+        return;
+    }
+
+    const LodMesh *partMeshes[CROWD_PART_COUNT] = {
+        &meshes.baseSide, &meshes.baseCap, &meshes.joint, &meshes.lowerArm,
+        &meshes.upperArm, &meshes.shadeCone, &meshes.shadeCap};
+    const CrowdFrame &frame = crowd.frames[crowd.drawnFrame];
+
+    glUseProgram(crowd.program);
+    glUniform1i(crowd.spotlightEnabledLocation, spotlightEnabled ? 1 : 0);
+    setMaterialIndexUniform(crowd.materialIndexLocation);
+
+    for (int part = 0; part < CROWD_PART_COUNT; part++)
+    {
+        bindMaterial(PART_MATERIALS[part]);
+
+        // Culled instances follow all visible ones in the buffer
+        size_t first = 0;
+        for (int group = 0; group < (includeCulled ? 2 * LOD_COUNT : LOD_COUNT); group++)
+        {
+            int level = group % LOD_COUNT;
+            int count = group < LOD_COUNT ? frame.lodCounts[part][level] : frame.culledLodCounts[part][level];
+            if (count == 0)
+            {
+                continue;
+            }
+            bindInstanceAttributes(crowd.matrixLocation, crowd.colorLocation, -1, crowd.instanceBuffers[part], first,
+                                   true);
+            drawMeshInstanced(partMeshes[part]->levels[level], count);
+            first += count;
+        }
+        bindInstanceAttributes(crowd.matrixLocation, crowd.colorLocation, -1, 0, 0, false);
+    }
+
+    glUseProgram(0);
+    setMaterialIndexUniform(-1);
+}
+
+/**
+ * Draw the crowd's pick IDs into the pick pass (same meshes, LODs and
+ * instance buffers as drawCrowd(), visible lamps only)
+ * The pick program turns each instance's index in lamp order into its
+ * lamp and joint, so no per-lamp data is uploaded for the pass.
+ * @param pick - Pick pass in progress (beginPickPass())
+ * @param firstLamp - Pick lamp number of crowd lamp 0
+ */
+void drawCrowdPickIds(const Crowd &crowd, const LampMeshes &meshes, const PickBuffer &pick, int firstLamp)
+{
+    if (crowd.program == 0 || crowd.lamps.empty())
+    {
+        return;
+    }
+
+    const LodMesh *partMeshes[CROWD_PART_COUNT] = {
+        &meshes.baseSide, &meshes.baseCap, &meshes.joint, &meshes.lowerArm,
+        &meshes.upperArm, &meshes.shadeCone, &meshes.shadeCap};
+    const CrowdFrame &frame = crowd.frames[crowd.drawnFrame];
+
+    for (int part = 0; part < CROWD_PART_COUNT; part++)
+    {
+        setPickInstancing(pick, pickId(firstLamp, 0), PART_JOINTS[part], PART_INSTANCES[part]);
+        size_t first = 0;
+        for (int level = 0; level < LOD_COUNT; level++)
+        {
+            int count = frame.lodCounts[part][level];
+            if (count == 0)
+            {
+                continue;
+            }
+            bindInstanceAttributes(pick.matrixLocation, -1, pick.indexLocation, crowd.instanceBuffers[part], first,
+                                   true);
+            drawMeshInstanced(partMeshes[part]->levels[level], count);
+            first += count;
+        }
+        bindInstanceAttributes(pick.matrixLocation, -1, pick.indexLocation, 0, 0, false);
+    }
+}
@@ -0,0 +1,162 @@
+/*
+ * Instanced Lamp Crowd
+ *
+ * A field of small lamps, each with its own LampJoints, color and
+ * animation phase. Every lamp primitive (base, arms, joints, shade) is
+ * drawn once for the whole crowd with hardware instancing: per-instance
+ * world matrices and colors live in buffer objects that are refreshed
+ * only when the animation time or the camera changes. Instances are
+ * grouped by level of detail, one instanced call per part and level.
+ * Lamps whose bounding sphere lies outside the view frustum are skipped
+ * by the camera pass but still drawn into the shadow map. Every lamp
+ * also has its own spotlight, shaded through the light clusters.
+ * Updates (clip sampling or IK, batched SIMD kinematics, LOD selection)
+ * run in chunks on the job system and are double-buffered, so the next
+ * frame's update can be computed while this one is drawn.
+ */
+
+#ifndef CROWD_H
+#define CROWD_H
+
+#include "animation.h"
+#include "frustum.h"
+#include "jobs.h"
+#include "kinematics.h"
+#include "lights.h"
+#include "mesh.h"
+#include "picking.h"
+#include "posebatch.h"
+
+#include <vector>
+
+// One instanced draw batch per lamp primitive
+enum CrowdPart
+{
+    CROWD_BASE_SIDE = 0,
+    CROWD_BASE_CAP,
+    CROWD_JOINT, // Three instances per lamp
+    CROWD_LOWER_ARM,
+    CROWD_UPPER_ARM,
+    CROWD_SHADE_CONE,
+    CROWD_SHADE_CAP,
+    CROWD_PART_COUNT
+};
+
+struct CrowdLamp
+{
+    Mat4 placement;    // Position, heading and scale on the table
+    float phase;       // Animation time offset (seconds)
+    float color[4];    // Ambient/diffuse color of this lamp
+    LampJoints joints; // Current pose
+};
+
+// Solver work done by one crowd look-at update
+struct CrowdAimStats
+{
+    int iterations;  // Summed over all lamps
+    int unreachable; // Lamps whose joint limits keep them off target
+};
+
+// Everything a crowd update depends on
+struct CrowdUpdate
+{
+    bool aim; // Aim at target with IK instead of playing clip
+    const AnimationClip *clip;
+    float time;
+    Interpolation mode;
+    float target[3]; // World space
+    LodView view;
+    Frustum frustum; // Camera view volume, for culling
+};
+
+// LOD-grouped instance data produced by one update. The crowd keeps two:
+// one is drawn while the workers fill the other. Each part's instances
+// are stored visible lamps first, then culled ones, by LOD in both.
+struct CrowdFrame
+{
+    bool valid;
+    CrowdUpdate inputs;
+    std::vector<GLfloat> uploadData[CROWD_PART_COUNT];
+    int lodCounts[CROWD_PART_COUNT][LOD_COUNT];       // Visible instances
+    int culledLodCounts[CROWD_PART_COUNT][LOD_COUNT]; // Outside the frustum
+    int culledLamps;
+    std::vector<SpotLight> lights; // One spotlight per lamp, in lamp order
+
+    bool moved;             // Lamp poses differ from the previous frame
+    CrowdAimStats aimStats; // Solver work, if this was a look-at update
+    double updateMicroseconds;
+};
+
+struct Crowd
+{
+    std::vector<CrowdLamp> lamps;
+
+    // Placements and joints of every lamp in structure-of-arrays form,
+    // and the world-space poses computed from them
+    LampBatch batch;
+    LampPoseBatch poses;
+
+    // Instanced lighting program and its inputs
+    GLuint program;
+    GLint matrixLocation; // mat4 attribute, occupies four locations
+    GLint colorLocation;
+    GLint spotlightEnabledLocation;
+    GLint materialIndexLocation; // -1 if materials come from gl_FrontMaterial
+
+    // Per-part instance data: 16 floats matrix + 4 floats color + the
+    // instance's index each, in lamp order, with each instance's LOD.
+    // Sized once, rewritten in place, and only touched by the update in
+    // flight.
+    GLuint instanceBuffers[CROWD_PART_COUNT];
+    std::vector<GLfloat> instanceData[CROWD_PART_COUNT];
+    std::vector<unsigned char> instanceLods[CROWD_PART_COUNT];
+    std::vector<unsigned char> lampCulled; // Per lamp: outside the frustum
+    std::vector<SpotLight> lights;
+    bool posed; // posedInputs describes the current joints
+    CrowdUpdate posedInputs;
+
+    // frames[drawnFrame] is in the instance buffers; the other one is free
+    // or, while prefetching, being filled by updateJob
+    CrowdFrame frames[2];
+    int drawnFrame;
+    bool prefetching;
+    Job updateJob;
+    const LampMeshes *jobMeshes;
+};
+
+// Lay out rows x columns lamps, leaving a clear circle around the origin.
+// Returns false if instancing (GL 3.3 / GLSL) is not available.
+bool createCrowd(Crowd &crowd, int rows, int columns, float spacing, float lampScale, float clearRadius);
+
+// Bring the drawn frame up to date with inputs: adopt the prefetched
+// frame if it was computed for the same inputs, otherwise update now
+// (spread over the job system's workers). Each lamp either samples the
+// clip at time + its phase or aims its spotlight at the target with
+// solveLookAt(), warm-started from its current pose, and is culled
+// against the frustum. Uploads the instance buffers; returns true if
+// any lamp moved.
+bool updateCrowd(Crowd &crowd, const LampMeshes &meshes, const CrowdUpdate &inputs);
+
+// Start computing the frame for inputs expected next on a worker, so it
+// overlaps this frame's GL submission. No-op without workers or if the
+// drawn frame already matches.
+void prefetchCrowdUpdate(Crowd &crowd, const LampMeshes &meshes, const CrowdUpdate &inputs);
+
+// Finish any prefetch and drop every computed frame, so the next
+// updateCrowd() poses all lamps again; call before changing the lamp
+// dimensions or meshes
+void resetCrowdFrames(Crowd &crowd);
+
+// Frame currently in the instance buffers
+const CrowdFrame &drawnCrowdFrame(const Crowd &crowd);
+
+// Draw the crowd: one instanced call per lamp primitive and LOD. Lamps
+// outside the camera frustum are included only if includeCulled is set
+// (for passes with another view, like the shadow map).
+void drawCrowd(const Crowd &crowd, const LampMeshes &meshes, bool spotlightEnabled, bool includeCulled);
+
+// Draw the lamps in view into a pick pass; crowd lamp i gets pick lamp
+// number firstLamp + i
+void drawCrowdPickIds(const Crowd &crowd, const LampMeshes &meshes, const PickBuffer &pick, int firstLamp);
+
+#endif // CROWD_H
@@ -0,0 +1,88 @@
+/*
+ * View Frustum Culling - implementation
+ */
+
+#include "frustum.h"
+
+#include <cmath>
+
+/**
+ * Extract the clip planes from a combined matrix (Gribb/Hartmann)
+ * A clip-space point is inside when -w <= x, y, z <= w, so each plane is
+ * the matrix's fourth row plus or minus one of the other rows.
+ * @param viewProjection - Projection * view (world to clip space)
+ */
+Frustum extractFrustum(const Mat4 &viewProjection)
+{
+    const float *m = viewProjection.m;
+    Frustum frustum;
+    for (int plane = 0; plane < FRUSTUM_PLANE_COUNT; plane++)
+    {
+        int row = plane / 2;
+        float sign = (plane % 2 == 0) ? 1.0f : -1.0f;
+        float *p = frustum.planes[plane];
+        for (int column = 0; column < 4; column++)
+        {
+            p[column] = m[column * 4 + 3] + sign * m[column * 4 + row];
+        }
+        float length = sqrtf(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+        for (int i = 0; i < 4; i++)
+        {
+            p[i] /= length;
+        }
+    }
+    return frustum;
+}
+
+/**
+ * Sphere test: rejected only when fully behind one of the planes
+ */
+bool sphereInFrustum(const Frustum &frustum, const float center[3], float radius)
+{
+    for (int plane = 0; plane < FRUSTUM_PLANE_COUNT; plane++)
+    {
+        const float *p = frustum.planes[plane];
+        if (p[0] * center[0] + p[1] * center[1] + p[2] * center[2] + p[3] < -radius)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Box test: rejected when the corner furthest along a plane's normal is
+ * still behind that plane
+ */
+bool boxInFrustum(const Frustum &frustum, const float boxMin[3], const float boxMax[3])
+{
+    for (int plane = 0; plane < FRUSTUM_PLANE_COUNT; plane++)
+    {
+        const float *p = frustum.planes[plane];
+        float distance = p[3];
+        for (int axis = 0; axis < 3; axis++)
+        {
+            distance += p[axis] * (p[axis] >= 0.0f ? boxMax[axis] : boxMin[axis]);
+        }
+        if (distance < 0.0f)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool frustumsEqual(const Frustum &a, const Frustum &b)
+{
+    for (int plane = 0; plane < FRUSTUM_PLANE_COUNT; plane++)
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            if (a.planes[plane][i] != b.planes[plane][i])
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
@@ -0,0 +1,42 @@
+/*
+ * View Frustum Culling
+ *
+ * The six planes of a camera's view volume, taken straight from its
+ * projection * view matrix, and conservative visibility tests for
+ * bounding spheres and axis-aligned boxes. A test only answers "may be
+ * visible": objects near a frustum corner can pass without being on
+ * screen, but nothing visible is ever rejected.
+ */
+
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include "matrix.h"
+
+enum FrustumPlane
+{
+    FRUSTUM_LEFT = 0,
+    FRUSTUM_RIGHT,
+    FRUSTUM_BOTTOM,
+    FRUSTUM_TOP,
+    FRUSTUM_NEAR,
+    FRUSTUM_FAR,
+    FRUSTUM_PLANE_COUNT
+};
+
+// Plane (a, b, c, d) keeps points with a x + b y + c z + d >= 0; (a, b, c)
+// is unit length, so the left-hand side is a signed distance
+struct Frustum
+{
+    float planes[FRUSTUM_PLANE_COUNT][4];
+};
+
+// World-space frustum of projection * view
+Frustum extractFrustum(const Mat4 &viewProjection);
+
+bool sphereInFrustum(const Frustum &frustum, const float center[3], float radius);
+bool boxInFrustum(const Frustum &frustum, const float boxMin[3], const float boxMax[3]);
+
+bool frustumsEqual(const Frustum &a, const Frustum &b);
+
+#endif // FRUSTUM_H
@@ -0,0 +1,124 @@
+/*
+ * Input Event Queue - implementation
+ */
+
+#include "input.h"
+
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+static const char *RECORDING_HEADER = "# PixarLamp input recording v1";
+static const char *EVENT_TYPE_NAMES[INPUT_EVENT_TYPE_COUNT] = {"key", "special", "tick", "orbit-x", "orbit-y", "zoom"};
+
+static std::deque<InputEvent> queue;
+static InputHandler handler = NULL;
+static std::ofstream recording;
+
+void setInputHandler(InputHandler inputHandler)
+{
+    handler = inputHandler;
+}
+
+void postInputEvent(InputEventType type, int code, int time)
+{
+    InputEvent event = {time, type, code};
+    queue.push_back(event);
+}
+
+/**
+ * Hand every queued event to the handler, oldest first
+ * Events are recorded before they are handled, so a handler that exits
+ * the program (ESC) still leaves its event in the recording.
+ */
+void dispatchInputEvents()
+{
+    while (!queue.empty())
+    {
+        InputEvent event = queue.front();
+        queue.pop_front();
+        if (recording.is_open())
+        {
+            recording << event.time << ' ' << EVENT_TYPE_NAMES[event.type] << ' ' << event.code << '\n';
+            recording.flush();
+        }
+        if (handler != NULL)
+        {
+            handler(event);
+        }
+    }
+}
+
+bool startInputRecording(const char *path)
+{
+    recording.open(path, std::ios::out | std::ios::trunc);
+    if (!recording.is_open())
+    {
+        return false;
+    }
+    recording << RECORDING_HEADER << '\n';
+    return true;
+}
+
+void stopInputRecording()
+{
+    if (recording.is_open())
+    {
+        recording.close();
+    }
+}
+
+/**
+ * Read a recording made by startInputRecording()
+ * Lines starting with '#' are comments; times must not decrease.
+ * @param path - Recording file
+ * @param events - Receives the events in file order
+ * @return false (after printing the offending line) on any error
+ */
+bool loadInputRecording(const char *path, std::vector<InputEvent> &events)
+{
+    std::ifstream in(path);
+    if (!in.is_open())
+    {
+        std::cerr << "Cannot open input recording " << path << std::endl;
+        return false;
+    }
+
+    events.clear();
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(in, line))
+    {
+        lineNumber++;
+        if (line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+
+        std::istringstream fields(line);
+        std::string typeName;
+        InputEvent event;
+        int type = INPUT_EVENT_TYPE_COUNT;
+        if (fields >> event.time >> typeName >> event.code)
+        {
+            for (type = 0; type < INPUT_EVENT_TYPE_COUNT; type++)
+            {
+                if (typeName == EVENT_TYPE_NAMES[type])
+                {
+                    break;
+                }
+            }
+        }
+        if (type == INPUT_EVENT_TYPE_COUNT || (!events.empty() && event.time < events.back().time))
+        {
+            std::cerr << path << ":" << lineNumber << ": expected '<time> <event type> <code>' in time order"
+                      << std::endl;
+            return false;
+        }
+        event.type = (InputEventType)type;
+        events.push_back(event);
+    }
+    return true;
+}
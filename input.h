@@ -0,0 +1,60 @@
+/*
+ * Input Event Queue
+ *
+ * Everything that changes the scene from outside - key presses, mouse
+ * drags and the ticks of the animation clock - arrives as a timestamped
+ * InputEvent.
+ * Events are queued, handed to one handler in order, and optionally
+ * written to a recording. A recording replays the same event sequence,
+ * either at its original pace in the window or as fast as frames render
+ * (--bench --replay), which gives a reproducible workload for comparing
+ * frame-time traces between builds.
+ *
+ * Recordings are text, one event per line:
+ *   <milliseconds since start> key|special|tick|orbit-x|orbit-y|zoom <code>
+ * where code is the ASCII key, the GLUT special key, the milliseconds
+ * the animation clock advanced, or the pixels the mouse was dragged.
+ */
+
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <vector>
+
+enum InputEventType
+{
+    INPUT_KEY = 0,     // keyboard(): ASCII key
+    INPUT_SPECIAL_KEY, // specialKeys(): GLUT_KEY_* code
+    INPUT_CLOCK_TICK,  // Animation clock advanced by code milliseconds
+    INPUT_ORBIT_X,     // Camera orbit drag, code pixels to the right
+    INPUT_ORBIT_Y,     // Camera orbit drag, code pixels down
+    INPUT_ZOOM,        // Zoom drag (or wheel), code pixels down = out
+    INPUT_EVENT_TYPE_COUNT
+};
+
+struct InputEvent
+{
+    int time; // Milliseconds since the session (or recording) started
+    InputEventType type;
+    int code;
+};
+
+typedef void (*InputHandler)(const InputEvent &event);
+
+// Handler that receives every dispatched event
+void setInputHandler(InputHandler handler);
+
+// Add an event to the queue; dispatchInputEvents() delivers it
+void postInputEvent(InputEventType type, int code, int time);
+
+// Deliver queued events in order, recording each one first
+void dispatchInputEvents();
+
+// Record every dispatched event to a file; returns false on error
+bool startInputRecording(const char *path);
+void stopInputRecording();
+
+// Read a recording; returns false (with a message) on any error
+bool loadInputRecording(const char *path, std::vector<InputEvent> &events);
+
+#endif // INPUT_H
@@ -0,0 +1,247 @@
+/*
+ * Worker Thread Pool - implementation
+ *
+ * One lock and one FIFO queue. Entries are either a Job or a helper
+ * ticket for a running parallelFor(); tickets claim chunks through an
+ * atomic counter, so however many workers join a loop, each chunk runs
+ * exactly once.
+ */
+
+#include "jobs.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// One parallelFor() call; lives on the caller's stack
+struct ParallelLoop
+{
+    RangeFunction function;
+    void *context;
+    size_t count;
+    size_t grain;
+    size_t chunks;
+    std::atomic<size_t> nextChunk;
+    int tickets; // Queued or running helper tickets, guarded by the lock
+};
+
+struct QueueEntry
+{
+    Job *job;
+    ParallelLoop *loop;
+};
+
+static std::mutex poolMutex;
+static std::condition_variable workAvailable;
+static std::condition_variable workDone;
+static std::deque<QueueEntry> queue;
+static std::vector<std::thread> workers;
+static bool stopping = false;
+
+/**
+ * Claim and run chunks of a loop until none are left
+ */
+static void runChunks(ParallelLoop &loop)
+{
+    for (;;)
+    {
+        size_t chunk = loop.nextChunk.fetch_add(1);
+        if (chunk >= loop.chunks)
+        {
+            return;
+        }
+        size_t begin = chunk * loop.grain;
+        loop.function(begin, std::min(begin + loop.grain, loop.count), loop.context);
+    }
+}
+
+static void workerMain()
+{
+    std::unique_lock<std::mutex> lock(poolMutex);
+    for (;;)
+    {
+        workAvailable.wait(lock, [] { return stopping || !queue.empty(); });
+        if (queue.empty())
+        {
+            return; // Stopping, and nothing left to do
+        }
+        QueueEntry entry = queue.front();
+        queue.pop_front();
+        if (entry.job != NULL)
+        {
+            entry.job->state = JOB_RUNNING;
+        }
+
+        lock.unlock();
+        if (entry.job != NULL)
+        {
+            entry.job->run(entry.job->context);
+        }
+        else
+        {
+            runChunks(*entry.loop);
+        }
+        lock.lock();
+
+        if (entry.job != NULL)
+        {
+            entry.job->state = JOB_DONE;
+        }
+        else
+        {
+            entry.loop->tickets--;
+        }
+        workDone.notify_all();
+    }
+}
+
+void startJobSystem(int workerCount)
+{
+    stopJobSystem();
+    if (workerCount < 0)
+    {
+        // hardware_concurrency() may report 0 when unknown
+        workerCount = std::max(0, (int)std::thread::hardware_concurrency() - 1);
+    }
+    stopping = false;
+    for (int i = 0; i < workerCount; i++)
+    {
+        workers.push_back(std::thread(workerMain));
+    }
+}
+
+/**
+ * Let the workers drain the queue, then join them
+ */
+void stopJobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        stopping = true;
+    }
+    workAvailable.notify_all();
+    for (size_t i = 0; i < workers.size(); i++)
+    {
+        workers[i].join();
+    }
+    workers.clear();
+}
+
+int jobWorkerCount()
+{
+    return (int)workers.size();
+}
+
+void startJob(Job &job, void (*run)(void *context), void *context)
+{
+    waitJob(job);
+    job.run = run;
+    job.context = context;
+    if (workers.empty())
+    {
+        run(context);
+        return;
+    }
+
+    QueueEntry entry = {&job, NULL};
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        job.state = JOB_QUEUED;
+        queue.push_back(entry);
+    }
+    workAvailable.notify_one();
+}
+
+/**
+ * Wait for a job, taking it out of the queue and running it here if no
+ * worker has started it yet
+ */
+void waitJob(Job &job)
+{
+    std::unique_lock<std::mutex> lock(poolMutex);
+    if (job.state == JOB_QUEUED)
+    {
+        for (std::deque<QueueEntry>::iterator it = queue.begin(); it != queue.end(); ++it)
+        {
+            if (it->job == &job)
+            {
+                queue.erase(it);
+                break;
+            }
+        }
+        job.state = JOB_RUNNING;
+        lock.unlock();
+        job.run(job.context);
+        lock.lock();
+    }
+    else
+    {
+        workDone.wait(lock, [&job] { return job.state != JOB_RUNNING; });
+    }
+    job.state = JOB_IDLE;
+}
+
+/**
+ * Run a range in chunks on the workers and this thread
+ * One helper ticket is queued per worker that could usefully join; the
+ * caller then claims chunks itself, withdraws the tickets nobody picked
+ * up and waits only for chunks already in flight.
+ * @param grain - Chunk size (items); chunk starts are multiples of it
+ */
+void parallelFor(size_t count, size_t grain, RangeFunction function, void *context)
+{
+    if (count == 0)
+    {
+        return;
+    }
+    grain = std::max(grain, (size_t)1);
+
+    ParallelLoop loop;
+    loop.function = function;
+    loop.context = context;
+    loop.count = count;
+    loop.grain = grain;
+    loop.chunks = (count + grain - 1) / grain;
+    loop.nextChunk = 0;
+    loop.tickets = 0;
+
+    int helpers = (int)std::min(loop.chunks - 1, workers.size());
+    if (helpers > 0)
+    {
+        QueueEntry entry = {NULL, &loop};
+        {
+            std::lock_guard<std::mutex> lock(poolMutex);
+            for (int i = 0; i < helpers; i++)
+            {
+                queue.push_back(entry);
+            }
+            loop.tickets = helpers;
+        }
+        workAvailable.notify_all();
+    }
+
+    runChunks(loop);
+    if (helpers == 0)
+    {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(poolMutex);
+    for (std::deque<QueueEntry>::iterator it = queue.begin(); it != queue.end();)
+    {
+        if (it->loop == &loop)
+        {
+            it = queue.erase(it);
+            loop.tickets--;
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    workDone.wait(lock, [&loop] { return loop.tickets == 0; });
+}
@@ -0,0 +1,55 @@
+/*
+ * Worker Thread Pool
+ *
+ * A fixed set of worker threads for CPU-side scene updates, with two
+ * kinds of work:
+ *   - parallelFor(): split an index range into chunks, run them on the
+ *     workers and the calling thread, return once every chunk is done
+ *   - startJob()/waitJob(): run one task in the background, e.g. the
+ *     next frame's crowd update while this frame is submitted to GL
+ * A background job may itself call parallelFor(). Waiting never idles
+ * on the queue: waitJob() runs a job no worker has picked up yet, and a
+ * parallelFor() caller works through the chunks itself.
+ */
+
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <cstddef>
+
+enum JobState
+{
+    JOB_IDLE = 0, // Never started, or finished and waited for
+    JOB_QUEUED,
+    JOB_RUNNING,
+    JOB_DONE
+};
+
+// A background task; owned by the caller, reusable once waited for.
+// Must start out JOB_IDLE.
+struct Job
+{
+    void (*run)(void *context);
+    void *context;
+    JobState state; // Guarded by the pool lock
+};
+
+// Start the workers: -1 = one per hardware thread besides the caller,
+// 0 = none (all work runs on the calling thread)
+void startJobSystem(int workers);
+void stopJobSystem();
+int jobWorkerCount();
+
+// Queue job.run(context) for a worker (runs it right away without workers)
+void startJob(Job &job, void (*run)(void *context), void *context);
+
+// Block until the job has finished; jobs not started yet run here.
+// No-op for a job that was never started or already waited for.
+void waitJob(Job &job);
+
+// Call function(begin, end, context) on disjoint chunks of [0, count),
+// each at most grain items long and starting at a multiple of grain
+typedef void (*RangeFunction)(size_t begin, size_t end, void *context);
+void parallelFor(size_t count, size_t grain, RangeFunction function, void *context);
+
+#endif // JOBS_H
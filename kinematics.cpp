@@ -0,0 +1,281 @@
+/*
+ * Lamp Forward Kinematics - implementation
+ */
+
+#include "kinematics.h"
+
+#include <cmath>
+
+// Look-at solver settings
+static const int LOOK_AT_MAX_ITERATIONS = 20;
+static const float LOOK_AT_TOLERANCE = 0.01f * (float)M_PI / 180.0f; // Aim error accepted (radians)
+static const float LOOK_AT_DAMPING = 0.05f;                          // Keeps steps finite near singularities
+static const float LOOK_AT_MAX_STEP = 0.25f;                         // Largest joint change per step (radians)
+
+// Share of each corrective step taken by the lower arm, upper arm and
+// lampshade: the shade does most of the aiming, like a person would
+static const float LOOK_AT_WEIGHTS[3] = {0.15f, 0.35f, 1.0f};
+
+LampDimensions lampDimensions = DEFAULT_LAMP_DIMENSIONS;
+
+/**
+ * Walk the joint hierarchy: Base -> LowerArm -> UpperArm -> Lampshade
+ * Each step mirrors the glRotatef()/glTranslatef() sequence the lamp
+ * was originally drawn with.
+ * @param joints - Joint angles in degrees
+ * @param pose - Receives the world matrix of every part and the spotlight
+ */
+void computeLampPose(const LampJoints &joints, LampPose &pose)
+{
+    const LampDimensions &d = lampDimensions;
+
+    // Level 1: Base rotation (Y-axis)
+    pose.base = mat4Identity();
+    mat4Rotate(pose.base, joints.baseRotation, 0.0f, 1.0f, 0.0f);
+
+    // Level 2: Lower arm pivots on top of the base
+    pose.lowerJoint = pose.base;
+    mat4Translate(pose.lowerJoint, 0.0f, d.baseHeight, 0.0f);
+    pose.lowerArm = pose.lowerJoint;
+    mat4Rotate(pose.lowerArm, joints.lowerArmAngle, 1.0f, 0.0f, 0.0f);
+
+    // Level 3: Upper arm pivots at the end of the lower arm
+    pose.upperJoint = pose.lowerArm;
+    mat4Translate(pose.upperJoint, 0.0f, d.lowerArmLength, 0.0f);
+    pose.upperArm = pose.upperJoint;
+    mat4Rotate(pose.upperArm, joints.upperArmAngle, 1.0f, 0.0f, 0.0f);
+
+    // Level 4: Lampshade tilts and spins at the end of the upper arm
+    pose.shadeJoint = pose.upperArm;
+    mat4Translate(pose.shadeJoint, 0.0f, d.upperArmLength, 0.0f);
+    pose.lampshade = pose.shadeJoint;
+    mat4Rotate(pose.lampshade, joints.lampshadeAngle, 1.0f, 0.0f, 0.0f);
+    mat4Rotate(pose.lampshade, joints.lampshadeRotation, 0.0f, 1.0f, 0.0f);
+
+    // Spotlight frame: past the joint sphere, aligned with the cone (+Z opens
+    // toward the table), light source at 60% depth inside the lampshade
+    Mat4 light = pose.lampshade;
+    mat4Translate(light, 0.0f, lampJointRadius(d), 0.0f);
+    mat4Rotate(light, -90.0f, 1.0f, 0.0f, 0.0f);
+    mat4Translate(light, 0.0f, 0.0f, d.lampshadeHeight * 0.6f);
+
+    // Position is the translation column, direction the transformed Z-axis
+    for (int i = 0; i < 3; i++)
+    {
+        pose.spotPosition[i] = light.m[12 + i];
+        pose.spotDirection[i] = light.m[8 + i];
+    }
+}
+
+/**
+ * Premultiply every part frame by a translation
+ * The part matrices are affine, so only their translation columns change.
+ * @param offset - World-space displacement
+ */
+void translateLampPose(LampPose &pose, const float offset[3])
+{
+    Mat4 *parts[] = {&pose.base,     &pose.lowerJoint, &pose.lowerArm, &pose.upperJoint,
+                     &pose.upperArm, &pose.shadeJoint, &pose.lampshade};
+    for (size_t part = 0; part < sizeof(parts) / sizeof(parts[0]); part++)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            parts[part]->m[12 + i] += offset[i];
+        }
+    }
+    for (int i = 0; i < 3; i++)
+    {
+        pose.spotPosition[i] += offset[i];
+    }
+}
+
+/**
+ * Bounds for culling that never need updating as the joints move
+ * Every arm point lies within the two link lengths of the lower pivot,
+ * and the shade (cone past the joint sphere) within its far rim of the
+ * shade joint; the base is checked separately since it sits below the
+ * pivot.
+ */
+void lampBoundingSphere(float center[3], float &radius)
+{
+    const LampDimensions &d = lampDimensions;
+    center[0] = 0.0f;
+    center[1] = d.baseHeight;
+    center[2] = 0.0f;
+
+    float shadeDepth = lampJointRadius(d) + d.lampshadeHeight;
+    float shadeReach = sqrtf(shadeDepth * shadeDepth + d.lampshadeRadius * d.lampshadeRadius);
+    float armReach = d.lowerArmLength + d.upperArmLength + fmaxf(shadeReach, lampJointRadius(d));
+    float baseReach = sqrtf(d.baseRadius * d.baseRadius + d.baseHeight * d.baseHeight);
+    radius = fmaxf(armReach, baseReach);
+}
+
+static float degreesToRadians(float degrees)
+{
+    return degrees * (float)M_PI / 180.0f;
+}
+
+static float radiansToDegrees(float radians)
+{
+    return radians * 180.0f / (float)M_PI;
+}
+
+// Wrap an angle into [-pi, pi]
+static float wrapAngle(float angle)
+{
+    return atan2f(sinf(angle), cosf(angle));
+}
+
+/**
+ * Aim the spotlight at a point
+ * All three pitch joints rotate about the base's X-axis, so once the base
+ * faces the target the rest is planar: in the base's (z, y) plane a unit
+ * direction at angle t from +Y is (sin t, cos t), the light sits at
+ *   shoulder + L1 u(a1) + L2 u(a1 + a2) + SPOT_OFFSET u(a1 + a2 + a3)
+ * and shines along u(a1 + a2 + a3). The residual is the angle between
+ * that axis and the direction to the target; each iteration takes the
+ * weighted minimum-norm step that cancels its linearization, skipping
+ * joints pinned at a limit.
+ * @param target - Point to aim at, in the lamp's unrotated frame
+ * @param joints - Warm start on input, solution on output
+ * @return Iterations taken and the remaining error
+ */
+LookAtResult solveLookAt(const float target[3], LampJoints &joints)
+{
+    LookAtResult result = {0, 0.0f, false};
+
+    // Base: turn so the target lies on the side the lampshade faces (the
+    // arm plane's +Z or -Z); when the shade points straight down, take
+    // whichever turn is smaller
+    float shadeFacing = sinf(degreesToRadians(joints.lowerArmAngle + joints.upperArmAngle + joints.lampshadeAngle));
+    float horizontal = sqrtf(target[0] * target[0] + target[2] * target[2]);
+    float reach = 0.0f; // Signed target distance along the base's +Z
+    if (horizontal > 1e-4f)
+    {
+        // Candidates are snapped to the nearest full turn of the warm start
+        // so solving the same target again leaves the base untouched
+        float facing = radiansToDegrees(atan2f(target[0], target[2]));
+        float forward = facing + 360.0f * roundf((joints.baseRotation - facing) / 360.0f);
+        float backward = facing + 180.0f + 360.0f * roundf((joints.baseRotation - facing - 180.0f) / 360.0f);
+        bool useForward = fabsf(shadeFacing) > 0.1f
+                              ? shadeFacing > 0.0f
+                              : fabsf(forward - joints.baseRotation) <= fabsf(backward - joints.baseRotation);
+        joints.baseRotation = useForward ? forward : backward;
+        reach = useForward ? horizontal : -horizontal;
+    }
+    float targetZ = reach;
+    float targetY = target[1] - lampDimensions.baseHeight; // Relative to the shoulder joint
+
+    const float lengths[3] = {lampDimensions.lowerArmLength, lampDimensions.upperArmLength,
+                              lampSpotOffset(lampDimensions)};
+    const float minimum[3] = {degreesToRadians(LOWER_ARM_MIN), degreesToRadians(UPPER_ARM_MIN),
+                              degreesToRadians(LAMPSHADE_MIN)};
+    const float maximum[3] = {degreesToRadians(LOWER_ARM_MAX), degreesToRadians(UPPER_ARM_MAX),
+                              degreesToRadians(LAMPSHADE_MAX)};
+    float angles[3] = {degreesToRadians(joints.lowerArmAngle), degreesToRadians(joints.upperArmAngle),
+                       degreesToRadians(joints.lampshadeAngle)};
+
+    // Set once the short way round is blocked by the limits
+    bool longWay = false;
+
+    for (;;)
+    {
+        // Absolute angle of each segment, and the light position
+        float absolute[3];
+        absolute[0] = angles[0];
+        absolute[1] = absolute[0] + angles[1];
+        absolute[2] = absolute[1] + angles[2];
+        float lightZ = 0.0f;
+        float lightY = 0.0f;
+        for (int i = 0; i < 3; i++)
+        {
+            lightZ += lengths[i] * sinf(absolute[i]);
+            lightY += lengths[i] * cosf(absolute[i]);
+        }
+
+        float dz = targetZ - lightZ;
+        float dy = targetY - lightY;
+        float distanceSquared = dz * dz + dy * dy;
+        if (distanceSquared < 1e-8f)
+        {
+            break; // Target at the light: every direction is as good
+        }
+        float residual = wrapAngle(absolute[2] - atan2f(dz, dy));
+        result.errorDeg = radiansToDegrees(fabsf(residual));
+        if (fabsf(residual) <= LOOK_AT_TOLERANCE)
+        {
+            result.converged = true;
+            break;
+        }
+        if (result.iterations == LOOK_AT_MAX_ITERATIONS)
+        {
+            break;
+        }
+        if (longWay)
+        {
+            residual += residual > 0.0f ? -2.0f * (float)M_PI : 2.0f * (float)M_PI;
+        }
+
+        // d(residual)/d(angle i): the axis turns with every joint, and the
+        // light moving by dP turns the target direction by -cross(d, dP) / |d|^2
+        float jacobian[3];
+        for (int i = 0; i < 3; i++)
+        {
+            float dLightZ = 0.0f;
+            float dLightY = 0.0f;
+            for (int k = i; k < 3; k++)
+            {
+                dLightZ += lengths[k] * cosf(absolute[k]);
+                dLightY -= lengths[k] * sinf(absolute[k]);
+            }
+            jacobian[i] = 1.0f + (dy * dLightZ - dz * dLightY) / distanceSquared;
+        }
+
+        // Joints at a limit that the step would push further sit out
+        float weights[3];
+        float denominator = LOOK_AT_DAMPING * LOOK_AT_DAMPING;
+        for (int i = 0; i < 3; i++)
+        {
+            float direction = -residual * jacobian[i];
+            bool pinned = (angles[i] <= minimum[i] && direction < 0.0f) ||
+                          (angles[i] >= maximum[i] && direction > 0.0f);
+            weights[i] = pinned ? 0.0f : LOOK_AT_WEIGHTS[i];
+            denominator += weights[i] * jacobian[i] * jacobian[i];
+        }
+        if (denominator <= LOOK_AT_DAMPING * LOOK_AT_DAMPING)
+        {
+            if (longWay)
+            {
+                break; // Pinned both ways round: out of reach
+            }
+            longWay = true;
+            continue;
+        }
+
+        // Far from the solution the linearization overshoots; cap the step
+        float step[3];
+        float largest = 0.0f;
+        for (int i = 0; i < 3; i++)
+        {
+            step[i] = -residual * weights[i] * jacobian[i] / denominator;
+            largest = fmaxf(largest, fabsf(step[i]));
+        }
+        float scale = largest > LOOK_AT_MAX_STEP ? LOOK_AT_MAX_STEP / largest : 1.0f;
+        for (int i = 0; i < 3; i++)
+        {
+            angles[i] = fmaxf(minimum[i], fminf(angles[i] + scale * step[i], maximum[i]));
+        }
+        result.iterations++;
+    }
+
+    // Untouched joints keep their exact values, so a still target
+    // produces a bit-identical pose (and no redraw)
+    if (result.iterations > 0)
+    {
+        joints.lowerArmAngle = radiansToDegrees(angles[0]);
+        joints.upperArmAngle = radiansToDegrees(angles[1]);
+        joints.lampshadeAngle = radiansToDegrees(angles[2]);
+        clampLampJoints(joints);
+    }
+    return result;
+}
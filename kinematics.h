@@ -0,0 +1,59 @@
+/*
+ * Lamp Forward Kinematics
+ *
+ * Computes the world-space frame of every lamp part from LampJoints on
+ * the CPU. Both the renderer and the spotlight setup consume the same
+ * LampPose, so the light always matches the drawn lampshade and nothing
+ * has to be read back from the GL matrix stack.
+ *
+ * The inverse problem - aiming the spotlight at a point - is solved by
+ * solveLookAt(): the base turns analytically, and the three pitch joints
+ * are refined by damped Newton steps warm-started from the given pose.
+ */
+
+#ifndef KINEMATICS_H
+#define KINEMATICS_H
+
+#include "lamp.h"
+#include "matrix.h"
+
+// World-space frames of each lamp part, in hierarchy order
+struct LampPose
+{
+    Mat4 base;       // Base (after base rotation)
+    Mat4 lowerJoint; // Joint sphere on top of the base
+    Mat4 lowerArm;   // Lower arm (after lower arm rotation)
+    Mat4 upperJoint; // Joint sphere at the end of the lower arm
+    Mat4 upperArm;   // Upper arm (after upper arm rotation)
+    Mat4 shadeJoint; // Joint sphere at the end of the upper arm
+    Mat4 lampshade;  // Lampshade (after tilt and spin)
+
+    float spotPosition[3];  // Light source inside the lampshade
+    float spotDirection[3]; // Unit vector the lampshade opens toward
+};
+
+void computeLampPose(const LampJoints &joints, LampPose &pose);
+
+// Move a whole pose, e.g. by the base translation of hop physics
+void translateLampPose(LampPose &pose, const float offset[3]);
+
+// Sphere holding the lamp in every pose, in its own frame (base on the
+// origin): centered on the lower arm pivot, reaching the rim of a fully
+// stretched lampshade. Depends only on the link lengths.
+void lampBoundingSphere(float center[3], float &radius);
+
+// Outcome of one solveLookAt() call
+struct LookAtResult
+{
+    int iterations;  // Newton steps taken (0 if the warm start already aimed)
+    float errorDeg;  // Remaining angle between the spot axis and the target
+    bool converged;  // false if the joint limits keep the target out of reach
+};
+
+// Aim the spotlight at a target given relative to the lamp's own frame
+// (base on the origin, before baseRotation). joints is both the warm
+// start and the result; every joint stays within its limits and the
+// lampshade spin, which does not move the light, is left alone.
+LookAtResult solveLookAt(const float target[3], LampJoints &joints);
+
+#endif // KINEMATICS_H
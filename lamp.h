@@ -0,0 +1,96 @@
+/*
+ * Lamp Model
+ *
+ * Joint angles and physical dimensions of the articulated lamp, shared
+ * by the renderer and the kinematics code.
+ */
+
+#ifndef LAMP_H
+#define LAMP_H
+
+#include <cmath>
+
+// Structure to hold all lamp joint angles (in degrees)
+struct LampJoints
+{
+    float baseRotation;      // Rotation of entire lamp around Y-axis
+    float lowerArmAngle;     // Angle of lower arm from base
+    float upperArmAngle;     // Angle of upper arm from lower arm
+    float lampshadeAngle;    // Tilt angle of lampshade
+    float lampshadeRotation; // Rotation of lampshade around its own axis
+};
+
+// Joint angle limits (degrees) enforced by the controls
+const float LOWER_ARM_MIN = -10.0f;
+const float LOWER_ARM_MAX = 90.0f;
+const float UPPER_ARM_MIN = -120.0f;
+const float UPPER_ARM_MAX = 90.0f;
+const float LAMPSHADE_MIN = -90.0f;
+const float LAMPSHADE_MAX = 45.0f;
+
+// True if both configurations describe the same pose
+inline bool lampJointsEqual(const LampJoints &a, const LampJoints &b)
+{
+    return a.baseRotation == b.baseRotation && a.lowerArmAngle == b.lowerArmAngle &&
+           a.upperArmAngle == b.upperArmAngle && a.lampshadeAngle == b.lampshadeAngle &&
+           a.lampshadeRotation == b.lampshadeRotation;
+}
+
+// Force every joint angle into its allowed range
+inline void clampLampJoints(LampJoints &joints)
+{
+    joints.lowerArmAngle = fmax(LOWER_ARM_MIN, fmin(joints.lowerArmAngle, LOWER_ARM_MAX));
+    joints.upperArmAngle = fmax(UPPER_ARM_MIN, fmin(joints.upperArmAngle, UPPER_ARM_MAX));
+    joints.lampshadeAngle = fmax(LAMPSHADE_MIN, fmin(joints.lampshadeAngle, LAMPSHADE_MAX));
+}
+
+// Default lamp dimensions (constexpr: the part meshes for them are built
+// at compile time, see lampgeometry.cpp)
+constexpr float BASE_RADIUS = 1.0f;
+constexpr float BASE_HEIGHT = 0.3f;
+constexpr float ARM_RADIUS = 0.15f;
+constexpr float LOWER_ARM_LENGTH = 3.0f;
+constexpr float UPPER_ARM_LENGTH = 2.5f;
+constexpr float LAMPSHADE_RADIUS = 0.8f;
+constexpr float LAMPSHADE_HEIGHT = 1.2f;
+
+// Physical dimensions of the lamp
+struct LampDimensions
+{
+    float baseRadius;
+    float baseHeight;
+    float armRadius;
+    float lowerArmLength;
+    float upperArmLength;
+    float lampshadeRadius;
+    float lampshadeHeight;
+};
+
+const LampDimensions DEFAULT_LAMP_DIMENSIONS = {BASE_RADIUS,      BASE_HEIGHT,      ARM_RADIUS,      LOWER_ARM_LENGTH,
+                                                UPPER_ARM_LENGTH, LAMPSHADE_RADIUS, LAMPSHADE_HEIGHT};
+
+// Dimensions everything is drawn and posed with; a scene file may change
+// them between frames (see scene.h), never while a crowd update runs
+extern LampDimensions lampDimensions;
+
+inline bool lampDimensionsEqual(const LampDimensions &a, const LampDimensions &b)
+{
+    return a.baseRadius == b.baseRadius && a.baseHeight == b.baseHeight && a.armRadius == b.armRadius &&
+           a.lowerArmLength == b.lowerArmLength && a.upperArmLength == b.upperArmLength &&
+           a.lampshadeRadius == b.lampshadeRadius && a.lampshadeHeight == b.lampshadeHeight;
+}
+
+// Radius of the joint spheres, which also offset the lampshade from its joint
+inline float lampJointRadius(const LampDimensions &dimensions)
+{
+    return dimensions.armRadius * 1.5f;
+}
+
+// Distance from the shade joint to the light along the shade axis: past
+// the joint sphere, 60% deep into the lampshade
+inline float lampSpotOffset(const LampDimensions &dimensions)
+{
+    return lampJointRadius(dimensions) + dimensions.lampshadeHeight * 0.6f;
+}
+
+#endif // LAMP_H
@@ -0,0 +1,175 @@
+/*
+ * Lamp Part Geometry - implementation
+ *
+ * Each table is a constexpr variable, so it is evaluated during
+ * compilation and lands in read-only data; no constructor runs at
+ * startup. The slice and stack counts are those of level 0. The tables
+ * hold the default dimensions; parts whose dimensions a scene file
+ * changed are tessellated at run time with the same counts.
+ */
+
+#include "lampgeometry.h"
+
+#include "lamp.h"
+#include "tessellation.h"
+
+static const int BASE_SLICES = 32;
+static const int ARM_SLICES = 16;
+static const int JOINT_SLICES = 16;
+static const int JOINT_STACKS = 16;
+static const int SHADE_SLICES = 32;
+
+constexpr float JOINT_RADIUS = ARM_RADIUS * 1.5f;
+constexpr float SHADE_TOP_SCALE = 0.4f; // Cone: narrow at top, wide at bottom
+constexpr float SHADE_GLOW_SCALE = 0.5f; // Glow disk radius relative to the opening
+constexpr float SHADE_TOP_RADIUS = LAMPSHADE_RADIUS * SHADE_TOP_SCALE;
+constexpr float SHADE_GLOW_RADIUS = LAMPSHADE_RADIUS * SHADE_GLOW_SCALE;
+
+static constexpr CylinderLodTable<BASE_SLICES> BASE_SIDE =
+    cylinderLodTable<BASE_SLICES>(BASE_RADIUS, BASE_RADIUS, BASE_HEIGHT);
+static constexpr DiskLodTable<BASE_SLICES> BASE_CAP = diskLodTable<BASE_SLICES>(BASE_RADIUS);
+static constexpr CylinderLodTable<ARM_SLICES> LOWER_ARM =
+    cylinderLodTable<ARM_SLICES>(ARM_RADIUS, ARM_RADIUS, LOWER_ARM_LENGTH);
+static constexpr CylinderLodTable<ARM_SLICES> UPPER_ARM =
+    cylinderLodTable<ARM_SLICES>(ARM_RADIUS, ARM_RADIUS, UPPER_ARM_LENGTH);
+static constexpr SphereLodTable<JOINT_SLICES, JOINT_STACKS> JOINT =
+    sphereLodTable<JOINT_SLICES, JOINT_STACKS>(JOINT_RADIUS);
+static constexpr CylinderLodTable<SHADE_SLICES> SHADE_CONE =
+    cylinderLodTable<SHADE_SLICES>(SHADE_TOP_RADIUS, LAMPSHADE_RADIUS, LAMPSHADE_HEIGHT);
+static constexpr DiskLodTable<SHADE_SLICES> SHADE_CAP = diskLodTable<SHADE_SLICES>(SHADE_TOP_RADIUS);
+static constexpr DiskLodTable<SHADE_SLICES> SHADE_GLOW = diskLodTable<SHADE_SLICES>(SHADE_GLOW_RADIUS);
+
+// Each part at the given dimensions: from its table when those are the
+// defaults it was built for, otherwise tessellated now
+
+static LodMesh createBaseSide(const LampDimensions &d)
+{
+    if (d.baseRadius != BASE_RADIUS || d.baseHeight != BASE_HEIGHT)
+    {
+        return createCylinderLod(d.baseRadius, d.baseRadius, d.baseHeight, BASE_SLICES);
+    }
+    MeshData levels[LOD_COUNT];
+    describeLevels(BASE_SIDE, levels);
+    return createCylinderLod(levels, BASE_RADIUS, BASE_RADIUS, BASE_HEIGHT);
+}
+
+static LodMesh createBaseCap(const LampDimensions &d)
+{
+    if (d.baseRadius != BASE_RADIUS)
+    {
+        return createDiskLod(d.baseRadius, BASE_SLICES);
+    }
+    MeshData levels[LOD_COUNT];
+    describeLevels(BASE_CAP, levels);
+    return createDiskLod(levels, BASE_RADIUS);
+}
+
+static LodMesh createLowerArm(const LampDimensions &d)
+{
+    if (d.armRadius != ARM_RADIUS || d.lowerArmLength != LOWER_ARM_LENGTH)
+    {
+        return createCylinderLod(d.armRadius, d.armRadius, d.lowerArmLength, ARM_SLICES);
+    }
+    MeshData levels[LOD_COUNT];
+    describeLevels(LOWER_ARM, levels);
+    return createCylinderLod(levels, ARM_RADIUS, ARM_RADIUS, LOWER_ARM_LENGTH);
+}
+
+static LodMesh createUpperArm(const LampDimensions &d)
+{
+    if (d.armRadius != ARM_RADIUS || d.upperArmLength != UPPER_ARM_LENGTH)
+    {
+        return createCylinderLod(d.armRadius, d.armRadius, d.upperArmLength, ARM_SLICES);
+    }
+    MeshData levels[LOD_COUNT];
+    describeLevels(UPPER_ARM, levels);
+    return createCylinderLod(levels, ARM_RADIUS, ARM_RADIUS, UPPER_ARM_LENGTH);
+}
+
+static LodMesh createJoint(const LampDimensions &d)
+{
+    if (d.armRadius != ARM_RADIUS)
+    {
+        return createSphereLod(lampJointRadius(d), JOINT_SLICES, JOINT_STACKS);
+    }
+    MeshData levels[LOD_COUNT];
+    describeLevels(JOINT, levels);
+    return createSphereLod(levels, JOINT_RADIUS);
+}
+
+static LodMesh createShadeCone(const LampDimensions &d)
+{
+    if (d.lampshadeRadius != LAMPSHADE_RADIUS || d.lampshadeHeight != LAMPSHADE_HEIGHT)
+    {
+        return createCylinderLod(d.lampshadeRadius * SHADE_TOP_SCALE, d.lampshadeRadius, d.lampshadeHeight,
+                                 SHADE_SLICES);
+    }
+    MeshData levels[LOD_COUNT];
+    describeLevels(SHADE_CONE, levels);
+    return createCylinderLod(levels, SHADE_TOP_RADIUS, LAMPSHADE_RADIUS, LAMPSHADE_HEIGHT);
+}
+
+static LodMesh createShadeCap(const LampDimensions &d)
+{
+    if (d.lampshadeRadius != LAMPSHADE_RADIUS)
+    {
+        return createDiskLod(d.lampshadeRadius * SHADE_TOP_SCALE, SHADE_SLICES);
+    }
+    MeshData levels[LOD_COUNT];
+    describeLevels(SHADE_CAP, levels);
+    return createDiskLod(levels, SHADE_TOP_RADIUS);
+}
+
+static LodMesh createShadeGlow(const LampDimensions &d)
+{
+    if (d.lampshadeRadius != LAMPSHADE_RADIUS)
+    {
+        return createDiskLod(d.lampshadeRadius * SHADE_GLOW_SCALE, SHADE_SLICES);
+    }
+    MeshData levels[LOD_COUNT];
+    describeLevels(SHADE_GLOW, levels);
+    return createDiskLod(levels, SHADE_GLOW_RADIUS);
+}
+
+void createLampPartMeshes(LampMeshes &meshes, const LampDimensions &dimensions)
+{
+    meshes.baseSide = createBaseSide(dimensions);
+    meshes.baseCap = createBaseCap(dimensions);
+    meshes.lowerArm = createLowerArm(dimensions);
+    meshes.upperArm = createUpperArm(dimensions);
+    meshes.joint = createJoint(dimensions);
+    meshes.shadeCone = createShadeCone(dimensions);
+    meshes.shadeCap = createShadeCap(dimensions);
+    meshes.shadeGlow = createShadeGlow(dimensions);
+}
+
+// Replace one part if any dimension it is built from changed
+static int rebuildPart(LodMesh &mesh, bool changed, LodMesh (*create)(const LampDimensions &),
+                       const LampDimensions &dimensions)
+{
+    if (!changed)
+    {
+        return 0;
+    }
+    deleteLodMesh(mesh);
+    mesh = create(dimensions);
+    return 1;
+}
+
+int updateLampPartMeshes(LampMeshes &meshes, const LampDimensions &from, const LampDimensions &to)
+{
+    bool base = from.baseRadius != to.baseRadius;
+    bool arm = from.armRadius != to.armRadius;
+    bool shade = from.lampshadeRadius != to.lampshadeRadius;
+
+    int rebuilt = 0;
+    rebuilt += rebuildPart(meshes.baseSide, base || from.baseHeight != to.baseHeight, createBaseSide, to);
+    rebuilt += rebuildPart(meshes.baseCap, base, createBaseCap, to);
+    rebuilt += rebuildPart(meshes.lowerArm, arm || from.lowerArmLength != to.lowerArmLength, createLowerArm, to);
+    rebuilt += rebuildPart(meshes.upperArm, arm || from.upperArmLength != to.upperArmLength, createUpperArm, to);
+    rebuilt += rebuildPart(meshes.joint, arm, createJoint, to);
+    rebuilt += rebuildPart(meshes.shadeCone, shade || from.lampshadeHeight != to.lampshadeHeight, createShadeCone, to);
+    rebuilt += rebuildPart(meshes.shadeCap, shade, createShadeCap, to);
+    rebuilt += rebuildPart(meshes.shadeGlow, shade, createShadeGlow, to);
+    return rebuilt;
+}
@@ -0,0 +1,23 @@
+/*
+ * Lamp Part Geometry
+ *
+ * Vertex data of every lamp part at every detail level, computed by the
+ * compiler from the default dimensions in lamp.h (see tessellation.h).
+ * With those dimensions startup only copies the tables into buffer
+ * objects; other dimensions are tessellated when the meshes are built.
+ */
+
+#ifndef LAMPGEOMETRY_H
+#define LAMPGEOMETRY_H
+
+#include "lamp.h"
+#include "mesh.h"
+
+// Build every part's LOD chain for the given dimensions
+void createLampPartMeshes(LampMeshes &meshes, const LampDimensions &dimensions);
+
+// Rebuild only the parts whose dimensions differ between from and to;
+// returns the number of parts rebuilt
+int updateLampPartMeshes(LampMeshes &meshes, const LampDimensions &from, const LampDimensions &to);
+
+#endif // LAMPGEOMETRY_H
@@ -0,0 +1,145 @@
+/*
+ * Baked Table Lighting - implementation
+ */
+
+#include "lightmap.h"
+
+// Height of the bake camera above the table; only the table is drawn,
+// so any depth range around it works
+static const float BAKE_EYE_HEIGHT = 10.0f;
+
+static GLint bakePreviousFramebuffer = 0;
+
+/**
+ * Create a mipmapped color texture and a framebuffer rendering into it
+ * @param size - Resolution (square)
+ * @param extent - Edge length of the table area the texture covers
+ */
+bool createTableLightmap(TableLightmap &lightmap, int size, float extent)
+{
+    lightmap.framebuffer = 0;
+    lightmap.texture = 0;
+    lightmap.size = size;
+    lightmap.extent = extent;
+    lightmap.valid = false;
+
+    if (!isGLVersionAtLeast(3, 0))
+    {
+        return false;
+    }
+
+    glGenTextures(1, &lightmap.texture);
+    glBindTexture(GL_TEXTURE_2D, lightmap.texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    GLint previousFramebuffer = 0;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+    glGenFramebuffers(1, &lightmap.framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, lightmap.framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, lightmap.texture, 0);
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+
+    if (!complete)
+    {
+        deleteTableLightmap(lightmap);
+        return false;
+    }
+    return true;
+}
+
+void deleteTableLightmap(TableLightmap &lightmap)
+{
+    glDeleteFramebuffers(1, &lightmap.framebuffer);
+    glDeleteTextures(1, &lightmap.texture);
+    lightmap.framebuffer = 0;
+    lightmap.texture = 0;
+    lightmap.valid = false;
+}
+
+/**
+ * Point the framebuffer, viewport and matrices at the lightmap
+ * Projection times modelview is a top-down orthographic view with -Z up,
+ * so texture s grows with x and t against z, matching bindTableLightmap().
+ * The projection undoes the camera view, which leaves eye space, and so
+ * the lighting, the camera's.
+ * @param tableTop - Height of the table surface
+ * @param cameraView - World-to-eye matrix of the frame being drawn
+ */
+void beginLightmapBake(TableLightmap &lightmap, float tableTop, const Mat4 &cameraView)
+{
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &bakePreviousFramebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, lightmap.framebuffer);
+
+    glPushAttrib(GL_VIEWPORT_BIT | GL_ENABLE_BIT | GL_COLOR_BUFFER_BIT);
+    glViewport(0, 0, lightmap.size, lightmap.size);
+    glDisable(GL_DEPTH_TEST); // The table is a single flat layer
+    glDisable(GL_BLEND);
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    float half = 0.5f * lightmap.extent;
+    const float eye[3] = {0.0f, tableTop + BAKE_EYE_HEIGHT, 0.0f};
+    const float center[3] = {0.0f, tableTop, 0.0f};
+    const float up[3] = {0.0f, 0.0f, -1.0f};
+    Mat4 orthographic = mat4Orthographic(-half, half, -half, half, 0.5f * BAKE_EYE_HEIGHT, 2.0f * BAKE_EYE_HEIGHT);
+    Mat4 topDown = mat4Multiply(orthographic, mat4LookAt(eye, center, up));
+    Mat4 projection = mat4Multiply(topDown, mat4InverseRigid(cameraView));
+
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadMatrixf(projection.m);
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadMatrixf(cameraView.m);
+}
+
+void endLightmapBake(TableLightmap &lightmap)
+{
+    glPopMatrix();
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+    glPopAttrib();
+    glBindFramebuffer(GL_FRAMEBUFFER, bakePreviousFramebuffer);
+
+    glBindTexture(GL_TEXTURE_2D, lightmap.texture);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    lightmap.valid = true;
+}
+
+/**
+ * Fixed-function texturing with generated coordinates
+ * s = x / extent + 0.5 and t = 0.5 - z / extent, in object space
+ */
+void bindTableLightmap(const TableLightmap &lightmap)
+{
+    const GLfloat planeS[] = {1.0f / lightmap.extent, 0.0f, 0.0f, 0.5f};
+    const GLfloat planeT[] = {0.0f, 0.0f, -1.0f / lightmap.extent, 0.5f};
+    glTexGeni(GL_S, GL_TEXTURE_GEN_MODE, GL_OBJECT_LINEAR);
+    glTexGeni(GL_T, GL_TEXTURE_GEN_MODE, GL_OBJECT_LINEAR);
+    glTexGenfv(GL_S, GL_OBJECT_PLANE, planeS);
+    glTexGenfv(GL_T, GL_OBJECT_PLANE, planeT);
+    glEnable(GL_TEXTURE_GEN_S);
+    glEnable(GL_TEXTURE_GEN_T);
+
+    glBindTexture(GL_TEXTURE_2D, lightmap.texture);
+    glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+    glEnable(GL_TEXTURE_2D);
+}
+
+void unbindTableLightmap()
+{
+    glDisable(GL_TEXTURE_2D);
+    glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glDisable(GL_TEXTURE_GEN_S);
+    glDisable(GL_TEXTURE_GEN_T);
+}
@@ -0,0 +1,54 @@
+/*
+ * Baked Table Lighting
+ *
+ * Most of the time the lamp stands still, yet the table is lit again
+ * every frame: a dense grid of per-vertex lit cells, or the per-pixel
+ * shader with its shadow filter over the whole table. A lightmap keeps
+ * the lit table in a texture, rendered once through the normal lighting
+ * path; until something that lights the table changes, the table is one
+ * unlit textured quad.
+ *
+ * The table's highlights depend on the viewer, so the bake is lit in the
+ * camera's eye space, exactly as a live frame, and only rasterized from
+ * straight above: the projection maps the table's x and z onto the
+ * texture. A baked table therefore matches the live one for the camera
+ * it was baked with; a moved camera needs a new bake.
+ */
+
+#ifndef LIGHTMAP_H
+#define LIGHTMAP_H
+
+#include "opengl.h"
+#include "matrix.h"
+
+struct TableLightmap
+{
+    GLuint framebuffer;
+    GLuint texture; // RGBA8 with mipmaps
+    int size;       // Width and height in texels
+    float extent;   // Edge length of the square table area covered
+    bool valid;     // The texture holds a finished bake
+};
+
+// Create the texture and framebuffer (GL 3.0+); false if unsupported
+bool createTableLightmap(TableLightmap &lightmap, int size, float extent);
+void deleteTableLightmap(TableLightmap &lightmap);
+
+// Render into the lightmap: binds its framebuffer and loads cameraView
+// as the modelview matrix, with a projection that lays the table at
+// height tableTop out flat. Lights and shadow lookups set up for the
+// camera stay valid; draw the lit table (centered on the origin) before
+// ending the bake.
+void beginLightmapBake(TableLightmap &lightmap, float tableTop, const Mat4 &cameraView);
+
+// Restore the previous framebuffer and matrices, build the mipmaps and
+// mark the lightmap valid
+void endLightmapBake(TableLightmap &lightmap);
+
+// Texture the following unlit draws with the lightmap; texture
+// coordinates come from the object-space x and z of a table centered on
+// the origin
+void bindTableLightmap(const TableLightmap &lightmap);
+void unbindTableLightmap();
+
+#endif // LIGHTMAP_H
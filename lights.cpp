@@ -0,0 +1,404 @@
+/*
+ * Clustered Spotlights - implementation
+ *
+ * Each light's cone is first bounded by a sphere to find the slices and
+ * tiles it may overlap; every candidate cluster is then tested against
+ * the cone itself (cone vs. the cluster's bounding sphere), and the
+ * surviving (cluster, light) pairs are grouped per cluster with a
+ * counting sort.
+ */
+
+#include "lights.h"
+
+#include <cmath>
+#include <cstring>
+
+static const int LIGHT_TEXELS = 3; // Texels per light in the data texture
+
+/**
+ * Allocate a float texture sampled with nearest filtering
+ */
+static GLuint createFloatTexture(GLenum internalFormat, GLenum format, int width, int height)
+{
+    GLuint texture = 0;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    return texture;
+}
+
+static void bindOnUnit(GLenum unit, GLuint texture)
+{
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+bool createLightClusters(LightClusters &clusters)
+{
+    clusters.dataTexture = 0;
+    clusters.gridTexture = 0;
+    clusters.indexTexture = 0;
+    clusters.indexRows = 1;
+    clusters.projection = mat4Identity();
+    clusters.zNear = 0.0f;
+    clusters.zFar = 0.0f;
+    clusters.clusterSpheres.clear();
+    clusters.lightCount = 0;
+    clusters.assignments = 0;
+    clusters.dropped = 0;
+    clusters.busiest = 0;
+
+    // Float and RG textures are core in GL 3.0
+    if (!isGLVersionAtLeast(3, 0))
+    {
+        return false;
+    }
+
+    clusters.dataTexture = createFloatTexture(GL_RGBA32F, GL_RGBA, LIGHT_TEXELS, MAX_SPOT_LIGHTS);
+    clusters.gridTexture = createFloatTexture(GL_RG32F, GL_RG, CLUSTER_TILES_X * CLUSTER_TILES_Y, CLUSTER_SLICES);
+    clusters.indexTexture = createFloatTexture(GL_R32F, GL_RED, LIGHT_INDEX_WIDTH, clusters.indexRows);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    clusters.lightData.assign(LIGHT_TEXELS * 4 * MAX_SPOT_LIGHTS, 0.0f);
+    clusters.gridData.assign(2 * CLUSTER_COUNT, 0.0f);
+
+    // Stay bound on their own units; only the GLSL programs sample them
+    bindOnUnit(LIGHT_DATA_TEXTURE_UNIT, clusters.dataTexture);
+    bindOnUnit(LIGHT_GRID_TEXTURE_UNIT, clusters.gridTexture);
+    bindOnUnit(LIGHT_INDEX_TEXTURE_UNIT, clusters.indexTexture);
+    return glGetError() == GL_NO_ERROR;
+}
+
+void deleteLightClusters(LightClusters &clusters)
+{
+    glDeleteTextures(1, &clusters.dataTexture);
+    glDeleteTextures(1, &clusters.gridTexture);
+    glDeleteTextures(1, &clusters.indexTexture);
+    clusters.dataTexture = 0;
+    clusters.gridTexture = 0;
+    clusters.indexTexture = 0;
+}
+
+// Distance to the near side of depth slice s (s = CLUSTER_SLICES: far end).
+// Slice 0 reaches from the eye to zNear; the others divide [zNear, zFar]
+// exponentially, so slices get thicker with distance like the tiles do.
+static float sliceDepth(const LightClusters &clusters, int slice)
+{
+    if (slice == 0)
+    {
+        return 0.0f;
+    }
+    return clusters.zNear * powf(clusters.zFar / clusters.zNear, (float)(slice - 1) / (CLUSTER_SLICES - 1));
+}
+
+static int sliceOfDepth(const LightClusters &clusters, float depth)
+{
+    if (depth < clusters.zNear)
+    {
+        return 0;
+    }
+    int slice = 1 + (int)floorf(logf(depth / clusters.zNear) / logf(clusters.zFar / clusters.zNear) *
+                                (CLUSTER_SLICES - 1));
+    return slice >= CLUSTER_SLICES ? CLUSTER_SLICES - 1 : slice;
+}
+
+static int clampTile(int tile, int count)
+{
+    return tile < 0 ? 0 : (tile >= count ? count - 1 : tile);
+}
+
+/**
+ * Bound every cluster of a symmetric perspective projection by a sphere
+ * A cluster spans a rectangle of normalized device x/y and a depth slice,
+ * so its corners are the rectangle scaled out to the slice's two depths.
+ */
+static void buildClusterSpheres(LightClusters &clusters)
+{
+    const float *p = clusters.projection.m;
+    clusters.clusterSpheres.resize(4 * CLUSTER_COUNT);
+    for (int slice = 0; slice < CLUSTER_SLICES; slice++)
+    {
+        float depths[2] = {sliceDepth(clusters, slice), sliceDepth(clusters, slice + 1)};
+        for (int ty = 0; ty < CLUSTER_TILES_Y; ty++)
+        {
+            for (int tx = 0; tx < CLUSTER_TILES_X; tx++)
+            {
+                float ndcX[2] = {-1.0f + 2.0f * tx / CLUSTER_TILES_X, -1.0f + 2.0f * (tx + 1) / CLUSTER_TILES_X};
+                float ndcY[2] = {-1.0f + 2.0f * ty / CLUSTER_TILES_Y, -1.0f + 2.0f * (ty + 1) / CLUSTER_TILES_Y};
+                float boxMin[3] = {INFINITY, INFINITY, INFINITY};
+                float boxMax[3] = {-INFINITY, -INFINITY, -INFINITY};
+                for (int corner = 0; corner < 8; corner++)
+                {
+                    float depth = depths[corner & 1];
+                    float point[3] = {ndcX[(corner >> 1) & 1] * depth / p[0], ndcY[corner >> 2] * depth / p[5], -depth};
+                    for (int axis = 0; axis < 3; axis++)
+                    {
+                        boxMin[axis] = fminf(boxMin[axis], point[axis]);
+                        boxMax[axis] = fmaxf(boxMax[axis], point[axis]);
+                    }
+                }
+
+                float *sphere = &clusters.clusterSpheres[4 * ((slice * CLUSTER_TILES_Y + ty) * CLUSTER_TILES_X + tx)];
+                float radiusSquared = 0.0f;
+                for (int axis = 0; axis < 3; axis++)
+                {
+                    sphere[axis] = 0.5f * (boxMin[axis] + boxMax[axis]);
+                    float half = 0.5f * (boxMax[axis] - boxMin[axis]);
+                    radiusSquared += half * half;
+                }
+                sphere[3] = sqrtf(radiusSquared);
+            }
+        }
+    }
+}
+
+/**
+ * Cone against sphere: false only if the sphere is certainly outside the
+ * range-limited cone (behind the apex, past the range, or off the side)
+ */
+static bool coneTouchesSphere(const float apex[3], const float axis[3], float cosAngle, float sinAngle,
+                              float range, const float *sphere)
+{
+    float v[3] = {sphere[0] - apex[0], sphere[1] - apex[1], sphere[2] - apex[2]};
+    float lengthSquared = v[0] * v[0] + v[1] * v[1] + v[2] * v[2];
+    float along = v[0] * axis[0] + v[1] * axis[1] + v[2] * axis[2];
+    float across = sqrtf(fmaxf(lengthSquared - along * along, 0.0f));
+    float radius = sphere[3];
+    if (along > range + radius || along < -radius)
+    {
+        return false;
+    }
+    return cosAngle * across - sinAngle * along <= radius;
+}
+
+/**
+ * Rebuild the cluster light lists and upload them
+ * @param cameraView - World-to-eye matrix of this frame
+ * @param projection - Camera projection (symmetric perspective)
+ * @param zNear, zFar - Depth range the slices divide up; nearer fragments
+ *                      share the first slice, and nothing lit may lie
+ *                      beyond zFar
+ */
+void updateLightClusters(LightClusters &clusters, const std::vector<SpotLight> &lights, const Mat4 &cameraView,
+                         const Mat4 &projection, float zNear, float zFar)
+{
+    if (clusters.dataTexture == 0)
+    {
+        return;
+    }
+    if (clusters.clusterSpheres.empty() || clusters.zNear != zNear || clusters.zFar != zFar ||
+        memcmp(clusters.projection.m, projection.m, sizeof(projection.m)) != 0)
+    {
+        clusters.projection = projection;
+        clusters.zNear = zNear;
+        clusters.zFar = zFar;
+        buildClusterSpheres(clusters);
+    }
+
+    const float *p = projection.m;
+    int count = (int)lights.size() < MAX_SPOT_LIGHTS ? (int)lights.size() : MAX_SPOT_LIGHTS;
+    clusters.pairClusters.clear();
+    clusters.pairLights.clear();
+
+    for (int i = 0; i < count; i++)
+    {
+        const SpotLight &light = lights[i];
+        float apex[3];
+        float axis[3];
+        mat4TransformPoint(cameraView, light.position, apex);
+        mat4TransformDirection(cameraView, light.direction, axis);
+
+        GLfloat *texels = &clusters.lightData[i * LIGHT_TEXELS * 4];
+        for (int c = 0; c < 3; c++)
+        {
+            texels[c] = apex[c];
+            texels[4 + c] = axis[c];
+            texels[8 + c] = light.color[c];
+        }
+        texels[3] = light.range;
+        texels[7] = light.cosCutoff;
+        texels[11] = light.exponent;
+
+        // Bounding sphere of the cone: around the base disk for wide
+        // cones, centered on the axis with apex and rim on it otherwise
+        float cosAngle = light.cosCutoff;
+        float sinAngle = sqrtf(fmaxf(1.0f - cosAngle * cosAngle, 0.0f));
+        float offset;
+        float radius;
+        if (cosAngle < 0.70710678f)
+        {
+            offset = cosAngle * light.range;
+            radius = sinAngle * light.range;
+        }
+        else
+        {
+            offset = 0.5f * light.range / cosAngle;
+            radius = offset;
+        }
+        float center[3] = {apex[0] + offset * axis[0], apex[1] + offset * axis[1], apex[2] + offset * axis[2]};
+
+        float nearest = fmaxf(-center[2] - radius, 0.0f);
+        float farthest = fminf(-center[2] + radius, zFar);
+        if (nearest > farthest)
+        {
+            continue; // Entirely behind the camera or past the last slice
+        }
+
+        int firstSlice = sliceOfDepth(clusters, nearest);
+        int lastSlice = sliceOfDepth(clusters, farthest);
+        for (int slice = firstSlice; slice <= lastSlice; slice++)
+        {
+            // Screen extent of the sphere within this slice's depth range;
+            // x / depth is monotonic in depth, so the ends bound it
+            float depthMin = fmaxf(nearest, fmaxf(sliceDepth(clusters, slice), 1e-3f));
+            float depthMax = fminf(farthest, sliceDepth(clusters, slice + 1));
+            float left = center[0] - radius;
+            float right = center[0] + radius;
+            float bottom = center[1] - radius;
+            float top = center[1] + radius;
+            float ndcLeft = p[0] * fminf(left / depthMin, left / depthMax);
+            float ndcRight = p[0] * fmaxf(right / depthMin, right / depthMax);
+            float ndcBottom = p[5] * fminf(bottom / depthMin, bottom / depthMax);
+            float ndcTop = p[5] * fmaxf(top / depthMin, top / depthMax);
+            if (ndcLeft > 1.0f || ndcRight < -1.0f || ndcBottom > 1.0f || ndcTop < -1.0f)
+            {
+                continue;
+            }
+
+            int tx0 = clampTile((int)floorf((ndcLeft + 1.0f) * 0.5f * CLUSTER_TILES_X), CLUSTER_TILES_X);
+            int tx1 = clampTile((int)floorf((ndcRight + 1.0f) * 0.5f * CLUSTER_TILES_X), CLUSTER_TILES_X);
+            int ty0 = clampTile((int)floorf((ndcBottom + 1.0f) * 0.5f * CLUSTER_TILES_Y), CLUSTER_TILES_Y);
+            int ty1 = clampTile((int)floorf((ndcTop + 1.0f) * 0.5f * CLUSTER_TILES_Y), CLUSTER_TILES_Y);
+            for (int ty = ty0; ty <= ty1; ty++)
+            {
+                for (int tx = tx0; tx <= tx1; tx++)
+                {
+                    int cluster = (slice * CLUSTER_TILES_Y + ty) * CLUSTER_TILES_X + tx;
+                    if (coneTouchesSphere(apex, axis, cosAngle, sinAngle, light.range,
+                                          &clusters.clusterSpheres[4 * cluster]))
+                    {
+                        clusters.pairClusters.push_back(cluster);
+                        clusters.pairLights.push_back(i);
+                    }
+                }
+            }
+        }
+    }
+
+    // Counting sort by cluster; lights stay in order within a cluster, and
+    // lists past MAX_CLUSTER_LIGHTS are cut
+    std::vector<int> &counts = clusters.clusterCounts;
+    std::vector<int> &next = clusters.clusterNext;
+    counts.assign(CLUSTER_COUNT, 0);
+    next.resize(CLUSTER_COUNT);
+    for (size_t k = 0; k < clusters.pairClusters.size(); k++)
+    {
+        counts[clusters.pairClusters[k]]++;
+    }
+    int total = 0;
+    clusters.busiest = 0;
+    clusters.dropped = 0;
+    for (int cluster = 0; cluster < CLUSTER_COUNT; cluster++)
+    {
+        int kept = counts[cluster] < MAX_CLUSTER_LIGHTS ? counts[cluster] : MAX_CLUSTER_LIGHTS;
+        clusters.dropped += counts[cluster] - kept;
+        clusters.busiest = counts[cluster] > clusters.busiest ? counts[cluster] : clusters.busiest;
+        clusters.gridData[2 * cluster] = (GLfloat)total;
+        clusters.gridData[2 * cluster + 1] = (GLfloat)kept;
+        next[cluster] = total;
+        counts[cluster] = total + kept; // End of this cluster's list from here on
+        total += kept;
+    }
+
+    int rows = total / LIGHT_INDEX_WIDTH + 1;
+    clusters.indexData.resize(rows * LIGHT_INDEX_WIDTH);
+    for (size_t k = 0; k < clusters.pairClusters.size(); k++)
+    {
+        int cluster = clusters.pairClusters[k];
+        if (next[cluster] < counts[cluster])
+        {
+            clusters.indexData[next[cluster]++] = (GLfloat)clusters.pairLights[k];
+        }
+    }
+
+    clusters.lightCount = count;
+    clusters.assignments = total;
+
+    // Upload; the index texture only ever grows (doubling its rows)
+    glBindTexture(GL_TEXTURE_2D, clusters.dataTexture);
+    if (count > 0)
+    {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, LIGHT_TEXELS, count, GL_RGBA, GL_FLOAT, &clusters.lightData[0]);
+    }
+    glBindTexture(GL_TEXTURE_2D, clusters.gridTexture);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, CLUSTER_TILES_X * CLUSTER_TILES_Y, CLUSTER_SLICES, GL_RG, GL_FLOAT,
+                    &clusters.gridData[0]);
+    glBindTexture(GL_TEXTURE_2D, clusters.indexTexture);
+    if (rows > clusters.indexRows)
+    {
+        while (clusters.indexRows < rows)
+        {
+            clusters.indexRows *= 2;
+        }
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, LIGHT_INDEX_WIDTH, clusters.indexRows, 0, GL_RED, GL_FLOAT, NULL);
+    }
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, LIGHT_INDEX_WIDTH, rows, GL_RED, GL_FLOAT, &clusters.indexData[0]);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+LightClusterUniforms getLightClusterUniforms(GLuint program)
+{
+    LightClusterUniforms uniforms;
+    uniforms.enabled = glGetUniformLocation(program, "clusteredLightsEnabled");
+    uniforms.tileSize = glGetUniformLocation(program, "clusterTileSize");
+    uniforms.sliceScale = glGetUniformLocation(program, "clusterSliceScale");
+    uniforms.sliceBias = glGetUniformLocation(program, "clusterSliceBias");
+    uniforms.indexRows = glGetUniformLocation(program, "lightIndexRows");
+
+    const char *samplers[3] = {"lightData", "lightGrid", "lightIndices"};
+    const GLenum units[3] = {LIGHT_DATA_TEXTURE_UNIT, LIGHT_GRID_TEXTURE_UNIT, LIGHT_INDEX_TEXTURE_UNIT};
+    glUseProgram(program);
+    for (int i = 0; i < 3; i++)
+    {
+        GLint sampler = glGetUniformLocation(program, samplers[i]);
+        if (sampler >= 0)
+        {
+            glUniform1i(sampler, units[i]);
+        }
+    }
+    glUseProgram(0);
+    return uniforms;
+}
+
+/**
+ * Hand the grid layout to a program
+ * The slice of eye depth z is floor(log(z) * scale + bias) + 1, which
+ * inverts sliceDepth().
+ * @param viewportWidth, viewportHeight - Pixels covered by the tiles
+ */
+void setLightClusterUniforms(GLuint program, const LightClusterUniforms &uniforms, const LightClusters &clusters,
+                             bool enabled, int viewportWidth, int viewportHeight)
+{
+    if (program == 0 || uniforms.enabled < 0)
+    {
+        return;
+    }
+
+    glUseProgram(program);
+    bool active = enabled && clusters.dataTexture != 0 && !clusters.clusterSpheres.empty();
+    glUniform1i(uniforms.enabled, active ? 1 : 0);
+    if (active)
+    {
+        float scale = (CLUSTER_SLICES - 1) / logf(clusters.zFar / clusters.zNear);
+        glUniform2f(uniforms.tileSize, (float)viewportWidth / CLUSTER_TILES_X, (float)viewportHeight / CLUSTER_TILES_Y);
+        glUniform1f(uniforms.sliceScale, scale);
+        glUniform1f(uniforms.sliceBias, -logf(clusters.zNear) * scale);
+        glUniform1f(uniforms.indexRows, (float)clusters.indexRows);
+    }
+    glUseProgram(0);
+}
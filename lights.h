@@ -0,0 +1,107 @@
+/*
+ * Clustered Spotlights
+ *
+ * Fixed-function lighting stops at eight lights, so every further
+ * spotlight (one per crowd lamp) is shaded by the GLSL programs from
+ * light data in textures instead. The view frustum is split into a grid
+ * of clusters - screen tiles times exponential depth slices - and each
+ * cluster gets the list of lights whose cones reach into it, so a
+ * fragment only evaluates the few lights that can touch it.
+ *
+ * Lists are rebuilt on the CPU whenever the lights or the camera move
+ * and uploaded as float textures, which GLSL 1.20 can read without any
+ * extension. Lights are stored in eye space, like the fixed-function
+ * light positions.
+ */
+
+#ifndef LIGHTS_H
+#define LIGHTS_H
+
+#include "opengl.h"
+#include "matrix.h"
+
+#include <vector>
+
+// Texture units the cluster textures stay bound to (after the shadow map)
+const GLenum LIGHT_DATA_TEXTURE_UNIT = 2;  // Light parameters
+const GLenum LIGHT_GRID_TEXTURE_UNIT = 3;  // (first entry, light count) per cluster
+const GLenum LIGHT_INDEX_TEXTURE_UNIT = 4; // Light lists of all clusters, back to back
+
+// Cluster grid: screen tiles across and up, and depth slices whose
+// thickness grows with distance
+const int CLUSTER_TILES_X = 32;
+const int CLUSTER_TILES_Y = 18;
+const int CLUSTER_SLICES = 32;
+const int CLUSTER_COUNT = CLUSTER_TILES_X * CLUSTER_TILES_Y * CLUSTER_SLICES;
+
+const int MAX_SPOT_LIGHTS = 1024;
+const int MAX_CLUSTER_LIGHTS = 64; // Lights kept per cluster (the shader's loop bound)
+const int LIGHT_INDEX_WIDTH = 1024; // Row length of the index texture
+
+struct SpotLight
+{
+    float position[3];  // World space
+    float direction[3]; // Unit cone axis, world space
+    float color[3];     // Diffuse and specular intensity
+    float cosCutoff;    // Cosine of the cone half-angle
+    float exponent;     // Falloff toward the cone edge, like GL_SPOT_EXPONENT
+    float range;        // Distance at which the light fades to zero
+};
+
+struct LightClusters
+{
+    GLuint dataTexture;  // RGBA32F, 3 texels per light (position + range, direction + cutoff, color + exponent)
+    GLuint gridTexture;  // RG32F, one texel per cluster
+    GLuint indexTexture; // R32F, LIGHT_INDEX_WIDTH light indices per row
+    int indexRows;       // Rows allocated in indexTexture
+
+    // Eye-space bounding sphere of every cluster, for this projection
+    Mat4 projection;
+    float zNear;
+    float zFar;
+    std::vector<float> clusterSpheres; // center xyz + radius per cluster
+
+    // Scratch arrays reused by every update
+    std::vector<GLfloat> lightData;
+    std::vector<GLfloat> gridData;
+    std::vector<GLfloat> indexData;
+    std::vector<int> pairClusters; // (cluster, light) pairs found by the cone tests
+    std::vector<int> pairLights;
+    std::vector<int> clusterCounts;
+    std::vector<int> clusterNext;
+
+    // Results of the last update
+    int lightCount;
+    int assignments; // Light list entries over all clusters
+    int dropped;     // Entries lost to the MAX_CLUSTER_LIGHTS limit
+    int busiest;     // Longest list
+};
+
+// Create the textures (GL 3.0 float textures); false if unsupported
+bool createLightClusters(LightClusters &clusters);
+void deleteLightClusters(LightClusters &clusters);
+
+// Assign the lights (at most MAX_SPOT_LIGHTS) to clusters of the given
+// camera and upload everything. Slice 0 covers depths up to zNear; the
+// other slices split [zNear, zFar].
+void updateLightClusters(LightClusters &clusters, const std::vector<SpotLight> &lights, const Mat4 &cameraView,
+                         const Mat4 &projection, float zNear, float zFar);
+
+// Uniform locations of the cluster inputs in one program
+struct LightClusterUniforms
+{
+    GLint enabled;
+    GLint tileSize;
+    GLint sliceScale;
+    GLint sliceBias;
+    GLint indexRows;
+};
+
+// Query a program's cluster uniforms and point its samplers at the units
+LightClusterUniforms getLightClusterUniforms(GLuint program);
+
+// Upload the current grid parameters to a program (binds it temporarily)
+void setLightClusterUniforms(GLuint program, const LightClusterUniforms &uniforms, const LightClusters &clusters,
+                             bool enabled, int viewportWidth, int viewportHeight);
+
+#endif // LIGHTS_H
@@ -9,15 +9,64 @@
  *
  * Controls:
  * - 1-4: Select joint (Base, Lower Arm, Upper Arm, Lampshade)
+ * - Left click: Select the joint of the part under the cursor
  * - Arrow keys: Rotate selected joint
+ * - Left mouse drag: Orbit the camera
+ * - Right mouse drag / wheel: Zoom
  * - F: Toggle spotlight on/off
+ * - L: Toggle per-pixel (GLSL) / per-vertex lighting
+ * - P: Play/pause keyframe animation
+ * - N: Next animation clip
+ * - I: Toggle linear/cubic interpolation
+ * - M: Toggle the instanced crowd of lamps
+ * - K: Toggle look-at mode (arrow keys move the target, lamps aim at it)
+ * - H: Toggle spotlight shadows (per-pixel lighting)
+ * - B: Toggle the baked table lightmap for a still lamp
+ * - T: Toggle frame-time statistics overlay
+ * - D: Toggle level-of-detail debug overlay
  * - R: Reset to default position
  * - ESC: Exit
  */
 
-#include <GL/glut.h>
+#include "opengl.h"
+#include "animation.h"
+#include "antialias.h"
+#include "bench.h"
+#include "capture.h"
+#include "clipfile.h"
+#include "corerenderer.h"
+#include "crowd.h"
+#include "frustum.h"
+#include "input.h"
+#include "jobs.h"
+#include "kinematics.h"
+#include "lamp.h"
+#include "lampgeometry.h"
+#include "lightmap.h"
+#include "lights.h"
+#include "material.h"
+#include "mesh.h"
+#include "physics.h"
+#include "picking.h"
+#include "scene.h"
+#include "scheduler.h"
+#include "shader.h"
+#include "shadow.h"
+#include "stats.h"
+#include "text.h"
+
+#include <GL/freeglut_ext.h> // glutInitContextVersion
+
+#include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
 
 const int WINDOW_WIDTH = 1024;
 const int WINDOW_HEIGHT = 768;
@@ -31,153 +80,479 @@ enum JointSelection
     LAMPSHADE = 3  // Lampshade joint (X and Y-axis)
 };
 
-// Structure to hold all lamp joint angles (in degrees)
-struct LampJoints
-{
-    float baseRotation;      // Rotation of entire lamp around Y-axis
-    float lowerArmAngle;     // Angle of lower arm from base
-    float upperArmAngle;     // Angle of upper arm from lower arm
-    float lampshadeAngle;    // Tilt angle of lampshade
-    float lampshadeRotation; // Rotation of lampshade around its own axis
-};
-
 // Initial lamp configuration
-LampJoints lampJoints = {0.0f, 30.0f, -60.0f, -90.0f, 0.0f};
+const LampJoints DEFAULT_LAMP_JOINTS = {0.0f, 30.0f, -60.0f, -90.0f, 0.0f};
+LampJoints lampJoints = DEFAULT_LAMP_JOINTS;
 JointSelection selectedJoint = BASE;
 bool spotlightEnabled = true;
+bool perPixelLighting = false; // Evaluate lighting per fragment with GLSL
+
+// Keyframe animation
+const int ANIMATION_TIMER_MS = 16; // Playback clock period (~60 Hz)
+const int MAX_CLIPS = 3;              // Built-in clips plus one from --clip
+AnimationClip animationClips[MAX_CLIPS];
+int clipCount = 0;
+int currentClip = 0;
+ClipFile showClip; // Mapped by --clip
+AnimationPlayer animationPlayer = {NULL, INTERPOLATE_CUBIC, 0.0f, 0.0f, false};
+int lastAnimationTick = 0; // GLUT_ELAPSED_TIME of the previous clock tick
+bool animationClockArmed = false; // An animationTimer() call is pending
+
+// Hop physics: the joints chase lampJoints and the base can leave the table
+bool physicsEnabled = false;
+LampBody lampBody;
+const float PHYSICS_FALL_RESET = -10.0f; // Put a lamp that fell off the table back at this height
+
+// Crowd of small instanced lamps around the main one
+const int CROWD_ROWS = 32;
+const int CROWD_COLUMNS = 32;
+const float CROWD_SPACING = 0.6f;      // Distance between neighbouring lamps
+const float CROWD_LAMP_SCALE = 0.2f;   // Size relative to the main lamp
+const float CROWD_CLEAR_RADIUS = 2.5f; // Keep the main lamp's footprint free
+Crowd crowd;
+bool crowdAvailable = false;
+bool crowdEnabled = false;
+
+// One spotlight per crowd lamp, shaded per pixel through light clusters
+LightClusters lightClusters;
+bool crowdLightsAvailable = false;
+bool crowdLightsEnabled = false;
+bool crowdLightsActive = false; // Shaded this frame (crowd shown, per-pixel lighting)
+const float LIGHT_SLICE_NEAR = 1.0f; // Depth covered by the first light cluster slice
+LightClusterUniforms perPixelLightUniforms;
+LightClusterUniforms crowdLightUniforms;
+
+// Look-at mode: inverse kinematics aims the spotlight at a table point
+const float LOOK_AT_STEP = 0.25f;       // Target movement per arrow keypress
+const float LOOK_AT_MIN_RADIUS = 2.0f;  // Keep the target clear of the base
+const float TABLE_TOP = -0.1f;          // Table surface height (see drawTable())
+bool lookAtEnabled = false;
+float lookAtTarget[3] = {0.0f, TABLE_TOP, -4.0f};
+LookAtResult lookAtResult = {0, 0.0f, true};
+double lookAtMicroseconds = 0.0;
+
+// Frame-time instrumentation
+bool statsOverlayEnabled = false; // Show per-frame timings in the overlay
+
+// Status text, batched into a single draw call
+TextOverlay hudText = {std::vector<TextLine>(), 0, true, 0, 0};
+
+// Headless benchmark (--bench): offscreen rendering without GLUT
+const int BENCH_WARMUP_FRAMES = 10; // Untimed frames for driver/shader warm-up
+bool headless = false;              // No GLUT window: skip GLUT-only drawing
+bool scriptedBench = false;          // Each frame's clip time is scripted (--bench, --render-out)
+float benchNextAnimationTime = 0.0f; // Clip time of the next scripted frame
+
+// Input replay (--replay): recorded events drive the scene instead of
+// the keyboard and the animation timer
+std::vector<InputEvent> replayEvents;
+size_t replayPosition = 0; // Next event to deliver
+bool replaying = false;
+
+// Lamp dimensions, materials, spotlight and table size: the built-in
+// defaults or a --scene file, which is watched and reloaded on change
+SceneDescription scene;
+const char *scenePath = NULL;
+SceneWatch sceneWatch = {-1, ""};
+const int SCENE_POLL_MS = 250;
 
 // Camera settings
 float cameraAngleX = 20.0f;
 float cameraAngleY = 30.0f;
 float cameraDistance = 15.0f;
+const float CAMERA_MIN_ELEVATION = 5.0f;  // Degrees above the table (cameraAngleY)
+const float CAMERA_MAX_ELEVATION = 85.0f; // Short of straight down, where the up vector breaks
+const float CAMERA_MIN_DISTANCE = 4.0f;
+const float CAMERA_MAX_DISTANCE = 60.0f;
+
+// Mouse camera control: motion events only add up the drag, which is
+// applied once per frame (see flushMouseDrag())
+const float ORBIT_DEGREES_PER_PIXEL = 0.3f;
+const float ZOOM_PER_PIXEL = 1.005f;  // Distance factor per pixel of zoom drag
+const int WHEEL_ZOOM_PIXELS = 40;     // One wheel notch zooms like this much drag
+int dragButton = -1;                  // GLUT button held for the drag, -1 if none
+int lastMouseX = 0;
+int lastMouseY = 0;
+int pendingOrbitX = 0; // Drag not yet applied (pixels)
+int pendingOrbitY = 0;
+int pendingZoom = 0;
+bool dragMoved = false; // The held button moved since it went down (not a click)
+// Click selection: a left click without drag queues a pick pass for the
+// next frame, whose result is polled without blocking (see picking.h)
+PickBuffer pickBuffer;
+bool pickingAvailable = false;
+bool pickPassActive = false; // Lamp draws go to the pick pass
+bool pickRequested = false;  // Draw a pick pass with the next frame
+int pickX = 0;               // Window pixel to pick, origin bottom left
+int pickY = 0;
+bool pickPollArmed = false;  // A pickPollTimer() call is pending
+const int PICK_POLL_MS = 2;
+
+// Anti-aliasing: the scene is drawn into offscreen targets and resolved
+// onto the single-sampled window or benchmark target (see antialias.h)
+const int DEFAULT_MSAA_SAMPLES = 4;
+const double DEFAULT_VSYNC_BUDGET_MS = 16.7; // One 60 Hz refresh
+AntialiasTarget antialiasTarget;
+AdaptiveQuality adaptiveQuality;
+bool antialiasAvailable = false;
+unsigned long taaChangeCount = 0; // sceneChangeCount() after the previous frame
+int taaStillFrames = 0;           // Frames since anything but TAA asked for one
+
+const float CAMERA_FOVY = 45.0f; // Vertical field of view (degrees)
+const float CAMERA_NEAR = 0.1f;
+const float CAMERA_FAR = 100.0f;
+Mat4 cameraProjection = mat4Identity(); // Set by reshape()
+int viewportWidth = WINDOW_WIDTH;
+int viewportHeight = WINDOW_HEIGHT;
+Frustum cameraFrustum;                  // World-space view volume, updated every frame
+
+// Table tessellation (the edge length is scene.tableSize)
+const int TABLE_DIVISIONS = 40;  // Grid cells per edge (more = smoother spotlight)
+const int TABLE_TILES = 4;       // Tiles per edge, culled separately (divides TABLE_DIVISIONS)
+
+// Tessellated lamp primitives, built once in init() and reused every frame
+LampMeshes lampMeshes;
+LodView lodView; // Camera state for LOD selection, updated every frame
+Mesh tableMesh;     // One tile as a dense grid, for per-vertex lighting
+Mesh tableQuadMesh; // One tile as two triangles, enough when lighting is per-pixel
+Mesh tableLightmapMesh; // The whole table as two triangles, drawn from the lightmap
+Mesh lookAtMarkerMesh;  // Small sphere at the look-at target
+
+// Per-pixel lighting program (0 if GLSL is unavailable)
+GLuint perPixelProgram = 0;
+GLint spotlightEnabledLocation = -1;
+GLint materialIndexLocation = -1; // -1 if the program uses gl_FrontMaterial
+GLint highlightEmissionLocation = -1;
+
+// Core-profile renderer (--core-profile): a GL 3.3 core context, drawn
+// without any fixed-function state (see corerenderer.h)
+bool coreProfile = false;
+CoreRenderer coreRenderer;
+const float SCENE_AMBIENT[4] = {0.2f, 0.2f, 0.2f, 1.0f}; // GL_LIGHT_MODEL_AMBIENT
+
+// Spotlight shadow map, sampled by the GLSL lighting programs only
+const int DEFAULT_SHADOW_SIZE = 1024;
+const int DEFAULT_PCF_RADIUS = 1;
+ShadowMap shadowMap;
+bool shadowsAvailable = false;
+bool shadowsEnabled = false;
+unsigned int shadowCasterRevision = 0; // Bumped whenever caster geometry changes
+ShadowUniforms perPixelShadowUniforms;
+ShadowUniforms crowdShadowUniforms;
+LampPose shadowCasterPose; // Pose drawn by drawShadowCasters()
+
+// Baked table lighting for a still lamp (see lightmap.h)
+const int LIGHTMAP_SIZE = 1024;
+const int LIGHTMAP_SETTLE_MS = 250; // Lighting held this long gets baked
+struct TableLighting                // Everything the table's lighting depends on
+{
+    LampJoints joints;           // Drawn joints
+    float base[3];               // Base translation (hop physics)
+    Mat4 view;                   // Camera: highlights depend on the viewer
+    bool spotlight;
+    bool perPixel;
+    bool shadows;
+    bool crowd;                  // Crowd lamps cast shadows on the table
+    unsigned int casterRevision; // shadowCasterRevision
+};
+TableLightmap tableLightmap;
+bool lightmapAvailable = false;
+bool lightmapEnabled = false;
+bool lightmapActive = false;        // The table was drawn from the bake this frame
+bool lightmapSettling = false;      // settlingLighting holds a candidate
+bool lightmapSettlePending = false; // A lightmapSettleTimer() call is pending
+TableLighting bakedLighting;        // What the lightmap holds
+TableLighting settlingLighting;     // Latest lighting, baked once it holds still
+std::chrono::steady_clock::time_point settlingSince;
+double lightmapBakeMicroseconds = 0.0; // CPU time of the last bake
+
+// Main lamp primitives, for the LOD debug overlay
+enum LampPart
+{
+    PART_BASE_SIDE = 0,
+    PART_BASE_CAP,
+    PART_LOWER_ARM,
+    PART_UPPER_ARM,
+    PART_LOWER_JOINT,
+    PART_UPPER_JOINT,
+    PART_SHADE_JOINT,
+    PART_SHADE_CONE,
+    PART_SHADE_CAP,
+    PART_SHADE_GLOW,
+    LAMP_PART_COUNT
+};
+const char *LAMP_PART_NAMES[LAMP_PART_COUNT] = {"Base", "Base cap", "Lower arm", "Upper arm", "Joint 1",
+                                                "Joint 2", "Joint 3", "Shade", "Shade cap", "Glow"};
+int lampPartLods[LAMP_PART_COUNT] = {0}; // Level each part was last drawn with
+bool lodOverlayEnabled = false;
 
-// Lamp physical dimensions
-const float BASE_RADIUS = 1.0f;
-const float BASE_HEIGHT = 0.3f;
-const float ARM_RADIUS = 0.15f;
-const float LOWER_ARM_LENGTH = 3.0f;
-const float UPPER_ARM_LENGTH = 2.5f;
-const float LAMPSHADE_RADIUS = 0.8f;
-const float LAMPSHADE_HEIGHT = 1.2f;
-
-void init();
+bool init(int shadowSize, int pcfRadius, int msaaSamples);
+void initFixedFunctionFeatures(int shadowSize, int pcfRadius);
 void display();
 void reshape(int width, int height);
 void keyboard(unsigned char key, int x, int y);
+void selectJoint(JointSelection joint);
 void specialKeys(int key, int x, int y);
-void drawBase();
-void drawArm(float length);
-void drawJoint();
-void drawLampshade();
-void drawTable();
-void setupLighting();
+void mouse(int button, int state, int x, int y);
+void mouseMotion(int x, int y);
+void flushMouseDrag();
+void requestPick(int x, int y);
+void drawPickPass(const LampPose &pose, bool lampVisible, const Mat4 &cameraView);
+void pickPollTimer(int value);
+void applyPick(unsigned int id);
+void cycleAntialiasMode();
+void toggleAdaptiveQuality();
+void settleTemporalAntialiasing();
+void orbitCamera(float azimuthDegrees, float elevationDegrees);
+void zoomCamera(float factor);
+void drawPartMesh(const LodMesh &mesh, const Mat4 &model, LampPart part);
+void drawBase(const Mat4 &partMatrix);
+void drawArm(const LodMesh &mesh, LampPart part, const Mat4 &partMatrix);
+void drawJoint(LampPart part, const Mat4 &partMatrix);
+void drawLampshade(const Mat4 &partMatrix);
+void drawTable(bool cull);
+void drawBakedTable();
+bool partSelected(JointSelection joint);
+void beginLampPart(JointSelection joint);
+void drawLamp(const LampPose &pose);
+void drawLookAtTarget();
+void moveLookAtTarget(float dx, float dz);
+void describeLights(const LampPose &pose, SceneLight lights[SCENE_LIGHT_COUNT]);
+void setupLighting(const LampPose &pose, const Mat4 &projection, const Mat4 &cameraView);
+void setFixedFunctionLight(GLenum light, const SceneLight &parameters);
 void setupMaterials();
-void drawCylinder(float radius, float height, int slices);
-void drawSphere(float radius, int slices, int stacks);
+void createLampMeshes();
+void createTableMeshes();
+void reloadScene();
+void sceneWatchTimer(int value);
+void setLightingEnabled(bool enabled);
+void setUnlitColor(float r, float g, float b, float a);
+void drawModelMesh(const Mesh &mesh, const Mat4 &model);
+void drawOverlay();
+void drawShadowCasters();
+void updateShadows(const LampPose &pose, const Mat4 &cameraView);
+void updateCrowdLights(const Mat4 &cameraView);
+bool shadowsActive();
+bool updateTableLightmap(const LampJoints &joints, const Mat4 &cameraView);
+void bakeTableLightmap(const Mat4 &cameraView);
+void lightmapSettleTimer(int value);
+CrowdUpdate currentCrowdUpdate();
+bool predictNextCrowdUpdate(const CrowdUpdate &current, CrowdUpdate &next);
+void benchmarkPose(int frame, int frameCount, LampJoints &joints);
+int runBenchmark(int frameCount, int width, int height);
+int runReplayBenchmark(int width, int height);
+void printHeadlessSetup(const std::string &workload, int width, int height);
+int renderClipFrames(const char *pattern, int width, int height, float fps);
+void handleInputEvent(const InputEvent &event);
+void handleKey(unsigned char key);
+void handleSpecialKey(int key);
+void replayTimer(int value);
+void animationTimer(int value);
+void advanceAnimation(float elapsedSeconds);
+void advancePhysics(float elapsedSeconds);
+bool animationClockNeeded();
+void startAnimationClock();
+void togglePhysics();
+void toggleAnimation();
+void stopAnimation();
 
 /**
  * Initialize OpenGL settings and display control instructions
+ * The core-profile renderer only sets up the table and the main lamp;
+ * the crowd, shadows, crowd spotlights, lightmap and text rely on
+ * fixed-function state or GLSL 1.20 built-ins and stay unavailable.
+ * @param shadowSize - Shadow map resolution
+ * @param pcfRadius - Shadow filter kernel radius
+ * @param msaaSamples - MSAA samples at full quality
+ * @return false if the core-profile renderer cannot be built
  */
-void init()
+bool init(int shadowSize, int pcfRadius, int msaaSamples)
 {
     glClearColor(0.0f, 0.0f, 0.0f, 1.0f); // Black background
     glEnable(GL_DEPTH_TEST);              // Enable depth testing for 3D
-    glEnable(GL_LIGHTING);                // Enable lighting calculations
-    glEnable(GL_LIGHT0);                  // Ambient light source
-    glEnable(GL_LIGHT1);                  // Spotlight from lamp
-    glEnable(GL_COLOR_MATERIAL);          // Allow materials to be set by glColor
-    glColorMaterial(GL_FRONT, GL_AMBIENT_AND_DIFFUSE);
-    glEnable(GL_NORMALIZE);  // Normalize normals after transformations
-    glShadeModel(GL_SMOOTH); // Smooth shading for better appearance
-    glEnable(GL_BLEND);      // Enable transparency
+    glEnable(GL_BLEND);                   // Enable transparency
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    if (!coreProfile)
+    {
+        glEnable(GL_LIGHTING); // Enable lighting calculations
+        glEnable(GL_LIGHT0);   // Ambient light source
+        glEnable(GL_LIGHT1);   // Spotlight from lamp
+        glLightModelfv(GL_LIGHT_MODEL_AMBIENT, SCENE_AMBIENT);
+        // No GL_COLOR_MATERIAL: lit colors come from the material table only,
+        // so unlit glColor draws (highlights, glow, text) cannot leak into them
+        glEnable(GL_NORMALIZE);  // Normalize normals after transformations
+        glShadeModel(GL_SMOOTH); // Smooth shading for better appearance
+    }
+
+    createLampMeshes();
+    initFrameStats();
+    if (!headless && !coreProfile)
+    {
+        // GLUT fonts need a GLUT window and glBitmap; headless runs draw no text
+        createFontAtlas(GLUT_BITMAP_HELVETICA_18);
+    }
+
+    animationClips[clipCount++] = createHopClip();
+    animationClips[clipCount++] = createLookAroundClip();
+
+    createMaterials();
+    if (coreProfile)
+    {
+        if (!createCoreRenderer(coreRenderer))
+        {
+            std::cerr << "Core-profile renderer unavailable" << std::endl;
+            return false;
+        }
+    }
+    else
+    {
+        initFixedFunctionFeatures(shadowSize, pcfRadius);
+    }
+    antialiasAvailable = createAntialiasTarget(antialiasTarget, coreProfile, msaaSamples);
+
+    if (headless)
+    {
+        return true;
+    }
+    pickingAvailable = createPickBuffer(pickBuffer, coreProfile);
 
     // Print control instructions to console
     std::cout << "Pixar Luxo Lamp Animation" << std::endl;
     std::cout << "=========================" << std::endl;
     std::cout << "Controls:" << std::endl;
     std::cout << "  1-4: Select joint (Base, Lower Arm, Upper Arm, Lampshade)" << std::endl;
+    std::cout << "  Left click: Select the joint of the part under the cursor" << std::endl;
     std::cout << "  Arrow Keys: Rotate selected joint" << std::endl;
+    std::cout << "  Left drag: Orbit camera, right drag / wheel: Zoom" << std::endl;
     std::cout << "  F: Toggle spotlight" << std::endl;
+    std::cout << "  L: Toggle per-pixel lighting" << std::endl;
+    std::cout << "  P: Play/pause animation" << std::endl;
+    std::cout << "  N: Next animation clip" << std::endl;
+    std::cout << "  I: Toggle linear/cubic interpolation" << std::endl;
+    std::cout << "  M: Toggle lamp crowd" << std::endl;
+    std::cout << "  K: Toggle look-at mode (arrow keys move the target)" << std::endl;
+    std::cout << "  J: Toggle hop physics (the base leaves the table)" << std::endl;
+    std::cout << "  H: Toggle shadows (per-pixel lighting)" << std::endl;
+    std::cout << "  G: Toggle crowd spotlights (per-pixel lighting)" << std::endl;
+    std::cout << "  B: Toggle baked table lightmap" << std::endl;
+    std::cout << "  T: Toggle frame statistics" << std::endl;
+    std::cout << "  D: Toggle LOD debug overlay" << std::endl;
+    std::cout << "  A: Cycle anti-aliasing (off, MSAA, TAA)" << std::endl;
+    std::cout << "  Q: Toggle adaptive quality (holds the frame rate)" << std::endl;
     std::cout << "  R: Reset to default position" << std::endl;
     std::cout << "  ESC: Exit" << std::endl;
+    if (coreProfile)
+    {
+        std::cout << "Core-profile renderer on " << glGetString(GL_VERSION) << " (crowd, shadows, crowd spotlights, "
+                  << "lightmap and text need the fixed-function renderer)" << std::endl;
+    }
+    return true;
+}
+
+/**
+ * Set up the crowd, per-pixel lighting, shadows, crowd spotlights and the
+ * table lightmap, each only if the context supports it
+ * @param shadowSize - Shadow map resolution
+ * @param pcfRadius - Shadow filter kernel radius
+ */
+void initFixedFunctionFeatures(int shadowSize, int pcfRadius)
+{
+    crowdAvailable = createCrowd(crowd, CROWD_ROWS, CROWD_COLUMNS, CROWD_SPACING, CROWD_LAMP_SCALE, CROWD_CLEAR_RADIUS);
+
+    perPixelProgram = createPerPixelLightingProgram(hasMaterialBuffer());
+    if (perPixelProgram != 0)
+    {
+        spotlightEnabledLocation = glGetUniformLocation(perPixelProgram, "spotlightEnabled");
+        if (bindMaterialBlock(perPixelProgram))
+        {
+            materialIndexLocation = glGetUniformLocation(perPixelProgram, "materialIndex");
+        }
+        highlightEmissionLocation = glGetUniformLocation(perPixelProgram, "highlightEmission");
+        perPixelShadowUniforms = getShadowUniforms(perPixelProgram);
+    }
+
+    shadowsAvailable = perPixelProgram != 0 && createShadowMap(shadowMap, shadowSize, pcfRadius);
+    if (crowdAvailable)
+    {
+        crowdShadowUniforms = getShadowUniforms(crowd.program);
+    }
+
+    crowdLightsAvailable = perPixelProgram != 0 && crowdAvailable && createLightClusters(lightClusters);
+    if (crowdLightsAvailable)
+    {
+        perPixelLightUniforms = getLightClusterUniforms(perPixelProgram);
+        crowdLightUniforms = getLightClusterUniforms(crowd.program);
+    }
+
+    lightmapAvailable = createTableLightmap(tableLightmap, LIGHTMAP_SIZE, scene.tableSize);
 }
 
 /**
- * Configure two light sources:
- * - GL_LIGHT0: Weak ambient light to create dark scene
- * - GL_LIGHT1: Bright spotlight emanating from lampshade
+ * Describe the two light sources in world space:
+ * - Light 0: Weak ambient light to create dark scene
+ * - Light 1: Bright spotlight emanating from lampshade
+ * Fields left at their glLight*() defaults are spelled out so the
+ * core-profile renderer lights the scene the same.
+ * @param pose - Lamp pose for this frame (spotlight position/direction)
  */
-void setupLighting()
+void describeLights(const LampPose &pose, SceneLight lights[SCENE_LIGHT_COUNT])
 {
     // --------------------------------------------------------------------
-    // GL_LIGHT0: Low ambient light to enhance spotlight effect
+    // Light 0: Low ambient light to enhance spotlight effect
     // --------------------------------------------------------------------
-    GLfloat ambientLight[] = {0.05f, 0.05f, 0.05f, 1.0f};
-    GLfloat lightPos0[] = {5.0f, 10.0f, 5.0f, 0.0f}; // Directional light
-    GLfloat diffuseLight[] = {0.1f, 0.1f, 0.1f, 1.0f};
-    glLightfv(GL_LIGHT0, GL_AMBIENT, ambientLight);
-    glLightfv(GL_LIGHT0, GL_DIFFUSE, diffuseLight);
-    glLightfv(GL_LIGHT0, GL_POSITION, lightPos0);
+    SceneLight fill = {
+        {0.05f, 0.05f, 0.05f, 1.0f}, // Ambient
+        {0.1f, 0.1f, 0.1f, 1.0f},    // Diffuse
+        {1.0f, 1.0f, 1.0f, 1.0f},    // Specular (GL_LIGHT0 default)
+        {5.0f, 10.0f, 5.0f, 0.0f},   // Directional light
+        {0.0f, 0.0f, -1.0f},         // No cone
+        0.0f,
+        180.0f,
+        {1.0f, 0.0f, 0.0f}};
+    lights[0] = fill;
 
     // --------------------------------------------------------------------
-    // GL_LIGHT1: Dynamic spotlight from lampshade
+    // Light 1: Dynamic spotlight from lampshade
+    // Position and direction come from the shared forward kinematics, so
+    // the light always matches the lampshade drawn in drawLamp(); color,
+    // cone and attenuation come from the scene
     // --------------------------------------------------------------------
+    const SpotlightSettings &settings = scene.spotlight;
+    SceneLight spot = {
+        {0.0f, 0.0f, 0.0f, 1.0f}, // No ambient
+        {settings.diffuse[0], settings.diffuse[1], settings.diffuse[2], settings.diffuse[3]},
+        {settings.specular[0], settings.specular[1], settings.specular[2], settings.specular[3]},
+        {pose.spotPosition[0], pose.spotPosition[1], pose.spotPosition[2], 1.0f},
+        {pose.spotDirection[0], pose.spotDirection[1], pose.spotDirection[2]},
+        settings.exponent,
+        settings.cutoff,
+        {settings.attenuation[0], settings.attenuation[1], settings.attenuation[2]}};
+    lights[1] = spot;
+}
+
+/**
+ * Configure the light sources of describeLights() for this frame
+ * The fixed-function lights are set with the camera view loaded, which
+ * moves them into eye space; the core renderer takes the view along.
+ * @param pose - Lamp pose for this frame
+ * @param projection - Eye-to-clip matrix the frame is drawn with
+ * @param cameraView - World-to-eye matrix of this frame
+ */
+void setupLighting(const LampPose &pose, const Mat4 &projection, const Mat4 &cameraView)
+{
+    SceneLight lights[SCENE_LIGHT_COUNT];
+    describeLights(pose, lights);
+    if (coreProfile)
+    {
+        beginCoreFrame(coreRenderer, projection, cameraView, SCENE_AMBIENT, lights, spotlightEnabled);
+        return;
+    }
+
+    setFixedFunctionLight(GL_LIGHT0, lights[0]);
     if (spotlightEnabled)
     {
         glEnable(GL_LIGHT1);
-
-        // Save current matrix and start fresh
-        glPushMatrix();
-        glLoadIdentity();
-
-        // Apply the same transformation hierarchy as the lamp geometry
-        // This ensures the light position and direction match the lampshade
-        glRotatef(lampJoints.baseRotation, 0.0f, 1.0f, 0.0f);
-        glTranslatef(0.0f, BASE_HEIGHT, 0.0f);
-        glRotatef(lampJoints.lowerArmAngle, 1.0f, 0.0f, 0.0f);
-        glTranslatef(0.0f, LOWER_ARM_LENGTH, 0.0f);
-        glRotatef(lampJoints.upperArmAngle, 1.0f, 0.0f, 0.0f);
-        glTranslatef(0.0f, UPPER_ARM_LENGTH, 0.0f);
-        glRotatef(lampJoints.lampshadeAngle, 1.0f, 0.0f, 0.0f);
-        glRotatef(lampJoints.lampshadeRotation, 0.0f, 1.0f, 0.0f);
-        glTranslatef(0.0f, ARM_RADIUS * 1.5f, 0.0f); // Move past joint sphere
-
-        // Align coordinate system with lampshade geometry
-        // The lampshade is drawn with -90° rotation, so we match that here
-        glRotatef(-90.0f, 1.0f, 0.0f, 0.0f);
-
-        // Position light source inside lampshade at 60% depth
-        // This creates the effect of light emanating from within
-        glTranslatef(0.0f, 0.0f, LAMPSHADE_HEIGHT * 0.6f);
-
-        // Extract the final world-space position and direction from the matrix
-        GLfloat modelview[16];
-        glGetFloatv(GL_MODELVIEW_MATRIX, modelview);
-
-        // Position is the translation component (4th column)
-        GLfloat spotPosition[] = {modelview[12], modelview[13], modelview[14], 1.0f};
-
-        // Direction is the transformed Z-axis (3rd column)
-        // After our transformations, +Z points in the direction the lampshade opens
-        GLfloat spotDirection[] = {modelview[8], modelview[9], modelview[10]};
-
-        glPopMatrix(); // Restore previous matrix
-
-        // Spotlight properties: Warm, bright yellow-white light
-        GLfloat spotDiffuse[] = {3.0f, 2.5f, 1.5f, 1.0f};  // Warm yellow-white
-        GLfloat spotSpecular[] = {2.0f, 2.0f, 2.0f, 1.0f}; // White highlights
-
-        // Apply all spotlight properties
-        glLightfv(GL_LIGHT1, GL_POSITION, spotPosition);
-        glLightfv(GL_LIGHT1, GL_DIFFUSE, spotDiffuse);
-        glLightfv(GL_LIGHT1, GL_SPECULAR, spotSpecular);
-        glLightfv(GL_LIGHT1, GL_SPOT_DIRECTION, spotDirection);
-        glLightf(GL_LIGHT1, GL_SPOT_CUTOFF, 60.0f);   // 60° cone angle
-        glLightf(GL_LIGHT1, GL_SPOT_EXPONENT, 15.0f); // Moderate falloff
-        glLightf(GL_LIGHT1, GL_CONSTANT_ATTENUATION, 0.5f);
-        glLightf(GL_LIGHT1, GL_LINEAR_ATTENUATION, 0.02f);
-        glLightf(GL_LIGHT1, GL_QUADRATIC_ATTENUATION, 0.005f);
+        setFixedFunctionLight(GL_LIGHT1, lights[1]);
     }
     else
     {
@@ -186,279 +561,424 @@ void setupLighting()
 }
 
 /**
- * Draw a cylinder using GLU quadrics
- * @param radius - Cylinder radius
- * @param height - Cylinder height
- * @param slices - Number of subdivisions around the Z-axis
+ * Load one light's parameters into a fixed-function light
+ * @param light - GL_LIGHT0, GL_LIGHT1, ...
+ * @param parameters - World-space parameters (the view must be loaded)
  */
-void drawCylinder(float radius, float height, int slices)
+void setFixedFunctionLight(GLenum light, const SceneLight &parameters)
 {
-    GLUquadric *quad = gluNewQuadric();
-    gluQuadricNormals(quad, GLU_SMOOTH); // Generate smooth normals
-    gluCylinder(quad, radius, radius, height, slices, 1);
-    gluDeleteQuadric(quad);
+    glLightfv(light, GL_AMBIENT, parameters.ambient);
+    glLightfv(light, GL_DIFFUSE, parameters.diffuse);
+    glLightfv(light, GL_SPECULAR, parameters.specular);
+    glLightfv(light, GL_POSITION, parameters.position);
+    glLightfv(light, GL_SPOT_DIRECTION, parameters.spotDirection);
+    glLightf(light, GL_SPOT_EXPONENT, parameters.spotExponent);
+    glLightf(light, GL_SPOT_CUTOFF, parameters.spotCutoff);
+    glLightf(light, GL_CONSTANT_ATTENUATION, parameters.attenuation[0]);
+    glLightf(light, GL_LINEAR_ATTENUATION, parameters.attenuation[1]);
+    glLightf(light, GL_QUADRATIC_ATTENUATION, parameters.attenuation[2]);
 }
 
 /**
- * Draw a sphere using GLU quadrics
- * @param radius - Sphere radius
- * @param slices - Number of subdivisions around the Z-axis
- * @param stacks - Number of subdivisions along the Z-axis
+ * Upload every lamp primitive into buffer objects
+ * With the default dimensions the lamp parts are tessellated at compile
+ * time (lampgeometry.cpp); only the table grids are built here. The draw
+ * functions below just bind and draw the cached meshes.
  */
-void drawSphere(float radius, int slices, int stacks)
+void createLampMeshes()
 {
-    GLUquadric *quad = gluNewQuadric();
-    gluQuadricNormals(quad, GLU_SMOOTH); // Generate smooth normals
-    gluSphere(quad, radius, slices, stacks);
-    gluDeleteQuadric(quad);
+    // Full detail; coarser levels for distant parts
+    createLampPartMeshes(lampMeshes, lampDimensions);
+    createTableMeshes();
+    lookAtMarkerMesh = createSphereMesh(0.2f, 8, 8);
 }
 
 /**
- * Draw the circular base of the lamp
- * Material: Dark metallic gray with high specular for metal appearance
+ * Build the table grids for scene.tableSize
+ */
+void createTableMeshes()
+{
+    tableMesh = createGridMesh(scene.tableSize / TABLE_TILES, TABLE_DIVISIONS / TABLE_TILES);
+    tableQuadMesh = createGridMesh(scene.tableSize / TABLE_TILES, 1);
+    tableLightmapMesh = createGridMesh(scene.tableSize, 1);
+}
+
+/**
+ * Enable or disable lighting for the following draws
+ * The per-pixel shader ignores GL_LIGHTING, so in that mode the program
+ * is bound and unbound here as well to keep unlit elements unlit. The
+ * core-profile program stays bound and switches with a uniform.
+ * The pick pass keeps its own program bound throughout.
+ * @param enabled - true for lit geometry, false for glow/wireframe/text
  */
-void drawBase()
+void setLightingEnabled(bool enabled)
 {
-    // Set material properties for dark metal
-    GLfloat baseMaterial[] = {0.2f, 0.2f, 0.22f, 1.0f};
-    GLfloat baseSpecular[] = {0.9f, 0.9f, 0.95f, 1.0f}; // High shine
-    GLfloat baseShininess[] = {80.0f};
+    if (pickPassActive)
+    {
+        return;
+    }
+    if (coreProfile)
+    {
+        setCoreLighting(coreRenderer, enabled);
+        return;
+    }
+    if (enabled)
+    {
+        glEnable(GL_LIGHTING);
+        if (perPixelLighting)
+        {
+            glUseProgram(perPixelProgram);
+            glUniform1i(spotlightEnabledLocation, spotlightEnabled ? 1 : 0);
+            setMaterialIndexUniform(materialIndexLocation);
+            setHighlightUniform(highlightEmissionLocation);
+        }
+    }
+    else
+    {
+        glDisable(GL_LIGHTING);
+        glUseProgram(0);
+        setMaterialIndexUniform(-1);
+        setHighlightUniform(-1);
+    }
+}
 
-    glMaterialfv(GL_FRONT, GL_AMBIENT_AND_DIFFUSE, baseMaterial);
-    glMaterialfv(GL_FRONT, GL_SPECULAR, baseSpecular);
-    glMaterialfv(GL_FRONT, GL_SHININESS, baseShininess);
+/**
+ * Color of the following unlit draws
+ */
+void setUnlitColor(float r, float g, float b, float a)
+{
+    if (pickPassActive)
+    {
+        return;
+    }
+    if (coreProfile)
+    {
+        const float color[4] = {r, g, b, a};
+        setCoreColor(coreRenderer, color);
+    }
+    else
+    {
+        glColor4f(r, g, b, a);
+    }
+}
 
+/**
+ * Draw a mesh placed in the world by a model matrix
+ * The fixed-function renderer multiplies it onto the loaded view; the
+ * core-profile one and the pick pass compose the modelview matrix on the
+ * CPU.
+ * @param mesh - Mesh to draw
+ * @param model - Mesh-to-world matrix
+ */
+void drawModelMesh(const Mesh &mesh, const Mat4 &model)
+{
+    if (pickPassActive)
+    {
+        drawPickMesh(pickBuffer, mesh, model);
+        return;
+    }
+    if (coreProfile)
+    {
+        drawCoreMesh(coreRenderer, mesh, model);
+        return;
+    }
     glPushMatrix();
+    glMultMatrixf(model.m);
+    drawMesh(mesh);
+    glPopMatrix();
+}
+
+/**
+ * Draw one lamp primitive at the detail level its screen size calls for
+ * @param mesh - LOD chain of the primitive
+ * @param model - Mesh-to-world matrix (multiplied onto the current view)
+ * @param part - Slot in lampPartLods for the debug overlay
+ */
+void drawPartMesh(const LodMesh &mesh, const Mat4 &model, LampPart part)
+{
+    int level = selectLod(mesh, model, lodView);
+    lampPartLods[part] = level;
+    drawModelMesh(mesh.levels[level], model);
+}
+
+/**
+ * Draw the circular base of the lamp
+ * Material: Dark metallic gray with high specular for metal appearance
+ * @param partMatrix - World matrix of the base (LampPose::base)
+ */
+void drawBase(const Mat4 &partMatrix)
+{
+    bindMaterial(MATERIAL_BASE);
+
     // Rotate -90° so cylinder points upward (Y-axis)
-    glRotatef(-90.0f, 1.0f, 0.0f, 0.0f);
-    drawCylinder(BASE_RADIUS, BASE_HEIGHT, 32);
+    Mat4 model = partMatrix;
+    mat4Rotate(model, -90.0f, 1.0f, 0.0f, 0.0f);
+    drawPartMesh(lampMeshes.baseSide, model, PART_BASE_SIDE);
 
     // Draw top cap to close the cylinder
-    GLUquadric *quad = gluNewQuadric();
-    gluQuadricNormals(quad, GLU_SMOOTH);
-    glTranslatef(0.0f, 0.0f, BASE_HEIGHT);
-    gluDisk(quad, 0.0f, BASE_RADIUS, 32, 1);
-    gluDeleteQuadric(quad);
-    glPopMatrix();
+    mat4Translate(model, 0.0f, 0.0f, lampDimensions.baseHeight);
+    drawPartMesh(lampMeshes.baseCap, model, PART_BASE_CAP);
 }
 
 /**
  * Draw an arm segment (cylinder)
  * Material: Dark metallic with blue-gray tint
- * @param length - Length of the arm segment
+ * @param mesh - Cached cylinder for this segment's length
+ * @param part - Which arm, for the LOD overlay
+ * @param partMatrix - World matrix of the segment
  */
-void drawArm(float length)
+void drawArm(const LodMesh &mesh, LampPart part, const Mat4 &partMatrix)
 {
-    // Set material properties for metallic arm
-    GLfloat armMaterial[] = {0.25f, 0.25f, 0.28f, 1.0f};
-    GLfloat armSpecular[] = {0.95f, 0.95f, 1.0f, 1.0f}; // Very shiny
-    GLfloat armShininess[] = {100.0f};
-
-    glMaterialfv(GL_FRONT, GL_AMBIENT_AND_DIFFUSE, armMaterial);
-    glMaterialfv(GL_FRONT, GL_SPECULAR, armSpecular);
-    glMaterialfv(GL_FRONT, GL_SHININESS, armShininess);
+    bindMaterial(MATERIAL_ARM);
 
-    glPushMatrix();
     // Rotate so cylinder extends along Y-axis
-    glRotatef(-90.0f, 1.0f, 0.0f, 0.0f);
-    drawCylinder(ARM_RADIUS, length, 16);
-    glPopMatrix();
+    Mat4 model = partMatrix;
+    mat4Rotate(model, -90.0f, 1.0f, 0.0f, 0.0f);
+    drawPartMesh(mesh, model, part);
 }
 
 /**
  * Draw a joint sphere that connects arm segments
  * Material: Polished dark metal with chrome-like finish
+ * @param part - Which joint, for the LOD overlay
+ * @param partMatrix - World matrix of the joint
  */
-void drawJoint()
+void drawJoint(LampPart part, const Mat4 &partMatrix)
 {
-    // Set material properties for chrome-like joint
-    GLfloat jointMaterial[] = {0.22f, 0.22f, 0.25f, 1.0f};
-    GLfloat jointSpecular[] = {1.0f, 1.0f, 1.0f, 1.0f}; // Maximum shine
-    GLfloat jointShininess[] = {120.0f};                // Very sharp highlights
-
-    glMaterialfv(GL_FRONT, GL_AMBIENT_AND_DIFFUSE, jointMaterial);
-    glMaterialfv(GL_FRONT, GL_SPECULAR, jointSpecular);
-    glMaterialfv(GL_FRONT, GL_SHININESS, jointShininess);
+    bindMaterial(MATERIAL_JOINT);
 
     // Joint sphere is slightly larger than arm radius
-    drawSphere(ARM_RADIUS * 1.5f, 16, 16);
+    drawPartMesh(lampMeshes.joint, partMatrix, part);
 }
 
 /**
  * Draw the lampshade (cone shape)
  * Material: Dark gray with slight blue tint
  * Shape: Narrow at top (joint), wide at bottom (opening)
+ * @param partMatrix - World matrix of the lampshade
  */
-void drawLampshade()
+void drawLampshade(const Mat4 &partMatrix)
 {
-    // Set material properties for lampshade
-    GLfloat shadeMaterial[] = {0.3f, 0.3f, 0.35f, 1.0f};
-    GLfloat shadeSpecular[] = {0.8f, 0.8f, 0.85f, 1.0f};
-    GLfloat shadeShininess[] = {90.0f};
-
-    glMaterialfv(GL_FRONT, GL_AMBIENT_AND_DIFFUSE, shadeMaterial);
-    glMaterialfv(GL_FRONT, GL_SPECULAR, shadeSpecular);
-    glMaterialfv(GL_FRONT, GL_SHININESS, shadeShininess);
+    bindMaterial(MATERIAL_SHADE);
 
-    glPushMatrix();
-    // Move past the joint sphere
-    glTranslatef(0.0f, ARM_RADIUS * 1.5f, 0.0f);
-    // Rotate -90° so the cone points downward
-    glRotatef(-90.0f, 1.0f, 0.0f, 0.0f);
-
-    GLUquadric *quad = gluNewQuadric();
-    gluQuadricNormals(quad, GLU_SMOOTH);
+    // Move past the joint sphere, then rotate -90° so the cone points downward
+    Mat4 model = partMatrix;
+    mat4Translate(model, 0.0f, lampJointRadius(lampDimensions), 0.0f);
+    mat4Rotate(model, -90.0f, 1.0f, 0.0f, 0.0f);
 
     // Draw cone: narrow at top (0.4 * radius), wide at bottom (radius)
-    gluCylinder(quad, LAMPSHADE_RADIUS * 0.4f, LAMPSHADE_RADIUS, LAMPSHADE_HEIGHT, 32, 1);
-
-    gluDisk(quad, 0.0f, LAMPSHADE_RADIUS * 0.4f, 32, 1);
+    drawPartMesh(lampMeshes.shadeCone, model, PART_SHADE_CONE);
+    drawPartMesh(lampMeshes.shadeCap, model, PART_SHADE_CAP);
 
     // Draw inner glow at bottom opening when spotlight is on
     if (spotlightEnabled)
     {
-        glDisable(GL_LIGHTING);                     // Draw unlit for glowing effect
-        glColor4f(1.0f, 0.9f, 0.2f, 0.9f);          // Bright warm yellow
-        glTranslatef(0.0f, 0.0f, LAMPSHADE_HEIGHT); // Move to bottom opening
-        gluDisk(quad, 0.0f, LAMPSHADE_RADIUS * 0.5f, 32, 1);
-        glEnable(GL_LIGHTING);
+        setLightingEnabled(false);                                        // Draw unlit for glowing effect
+        setUnlitColor(1.0f, 0.9f, 0.2f, 0.9f);                            // Bright warm yellow
+        mat4Translate(model, 0.0f, 0.0f, lampDimensions.lampshadeHeight); // Move to bottom opening
+        drawPartMesh(lampMeshes.shadeGlow, model, PART_SHADE_GLOW);
+        setLightingEnabled(true);
     }
-
-    gluDeleteQuadric(quad);
-    glPopMatrix();
 }
 
 /**
  * Draw the table surface as a subdivided grid
  * Subdivision improves per-vertex lighting calculation, making the spotlight
- * appear as a smooth gradient instead of interpolated across 4 corners
+ * appear as a smooth gradient instead of interpolated across 4 corners.
+ * Resolution is set by TABLE_DIVISIONS; the grid is a single cached strip.
+ * Per-pixel lighting (either renderer) does not need the subdivision and
+ * uses a single quad.
+ * The table is split into TABLE_TILES x TABLE_TILES tiles that share one
+ * mesh; tiles outside the view frustum are skipped.
+ * @param cull - Skip tiles outside cameraFrustum (off for the lightmap bake)
  */
-void drawTable()
+void drawTable(bool cull)
 {
-    // Set material properties for matte table surface
-    GLfloat tableMaterial[] = {0.4f, 0.4f, 0.4f, 1.0f}; // Medium gray
-    GLfloat tableSpecular[] = {0.2f, 0.2f, 0.2f, 1.0f}; // Low specular
-    GLfloat tableShininess[] = {10.0f};                 // Dull surface
-
-    glMaterialfv(GL_FRONT, GL_AMBIENT_AND_DIFFUSE, tableMaterial);
-    glMaterialfv(GL_FRONT, GL_SPECULAR, tableSpecular);
-    glMaterialfv(GL_FRONT, GL_SHININESS, tableShininess);
-
-    glPushMatrix();
-    glTranslatef(0.0f, -0.1f, 0.0f); // Slightly below origin
-
-    // Grid parameters for table subdivision
-    float start = -10.0f;
-    float end = 10.0f;
-    float step = 0.5f; // Smaller step = finer grid = better lighting quality
+    bindMaterial(MATERIAL_TABLE);
 
-    glBegin(GL_QUADS);
-    glNormal3f(0.0f, 1.0f, 0.0f); // All vertices have upward normal
-
-    // Draw grid of small quads instead of one large quad
-    // This allows OpenGL to calculate lighting at more vertices
-    for (float x = start; x < end; x += step)
+    float tileSize = scene.tableSize / TABLE_TILES;
+    int culled = 0;
+    for (int row = 0; row < TABLE_TILES; row++)
     {
-        for (float z = start; z < end; z += step)
+        for (int column = 0; column < TABLE_TILES; column++)
         {
-            glVertex3f(x, 0.0f, z);
-            glVertex3f(x, 0.0f, z + step);
-            glVertex3f(x + step, 0.0f, z + step);
-            glVertex3f(x + step, 0.0f, z);
+            float boxMin[3] = {-0.5f * scene.tableSize + column * tileSize, TABLE_TOP,
+                               -0.5f * scene.tableSize + row * tileSize};
+            float boxMax[3] = {boxMin[0] + tileSize, TABLE_TOP, boxMin[2] + tileSize};
+            if (cull && !boxInFrustum(cameraFrustum, boxMin, boxMax))
+            {
+                culled++;
+                continue;
+            }
+
+            Mat4 model = mat4Identity();
+            mat4Translate(model, boxMin[0] + 0.5f * tileSize, TABLE_TOP, boxMin[2] + 0.5f * tileSize);
+
+            // Grid of small cells instead of one large quad, built once in init()
+            // This allows OpenGL to calculate lighting at more vertices
+            drawModelMesh(perPixelLighting || coreProfile ? tableQuadMesh : tableMesh, model);
         }
     }
-    glEnd();
-
-    glPopMatrix();
+    if (cull)
+    {
+        countCulling(CULL_TABLE_TILES, TABLE_TILES * TABLE_TILES, culled);
+    }
 }
 
 /**
- * Main display callback - renders the entire scene
- * Hierarchy: Table -> Lamp (Base -> LowerArm -> UpperArm -> Lampshade)
+ * Draw the table as one unlit quad textured with the lightmap
+ * The whole table counts as a single tile for the culling statistics.
  */
-void display()
+void drawBakedTable()
 {
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    glLoadIdentity();
-
-    // Position camera using spherical coordinates
-    gluLookAt(
-        cameraDistance * cos(cameraAngleY * M_PI / 180.0f) * sin(cameraAngleX * M_PI / 180.0f),
-        cameraDistance * sin(cameraAngleY * M_PI / 180.0f),
-        cameraDistance * cos(cameraAngleY * M_PI / 180.0f) * cos(cameraAngleX * M_PI / 180.0f),
-        0.0f, 3.0f, 0.0f, // Look at point slightly above origin
-        0.0f, 1.0f, 0.0f  // Up vector
-    );
-
-    setupLighting();
-    drawTable();
+    float boxMin[3] = {-0.5f * scene.tableSize, TABLE_TOP, -0.5f * scene.tableSize};
+    float boxMax[3] = {0.5f * scene.tableSize, TABLE_TOP, 0.5f * scene.tableSize};
+    bool visible = boxInFrustum(cameraFrustum, boxMin, boxMax);
+    countCulling(CULL_TABLE_TILES, 1, visible ? 0 : 1);
+    if (!visible)
+    {
+        return;
+    }
 
+    setLightingEnabled(false);
+    bindTableLightmap(tableLightmap);
     glPushMatrix();
+    glTranslatef(0.0f, TABLE_TOP, 0.0f);
+    drawMesh(tableLightmapMesh);
+    glPopMatrix();
+    unbindTableLightmap();
+    setLightingEnabled(true);
+}
 
-    // Level 1: Base rotation (Y-axis)
-    glRotatef(lampJoints.baseRotation, 0.0f, 1.0f, 0.0f);
+/**
+ * True if a lamp part is drawn with the selection tint
+ * Offline renders and benchmarks show the scene without it.
+ * @param joint - Joint that moves the part
+ */
+bool partSelected(JointSelection joint)
+{
+    return selectedJoint == joint && !headless;
+}
 
-    // Draw selection highlight for base
-    if (selectedJoint == BASE)
+/**
+ * Start drawing the parts a joint moves: tinted if the joint is
+ * selected, or in the pick pass, tagged with the joint's pick ID
+ * @param joint - Joint that moves the following parts
+ */
+void beginLampPart(JointSelection joint)
+{
+    if (pickPassActive)
     {
-        glDisable(GL_LIGHTING);
-        glColor3f(1.0f, 1.0f, 0.0f); // Yellow wireframe
-        glPushMatrix();
-        glTranslatef(0.0f, BASE_HEIGHT * 0.5f, 0.0f);
-        glutWireCube(BASE_RADIUS * 2.2f);
-        glPopMatrix();
-        glEnable(GL_LIGHTING);
+        setPickId(pickBuffer, pickId(0, joint));
     }
-
-    drawBase();
-    glTranslatef(0.0f, BASE_HEIGHT, 0.0f); // Move up to top of base
-
-    // Level 2: Lower arm joint
-    if (selectedJoint == LOWER_ARM)
+    else
     {
-        glDisable(GL_LIGHTING);
-        glColor3f(1.0f, 1.0f, 0.0f); // Yellow wireframe
-        glutWireSphere(ARM_RADIUS * 2.5f, 16, 16);
-        glEnable(GL_LIGHTING);
+        setHighlighted(partSelected(joint));
     }
+}
 
-    drawJoint();
-    glRotatef(lampJoints.lowerArmAngle, 1.0f, 0.0f, 0.0f); // Rotate lower arm
-    drawArm(LOWER_ARM_LENGTH);
-    glTranslatef(0.0f, LOWER_ARM_LENGTH, 0.0f); // Move to end of lower arm
-
-    // Level 3: Upper arm joint
-    if (selectedJoint == UPPER_ARM)
+/**
+ * Draw the articulated lamp from its precomputed pose
+ * Hierarchy: Base -> LowerArm -> UpperArm -> Lampshade
+ * Every part has its own world matrix, so parts are drawn grouped by
+ * material (base, arms, joints, shade) rather than in hierarchy order.
+ * The selected joint and the part it moves are tinted as they are drawn
+ * (setHighlighted()), in the same pass and with the same meshes; the
+ * pick pass draws the lamp through here as well.
+ * @param pose - World matrices of every part, from computeLampPose()
+ */
+void drawLamp(const LampPose &pose)
+{
+    // Level 1: Base
+    beginLampPart(BASE);
+    drawBase(pose.base);
+
+    // Levels 2 and 3: Arm segments
+    beginLampPart(LOWER_ARM);
+    drawArm(lampMeshes.lowerArm, PART_LOWER_ARM, pose.lowerArm);
+    beginLampPart(UPPER_ARM);
+    drawArm(lampMeshes.upperArm, PART_UPPER_ARM, pose.upperArm);
+
+    // Joints between the levels, each tinted with the part it turns
+    const Mat4 *jointMatrices[] = {&pose.lowerJoint, &pose.upperJoint, &pose.shadeJoint};
+    const JointSelection jointSelections[] = {LOWER_ARM, UPPER_ARM, LAMPSHADE};
+    const LampPart jointParts[] = {PART_LOWER_JOINT, PART_UPPER_JOINT, PART_SHADE_JOINT};
+    for (int i = 0; i < 3; i++)
     {
-        glDisable(GL_LIGHTING);
-        glColor3f(1.0f, 1.0f, 0.0f); // Yellow wireframe
-        glutWireSphere(ARM_RADIUS * 2.5f, 16, 16);
-        glEnable(GL_LIGHTING);
+        beginLampPart(jointSelections[i]);
+        drawJoint(jointParts[i], *jointMatrices[i]);
     }
 
-    drawJoint();
-    glRotatef(lampJoints.upperArmAngle, 1.0f, 0.0f, 0.0f); // Rotate upper arm
-    drawArm(UPPER_ARM_LENGTH);
-    glTranslatef(0.0f, UPPER_ARM_LENGTH, 0.0f); // Move to end of upper arm
+    // Level 4: Lampshade
+    beginLampPart(LAMPSHADE);
+    drawLampshade(pose.lampshade);
+    setHighlighted(false);
+}
+
+/**
+ * Draw an unlit yellow marker where the lamps are looking
+ */
+void drawLookAtTarget()
+{
+    setLightingEnabled(false);
+    setUnlitColor(1.0f, 1.0f, 0.0f, 1.0f);
+    Mat4 model = mat4Identity();
+    mat4Translate(model, lookAtTarget[0], lookAtTarget[1], lookAtTarget[2]);
+    drawModelMesh(lookAtMarkerMesh, model);
+    setLightingEnabled(true);
+}
 
-    // Level 4: Lampshade joint
-    if (selectedJoint == LAMPSHADE)
+/**
+ * Move the look-at target across the table
+ * The target stays on the table and out of the base's footprint, where
+ * no pose can aim at it.
+ * @param dx - Movement along X
+ * @param dz - Movement along Z
+ */
+void moveLookAtTarget(float dx, float dz)
+{
+    float halfTable = 0.5f * scene.tableSize;
+    float x = fmaxf(-halfTable, fminf(lookAtTarget[0] + dx, halfTable));
+    float z = fmaxf(-halfTable, fminf(lookAtTarget[2] + dz, halfTable));
+    float radius = sqrtf(x * x + z * z);
+    if (radius < LOOK_AT_MIN_RADIUS)
     {
-        glDisable(GL_LIGHTING);
-        glColor3f(1.0f, 1.0f, 0.0f); // Yellow wireframe
-        glutWireSphere(ARM_RADIUS * 2.5f, 16, 16);
-        glEnable(GL_LIGHTING);
+        // Push out radially (or keep the old spot when crossing the center)
+        if (radius < 1e-3f)
+        {
+            return;
+        }
+        x *= LOOK_AT_MIN_RADIUS / radius;
+        z *= LOOK_AT_MIN_RADIUS / radius;
     }
+    if (x != lookAtTarget[0] || z != lookAtTarget[2])
+    {
+        lookAtTarget[0] = x;
+        lookAtTarget[2] = z;
+        markSceneDirty();
+    }
+}
 
-    drawJoint();
-    glRotatef(lampJoints.lampshadeAngle, 1.0f, 0.0f, 0.0f);    // Tilt
-    glRotatef(lampJoints.lampshadeRotation, 0.0f, 1.0f, 0.0f); // Spin
-    drawLampshade();
-
-    glPopMatrix();
+/**
+ * Format a duration for the stats overlay ("n/a" if not measured)
+ */
+std::string formatMs(double ms)
+{
+    if (ms < 0.0)
+    {
+        return "n/a";
+    }
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.2f ms", ms);
+    return buffer;
+}
 
-    // Draw 2D UI text overlay
-    glDisable(GL_LIGHTING);
+/**
+ * Draw the 2D status text (and frame statistics when enabled)
+ */
+void drawOverlay()
+{
+    setLightingEnabled(false);
 
     // Switch to orthographic projection for 2D text
     glMatrixMode(GL_PROJECTION);
@@ -469,109 +989,1485 @@ void display()
     glPushMatrix();
     glLoadIdentity();
 
-    // Display selected joint name
     glColor3f(1.0f, 1.0f, 1.0f);
-    glRasterPos2f(10, WINDOW_HEIGHT - 20);
+    beginText(hudText);
+
+    // Display selected joint name
     const char *jointNames[] = {"Base", "Lower Arm", "Upper Arm", "Lampshade"};
-    std::string info = "Selected Joint: " + std::string(jointNames[selectedJoint]);
-    for (char c : info)
+    addText(hudText, 10, WINDOW_HEIGHT - 20, "Selected Joint: " + std::string(jointNames[selectedJoint]));
+
+    // Display spotlight status
+    addText(hudText, 10, WINDOW_HEIGHT - 45, spotlightEnabled ? "Spotlight: ON" : "Spotlight: OFF");
+
+    // Display lighting mode
+    addText(hudText, 10, WINDOW_HEIGHT - 70, perPixelLighting ? "Lighting: Per-pixel" : "Lighting: Per-vertex");
+
+    // Display animation status
+    addText(hudText, 10, WINDOW_HEIGHT - 95,
+            "Animation: " + std::string(animationClips[currentClip].name) +
+                (animationPlayer.interpolation == INTERPOLATE_CUBIC ? " (cubic)" : " (linear)") +
+                (animationPlayer.playing ? " - Playing" : " - Stopped"));
+
+    float y = WINDOW_HEIGHT - 120;
+
+    // Display anti-aliasing, as the adaptive controller has set it
+    if (antialiasTarget.mode != ANTIALIAS_OFF || adaptiveQuality.enabled)
     {
-        glutBitmapCharacter(GLUT_BITMAP_HELVETICA_18, c);
+        addText(hudText, 10, y,
+                "Anti-aliasing: " + describeAntialias(antialiasTarget) +
+                    (adaptiveQuality.enabled ? " (adaptive, " + formatMs(adaptiveQuality.smoothedMs) + ")" : ""));
+        y -= 25;
     }
 
-    // Display spotlight status
-    glRasterPos2f(10, WINDOW_HEIGHT - 45);
-    std::string lightInfo = spotlightEnabled ? "Spotlight: ON" : "Spotlight: OFF";
-    for (char c : lightInfo)
+    // Display shadow status (shadows only exist in the GLSL paths)
+    if (shadowsEnabled)
+    {
+        addText(hudText, 10, y,
+                "Shadows: " + std::to_string(shadowMap.size) + "px, PCF " + std::to_string(shadowMap.pcfRadius) +
+                    (perPixelLighting ? "" : " (per-pixel only)"));
+        y -= 25;
+    }
+
+    // Display whether the table comes from the lightmap
+    if (lightmapEnabled)
+    {
+        char buffer[128];
+        if (lightmapActive)
+        {
+            snprintf(buffer, sizeof(buffer), "Table lightmap: baked (%dpx, last bake %.0f us)", tableLightmap.size,
+                     lightmapBakeMicroseconds);
+        }
+        else
+        {
+            snprintf(buffer, sizeof(buffer), "Table lightmap: live (%s)",
+                     crowdLightsActive ? "crowd spotlights need live lighting" : "waiting for the lamp to settle");
+        }
+        addText(hudText, 10, y, buffer);
+        y -= 25;
+    }
+
+    // Display crowd size
+    if (crowdEnabled)
+    {
+        char buffer[128];
+        snprintf(buffer, sizeof(buffer), "Crowd: %zu lamps (instanced), update %.0f us on %d threads",
+                 crowd.lamps.size(), drawnCrowdFrame(crowd).updateMicroseconds, jobWorkerCount() + 1);
+        addText(hudText, 10, y, buffer);
+        y -= 25;
+        if (crowdLightsActive)
+        {
+            snprintf(buffer, sizeof(buffer), "Crowd spotlights: %d clustered, %d list entries (longest %d%s)",
+                     lightClusters.lightCount, lightClusters.assignments, lightClusters.busiest,
+                     lightClusters.dropped > 0 ? ", some cut" : "");
+            addText(hudText, 10, y, buffer);
+            y -= 25;
+        }
+    }
+
+    // Look-at target and the solver's work this frame
+    if (lookAtEnabled)
+    {
+        char buffer[128];
+        snprintf(buffer, sizeof(buffer), "Look-at: (%.2f, %.2f)  %d steps in %.1f us%s", lookAtTarget[0],
+                 lookAtTarget[2], lookAtResult.iterations, lookAtMicroseconds,
+                 lookAtResult.converged ? "" : " (out of reach)");
+        addText(hudText, 10, y, buffer);
+        y -= 25;
+        if (crowdEnabled)
+        {
+            const CrowdAimStats &aimStats = drawnCrowdFrame(crowd).aimStats;
+            snprintf(buffer, sizeof(buffer), "Crowd look-at: %d steps, %d out of reach", aimStats.iterations,
+                     aimStats.unreachable);
+            addText(hudText, 10, y, buffer);
+            y -= 25;
+        }
+    }
+
+    // Hop physics: how high the base is and how often it has landed
+    if (physicsEnabled)
+    {
+        char buffer[128];
+        snprintf(buffer, sizeof(buffer), "Physics: base at (%.2f, %.2f, %.2f), %s, %d landings (%.0f Hz)",
+                 lampBody.position[0], lampBody.position[1], lampBody.position[2],
+                 lampBody.grounded ? "on the table" : "airborne", lampBody.landings, 1.0f / PHYSICS_TIMESTEP);
+        addText(hudText, 10, y, buffer);
+        y -= 25;
+    }
+
+    // Frame statistics: the previous completed frame, since GPU timings
+    // arrive a few frames late
+    if (statsOverlayEnabled)
+    {
+        const FrameSample &sample = lastFrameSample();
+        addText(hudText, 10, y,
+                "Frame " + std::to_string(sample.frame) + "  CPU: " + formatMs(sample.cpuMs) + "  GPU: " +
+                    formatMs(sample.gpuMs) + "  Draws: " + std::to_string(sample.drawCalls));
+        y -= 25;
+        std::string culling = "  Culled:";
+        for (int i = 0; i < CULL_GROUP_COUNT; i++)
+        {
+            culling += std::string(i > 0 ? "," : "") + " " + std::to_string(sample.cullRejected[i]) + " of " +
+                       std::to_string(sample.cullTested[i]) + " " + cullGroupName((CullGroup)i);
+        }
+        addText(hudText, 10, y, culling);
+        y -= 25;
+        for (int i = 0; i < SECTION_COUNT; i++)
+        {
+            addText(hudText, 10, y,
+                    std::string("  ") + frameSectionName((FrameSection)i) + "  CPU: " +
+                        formatMs(sample.cpuSectionMs[i]) + "  GPU: " + formatMs(sample.gpuSectionMs[i]));
+            y -= 25;
+        }
+    }
+
+    // Detail level of every main lamp part (0 = full), and how many crowd
+    // instances are drawn at each level
+    if (lodOverlayEnabled)
     {
-        glutBitmapCharacter(GLUT_BITMAP_HELVETICA_18, c);
+        std::string line = "LOD";
+        for (int i = 0; i < LAMP_PART_COUNT; i++)
+        {
+            line += std::string("  ") + LAMP_PART_NAMES[i] + ": " + std::to_string(lampPartLods[i]);
+            if (i == LAMP_PART_COUNT / 2 - 1)
+            {
+                addText(hudText, 10, y, line);
+                y -= 25;
+                line = "   ";
+            }
+        }
+        addText(hudText, 10, y, line);
+        y -= 25;
+
+        if (crowdEnabled)
+        {
+            line = "Crowd instances per LOD:";
+            for (int level = 0; level < LOD_COUNT; level++)
+            {
+                int count = 0;
+                for (int part = 0; part < CROWD_PART_COUNT; part++)
+                {
+                    count += drawnCrowdFrame(crowd).lodCounts[part][level];
+                }
+                line += "  " + std::to_string(level) + ": " + std::to_string(count);
+            }
+            addText(hudText, 10, y, line);
+            y -= 25;
+        }
     }
 
+    // Whole HUD in one draw call
+    drawTextOverlay(hudText);
+
     // Restore previous projection
     glPopMatrix();
     glMatrixMode(GL_PROJECTION);
     glPopMatrix();
     glMatrixMode(GL_MODELVIEW);
-    glEnable(GL_LIGHTING);
-
-    glutSwapBuffers(); // Swap front and back buffers
+    setLightingEnabled(true);
 }
 
 /**
- * Reshape callback - called when window is resized
- * @param width - New window width
- * @param height - New window height
+ * Draw everything that casts a spotlight shadow into the depth pass
+ * The main lamp's shade is left out: the light sits inside it, so it
+ * would shadow the whole cone.
  */
-void reshape(int width, int height)
+void drawShadowCasters()
 {
-    if (height == 0)
-        height = 1; // Prevent division by zero
-    float aspect = (float)width / (float)height;
+    setLightingEnabled(false); // Plain fixed-function depth for the main lamp
 
-    glViewport(0, 0, width, height);
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    gluPerspective(45.0f, aspect, 0.1f, 100.0f); // 45° FOV
-    glMatrixMode(GL_MODELVIEW);
+    drawBase(shadowCasterPose.base);
+    drawArm(lampMeshes.lowerArm, PART_LOWER_ARM, shadowCasterPose.lowerArm);
+    drawArm(lampMeshes.upperArm, PART_UPPER_ARM, shadowCasterPose.upperArm);
+    drawJoint(PART_LOWER_JOINT, shadowCasterPose.lowerJoint);
+    drawJoint(PART_UPPER_JOINT, shadowCasterPose.upperJoint);
+
+    if (crowdEnabled)
+    {
+        // Light clusters belong to the camera view; depth needs no shading
+        setLightClusterUniforms(crowd.program, crowdLightUniforms, lightClusters, false, 0, 0);
+        drawCrowd(crowd, lampMeshes, spotlightEnabled, true); // Off-screen lamps still cast shadows
+        setLightClusterUniforms(crowd.program, crowdLightUniforms, lightClusters, crowdLightsActive,
+                                antialiasRenderWidth(antialiasTarget), antialiasRenderHeight(antialiasTarget));
+    }
 }
 
 /**
- * Keyboard callback - handles number keys and special commands
- * @param key - ASCII character code
- * @param x - Mouse X position (unused)
- * @param y - Mouse Y position (unused)
+ * Refresh the shadow map if needed and hand it to the GLSL programs
+ * The depth pass only runs when the spotlight or the casters moved;
+ * static views reuse the cached texture.
+ * @param pose - Lamp pose for this frame
+ * @param cameraView - World-to-eye matrix of this frame
  */
-void keyboard(unsigned char key, int x, int y)
+void updateShadows(const LampPose &pose, const Mat4 &cameraView)
 {
-    switch (key)
+    if (!shadowsAvailable)
     {
-    case '1':
-        selectedJoint = BASE;
-        std::cout << "Selected: Base" << std::endl;
-        break;
-    case '2':
-        selectedJoint = LOWER_ARM;
-        std::cout << "Selected: Lower Arm" << std::endl;
-        break;
-    case '3':
-        selectedJoint = UPPER_ARM;
-        std::cout << "Selected: Upper Arm" << std::endl;
+        return;
+    }
+
+    bool active = shadowsActive();
+    if (active)
+    {
+        // The caster list depends on whether the crowd is shown
+        unsigned int revision = shadowCasterRevision * 2 + (crowdEnabled ? 1 : 0);
+        shadowCasterPose = pose;
+        updateShadowMap(shadowMap, pose.spotPosition, pose.spotDirection, scene.spotlight.cutoff, revision,
+                        drawShadowCasters);
+    }
+
+    setShadowUniforms(perPixelProgram, perPixelShadowUniforms, shadowMap, active, cameraView);
+    if (crowdAvailable)
+    {
+        setShadowUniforms(crowd.program, crowdShadowUniforms, shadowMap, active, cameraView);
+    }
+}
+
+/**
+ * True if the spotlight shadow is drawn this frame
+ */
+bool shadowsActive()
+{
+    return shadowsEnabled && spotlightEnabled && perPixelLighting;
+}
+
+/**
+ * True if two table lighting states light the table the same
+ */
+bool tableLightingEqual(const TableLighting &a, const TableLighting &b)
+{
+    return lampJointsEqual(a.joints, b.joints) && a.base[0] == b.base[0] && a.base[1] == b.base[1] &&
+           a.base[2] == b.base[2] && std::equal(a.view.m, a.view.m + 16, b.view.m) && a.spotlight == b.spotlight &&
+           a.perPixel == b.perPixel && a.shadows == b.shadows && a.crowd == b.crowd &&
+           a.casterRevision == b.casterRevision;
+}
+
+/**
+ * Decide whether the table is drawn from the lightmap, baking it first
+ * once the table's lighting has held still for LIGHTMAP_SETTLE_MS
+ * While the lamp or the camera moves the table is lit live. A still
+ * scene is not redrawn by itself, so a settle timer asks for the frame
+ * that bakes.
+ * @param joints - Joint angles drawn this frame
+ * @param cameraView - World-to-eye matrix of this frame
+ * @return true if the lightmap holds this frame's table lighting
+ */
+bool updateTableLightmap(const LampJoints &joints, const Mat4 &cameraView)
+{
+    // Crowd spotlights are clustered in camera space: nothing to keep
+    if (!lightmapEnabled || crowdLightsActive)
+    {
+        return false;
+    }
+
+    TableLighting lighting;
+    lighting.joints = joints;
+    for (int i = 0; i < 3; i++)
+    {
+        lighting.base[i] = physicsEnabled ? lampBody.position[i] : 0.0f;
+    }
+    lighting.view = cameraView;
+    lighting.spotlight = spotlightEnabled;
+    lighting.perPixel = perPixelLighting;
+    lighting.shadows = shadowsActive();
+    lighting.crowd = crowdEnabled;
+    lighting.casterRevision = shadowCasterRevision;
+
+    if (tableLightmap.valid && tableLightingEqual(lighting, bakedLighting))
+    {
+        return true;
+    }
+
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (!lightmapSettling || !tableLightingEqual(lighting, settlingLighting))
+    {
+        settlingLighting = lighting;
+        settlingSince = now;
+        lightmapSettling = true;
+    }
+    int heldMs = (int)std::chrono::duration_cast<std::chrono::milliseconds>(now - settlingSince).count();
+    if (heldMs < LIGHTMAP_SETTLE_MS)
+    {
+        if (!headless && !lightmapSettlePending)
+        {
+            lightmapSettlePending = true;
+            glutTimerFunc(LIGHTMAP_SETTLE_MS - heldMs, lightmapSettleTimer, 0);
+        }
+        return false;
+    }
+
+    bakeTableLightmap(cameraView);
+    bakedLighting = lighting;
+    return true;
+}
+
+/**
+ * Render the lit table into the lightmap through the normal lighting path
+ * The lights and shadow lookups of this frame apply unchanged, since the
+ * bake keeps the camera's eye space.
+ * @param cameraView - World-to-eye matrix of this frame
+ */
+void bakeTableLightmap(const Mat4 &cameraView)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    beginLightmapBake(tableLightmap, TABLE_TOP, cameraView);
+    drawTable(false);
+    endLightmapBake(tableLightmap);
+    lightmapBakeMicroseconds =
+        std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * One-shot timer: redraw so updateTableLightmap() can see the lighting
+ * has held still
+ * @param value - Unused
+ */
+void lightmapSettleTimer(int value)
+{
+    (void)value;
+    lightmapSettlePending = false;
+    markSceneDirty();
+}
+
+/**
+ * Apply an edited scene file
+ * Only what changed is rebuilt: the lamp part meshes whose dimensions
+ * differ (once the crowd's prefetch is done with the old ones), the
+ * material slots that differ and, for a new size, the table grids. The
+ * spotlight is read from the scene every frame. A file that does not
+ * parse leaves the current scene in place.
+ */
+void reloadScene()
+{
+    SceneDescription loaded;
+    if (!loadSceneFile(scenePath, loaded))
+    {
+        std::cerr << "Keeping the current scene" << std::endl;
+        return;
+    }
+    unsigned int changes = sceneChanges(scene, loaded);
+    if (changes == 0)
+    {
+        return;
+    }
+
+    int meshesRebuilt = 0;
+    if (changes & SCENE_LAMP)
+    {
+        if (crowdAvailable)
+        {
+            resetCrowdFrames(crowd);
+        }
+        meshesRebuilt += updateLampPartMeshes(lampMeshes, lampDimensions, loaded.lamp);
+        lampDimensions = loaded.lamp;
+        shadowCasterRevision++;
+    }
+    int materialsChanged = 0;
+    for (int i = 0; i < MATERIAL_COUNT; i++)
+    {
+        materialsChanged += setMaterial((MaterialId)i, loaded.materials[i]) ? 1 : 0;
+    }
+    if ((changes & SCENE_SPOTLIGHT) && shadowsAvailable)
+    {
+        invalidateShadowMap(shadowMap); // The cone is the shadow frustum
+    }
+    bool tableResized = (changes & SCENE_TABLE) != 0;
+    scene = loaded;
+    if (tableResized)
+    {
+        deleteMesh(tableMesh);
+        deleteMesh(tableQuadMesh);
+        deleteMesh(tableLightmapMesh);
+        createTableMeshes();
+        tableLightmap.extent = scene.tableSize;
+        lampBody.tableHalfSize = 0.5f * scene.tableSize; // A hopping lamp falls off the new edge
+    }
+    tableLightmap.valid = false; // Every group lights the table
+
+    std::cout << "Scene reloaded: " << meshesRebuilt << " lamp meshes, " << materialsChanged << " materials"
+              << ((changes & SCENE_SPOTLIGHT) ? ", spotlight" : "") << (tableResized ? ", table" : "") << std::endl;
+    markSceneDirty();
+}
+
+/**
+ * Scene file timer - reloads the scene once the watched file was written
+ * Polls the non-blocking inotify descriptor, so the event loop keeps
+ * sleeping between polls and nothing is redrawn unless the file changed.
+ * @param value - Unused timer value
+ */
+void sceneWatchTimer(int value)
+{
+    (void)value;
+    if (sceneFileChanged(sceneWatch))
+    {
+        reloadScene();
+    }
+    glutTimerFunc(SCENE_POLL_MS, sceneWatchTimer, 0);
+}
+
+/**
+ * Rebuild the light clusters from the crowd's spotlights and hand them
+ * to both lighting programs
+ * The clusters only exist for per-pixel lighting; in per-vertex mode the
+ * crowd lamps stay dark, like the shadows.
+ * @param cameraView - World-to-eye matrix of this frame
+ */
+void updateCrowdLights(const Mat4 &cameraView)
+{
+    if (!crowdLightsAvailable)
+    {
+        return;
+    }
+
+    crowdLightsActive = crowdLightsEnabled && crowdEnabled && perPixelLighting;
+    if (crowdLightsActive)
+    {
+        updateLightClusters(lightClusters, drawnCrowdFrame(crowd).lights, cameraView, cameraProjection,
+                            LIGHT_SLICE_NEAR, CAMERA_FAR);
+    }
+    // Tiles are sized in the pixels of the target being drawn
+    int width = antialiasRenderWidth(antialiasTarget);
+    int height = antialiasRenderHeight(antialiasTarget);
+    setLightClusterUniforms(perPixelProgram, perPixelLightUniforms, lightClusters, crowdLightsActive, width, height);
+    setLightClusterUniforms(crowd.program, crowdLightUniforms, lightClusters, crowdLightsActive, width, height);
+}
+
+/**
+ * Crowd inputs of this frame: the animation clock or the look-at target,
+ * and the camera for LOD selection
+ */
+CrowdUpdate currentCrowdUpdate()
+{
+    CrowdUpdate inputs;
+    inputs.aim = lookAtEnabled;
+    inputs.clip = &animationClips[currentClip];
+    inputs.time = animationPlayer.time;
+    inputs.mode = animationPlayer.interpolation;
+    for (int i = 0; i < 3; i++)
+    {
+        inputs.target[i] = lookAtTarget[i];
+    }
+    inputs.view = lodView;
+    inputs.frustum = cameraFrustum;
+    return inputs;
+}
+
+/**
+ * Guess the next frame's crowd inputs so the update can run ahead
+ * Playback advances by one timer period with the camera held still;
+ * the look-at target is left alone, it only moves on keypresses. A wrong
+ * guess only wastes the background work: updateCrowd() then computes
+ * the real inputs as if nothing had been prefetched.
+ * @return false if the next frame is not expected to change the crowd
+ */
+bool predictNextCrowdUpdate(const CrowdUpdate &current, CrowdUpdate &next)
+{
+    if (current.aim)
+    {
+        return false;
+    }
+    next = current;
+    if (scriptedBench)
+    {
+        next.time = benchNextAnimationTime;
+        return true;
+    }
+    if (!animationPlayer.playing)
+    {
+        return false;
+    }
+    AnimationPlayer player = animationPlayer;
+    advancePlayback(player, ANIMATION_TIMER_MS / 1000.0f);
+    next.time = player.time;
+    return true;
+}
+
+/**
+ * Main display callback - renders the entire scene
+ * Hierarchy: Table -> Lamp (Base -> LowerArm -> UpperArm -> Lampshade)
+ */
+void display()
+{
+    beginFrameStats();
+    beginSection(SECTION_LIGHTING);
+
+    // However many motion events came in, the camera moves once per frame
+    flushMouseDrag();
+
+    // Clears the window, or the offscreen target with anti-aliasing on
+    beginAntialiasFrame(antialiasTarget);
+
+    // Position camera using spherical coordinates; the view matrix is
+    // kept for the shadow lookup, which starts from eye space
+    const float eye[3] = {
+        cameraDistance * cosf(cameraAngleY * (float)M_PI / 180.0f) * sinf(cameraAngleX * (float)M_PI / 180.0f),
+        cameraDistance * sinf(cameraAngleY * (float)M_PI / 180.0f),
+        cameraDistance * cosf(cameraAngleY * (float)M_PI / 180.0f) * cosf(cameraAngleX * (float)M_PI / 180.0f)};
+    const float center[3] = {0.0f, 3.0f, 0.0f}; // Look at point slightly above origin
+    const float up[3] = {0.0f, 1.0f, 0.0f};
+    Mat4 cameraView = mat4LookAt(eye, center, up);
+    if (!coreProfile)
+    {
+        glLoadMatrixf(cameraView.m);
+    }
+    lodView.eye[0] = eye[0];
+    lodView.eye[1] = eye[1];
+    lodView.eye[2] = eye[2];
+    cameraFrustum = extractFrustum(mat4Multiply(cameraProjection, cameraView));
+
+    // TAA jitters what is drawn; culling and picking keep the camera's projection
+    Mat4 drawProjection = antialiasProjection(antialiasTarget, cameraProjection);
+    if (!coreProfile)
+    {
+        glMatrixMode(GL_PROJECTION);
+        glLoadMatrixf(drawProjection.m);
+        glMatrixMode(GL_MODELVIEW);
+    }
+
+    // Look-at mode: solve the joints for the target, warm-started from the
+    // previous frame (a still target converges in zero steps)
+    if (lookAtEnabled)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        lookAtResult = solveLookAt(lookAtTarget, lampJoints);
+        lookAtMicroseconds =
+            std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Forward kinematics once per frame, shared by lighting and drawing;
+    // with physics on the servoed joints and the base translation are drawn
+    const LampJoints &drawnJoints = physicsEnabled ? lampBody.joints : lampJoints;
+    LampPose lampPose;
+    computeLampPose(drawnJoints, lampPose);
+    if (physicsEnabled)
+    {
+        translateLampPose(lampPose, lampBody.position);
+    }
+
+    setupLighting(lampPose, drawProjection, cameraView);
+
+    // Crowd lamps follow the current clip, each with its own phase, or
+    // all aim at the look-at target. Usually the workers computed this
+    // frame's update while the previous frame was being submitted.
+    if (crowdEnabled)
+    {
+        CrowdUpdate crowdInputs = currentCrowdUpdate();
+        if (updateCrowd(crowd, lampMeshes, crowdInputs))
+        {
+            shadowCasterRevision++;
+        }
+
+        // Start on the next frame's update while this one is drawn
+        CrowdUpdate next;
+        if (predictNextCrowdUpdate(crowdInputs, next))
+        {
+            prefetchCrowdUpdate(crowd, lampMeshes, next);
+        }
+    }
+    updateCrowdLights(cameraView);
+
+    beginSection(SECTION_SHADOWS);
+    updateShadows(lampPose, cameraView);
+    setLightingEnabled(true);
+
+    // With a still lamp and camera the table comes from the lightmap
+    beginSection(SECTION_TABLE);
+    lightmapActive = updateTableLightmap(drawnJoints, cameraView);
+    if (lightmapActive)
+    {
+        drawBakedTable();
+    }
+    else
+    {
+        drawTable(true);
+    }
+
+    // Lamps outside the view frustum are skipped; the main lamp's bounds
+    // hold every pose, so they only move with the physics base
+    beginSection(SECTION_LAMPS);
+    float lampCenter[3];
+    float lampRadius;
+    lampBoundingSphere(lampCenter, lampRadius);
+    if (physicsEnabled)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            lampCenter[i] += lampBody.position[i];
+        }
+    }
+    bool lampVisible = sphereInFrustum(cameraFrustum, lampCenter, lampRadius);
+    if (lampVisible)
+    {
+        drawLamp(lampPose);
+    }
+    countCulling(CULL_LAMPS, 1, lampVisible ? 0 : 1);
+    if (lookAtEnabled)
+    {
+        drawLookAtTarget();
+    }
+
+    if (crowdEnabled)
+    {
+        drawCrowd(crowd, lampMeshes, spotlightEnabled, false);
+        countCulling(CULL_LAMPS, (int)crowd.lamps.size(), drawnCrowdFrame(crowd).culledLamps);
+        setLightingEnabled(true); // Rebind the main lighting program
+    }
+
+    if (pickRequested)
+    {
+        drawPickPass(lampPose, lampVisible, cameraView);
+    }
+
+    beginSection(SECTION_RESOLVE);
+    resolveAntialiasFrame(antialiasTarget, cameraProjection, cameraView);
+
+    // The HUD's bitmap font needs the fixed-function renderer
+    beginSection(SECTION_OVERLAY);
+    if (!coreProfile)
+    {
+        drawOverlay();
+    }
+
+    endFrameStats();
+    if (!headless)
+    {
+        glutSwapBuffers(); // Swap front and back buffers
+    }
+    frameRendered();
+
+    if (updateAdaptiveQuality(adaptiveQuality, antialiasTarget, lastFrameSample()))
+    {
+        std::cout << "Adaptive quality: " << describeAntialias(antialiasTarget) << std::endl;
+        markSceneDirty();
+    }
+    settleTemporalAntialiasing();
+}
+
+/**
+ * Keep drawing a still scene under TAA until its history has converged
+ * Every frame adds one jittered sample per pixel; without the extra
+ * frames an idle scene would stay at the partly blended one it stopped on.
+ */
+void settleTemporalAntialiasing()
+{
+    if (!antialiasTarget.active || antialiasTarget.mode != ANTIALIAS_TAA)
+    {
+        return;
+    }
+    if (sceneChangeCount() != taaChangeCount)
+    {
+        taaStillFrames = 0;
+    }
+    if (++taaStillFrames < TAA_SETTLE_FRAMES)
+    {
+        markSceneDirty();
+    }
+    taaChangeCount = sceneChangeCount();
+}
+
+/**
+ * Reshape callback - called when window is resized
+ * @param width - New window width
+ * @param height - New window height
+ */
+void reshape(int width, int height)
+{
+    if (height == 0)
+        height = 1; // Prevent division by zero
+    float aspect = (float)width / (float)height;
+
+    glViewport(0, 0, width, height);
+    viewportWidth = width;
+    viewportHeight = height;
+    resizeAntialiasTarget(antialiasTarget, width, height);
+    // Same matrix as gluPerspective(), kept for frustum culling; the
+    // core-profile renderer picks it up in setupLighting()
+    cameraProjection = mat4Perspective(CAMERA_FOVY, aspect, CAMERA_NEAR, CAMERA_FAR);
+    if (!coreProfile)
+    {
+        glMatrixMode(GL_PROJECTION);
+        glLoadMatrixf(cameraProjection.m);
+        glMatrixMode(GL_MODELVIEW);
+    }
+
+    // Pixels per world unit at distance 1, for LOD selection
+    lodView.pixelsPerUnit = height / (2.0f * tanf(0.5f * CAMERA_FOVY * (float)M_PI / 180.0f));
+}
+
+/**
+ * Animation clock - posts the wall-clock time since the last tick as an
+ * input event, which advances playback and physics in fixed steps
+ * The timer only re-arms itself while a clip is playing or physics is
+ * on, so a stopped animation costs nothing otherwise.
+ * @param value - Unused
+ */
+void animationTimer(int value)
+{
+    (void)value;
+    animationClockArmed = false;
+    if (!animationClockNeeded() || replaying)
+    {
+        return;
+    }
+
+    int now = glutGet(GLUT_ELAPSED_TIME);
+    postInputEvent(INPUT_CLOCK_TICK, now - lastAnimationTick, now);
+    lastAnimationTick = now;
+    dispatchInputEvents();
+
+    if (animationClockNeeded())
+    {
+        animationClockArmed = true;
+        glutTimerFunc(ANIMATION_TIMER_MS, animationTimer, 0);
+    }
+}
+
+/**
+ * True while something advances with the animation clock
+ */
+bool animationClockNeeded()
+{
+    return animationPlayer.playing || physicsEnabled;
+}
+
+/**
+ * Start the animation clock unless it already runs
+ * During a replay the recorded clock ticks take its place.
+ */
+void startAnimationClock()
+{
+    if (replaying || animationClockArmed)
+    {
+        return;
+    }
+    lastAnimationTick = glutGet(GLUT_ELAPSED_TIME);
+    animationClockArmed = true;
+    glutTimerFunc(ANIMATION_TIMER_MS, animationTimer, 0);
+}
+
+/**
+ * Advance playback by one clock tick and pose the lamp
+ * @param elapsedSeconds - Time since the previous tick
+ */
+void advanceAnimation(float elapsedSeconds)
+{
+    if (physicsEnabled)
+    {
+        bool wasPlaying = animationPlayer.playing;
+        advancePhysics(elapsedSeconds);
+        if (wasPlaying && !animationPlayer.playing)
+        {
+            markSceneDirty();
+        }
+        return;
+    }
+
+    if (!animationPlayer.playing)
+    {
+        return;
+    }
+
+    if (advancePlayback(animationPlayer, elapsedSeconds) > 0)
+    {
+        LampJoints previous = lampJoints;
+        sampleClip(*animationPlayer.clip, animationPlayer.time, animationPlayer.interpolation, lampJoints);
+        if (!lampJointsEqual(lampJoints, previous))
+        {
+            markSceneDirty();
+        }
+    }
+
+    // Finished non-looping clips still need the status line refreshed
+    if (!animationPlayer.playing)
+    {
+        markSceneDirty();
+    }
+}
+
+/**
+ * Run the hop physics substeps due after elapsedSeconds
+ * Playback advances inside the substeps and the clip is sampled at every
+ * one of them, so the servos see a smooth target whatever the tick rate.
+ * lampJoints stays the commanded pose; the body's joints are drawn.
+ * @param elapsedSeconds - Time since the previous tick
+ */
+void advancePhysics(float elapsedSeconds)
+{
+    int substeps = takePhysicsSubsteps(lampBody, elapsedSeconds);
+    for (int i = 0; i < substeps; i++)
+    {
+        if (animationPlayer.playing)
+        {
+            advancePlayback(animationPlayer, PHYSICS_TIMESTEP);
+            sampleClip(*animationPlayer.clip, animationPlayer.time + animationPlayer.accumulator,
+                       animationPlayer.interpolation, lampJoints);
+        }
+        if (lampBodyAtRest(lampBody, lampJoints))
+        {
+            continue;
+        }
+        stepLampBody(lampBody, lampJoints);
+        markSceneDirty();
+    }
+
+    if (lampBody.position[1] < PHYSICS_FALL_RESET)
+    {
+        std::cout << "Physics: the lamp fell off the table" << std::endl;
+        resetLampBody(lampBody, lampJoints, 0.0f, 0.0f, 0.5f * scene.tableSize);
+    }
+}
+
+/**
+ * Switch hop physics on (the lamp stands still at the table center in
+ * its current pose) or off (the joints again follow lampJoints exactly)
+ */
+void togglePhysics()
+{
+    physicsEnabled = !physicsEnabled;
+    if (physicsEnabled)
+    {
+        resetLampBody(lampBody, lampJoints, 0.0f, 0.0f, 0.5f * scene.tableSize);
+        if (!headless)
+        {
+            startAnimationClock();
+        }
+    }
+    std::cout << "Physics: " << (physicsEnabled ? "ON" : "OFF") << std::endl;
+    markSceneDirty();
+}
+
+/**
+ * Step the anti-aliasing mode: off, MSAA, TAA, off
+ * Adaptive quality starts over from the new mode's best level.
+ */
+void cycleAntialiasMode()
+{
+    if (!antialiasAvailable)
+    {
+        std::cout << "Anti-aliasing unavailable (requires OpenGL 3.0)" << std::endl;
+        return;
+    }
+    AntialiasMode mode = (AntialiasMode)((antialiasTarget.mode + 1) % ANTIALIAS_MODE_COUNT);
+    setAntialiasMode(antialiasTarget, adaptiveQuality, mode);
+    std::cout << "Anti-aliasing: " << describeAntialias(antialiasTarget) << std::endl;
+    markSceneDirty();
+}
+
+/**
+ * Switch the frame-time driven quality ladder on or off; off returns to
+ * the mode's full quality
+ */
+void toggleAdaptiveQuality()
+{
+    if (!antialiasAvailable)
+    {
+        std::cout << "Adaptive quality unavailable (requires OpenGL 3.0)" << std::endl;
+        return;
+    }
+    adaptiveQuality.enabled = !adaptiveQuality.enabled;
+    setAntialiasMode(antialiasTarget, adaptiveQuality, antialiasTarget.mode);
+    std::cout << "Adaptive quality: " << (adaptiveQuality.enabled ? "ON" : "OFF") << " ("
+              << adaptiveQuality.budgetMs << " ms budget)" << std::endl;
+    markSceneDirty();
+}
+
+/**
+ * Replay clock - delivers recorded events at their original times
+ * Recorded times and GLUT_ELAPSED_TIME both count from GLUT startup, so
+ * the pauses of the recorded session are kept. Once the last event is
+ * out the keyboard and the animation timer take over again.
+ * @param value - Unused
+ */
+void replayTimer(int value)
+{
+    (void)value;
+    int now = glutGet(GLUT_ELAPSED_TIME);
+    while (replayPosition < replayEvents.size() && replayEvents[replayPosition].time <= now)
+    {
+        const InputEvent &event = replayEvents[replayPosition++];
+        postInputEvent(event.type, event.code, event.time);
+    }
+    dispatchInputEvents();
+
+    if (replayPosition < replayEvents.size())
+    {
+        glutTimerFunc(replayEvents[replayPosition].time - now, replayTimer, 0);
+        return;
+    }
+    replaying = false;
+    std::cout << "Replay finished" << std::endl;
+    if (animationClockNeeded())
+    {
+        startAnimationClock();
+    }
+}
+
+/**
+ * Start or pause playback of the current clip
+ */
+void toggleAnimation()
+{
+    if (animationPlayer.playing)
+    {
+        stopAnimation();
+        return;
+    }
+
+    // Resume where we paused if the clip is unchanged, otherwise restart
+    const AnimationClip *clip = &animationClips[currentClip];
+    if (animationPlayer.clip != clip || (!clip->looping && animationPlayer.time >= clipDuration(*clip)))
+    {
+        startPlayback(animationPlayer, clip);
+    }
+    animationPlayer.playing = true;
+    std::cout << "Animation: " << animationClips[currentClip].name << " playing" << std::endl;
+
+    startAnimationClock();
+    markSceneDirty();
+}
+
+/**
+ * Pause playback, e.g. when the user takes manual control of the joints
+ */
+void stopAnimation()
+{
+    if (animationPlayer.playing)
+    {
+        animationPlayer.playing = false;
+        std::cout << "Animation: stopped" << std::endl;
+        markSceneDirty();
+    }
+}
+
+/**
+ * Change the joint controlled by the arrow keys
+ * @param joint - Joint to select; redraws only if the selection changed
+ */
+void selectJoint(JointSelection joint)
+{
+    const char *jointNames[] = {"Base", "Lower Arm", "Upper Arm", "Lampshade"};
+    std::cout << "Selected: " << jointNames[joint] << std::endl;
+    if (selectedJoint != joint)
+    {
+        selectedJoint = joint;
+        markSceneDirty();
+    }
+}
+
+/**
+ * Deliver one input event to the code that acts on it
+ */
+void handleInputEvent(const InputEvent &event)
+{
+    switch (event.type)
+    {
+    case INPUT_KEY:
+        handleKey((unsigned char)event.code);
+        break;
+    case INPUT_SPECIAL_KEY:
+        handleSpecialKey(event.code);
+        break;
+    case INPUT_CLOCK_TICK:
+        advanceAnimation(event.code / 1000.0f);
+        break;
+    case INPUT_ORBIT_X:
+        orbitCamera(-event.code * ORBIT_DEGREES_PER_PIXEL, 0.0f);
+        break;
+    case INPUT_ORBIT_Y:
+        orbitCamera(0.0f, event.code * ORBIT_DEGREES_PER_PIXEL);
+        break;
+    case INPUT_ZOOM:
+        zoomCamera(powf(ZOOM_PER_PIXEL, (float)event.code));
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * Keyboard callback - queues the key as an input event
+ * While a replay runs only ESC gets through.
+ * @param key - ASCII character code
+ * @param x - Mouse X position (unused)
+ * @param y - Mouse Y position (unused)
+ */
+void keyboard(unsigned char key, int x, int y)
+{
+    if (replaying && key != 27)
+    {
+        return;
+    }
+    postInputEvent(INPUT_KEY, key, glutGet(GLUT_ELAPSED_TIME));
+    dispatchInputEvents();
+}
+
+/**
+ * Special keys callback - queues the key as an input event
+ * @param key - GLUT special key code
+ * @param x - Mouse X position (unused)
+ * @param y - Mouse Y position (unused)
+ */
+void specialKeys(int key, int x, int y)
+{
+    if (replaying)
+    {
+        return;
+    }
+    postInputEvent(INPUT_SPECIAL_KEY, key, glutGet(GLUT_ELAPSED_TIME));
+    dispatchInputEvents();
+}
+
+/**
+ * Mouse button callback - starts and ends drags, turns wheel notches
+ * into zoom and a left click without drag into a pick
+ * freeglut reports the wheel as buttons 3 (up) and 4 (down).
+ * @param button - GLUT button
+ * @param state - GLUT_DOWN or GLUT_UP
+ * @param x - Mouse X position
+ * @param y - Mouse Y position
+ */
+void mouse(int button, int state, int x, int y)
+{
+    if (replaying)
+    {
+        return;
+    }
+    if (button == 3 || button == 4)
+    {
+        if (state == GLUT_DOWN)
+        {
+            pendingZoom += button == 3 ? -WHEEL_ZOOM_PIXELS : WHEEL_ZOOM_PIXELS;
+            markSceneDirty();
+        }
+        return;
+    }
+    if (state == GLUT_DOWN && dragButton < 0)
+    {
+        dragButton = button;
+        dragMoved = false;
+        lastMouseX = x;
+        lastMouseY = y;
+    }
+    else if (state == GLUT_UP && button == dragButton)
+    {
+        dragButton = -1;
+        if (button == GLUT_LEFT_BUTTON && !dragMoved)
+        {
+            requestPick(x, y);
+        }
+    }
+}
+
+/**
+ * Motion callback (a button is held) - adds up the drag
+ * Nothing is applied here: a mouse reporting at 1 kHz would otherwise
+ * move the camera many times per displayed frame. markSceneDirty() posts
+ * one redisplay, and display() applies the sum through flushMouseDrag().
+ * @param x - Mouse X position
+ * @param y - Mouse Y position
+ */
+void mouseMotion(int x, int y)
+{
+    if (replaying || dragButton < 0)
+    {
+        return;
+    }
+    int dx = x - lastMouseX;
+    int dy = y - lastMouseY;
+    lastMouseX = x;
+    lastMouseY = y;
+    if (dragButton == GLUT_LEFT_BUTTON)
+    {
+        pendingOrbitX += dx;
+        pendingOrbitY += dy;
+    }
+    else if (dragButton == GLUT_RIGHT_BUTTON)
+    {
+        pendingZoom += dy;
+    }
+    else
+    {
+        return;
+    }
+    if (dx != 0 || dy != 0)
+    {
+        dragMoved = true;
+        markSceneDirty();
+    }
+}
+
+/**
+ * Queue the drag gathered since the last frame as input events
+ * At most one event per axis per frame, so recordings and replays see
+ * the same coalesced camera moves as the window did.
+ */
+void flushMouseDrag()
+{
+    if (pendingOrbitX == 0 && pendingOrbitY == 0 && pendingZoom == 0)
+    {
+        return;
+    }
+    int now = glutGet(GLUT_ELAPSED_TIME);
+    if (pendingOrbitX != 0)
+    {
+        postInputEvent(INPUT_ORBIT_X, pendingOrbitX, now);
+    }
+    if (pendingOrbitY != 0)
+    {
+        postInputEvent(INPUT_ORBIT_Y, pendingOrbitY, now);
+    }
+    if (pendingZoom != 0)
+    {
+        postInputEvent(INPUT_ZOOM, pendingZoom, now);
+    }
+    pendingOrbitX = pendingOrbitY = pendingZoom = 0;
+    dispatchInputEvents();
+}
+
+/**
+ * Select whatever is under a clicked pixel with the next frame
+ * The frame draws a pick pass after the scene; the readback finishes in
+ * pickPollTimer(). A click while one is in flight replaces it.
+ * @param x - Mouse X position
+ * @param y - Mouse Y position (from the top, as GLUT reports it)
+ */
+void requestPick(int x, int y)
+{
+    if (!pickingAvailable)
+    {
+        return;
+    }
+    pickX = x;
+    pickY = viewportHeight - 1 - y;
+    pickRequested = true;
+    markSceneDirty();
+}
+
+/**
+ * Draw the lamps into the pick target and start the readback
+ * Same poses, detail levels and culling as the frame just drawn, so the
+ * pick matches what is on screen. Materials and the selection tint are
+ * left alone; the lighting program is bound again afterwards.
+ * @param pose - Main lamp pose of the frame
+ * @param lampVisible - The main lamp was drawn (inside the frustum)
+ * @param cameraView - World-to-eye matrix of the frame
+ */
+void drawPickPass(const LampPose &pose, bool lampVisible, const Mat4 &cameraView)
+{
+    pickRequested = false;
+    beginPickPass(pickBuffer, cameraProjection, cameraView, pickX, pickY, viewportWidth, viewportHeight);
+    setMaterialIndexUniform(-1);
+    setHighlightUniform(-1);
+    pickPassActive = true;
+    if (lampVisible)
+    {
+        drawLamp(pose);
+    }
+    if (crowdEnabled)
+    {
+        drawCrowdPickIds(crowd, lampMeshes, pickBuffer, 1);
+    }
+    pickPassActive = false;
+    endPickPass(pickBuffer);
+
+    // The core-profile program is bound again by the next beginCoreFrame()
+    if (!coreProfile)
+    {
+        setLightingEnabled(true);
+    }
+    if (!pickPollArmed)
+    {
+        pickPollArmed = true;
+        glutTimerFunc(PICK_POLL_MS, pickPollTimer, 0);
+    }
+}
+
+/**
+ * Pick readback timer - checks the fence and acts on a finished pick
+ * Re-arms itself while the readback is in flight; nothing is redrawn
+ * until the result arrives.
+ * @param value - Unused timer value
+ */
+void pickPollTimer(int value)
+{
+    (void)value;
+    unsigned int id = PICK_NONE;
+    if (pollPickResult(pickBuffer, id))
+    {
+        pickPollArmed = false;
+        applyPick(id);
+    }
+    else if (pickPending(pickBuffer))
+    {
+        glutTimerFunc(PICK_POLL_MS, pickPollTimer, 0);
+    }
+    else
+    {
+        pickPollArmed = false;
+    }
+}
+
+/**
+ * Act on a picked ID
+ * A part of the main lamp selects its joint through the same event as
+ * the number keys, so recordings replay the selection. Crowd lamps have
+ * no controls of their own and are only reported.
+ * @param id - Pick ID under the cursor (PICK_NONE for the background)
+ */
+void applyPick(unsigned int id)
+{
+    if (id == PICK_NONE)
+    {
+        return;
+    }
+    int lamp = pickedLamp(id);
+    int joint = pickedJoint(id);
+    if (lamp == 0)
+    {
+        postInputEvent(INPUT_KEY, '1' + joint, glutGet(GLUT_ELAPSED_TIME));
+        dispatchInputEvents();
+        return;
+    }
+    const char *jointNames[] = {"Base", "Lower Arm", "Upper Arm", "Lampshade"};
+    std::cout << "Picked crowd lamp " << lamp - 1 << " (" << jointNames[joint] << ")" << std::endl;
+}
+
+/**
+ * Turn the camera around the scene
+ * @param azimuthDegrees - Added to cameraAngleX (wraps around)
+ * @param elevationDegrees - Added to cameraAngleY, held between
+ *                           CAMERA_MIN_ELEVATION and CAMERA_MAX_ELEVATION
+ */
+void orbitCamera(float azimuthDegrees, float elevationDegrees)
+{
+    float azimuth = fmodf(cameraAngleX + azimuthDegrees, 360.0f);
+    float elevation = std::max(CAMERA_MIN_ELEVATION, std::min(cameraAngleY + elevationDegrees, CAMERA_MAX_ELEVATION));
+    if (azimuth != cameraAngleX || elevation != cameraAngleY)
+    {
+        cameraAngleX = azimuth;
+        cameraAngleY = elevation;
+        markSceneDirty();
+    }
+}
+
+/**
+ * Move the camera toward (factor < 1) or away from the look-at point
+ * @param factor - Multiplies cameraDistance, within the distance limits
+ */
+void zoomCamera(float factor)
+{
+    float distance = std::max(CAMERA_MIN_DISTANCE, std::min(cameraDistance * factor, CAMERA_MAX_DISTANCE));
+    if (distance != cameraDistance)
+    {
+        cameraDistance = distance;
+        markSceneDirty();
+    }
+}
+
+/**
+ * Act on a key press: joint selection and commands
+ * @param key - ASCII character code
+ */
+void handleKey(unsigned char key)
+{
+    switch (key)
+    {
+    case '1':
+        selectJoint(BASE);
+        break;
+    case '2':
+        selectJoint(LOWER_ARM);
+        break;
+    case '3':
+        selectJoint(UPPER_ARM);
         break;
     case '4':
-        selectedJoint = LAMPSHADE;
-        std::cout << "Selected: Lampshade" << std::endl;
+        selectJoint(LAMPSHADE);
         break;
     case 'f':
     case 'F':
         spotlightEnabled = !spotlightEnabled;
         std::cout << "Spotlight: " << (spotlightEnabled ? "ON" : "OFF") << std::endl;
+        markSceneDirty();
+        break;
+    case 'l':
+    case 'L':
+        if (coreProfile)
+        {
+            std::cout << "The core-profile renderer always lights per pixel" << std::endl;
+            break;
+        }
+        if (perPixelProgram == 0)
+        {
+            std::cout << "Per-pixel lighting unavailable (shader failed to build)" << std::endl;
+            break;
+        }
+        perPixelLighting = !perPixelLighting;
+        std::cout << "Lighting: " << (perPixelLighting ? "Per-pixel" : "Per-vertex") << std::endl;
+        markSceneDirty();
+        break;
+    case 'p':
+    case 'P':
+        // Playback and look-at both drive the joints; playing wins
+        lookAtEnabled = false;
+        toggleAnimation();
+        break;
+    case 'n':
+    case 'N':
+        // Switch clips; playback restarts on the next 'P'
+        stopAnimation();
+        currentClip = (currentClip + 1) % clipCount;
+        std::cout << "Animation clip: " << animationClips[currentClip].name << std::endl;
+        markSceneDirty();
+        break;
+    case 'i':
+    case 'I':
+        animationPlayer.interpolation =
+            animationPlayer.interpolation == INTERPOLATE_CUBIC ? INTERPOLATE_LINEAR : INTERPOLATE_CUBIC;
+        std::cout << "Interpolation: " << (animationPlayer.interpolation == INTERPOLATE_CUBIC ? "Cubic" : "Linear")
+                  << std::endl;
+        markSceneDirty();
+        break;
+    case 'm':
+    case 'M':
+        if (!crowdAvailable)
+        {
+            std::cout << "Lamp crowd unavailable (requires OpenGL 3.3)" << std::endl;
+            break;
+        }
+        crowdEnabled = !crowdEnabled;
+        std::cout << "Crowd: " << (crowdEnabled ? "ON" : "OFF") << std::endl;
+        markSceneDirty();
+        break;
+    case 'h':
+    case 'H':
+        if (!shadowsAvailable)
+        {
+            std::cout << "Shadows unavailable (requires OpenGL 3.0 and GLSL)" << std::endl;
+            break;
+        }
+        shadowsEnabled = !shadowsEnabled;
+        std::cout << "Shadows: " << (shadowsEnabled ? "ON" : "OFF")
+                  << (shadowsEnabled && !perPixelLighting ? " (visible with per-pixel lighting)" : "") << std::endl;
+        markSceneDirty();
+        break;
+    case 'g':
+    case 'G':
+        if (!crowdLightsAvailable)
+        {
+            std::cout << "Crowd spotlights unavailable (requires OpenGL 3.3 and GLSL)" << std::endl;
+            break;
+        }
+        crowdLightsEnabled = !crowdLightsEnabled;
+        std::cout << "Crowd spotlights: " << (crowdLightsEnabled ? "ON" : "OFF")
+                  << (crowdLightsEnabled && !perPixelLighting ? " (visible with per-pixel lighting)" : "")
+                  << std::endl;
+        markSceneDirty();
+        break;
+    case 'k':
+    case 'K':
+        lookAtEnabled = !lookAtEnabled;
+        if (lookAtEnabled)
+        {
+            stopAnimation();
+        }
+        std::cout << "Look-at: " << (lookAtEnabled ? "ON (arrow keys move the target)" : "OFF") << std::endl;
+        markSceneDirty();
+        break;
+    case 'j':
+    case 'J':
+        togglePhysics();
+        break;
+    case 'b':
+    case 'B':
+        if (!lightmapAvailable)
+        {
+            std::cout << "Table lightmap unavailable (requires OpenGL 3.0)" << std::endl;
+            break;
+        }
+        lightmapEnabled = !lightmapEnabled;
+        lightmapSettling = false;
+        tableLightmap.valid = false;
+        std::cout << "Table lightmap: " << (lightmapEnabled ? "ON (baked while the lamp is still)" : "OFF")
+                  << std::endl;
+        markSceneDirty();
+        break;
+    case 't':
+    case 'T':
+        statsOverlayEnabled = !statsOverlayEnabled;
+        std::cout << "Frame statistics: " << (statsOverlayEnabled ? "ON" : "OFF") << std::endl;
+        markSceneDirty();
+        break;
+    case 'd':
+    case 'D':
+        lodOverlayEnabled = !lodOverlayEnabled;
+        std::cout << "LOD overlay: " << (lodOverlayEnabled ? "ON" : "OFF") << std::endl;
+        markSceneDirty();
+        break;
+    case 'a':
+    case 'A':
+        cycleAntialiasMode();
+        break;
+    case 'q':
+    case 'Q':
+        toggleAdaptiveQuality();
         break;
     case 'r':
     case 'R':
         // Reset all joints to default configuration
-        lampJoints.baseRotation = 0.0f;
-        lampJoints.lowerArmAngle = 30.0f;
-        lampJoints.upperArmAngle = -60.0f;
-        lampJoints.lampshadeAngle = -90.0f;
-        lampJoints.lampshadeRotation = 0.0f;
+        stopAnimation();
+        if (lookAtEnabled)
+        {
+            lookAtEnabled = false;
+            markSceneDirty();
+        }
+        if (!lampJointsEqual(lampJoints, DEFAULT_LAMP_JOINTS))
+        {
+            lampJoints = DEFAULT_LAMP_JOINTS;
+            markSceneDirty();
+        }
+        if (physicsEnabled)
+        {
+            resetLampBody(lampBody, lampJoints, 0.0f, 0.0f, 0.5f * scene.tableSize);
+            markSceneDirty();
+        }
         std::cout << "Reset to default position" << std::endl;
         break;
     case 27: // ESC key
         exit(0);
         break;
     }
-    glutPostRedisplay(); // Request scene redraw
+    // Unhandled keys and no-op commands leave the scene untouched: no redraw
 }
 
 /**
- * Special keys callback - handles arrow keys for joint rotation
+ * Act on a special key: arrow keys rotate the selected joint
  * @param key - GLUT special key code
- * @param x - Mouse X position (unused)
- * @param y - Mouse Y position (unused)
  */
-void specialKeys(int key, int x, int y)
+void handleSpecialKey(int key)
 {
     const float rotationStep = 3.0f; // Degrees per keypress
+    const LampJoints previous = lampJoints;
+
+    // In look-at mode the arrows move the target instead of a joint
+    if (lookAtEnabled)
+    {
+        switch (key)
+        {
+        case GLUT_KEY_LEFT:
+            moveLookAtTarget(-LOOK_AT_STEP, 0.0f);
+            break;
+        case GLUT_KEY_RIGHT:
+            moveLookAtTarget(LOOK_AT_STEP, 0.0f);
+            break;
+        case GLUT_KEY_UP:
+            moveLookAtTarget(0.0f, -LOOK_AT_STEP);
+            break;
+        case GLUT_KEY_DOWN:
+            moveLookAtTarget(0.0f, LOOK_AT_STEP);
+            break;
+        }
+        return;
+    }
 
     switch (key)
     {
@@ -601,59 +2497,660 @@ void specialKeys(int key, int x, int y)
         if (selectedJoint == LOWER_ARM)
         {
             lampJoints.lowerArmAngle += rotationStep;
-            lampJoints.lowerArmAngle = fmin(lampJoints.lowerArmAngle, 90.0f);
+            lampJoints.lowerArmAngle = fmin(lampJoints.lowerArmAngle, LOWER_ARM_MAX);
         }
         else if (selectedJoint == UPPER_ARM)
         {
             lampJoints.upperArmAngle += rotationStep;
-            lampJoints.upperArmAngle = fmin(lampJoints.upperArmAngle, 90.0f);
+            lampJoints.upperArmAngle = fmin(lampJoints.upperArmAngle, UPPER_ARM_MAX);
         }
         else if (selectedJoint == LAMPSHADE)
         {
             lampJoints.lampshadeAngle += rotationStep;
-            lampJoints.lampshadeAngle = fmin(lampJoints.lampshadeAngle, 45.0f);
+            lampJoints.lampshadeAngle = fmin(lampJoints.lampshadeAngle, LAMPSHADE_MAX);
         }
         break;
     case GLUT_KEY_DOWN:
         if (selectedJoint == LOWER_ARM)
         {
             lampJoints.lowerArmAngle -= rotationStep;
-            lampJoints.lowerArmAngle = fmax(lampJoints.lowerArmAngle, -10.0f);
+            lampJoints.lowerArmAngle = fmax(lampJoints.lowerArmAngle, LOWER_ARM_MIN);
         }
         else if (selectedJoint == UPPER_ARM)
         {
             lampJoints.upperArmAngle -= rotationStep;
-            lampJoints.upperArmAngle = fmax(lampJoints.upperArmAngle, -120.0f);
+            lampJoints.upperArmAngle = fmax(lampJoints.upperArmAngle, UPPER_ARM_MIN);
         }
         else if (selectedJoint == LAMPSHADE)
         {
             lampJoints.lampshadeAngle -= rotationStep;
-            lampJoints.lampshadeAngle = fmax(lampJoints.lampshadeAngle, -90.0f);
+            lampJoints.lampshadeAngle = fmax(lampJoints.lampshadeAngle, LAMPSHADE_MIN);
         }
         break;
     }
 
-    glutPostRedisplay(); // Request scene redraw
+    // Only redraw if the joint actually moved (not when pinned at a limit)
+    if (!lampJointsEqual(lampJoints, previous))
+    {
+        // Manual control takes over from the animation
+        stopAnimation();
+        markSceneDirty();
+    }
+}
+
+/**
+ * Scripted joint sweep used by the benchmark
+ * Turns the base once around over the run while the arms and lampshade
+ * swing through their ranges, so every part moves every frame.
+ * @param frame - Frame number (negative during warm-up)
+ * @param frameCount - Number of timed frames
+ * @param joints - Receives the pose
+ */
+void benchmarkPose(int frame, int frameCount, LampJoints &joints)
+{
+    float t = (float)frame / (float)frameCount;
+    float wave = 2.0f * (float)M_PI * t;
+    joints.baseRotation = 360.0f * t;
+    joints.lowerArmAngle =
+        0.5f * (LOWER_ARM_MIN + LOWER_ARM_MAX) + 0.5f * (LOWER_ARM_MAX - LOWER_ARM_MIN) * sinf(2.0f * wave);
+    joints.upperArmAngle =
+        0.5f * (UPPER_ARM_MIN + UPPER_ARM_MAX) + 0.5f * (UPPER_ARM_MAX - UPPER_ARM_MIN) * sinf(3.0f * wave);
+    joints.lampshadeAngle =
+        0.5f * (LAMPSHADE_MIN + LAMPSHADE_MAX) + 0.5f * (LAMPSHADE_MAX - LAMPSHADE_MIN) * cosf(5.0f * wave);
+    joints.lampshadeRotation = 45.0f * sinf(wave);
+    clampLampJoints(joints);
+}
+
+/**
+ * Headless benchmark: render frames offscreen and report frame times
+ * Expects init() to have run on the headless context. Each frame is
+ * timed from the start of display() until glFinish() returns, which
+ * stands in for the buffer swap of the windowed path.
+ * @param frameCount - Number of timed frames
+ * @param width - Offscreen framebuffer width
+ * @param height - Offscreen framebuffer height
+ * @return Process exit status
+ */
+int runBenchmark(int frameCount, int width, int height)
+{
+    OffscreenTarget target;
+    if (!createOffscreenTarget(target, width, height))
+    {
+        destroyHeadlessContext();
+        return 1;
+    }
+    reshape(width, height);
+    scriptedBench = true;
+
+    std::ostringstream what;
+    what << "Benchmark: " << frameCount << " frames";
+    printHeadlessSetup(what.str(), width, height);
+
+    std::vector<double> frameMs;
+    frameMs.reserve(frameCount);
+    for (int frame = -BENCH_WARMUP_FRAMES; frame < frameCount; frame++)
+    {
+        benchmarkPose(frame, frameCount, lampJoints);
+        animationPlayer.time = frame * ANIMATION_TIMESTEP; // Keeps the crowd moving
+        benchNextAnimationTime = (frame + 1) * ANIMATION_TIMESTEP;
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        display();
+        glFinish();
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+        if (frame >= 0)
+        {
+            frameMs.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+        }
+    }
+    printFrameTimeSummary(frameMs);
+
+    // Flush pending GPU timings while the context still exists
+    closeStatsCsv();
+    deleteOffscreenTarget(target);
+    destroyHeadlessContext();
+    return 0;
+}
+
+/**
+ * Headless replay: deliver a recorded session as fast as frames render
+ * Events recorded in the same millisecond (the drag a frame applied, in
+ * x, y and zoom) are delivered together; whenever they change the scene
+ * one timed frame follows, so the same recording gives the same sequence
+ * of frames on every build; compare runs with --stats-csv. A recorded
+ * ESC ends the replay.
+ * @param width - Offscreen framebuffer width
+ * @param height - Offscreen framebuffer height
+ * @return Process exit status
+ */
+int runReplayBenchmark(int width, int height)
+{
+    OffscreenTarget target;
+    if (!createOffscreenTarget(target, width, height))
+    {
+        destroyHeadlessContext();
+        return 1;
+    }
+    reshape(width, height);
+    replaying = true;
+
+    std::ostringstream what;
+    what << "Benchmark: replay of " << replayEvents.size() << " input events";
+    printHeadlessSetup(what.str(), width, height);
+
+    // The starting scene, drawn untimed like the benchmark warm-up
+    display();
+    glFinish();
+
+    std::vector<double> frameMs;
+    replayPosition = 0;
+    while (replayPosition < replayEvents.size())
+    {
+        int time = replayEvents[replayPosition].time;
+        bool exitRequested = false;
+        for (; replayPosition < replayEvents.size() && replayEvents[replayPosition].time == time; replayPosition++)
+        {
+            const InputEvent &event = replayEvents[replayPosition];
+            exitRequested = event.type == INPUT_KEY && event.code == 27;
+            if (exitRequested)
+            {
+                break;
+            }
+            postInputEvent(event.type, event.code, event.time);
+        }
+        dispatchInputEvents();
+        if (exitRequested)
+        {
+            break;
+        }
+        if (!isSceneDirty())
+        {
+            continue;
+        }
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        display();
+        glFinish();
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+        frameMs.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    printFrameTimeSummary(frameMs);
+
+    closeStatsCsv();
+    deleteOffscreenTarget(target);
+    destroyHeadlessContext();
+    return 0;
+}
+
+/**
+ * Offline render: play the current clip once through and save every
+ * frame as an image
+ * Frames are not waited for; capture reads them back asynchronously and
+ * writes them on its own thread, so the GPU sets the pace.
+ * @param pattern - Output file pattern (see startFrameCapture())
+ * @param width - Image width
+ * @param height - Image height
+ * @param fps - Frames per second of clip time
+ * @return Process exit status
+ */
+int renderClipFrames(const char *pattern, int width, int height, float fps)
+{
+    OffscreenTarget target;
+    if (!createOffscreenTarget(target, width, height))
+    {
+        destroyHeadlessContext();
+        return 1;
+    }
+    if (!startFrameCapture(pattern, width, height))
+    {
+        deleteOffscreenTarget(target);
+        destroyHeadlessContext();
+        return 1;
+    }
+    reshape(width, height);
+    scriptedBench = true;
+
+    // A loop ends on its first pose, which is not repeated
+    const AnimationClip &clip = animationClips[currentClip];
+    int frameCount = (int)floorf(clipDuration(clip) * fps + 0.5f) + (clip.looping ? 0 : 1);
+    frameCount = std::max(frameCount, 1);
+
+    std::ostringstream what;
+    what << "Rendering: " << frameCount << " frames of " << clip.name << " at " << fps << " fps";
+    printHeadlessSetup(what.str(), width, height);
+
+    // With physics on, the lamp is simulated from rest through the clip
+    // and each frame shows the body after 1/fps seconds more
+    if (physicsEnabled)
+    {
+        startPlayback(animationPlayer, &clip);
+        animationPlayer.playing = true;
+        sampleClip(clip, 0.0f, animationPlayer.interpolation, lampJoints);
+        resetLampBody(lampBody, lampJoints, 0.0f, 0.0f, 0.5f * scene.tableSize);
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < frameCount; frame++)
+    {
+        benchNextAnimationTime = (frame + 1) / fps;
+        if (physicsEnabled)
+        {
+            if (frame > 0)
+            {
+                advancePhysics(1.0f / fps);
+            }
+        }
+        else
+        {
+            animationPlayer.time = frame / fps;
+            sampleClip(clip, animationPlayer.time, animationPlayer.interpolation, lampJoints);
+        }
+        display();
+        if (!captureFrame(frame))
+        {
+            frameCount = frame + 1;
+            break;
+        }
+    }
+    bool written = finishFrameCapture();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (written)
+    {
+        std::cout << "Rendered " << frameCount << " frames to " << pattern << " in " << seconds << " s ("
+                  << frameCount / seconds << " fps)" << std::endl;
+    }
+
+    closeStatsCsv();
+    deleteOffscreenTarget(target);
+    destroyHeadlessContext();
+    return written ? 0 : 1;
 }
 
+/**
+ * Print what a headless run renders, and on which renderer
+ * @param workload - e.g. "Benchmark: 600 frames"
+ */
+void printHeadlessSetup(const std::string &workload, int width, int height)
+{
+    std::cout << workload << " at " << width << "x" << height << ", "
+              << (crowdEnabled ? "crowd on" : "crowd off") << ", "
+              << (coreProfile ? "core-profile" : perPixelLighting ? "per-pixel" : "per-vertex") << " lighting"
+              << (shadowsEnabled ? ", shadows on" : "") << (crowdLightsEnabled ? ", crowd spotlights" : "")
+              << (lightmapEnabled ? ", table lightmap" : "")
+              << (antialiasTarget.mode != ANTIALIAS_OFF ? ", " + describeAntialias(antialiasTarget) : "")
+              << (adaptiveQuality.enabled ? ", adaptive quality" : "") << ", "
+              << jobWorkerCount() << " worker threads" << std::endl;
+    std::cout << "Renderer: " << glGetString(GL_RENDERER) << std::endl;
+}
+
+/**
+ * Command line options (all optional):
+ *   --stats-csv <path>  Write per-frame timings to a CSV file
+ *   --crowd             Start with the lamp crowd shown
+ *   --per-pixel         Start with per-pixel lighting
+ *   --bench             Render offscreen without a window and report frame times
+ *   --frames <n>        Timed frames for --bench (default 600)
+ *   --size <w>x<h>      Offscreen resolution for --bench (default 1920x1080)
+ *   --bench-fk          Time per-lamp vs batched (SIMD) kinematics and exit
+ *   --bench-physics     Time hop physics for hundreds to thousands of lamps and exit
+ *   --threads <n>       Worker threads for scene updates (default: one per core
+ *                       besides the render thread; 0 = update on the render thread)
+ *   --shadows           Start with spotlight shadows on
+ *   --crowd-lights      Start with a spotlight per crowd lamp (per-pixel lighting)
+ *   --shadow-size <n>   Shadow map resolution (default 1024)
+ *   --shadow-pcf <r>    Shadow filter radius, 0-3 (default 1)
+ *   --clip <path>       Add a binary clip (memory-mapped) and select it
+ *   --import-clip <text> <clip>
+ *                       Convert a text clip to the binary format and exit
+ *   --render-out <pattern>
+ *                       Render the current clip offscreen to numbered PPM files
+ *                       (e.g. frames/lamp_%04d.ppm) at --size, then exit
+ *   --render-fps <n>    Frames per second of clip time for --render-out (default 30)
+ *   --physics           Start with hop physics on (also for --render-out)
+ *   --lightmap          Start with the table lightmap on (baked while the lamp is still)
+ *   --record <path>     Record every input event to a file
+ *   --replay <path>     Replay a recording at its original pace; with --bench,
+ *                       as fast as possible instead of the scripted frames
+ *   --core-profile      Render through a GL 3.3 core-profile context with the
+ *                       shader-only renderer instead of the fixed-function one
+ *   --aa <mode>         Anti-aliasing: off, msaa2, msaa4, msaa8 or taa (default off)
+ *   --adaptive-quality  Lower MSAA samples, then resolution, when frames miss the budget
+ *   --vsync-budget <ms> Frame time budget for --adaptive-quality (default 16.7)
+ *   --scene <path>      Read the scene description from a file and reload it
+ *                       whenever the file is saved
+ */
 int main(int argc, char **argv)
 {
-    // Initialize GLUT
-    glutInit(&argc, argv);
-    glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB | GLUT_DEPTH);
-    glutInitWindowSize(WINDOW_WIDTH, WINDOW_HEIGHT);
-    glutInitWindowPosition(100, 100);
-    glutCreateWindow("Pixar Luxo Lamp Animation");
+    const char *statsCsvPath = NULL;
+    bool startWithCrowd = false;
+    bool startPerPixel = false;
+    bool bench = false;
+    int benchFrames = 600;
+    int benchWidth = 1920;
+    int benchHeight = 1080;
+    bool startWithShadows = false;
+    bool startWithCrowdLights = false;
+    bool startWithPhysics = false;
+    bool startWithLightmap = false;
+    int shadowSize = DEFAULT_SHADOW_SIZE;
+    int pcfRadius = DEFAULT_PCF_RADIUS;
+    int workerThreads = -1;
+    const char *clipPath = NULL;
+    const char *recordPath = NULL;
+    const char *renderPattern = NULL;
+    float renderFps = 30.0f;
+    const char *replayPath = NULL;
+    AntialiasMode antialiasMode = ANTIALIAS_OFF;
+    int msaaSamples = DEFAULT_MSAA_SAMPLES;
+    bool startAdaptive = false;
+    double vsyncBudgetMs = DEFAULT_VSYNC_BUDGET_MS;
+    defaultScene(scene);
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--stats-csv") == 0 && i + 1 < argc)
+        {
+            statsCsvPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--crowd") == 0)
+        {
+            startWithCrowd = true;
+        }
+        else if (strcmp(argv[i], "--per-pixel") == 0)
+        {
+            startPerPixel = true;
+        }
+        else if (strcmp(argv[i], "--bench") == 0)
+        {
+            bench = true;
+        }
+        else if (strcmp(argv[i], "--bench-fk") == 0)
+        {
+            // CPU only: no window or GL context needed
+            return runKinematicsBenchmark();
+        }
+        else if (strcmp(argv[i], "--bench-physics") == 0)
+        {
+            return runPhysicsBenchmark();
+        }
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+        {
+            benchFrames = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc)
+        {
+            if (sscanf(argv[++i], "%dx%d", &benchWidth, &benchHeight) != 2)
+            {
+                benchWidth = 0;
+            }
+        }
+        else if (strcmp(argv[i], "--shadows") == 0)
+        {
+            startWithShadows = true;
+        }
+        else if (strcmp(argv[i], "--crowd-lights") == 0)
+        {
+            startWithCrowdLights = true;
+        }
+        else if (strcmp(argv[i], "--physics") == 0)
+        {
+            startWithPhysics = true;
+        }
+        else if (strcmp(argv[i], "--lightmap") == 0)
+        {
+            startWithLightmap = true;
+        }
+        else if (strcmp(argv[i], "--core-profile") == 0)
+        {
+            coreProfile = true;
+        }
+        else if (strcmp(argv[i], "--aa") == 0 && i + 1 < argc)
+        {
+            const char *mode = argv[++i];
+            if (strcmp(mode, "off") == 0)
+            {
+                antialiasMode = ANTIALIAS_OFF;
+            }
+            else if (strcmp(mode, "taa") == 0)
+            {
+                antialiasMode = ANTIALIAS_TAA;
+            }
+            else if (sscanf(mode, "msaa%d", &msaaSamples) == 1 &&
+                     (msaaSamples == 2 || msaaSamples == 4 || msaaSamples == 8))
+            {
+                antialiasMode = ANTIALIAS_MSAA;
+            }
+            else
+            {
+                std::cerr << "Invalid --aa (off, msaa2, msaa4, msaa8 or taa)" << std::endl;
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--adaptive-quality") == 0)
+        {
+            startAdaptive = true;
+        }
+        else if (strcmp(argv[i], "--vsync-budget") == 0 && i + 1 < argc)
+        {
+            vsyncBudgetMs = atof(argv[++i]);
+            if (vsyncBudgetMs <= 0.0)
+            {
+                std::cerr << "Invalid --vsync-budget (milliseconds)" << std::endl;
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--shadow-size") == 0 && i + 1 < argc)
+        {
+            shadowSize = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--shadow-pcf") == 0 && i + 1 < argc)
+        {
+            pcfRadius = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--render-out") == 0 && i + 1 < argc)
+        {
+            renderPattern = argv[++i];
+        }
+        else if (strcmp(argv[i], "--render-fps") == 0 && i + 1 < argc)
+        {
+            renderFps = (float)atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+        {
+            recordPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+        {
+            replayPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--scene") == 0 && i + 1 < argc)
+        {
+            scenePath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--clip") == 0 && i + 1 < argc)
+        {
+            clipPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--import-clip") == 0 && i + 2 < argc)
+        {
+            // Offline conversion: no window or GL context needed
+            AnimationClip clip;
+            std::string name;
+            if (!importClipText(argv[i + 1], clip, name) || !writeClipFile(argv[i + 2], clip))
+            {
+                return 1;
+            }
+            std::cout << "Wrote " << clip.keyframes.size() << " keys of " << name << " to " << argv[i + 2] << std::endl;
+            return 0;
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            workerThreads = atoi(argv[++i]);
+            if (workerThreads < 0)
+            {
+                std::cerr << "Invalid --threads (0 or more)" << std::endl;
+                return 1;
+            }
+        }
+    }
+    if (shadowSize <= 0 || pcfRadius < 0 || pcfRadius > MAX_PCF_RADIUS)
+    {
+        std::cerr << "Invalid --shadow-size or --shadow-pcf (radius 0-" << MAX_PCF_RADIUS << ")" << std::endl;
+        return 1;
+    }
+    if (bench && (benchFrames <= 0 || benchWidth <= 0 || benchHeight <= 0))
+    {
+        std::cerr << "Invalid --frames or --size for --bench" << std::endl;
+        return 1;
+    }
+    if (renderPattern != NULL && (renderFps <= 0.0f || benchWidth <= 0 || benchHeight <= 0))
+    {
+        std::cerr << "Invalid --render-fps or --size for --render-out" << std::endl;
+        return 1;
+    }
+    if (clipPath != NULL && !openClipFile(clipPath, showClip))
+    {
+        return 1;
+    }
+    if (replayPath != NULL && !loadInputRecording(replayPath, replayEvents))
+    {
+        return 1;
+    }
+    if (scenePath != NULL && !loadSceneFile(scenePath, scene))
+    {
+        return 1;
+    }
+    // Before any GL context: meshes are built from these in init()
+    lampDimensions = scene.lamp;
+    for (int i = 0; i < MATERIAL_COUNT; i++)
+    {
+        setMaterial((MaterialId)i, scene.materials[i]);
+    }
+
+    // Workers for the crowd update; joined at exit, before globals go away
+    startJobSystem(workerThreads);
+    atexit(stopJobSystem);
+
+    if (bench || renderPattern != NULL)
+    {
+        // Headless context instead of GLUT; init() needs it current
+        headless = true;
+        setRedisplayPosting(false);
+        if (!createHeadlessContext(coreProfile))
+        {
+            return 1;
+        }
+    }
+    else
+    {
+        // Initialize GLUT
+        glutInit(&argc, argv);
+        glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB | GLUT_DEPTH);
+        glutInitWindowSize(WINDOW_WIDTH, WINDOW_HEIGHT);
+        glutInitWindowPosition(100, 100);
+        if (coreProfile)
+        {
+            glutInitContextVersion(3, 3);
+            glutInitContextProfile(GLUT_CORE_PROFILE);
+        }
+        glutCreateWindow("Pixar Luxo Lamp Animation");
+    }
+    if (coreProfile && !isCoreProfileContext())
+    {
+        std::cerr << "No OpenGL 3.3 core-profile context for --core-profile" << std::endl;
+        return 1;
+    }
 
     // Initialize OpenGL settings
-    init();
+    if (!init(shadowSize, pcfRadius, msaaSamples))
+    {
+        return 1;
+    }
+    if (clipPath != NULL)
+    {
+        currentClip = clipCount;
+        animationClips[clipCount++] = showClip.clip;
+        std::cout << "Animation clip: " << showClip.clip.name << " (" << clipDuration(showClip.clip) << " s)"
+                  << std::endl;
+    }
+
+    crowdEnabled = startWithCrowd && crowdAvailable;
+    perPixelLighting = startPerPixel && perPixelProgram != 0;
+    shadowsEnabled = startWithShadows && shadowsAvailable;
+    crowdLightsEnabled = startWithCrowdLights && crowdLightsAvailable;
+    lightmapEnabled = startWithLightmap && lightmapAvailable;
+    initAdaptiveQuality(adaptiveQuality, vsyncBudgetMs);
+    adaptiveQuality.enabled = startAdaptive && antialiasAvailable;
+    if ((antialiasMode != ANTIALIAS_OFF || startAdaptive) && !antialiasAvailable)
+    {
+        std::cerr << "Anti-aliasing unavailable (requires OpenGL 3.0)" << std::endl;
+    }
+    setAntialiasMode(antialiasTarget, adaptiveQuality, antialiasAvailable ? antialiasMode : ANTIALIAS_OFF);
+    if (startWithPhysics)
+    {
+        togglePhysics();
+    }
+    if (statsCsvPath != NULL)
+    {
+        if (openStatsCsv(statsCsvPath))
+        {
+            std::cout << "Writing frame statistics to " << statsCsvPath << std::endl;
+            atexit(closeStatsCsv);
+        }
+        else
+        {
+            std::cerr << "Cannot open " << statsCsvPath << " for writing" << std::endl;
+        }
+    }
+
+    // Keys and clock ticks reach the scene only through the event queue
+    setInputHandler(handleInputEvent);
+    if (recordPath != NULL)
+    {
+        if (startInputRecording(recordPath))
+        {
+            std::cout << "Recording input to " << recordPath << std::endl;
+            atexit(stopInputRecording);
+        }
+        else
+        {
+            std::cerr << "Cannot open " << recordPath << " for writing" << std::endl;
+        }
+    }
+
+    if (renderPattern != NULL)
+    {
+        return renderClipFrames(renderPattern, benchWidth, benchHeight, renderFps);
+    }
+    if (bench)
+    {
+        return replayPath != NULL ? runReplayBenchmark(benchWidth, benchHeight)
+                                  : runBenchmark(benchFrames, benchWidth, benchHeight);
+    }
+
+    if (replayPath != NULL)
+    {
+        std::cout << "Replaying " << replayEvents.size() << " input events from " << replayPath << std::endl;
+        replaying = true;
+        glutTimerFunc(0, replayTimer, 0);
+    }
+    if (scenePath != NULL && startSceneWatch(sceneWatch, scenePath))
+    {
+        std::cout << "Watching " << scenePath << " for changes" << std::endl;
+        glutTimerFunc(SCENE_POLL_MS, sceneWatchTimer, 0);
+    }
 
     // Register callback functions
     glutDisplayFunc(display);
     glutReshapeFunc(reshape);
     glutKeyboardFunc(keyboard);
     glutSpecialFunc(specialKeys);
+    glutMouseFunc(mouse);
+    glutMotionFunc(mouseMotion);
 
+    // No idle callback: frames are only drawn when markSceneDirty() posts a
+    // redisplay, so the event loop sleeps while the scene is static
     // Enter main event loop (never returns)
     glutMainLoop();
     return 0;
@@ -0,0 +1,228 @@
+/*
+ * Material Table and State Tracking - implementation
+ */
+
+#include "material.h"
+
+#include <algorithm>
+
+// Values of the former per-function material arrays in main.cpp
+static const Material DEFAULT_MATERIALS[MATERIAL_COUNT] = {
+    {{0.2f, 0.2f, 0.22f, 1.0f}, {0.9f, 0.9f, 0.95f, 1.0f}, 80.0f},    // Base
+    {{0.25f, 0.25f, 0.28f, 1.0f}, {0.95f, 0.95f, 1.0f, 1.0f}, 100.0f}, // Arm
+    {{0.22f, 0.22f, 0.25f, 1.0f}, {1.0f, 1.0f, 1.0f, 1.0f}, 120.0f},   // Joint
+    {{0.3f, 0.3f, 0.35f, 1.0f}, {0.8f, 0.8f, 0.85f, 1.0f}, 90.0f},     // Lampshade
+    {{0.4f, 0.4f, 0.4f, 1.0f}, {0.2f, 0.2f, 0.2f, 1.0f}, 10.0f},       // Table
+};
+
+// Current table; starts out as the defaults, slots change with setMaterial()
+static Material MATERIALS[MATERIAL_COUNT] = {
+    DEFAULT_MATERIALS[0], DEFAULT_MATERIALS[1], DEFAULT_MATERIALS[2], DEFAULT_MATERIALS[3], DEFAULT_MATERIALS[4],
+};
+
+// std140 layout of one MaterialParameters entry in the shaders
+struct MaterialBlockEntry
+{
+    GLfloat ambientDiffuse[4];
+    GLfloat specular[4];
+    GLfloat shininess;
+    GLfloat padding[3];
+};
+
+static GLuint materialBuffer = 0;
+static int activeMaterial = -1;   // Material in the fixed-function state
+static GLint indexLocation = -1;  // materialIndex of the bound program
+static bool fixedFunction = true; // False in a core profile: no glMaterial state
+static bool highlightActive = false;
+static GLint highlightLocation = -1; // highlightEmission of the bound program
+
+static const GLfloat NO_EMISSION[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+
+static void fillBlockEntry(const Material &material, MaterialBlockEntry &entry)
+{
+    for (int c = 0; c < 4; c++)
+    {
+        entry.ambientDiffuse[c] = material.ambientDiffuse[c];
+        entry.specular[c] = material.specular[c];
+    }
+    entry.shininess = material.shininess;
+    entry.padding[0] = entry.padding[1] = entry.padding[2] = 0.0f;
+}
+
+/**
+ * Upload every material to the uniform buffer read by the GLSL programs
+ */
+void createMaterials()
+{
+    activeMaterial = -1;
+    indexLocation = -1;
+    highlightActive = false;
+    highlightLocation = -1;
+    fixedFunction = !isCoreProfileContext();
+    if (!isGLVersionAtLeast(3, 1))
+    {
+        return;
+    }
+
+    MaterialBlockEntry entries[MATERIAL_COUNT];
+    for (int i = 0; i < MATERIAL_COUNT; i++)
+    {
+        fillBlockEntry(MATERIALS[i], entries[i]);
+    }
+
+    glGenBuffers(1, &materialBuffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, materialBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(entries), entries, GL_STATIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, MATERIAL_BLOCK_BINDING, materialBuffer);
+}
+
+bool hasMaterialBuffer()
+{
+    return materialBuffer != 0;
+}
+
+const Material &getMaterial(MaterialId id)
+{
+    return MATERIALS[id];
+}
+
+const Material &getDefaultMaterial(MaterialId id)
+{
+    return DEFAULT_MATERIALS[id];
+}
+
+bool materialsEqual(const Material &a, const Material &b)
+{
+    return std::equal(a.ambientDiffuse, a.ambientDiffuse + 4, b.ambientDiffuse) &&
+           std::equal(a.specular, a.specular + 4, b.specular) && a.shininess == b.shininess;
+}
+
+/**
+ * Replace one slot of the table
+ * Only that slot's entry of the uniform buffer is rewritten. If it is
+ * the active material, the next bindMaterial() loads it again; a bound
+ * program reads the new values from the buffer right away.
+ * @param id - Slot to replace
+ * @param material - New parameters
+ * @return false (and no GL calls) if the slot already holds them
+ */
+bool setMaterial(MaterialId id, const Material &material)
+{
+    Material &slot = MATERIALS[id];
+    if (materialsEqual(material, slot))
+    {
+        return false;
+    }
+    slot = material;
+
+    if (materialBuffer != 0)
+    {
+        MaterialBlockEntry entry;
+        fillBlockEntry(slot, entry);
+        glBindBuffer(GL_UNIFORM_BUFFER, materialBuffer);
+        glBufferSubData(GL_UNIFORM_BUFFER, id * sizeof(entry), sizeof(entry), &entry);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+    if (activeMaterial == id)
+    {
+        activeMaterial = -1;
+    }
+    return true;
+}
+
+/**
+ * Make a material current for both the fixed-function pipeline (unless
+ * the context is a core profile) and the bound material-aware program
+ * @param id - Material to bind; no GL calls if it is already active
+ */
+void bindMaterial(MaterialId id)
+{
+    if (activeMaterial == id)
+    {
+        return;
+    }
+    activeMaterial = id;
+
+    if (fixedFunction)
+    {
+        const Material &material = MATERIALS[id];
+        glMaterialfv(GL_FRONT, GL_AMBIENT_AND_DIFFUSE, material.ambientDiffuse);
+        glMaterialfv(GL_FRONT, GL_SPECULAR, material.specular);
+        glMaterialf(GL_FRONT, GL_SHININESS, material.shininess);
+    }
+    if (indexLocation >= 0)
+    {
+        glUniform1i(indexLocation, id);
+    }
+}
+
+/**
+ * Point the tracker at the bound program's materialIndex uniform
+ * @param location - Uniform location, or -1 if the program has none
+ */
+void setMaterialIndexUniform(GLint location)
+{
+    indexLocation = location;
+    if (indexLocation >= 0 && activeMaterial >= 0)
+    {
+        glUniform1i(indexLocation, activeMaterial);
+    }
+}
+
+/**
+ * Attach the material uniform buffer to a program
+ * @param program - Linked program, possibly built without the block
+ * @return true if the program reads materials from the buffer
+ */
+bool bindMaterialBlock(GLuint program)
+{
+    if (materialBuffer == 0)
+    {
+        return false;
+    }
+    GLuint blockIndex = glGetUniformBlockIndex(program, "MaterialBlock");
+    if (blockIndex == GL_INVALID_INDEX)
+    {
+        return false;
+    }
+    glUniformBlockBinding(program, blockIndex, MATERIAL_BLOCK_BINDING);
+    return true;
+}
+
+/**
+ * Switch the selection tint for both the fixed-function pipeline and the
+ * bound program
+ * @param highlighted - Add HIGHLIGHT_EMISSION to the following lit draws
+ */
+void setHighlighted(bool highlighted)
+{
+    if (highlightActive == highlighted)
+    {
+        return;
+    }
+    highlightActive = highlighted;
+
+    const GLfloat *emission = highlighted ? HIGHLIGHT_EMISSION : NO_EMISSION;
+    if (fixedFunction)
+    {
+        glMaterialfv(GL_FRONT, GL_EMISSION, emission);
+    }
+    if (highlightLocation >= 0)
+    {
+        glUniform4fv(highlightLocation, 1, emission);
+    }
+}
+
+/**
+ * Point the tracker at the bound program's highlightEmission uniform
+ * @param location - Uniform location, or -1 if the program has none
+ */
+void setHighlightUniform(GLint location)
+{
+    highlightLocation = location;
+    if (highlightLocation >= 0)
+    {
+        glUniform4fv(highlightLocation, 1, highlightActive ? HIGHLIGHT_EMISSION : NO_EMISSION);
+    }
+}
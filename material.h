@@ -0,0 +1,76 @@
+/*
+ * Material Table and State Tracking
+ *
+ * Every surface material in the scene is defined once here. Binding
+ * goes through bindMaterial(), which skips the glMaterial calls when the
+ * requested material is already active. For GLSL programs the table is
+ * also uploaded once into a uniform buffer, so switching materials
+ * there is a single integer uniform. A slot can be replaced at run time;
+ * only its entry of the buffer is uploaded again.
+ *
+ * The selected lamp part is marked by an emissive tint on top of its
+ * material, tracked the same way: GL_EMISSION for the fixed-function
+ * pipeline, a vec4 uniform for the programs. It is just another piece of
+ * per-draw state, so the highlight needs no extra geometry or passes.
+ */
+
+#ifndef MATERIAL_H
+#define MATERIAL_H
+
+#include "opengl.h"
+
+enum MaterialId
+{
+    MATERIAL_BASE = 0, // Dark metal with a high shine
+    MATERIAL_ARM,      // Metallic with a blue-gray tint
+    MATERIAL_JOINT,    // Chrome-like
+    MATERIAL_SHADE,    // Dark gray lampshade
+    MATERIAL_TABLE,    // Matte gray
+    MATERIAL_COUNT
+};
+
+struct Material
+{
+    GLfloat ambientDiffuse[4];
+    GLfloat specular[4];
+    GLfloat shininess;
+};
+
+// Uniform block binding point of the shaders' MaterialBlock
+const GLuint MATERIAL_BLOCK_BINDING = 0;
+
+// Upload the table into a uniform buffer (GL 3.1+) and reset tracking
+void createMaterials();
+bool hasMaterialBuffer();
+
+const Material &getMaterial(MaterialId id);
+const Material &getDefaultMaterial(MaterialId id);
+bool materialsEqual(const Material &a, const Material &b);
+
+// Change a material slot (e.g. from the scene file); true if it changed
+bool setMaterial(MaterialId id, const Material &material);
+
+// Make a material current unless it already is
+void bindMaterial(MaterialId id);
+
+// Location of the bound program's "materialIndex" uniform, or -1 when
+// no program reading the uniform buffer is bound. The active material
+// is written to the new location immediately.
+void setMaterialIndexUniform(GLint location);
+
+// Bind the material uniform buffer to a program's MaterialBlock;
+// returns false if the program has no such block
+bool bindMaterialBlock(GLuint program);
+
+// Emission added to the selected part (the yellow of the other markers)
+const GLfloat HIGHLIGHT_EMISSION[4] = {0.45f, 0.45f, 0.0f, 1.0f};
+
+// Tint the following lit draws as selected, or stop; no GL calls if
+// the state is unchanged
+void setHighlighted(bool highlighted);
+
+// Location of the bound program's "highlightEmission" uniform, or -1;
+// written immediately, like setMaterialIndexUniform()
+void setHighlightUniform(GLint location);
+
+#endif // MATERIAL_H
@@ -0,0 +1,227 @@
+/*
+ * 4x4 Matrix Math - implementation
+ */
+
+#include "matrix.h"
+
+#include <cmath>
+
+/**
+ * Identity matrix
+ */
+Mat4 mat4Identity()
+{
+    Mat4 result;
+    for (int i = 0; i < 16; i++)
+    {
+        result.m[i] = (i % 5 == 0) ? 1.0f : 0.0f;
+    }
+    return result;
+}
+
+/**
+ * Matrix product a * b (b is applied first, as with glMultMatrixf)
+ */
+Mat4 mat4Multiply(const Mat4 &a, const Mat4 &b)
+{
+    Mat4 result;
+    for (int column = 0; column < 4; column++)
+    {
+        for (int row = 0; row < 4; row++)
+        {
+            float sum = 0.0f;
+            for (int k = 0; k < 4; k++)
+            {
+                sum += a.m[k * 4 + row] * b.m[column * 4 + k];
+            }
+            result.m[column * 4 + row] = sum;
+        }
+    }
+    return result;
+}
+
+/**
+ * Post-multiply a translation, like glTranslatef()
+ */
+void mat4Translate(Mat4 &matrix, float x, float y, float z)
+{
+    for (int row = 0; row < 4; row++)
+    {
+        matrix.m[12 + row] += matrix.m[row] * x + matrix.m[4 + row] * y + matrix.m[8 + row] * z;
+    }
+}
+
+/**
+ * Post-multiply a rotation about an arbitrary axis, like glRotatef()
+ * @param angle - Rotation angle in degrees
+ * @param x, y, z - Rotation axis (normalized internally)
+ */
+void mat4Rotate(Mat4 &matrix, float angle, float x, float y, float z)
+{
+    float length = sqrtf(x * x + y * y + z * z);
+    if (length == 0.0f)
+    {
+        return;
+    }
+    x /= length;
+    y /= length;
+    z /= length;
+
+    float radians = angle * (float)M_PI / 180.0f;
+    float c = cosf(radians);
+    float s = sinf(radians);
+    float t = 1.0f - c;
+
+    Mat4 rotation = mat4Identity();
+    rotation.m[0] = x * x * t + c;
+    rotation.m[1] = y * x * t + z * s;
+    rotation.m[2] = x * z * t - y * s;
+    rotation.m[4] = x * y * t - z * s;
+    rotation.m[5] = y * y * t + c;
+    rotation.m[6] = y * z * t + x * s;
+    rotation.m[8] = x * z * t + y * s;
+    rotation.m[9] = y * z * t - x * s;
+    rotation.m[10] = z * z * t + c;
+
+    matrix = mat4Multiply(matrix, rotation);
+}
+
+/**
+ * Post-multiply a scale, like glScalef()
+ */
+void mat4Scale(Mat4 &matrix, float x, float y, float z)
+{
+    for (int row = 0; row < 4; row++)
+    {
+        matrix.m[row] *= x;
+        matrix.m[4 + row] *= y;
+        matrix.m[8 + row] *= z;
+    }
+}
+
+/**
+ * Viewing matrix looking from eye towards center, like gluLookAt()
+ */
+Mat4 mat4LookAt(const float eye[3], const float center[3], const float up[3])
+{
+    float f[3] = {center[0] - eye[0], center[1] - eye[1], center[2] - eye[2]};
+    float length = sqrtf(f[0] * f[0] + f[1] * f[1] + f[2] * f[2]);
+    f[0] /= length;
+    f[1] /= length;
+    f[2] /= length;
+
+    // s = f x up, u = s x f
+    float s[3] = {f[1] * up[2] - f[2] * up[1], f[2] * up[0] - f[0] * up[2], f[0] * up[1] - f[1] * up[0]};
+    length = sqrtf(s[0] * s[0] + s[1] * s[1] + s[2] * s[2]);
+    s[0] /= length;
+    s[1] /= length;
+    s[2] /= length;
+    float u[3] = {s[1] * f[2] - s[2] * f[1], s[2] * f[0] - s[0] * f[2], s[0] * f[1] - s[1] * f[0]};
+
+    Mat4 result = mat4Identity();
+    for (int i = 0; i < 3; i++)
+    {
+        result.m[i * 4 + 0] = s[i];
+        result.m[i * 4 + 1] = u[i];
+        result.m[i * 4 + 2] = -f[i];
+    }
+    mat4Translate(result, -eye[0], -eye[1], -eye[2]);
+    return result;
+}
+
+/**
+ * Perspective projection, like gluPerspective()
+ * @param fovy - Vertical field of view in degrees
+ */
+Mat4 mat4Perspective(float fovy, float aspect, float zNear, float zFar)
+{
+    float f = 1.0f / tanf(fovy * (float)M_PI / 360.0f);
+    Mat4 result;
+    for (int i = 0; i < 16; i++)
+    {
+        result.m[i] = 0.0f;
+    }
+    result.m[0] = f / aspect;
+    result.m[5] = f;
+    result.m[10] = (zFar + zNear) / (zNear - zFar);
+    result.m[11] = -1.0f;
+    result.m[14] = 2.0f * zFar * zNear / (zNear - zFar);
+    return result;
+}
+
+/**
+ * Parallel projection of a box, like glOrtho()
+ */
+Mat4 mat4Orthographic(float left, float right, float bottom, float top, float zNear, float zFar)
+{
+    Mat4 result = mat4Identity();
+    result.m[0] = 2.0f / (right - left);
+    result.m[5] = 2.0f / (top - bottom);
+    result.m[10] = -2.0f / (zFar - zNear);
+    result.m[12] = -(right + left) / (right - left);
+    result.m[13] = -(top + bottom) / (top - bottom);
+    result.m[14] = -(zFar + zNear) / (zFar - zNear);
+    return result;
+}
+
+/**
+ * Inverse of a rigid transform: transpose the rotation, rotate back the
+ * negated translation
+ */
+Mat4 mat4InverseRigid(const Mat4 &matrix)
+{
+    Mat4 result = mat4Identity();
+    for (int row = 0; row < 3; row++)
+    {
+        for (int column = 0; column < 3; column++)
+        {
+            result.m[column * 4 + row] = matrix.m[row * 4 + column];
+        }
+    }
+    for (int row = 0; row < 3; row++)
+    {
+        result.m[12 + row] = -(result.m[row] * matrix.m[12] + result.m[4 + row] * matrix.m[13] +
+                               result.m[8 + row] * matrix.m[14]);
+    }
+    return result;
+}
+
+/**
+ * Inverse of a symmetric perspective projection, in closed form: only the
+ * scale terms, the depth mapping (m[10], m[14]) and the w = -z row are set
+ */
+Mat4 mat4InversePerspective(const Mat4 &matrix)
+{
+    Mat4 result = mat4Identity();
+    result.m[0] = 1.0f / matrix.m[0];
+    result.m[5] = 1.0f / matrix.m[5];
+    result.m[10] = 0.0f;
+    result.m[11] = 1.0f / matrix.m[14];
+    result.m[14] = -1.0f;
+    result.m[15] = matrix.m[10] / matrix.m[14];
+    return result;
+}
+
+/**
+ * Transform a point (implicit w = 1); in and out may alias
+ */
+void mat4TransformPoint(const Mat4 &matrix, const float in[3], float out[3])
+{
+    float x = in[0], y = in[1], z = in[2];
+    for (int row = 0; row < 3; row++)
+    {
+        out[row] = matrix.m[row] * x + matrix.m[4 + row] * y + matrix.m[8 + row] * z + matrix.m[12 + row];
+    }
+}
+
+/**
+ * Transform a direction (implicit w = 0, translation ignored); in and out may alias
+ */
+void mat4TransformDirection(const Mat4 &matrix, const float in[3], float out[3])
+{
+    float x = in[0], y = in[1], z = in[2];
+    for (int row = 0; row < 3; row++)
+    {
+        out[row] = matrix.m[row] * x + matrix.m[4 + row] * y + matrix.m[8 + row] * z;
+    }
+}
@@ -0,0 +1,43 @@
+/*
+ * 4x4 Matrix Math
+ *
+ * Minimal CPU-side replacement for the fixed-function matrix stack.
+ * Matrices are column-major like OpenGL, so they can be passed straight
+ * to glLoadMatrixf()/glMultMatrixf(), and the transform helpers
+ * post-multiply exactly like glTranslatef()/glRotatef()/glScalef().
+ */
+
+#ifndef MATRIX_H
+#define MATRIX_H
+
+struct Mat4
+{
+    float m[16]; // Column-major: m[12..14] holds the translation
+};
+
+Mat4 mat4Identity();
+Mat4 mat4Multiply(const Mat4 &a, const Mat4 &b);
+
+// In-place equivalents of glTranslatef() / glRotatef() (angle in degrees) / glScalef()
+void mat4Translate(Mat4 &matrix, float x, float y, float z);
+void mat4Rotate(Mat4 &matrix, float angle, float x, float y, float z);
+void mat4Scale(Mat4 &matrix, float x, float y, float z);
+
+// Equivalents of gluLookAt() and gluPerspective() (fovy in degrees)
+Mat4 mat4LookAt(const float eye[3], const float center[3], const float up[3]);
+Mat4 mat4Perspective(float fovy, float aspect, float zNear, float zFar);
+
+// Equivalent of glOrtho()
+Mat4 mat4Orthographic(float left, float right, float bottom, float top, float zNear, float zFar);
+
+// Inverse of a rotation + translation matrix (no scale)
+Mat4 mat4InverseRigid(const Mat4 &matrix);
+
+// Inverse of a mat4Perspective() matrix
+Mat4 mat4InversePerspective(const Mat4 &matrix);
+
+// Apply the matrix to a point (w = 1) or a direction (w = 0)
+void mat4TransformPoint(const Mat4 &matrix, const float in[3], float out[3]);
+void mat4TransformDirection(const Mat4 &matrix, const float in[3], float out[3]);
+
+#endif // MATRIX_H
@@ -0,0 +1,440 @@
+/*
+ * Static Mesh Cache - implementation
+ *
+ * Vertex layouts follow the GLU quadric conventions (sin for X, cos for Y,
+ * primitives built along +Z) so cached meshes are drop-in replacements.
+ * The quadrics are defined element by element in tessellation.h; the
+ * functions here evaluate those definitions at run time.
+ */
+
+#include "mesh.h"
+
+#include "stats.h"
+#include "tessellation.h"
+
+#include <cmath>
+#include <vector>
+
+// Stride of one interleaved vertex: position (3 floats) + normal (3 floats)
+static const GLsizei VERTEX_STRIDE = 6 * sizeof(GLfloat);
+
+/**
+ * Append one interleaved vertex to the vertex array
+ */
+static void addVertex(std::vector<GLfloat> &vertices,
+                      float px, float py, float pz,
+                      float nx, float ny, float nz)
+{
+    vertices.push_back(px);
+    vertices.push_back(py);
+    vertices.push_back(pz);
+    vertices.push_back(nx);
+    vertices.push_back(ny);
+    vertices.push_back(nz);
+}
+
+/**
+ * Copy tessellated geometry into buffer objects
+ * @param data - Primitive type, interleaved position/normal data and
+ *               optional index list
+ */
+static Mesh uploadMesh(const MeshData &data)
+{
+    Mesh mesh;
+    mesh.mode = data.mode;
+    mesh.indexBuffer = 0;
+    mesh.vertexArray = 0;
+
+    glGenBuffers(1, &mesh.vertexBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, data.vertexFloats * sizeof(GLfloat), data.vertices, GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    if (data.indices == NULL)
+    {
+        mesh.count = (GLsizei)(data.vertexFloats * sizeof(GLfloat) / VERTEX_STRIDE);
+    }
+    else
+    {
+        glGenBuffers(1, &mesh.indexBuffer);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.indexBuffer);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, data.indexCount * sizeof(GLuint), data.indices, GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        mesh.count = (GLsizei)data.indexCount;
+    }
+
+    if (isCoreProfileContext())
+    {
+        glGenVertexArrays(1, &mesh.vertexArray);
+        glBindVertexArray(mesh.vertexArray);
+        glBindBuffer(GL_ARRAY_BUFFER, mesh.vertexBuffer);
+        glEnableVertexAttribArray(MESH_POSITION_ATTRIBUTE);
+        glEnableVertexAttribArray(MESH_NORMAL_ATTRIBUTE);
+        glVertexAttribPointer(MESH_POSITION_ATTRIBUTE, 3, GL_FLOAT, GL_FALSE, VERTEX_STRIDE, (const GLvoid *)0);
+        glVertexAttribPointer(MESH_NORMAL_ATTRIBUTE, 3, GL_FLOAT, GL_FALSE, VERTEX_STRIDE,
+                              (const GLvoid *)(3 * sizeof(GLfloat)));
+        if (mesh.indexBuffer != 0)
+        {
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.indexBuffer); // Recorded in the vertex array
+        }
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    return mesh;
+}
+
+static Mesh uploadMesh(GLenum mode, const std::vector<GLfloat> &vertices, const std::vector<GLuint> &indices)
+{
+    MeshData data = {mode, &vertices[0], (int)vertices.size(), indices.empty() ? NULL : &indices[0],
+                     (int)indices.size(), 0};
+    return uploadMesh(data);
+}
+
+/**
+ * Build a (possibly tapered) cylinder along +Z as a single triangle strip
+ * @param baseRadius - Radius at z = 0
+ * @param topRadius - Radius at z = height
+ * @param height - Cylinder height
+ * @param slices - Number of subdivisions around the Z-axis
+ */
+Mesh createCylinderMesh(float baseRadius, float topRadius, float height, int slices)
+{
+    std::vector<GLfloat> vertices(cylinderFloats(slices));
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        vertices[i] = cylinderFloat(baseRadius, topRadius, height, slices, (int)i);
+    }
+    return uploadMesh(GL_TRIANGLE_STRIP, vertices, std::vector<GLuint>());
+}
+
+/**
+ * Build a filled disk in the XY-plane facing +Z as a triangle fan
+ * @param radius - Disk radius
+ * @param slices - Number of subdivisions around the Z-axis
+ */
+Mesh createDiskMesh(float radius, int slices)
+{
+    std::vector<GLfloat> vertices(diskFloats(slices));
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        vertices[i] = diskFloat(radius, slices, (int)i);
+    }
+    return uploadMesh(GL_TRIANGLE_FAN, vertices, std::vector<GLuint>());
+}
+
+/**
+ * Build a sphere centered at the origin as an indexed triangle list
+ * @param radius - Sphere radius
+ * @param slices - Number of subdivisions around the Z-axis
+ * @param stacks - Number of subdivisions along the Z-axis
+ */
+Mesh createSphereMesh(float radius, int slices, int stacks)
+{
+    std::vector<GLfloat> vertices(sphereFloats(slices, stacks));
+    std::vector<GLuint> indices(sphereIndexCount(slices, stacks));
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        vertices[i] = sphereFloat(radius, slices, stacks, (int)i);
+    }
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        indices[i] = sphereIndex(slices, (int)i);
+    }
+    return uploadMesh(GL_TRIANGLES, vertices, indices);
+}
+
+/**
+ * Build a subdivided square in the XZ-plane as one indexed triangle strip
+ * Rows are stitched together with degenerate triangles so the whole grid
+ * is drawn with a single call regardless of resolution.
+ * @param size - Edge length of the square
+ * @param divisions - Number of cells along each edge
+ */
+Mesh createGridMesh(float size, int divisions)
+{
+    std::vector<GLfloat> vertices;
+    std::vector<GLuint> indices;
+    vertices.reserve((divisions + 1) * (divisions + 1) * 6);
+    indices.reserve(divisions * (2 * (divisions + 1) + 2));
+
+    float start = -0.5f * size;
+    float step = size / (float)divisions;
+
+    for (int i = 0; i <= divisions; i++)
+    {
+        for (int j = 0; j <= divisions; j++)
+        {
+            addVertex(vertices, start + i * step, 0.0f, start + j * step, 0.0f, 1.0f, 0.0f);
+        }
+    }
+
+    for (int i = 0; i < divisions; i++)
+    {
+        GLuint column = i * (divisions + 1);
+        GLuint nextColumn = column + divisions + 1;
+
+        // Repeat the first vertex of this strip to join it to the previous one
+        if (i > 0)
+        {
+            indices.push_back(nextColumn);
+        }
+
+        // Next column first, so the triangles wind counterclockwise seen
+        // from above like the quads they replace
+        for (int j = 0; j <= divisions; j++)
+        {
+            indices.push_back(nextColumn + j);
+            indices.push_back(column + j);
+        }
+
+        // Repeat the last vertex so the next strip starts with degenerates
+        if (i < divisions - 1)
+        {
+            indices.push_back(column + divisions);
+        }
+    }
+
+    return uploadMesh(GL_TRIANGLE_STRIP, vertices, indices);
+}
+
+/**
+ * Bind a mesh's vertex and index buffers as the conventional vertex and
+ * normal arrays, or its vertex array object in a core profile
+ */
+static void bindMesh(const Mesh &mesh)
+{
+    if (mesh.vertexArray != 0)
+    {
+        glBindVertexArray(mesh.vertexArray);
+        return;
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.vertexBuffer);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_NORMAL_ARRAY);
+    glVertexPointer(3, GL_FLOAT, VERTEX_STRIDE, (const GLvoid *)0);
+    glNormalPointer(GL_FLOAT, VERTEX_STRIDE, (const GLvoid *)(3 * sizeof(GLfloat)));
+    if (mesh.indexBuffer != 0)
+    {
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.indexBuffer);
+    }
+}
+
+/**
+ * Undo bindMesh() so client-side vertex arrays used elsewhere (e.g. GLUT
+ * wire shapes) keep working
+ */
+static void unbindMesh(const Mesh &mesh)
+{
+    if (mesh.vertexArray != 0)
+    {
+        glBindVertexArray(0);
+        return;
+    }
+    glDisableClientState(GL_NORMAL_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/**
+ * Draw a cached mesh with the current modelview matrix and material
+ */
+void drawMesh(const Mesh &mesh)
+{
+    bindMesh(mesh);
+    if (mesh.indexBuffer != 0)
+    {
+        glDrawElements(mesh.mode, mesh.count, GL_UNSIGNED_INT, (const GLvoid *)0);
+    }
+    else
+    {
+        glDrawArrays(mesh.mode, 0, mesh.count);
+    }
+    unbindMesh(mesh);
+    countDrawCalls(1);
+}
+
+/**
+ * Draw several copies of a mesh in one call (GL 3.1+)
+ * Per-instance data must already be bound as instanced vertex attributes
+ * by the caller.
+ * @param mesh - Mesh to draw
+ * @param instanceCount - Number of copies
+ */
+void drawMeshInstanced(const Mesh &mesh, GLsizei instanceCount)
+{
+    bindMesh(mesh);
+    if (mesh.indexBuffer != 0)
+    {
+        glDrawElementsInstanced(mesh.mode, mesh.count, GL_UNSIGNED_INT, (const GLvoid *)0, instanceCount);
+    }
+    else
+    {
+        glDrawArraysInstanced(mesh.mode, 0, mesh.count, instanceCount);
+    }
+    unbindMesh(mesh);
+    countDrawCalls(1);
+}
+
+/**
+ * Release the buffer objects owned by a mesh
+ */
+void deleteMesh(Mesh &mesh)
+{
+    glDeleteBuffers(1, &mesh.vertexBuffer);
+    if (mesh.indexBuffer != 0)
+    {
+        glDeleteBuffers(1, &mesh.indexBuffer);
+    }
+    if (mesh.vertexArray != 0)
+    {
+        glDeleteVertexArrays(1, &mesh.vertexArray);
+    }
+    mesh.vertexBuffer = 0;
+    mesh.indexBuffer = 0;
+    mesh.vertexArray = 0;
+    mesh.count = 0;
+}
+
+// Bounds of a cylinder along +Z
+static void setCylinderBounds(LodMesh &mesh, float baseRadius, float topRadius, float height)
+{
+    mesh.radius = fmaxf(baseRadius, topRadius);
+    mesh.center[0] = 0.0f;
+    mesh.center[1] = 0.0f;
+    mesh.center[2] = 0.5f * height;
+    mesh.boundingRadius = sqrtf(mesh.radius * mesh.radius + 0.25f * height * height);
+}
+
+// Bounds of a disk or sphere centered at the origin
+static void setRoundBounds(LodMesh &mesh, float radius)
+{
+    mesh.radius = radius;
+    mesh.center[0] = mesh.center[1] = mesh.center[2] = 0.0f;
+    mesh.boundingRadius = radius;
+}
+
+static void uploadLevels(LodMesh &mesh, const MeshData levels[LOD_COUNT])
+{
+    for (int level = 0; level < LOD_COUNT; level++)
+    {
+        mesh.slices[level] = levels[level].slices;
+        mesh.levels[level] = uploadMesh(levels[level]);
+    }
+}
+
+/**
+ * Tessellate a cylinder at every detail level
+ * @param slices - Slices of level 0; coarser levels halve it
+ */
+LodMesh createCylinderLod(float baseRadius, float topRadius, float height, int slices)
+{
+    LodMesh mesh;
+    for (int level = 0; level < LOD_COUNT; level++)
+    {
+        mesh.slices[level] = lodSlices(slices, level);
+        mesh.levels[level] = createCylinderMesh(baseRadius, topRadius, height, mesh.slices[level]);
+    }
+    setCylinderBounds(mesh, baseRadius, topRadius, height);
+    return mesh;
+}
+
+LodMesh createDiskLod(float radius, int slices)
+{
+    LodMesh mesh;
+    for (int level = 0; level < LOD_COUNT; level++)
+    {
+        mesh.slices[level] = lodSlices(slices, level);
+        mesh.levels[level] = createDiskMesh(radius, mesh.slices[level]);
+    }
+    setRoundBounds(mesh, radius);
+    return mesh;
+}
+
+/**
+ * Tessellate a sphere at every detail level
+ * @param slices - Slices of level 0
+ * @param stacks - Stacks of level 0; reduced along with the slices
+ */
+LodMesh createSphereLod(float radius, int slices, int stacks)
+{
+    LodMesh mesh;
+    for (int level = 0; level < LOD_COUNT; level++)
+    {
+        mesh.slices[level] = lodSlices(slices, level);
+        mesh.levels[level] = createSphereMesh(radius, mesh.slices[level], lodSlices(stacks, level));
+    }
+    setRoundBounds(mesh, radius);
+    return mesh;
+}
+
+/**
+ * Upload a cylinder's detail levels as they are
+ * @param levels - Vertex data of each level, finest first
+ */
+LodMesh createCylinderLod(const MeshData levels[LOD_COUNT], float baseRadius, float topRadius, float height)
+{
+    LodMesh mesh;
+    uploadLevels(mesh, levels);
+    setCylinderBounds(mesh, baseRadius, topRadius, height);
+    return mesh;
+}
+
+LodMesh createDiskLod(const MeshData levels[LOD_COUNT], float radius)
+{
+    LodMesh mesh;
+    uploadLevels(mesh, levels);
+    setRoundBounds(mesh, radius);
+    return mesh;
+}
+
+LodMesh createSphereLod(const MeshData levels[LOD_COUNT], float radius)
+{
+    LodMesh mesh;
+    uploadLevels(mesh, levels);
+    setRoundBounds(mesh, radius);
+    return mesh;
+}
+
+void deleteLodMesh(LodMesh &mesh)
+{
+    for (int level = 0; level < LOD_COUNT; level++)
+    {
+        deleteMesh(mesh.levels[level]);
+    }
+}
+
+/**
+ * Pick a detail level from the projected size of the round cross-section
+ * A polygon with n slices deviates from its circle by r (1 - cos(pi / n)),
+ * so the error is measured in pixels at the part's nearest distance.
+ * @param mesh - LOD chain to choose from
+ * @param model - Mesh-to-world matrix of this draw
+ * @param view - Camera position and projection scale
+ * @return Level index, 0 = finest
+ */
+int selectLod(const LodMesh &mesh, const Mat4 &model, const LodView &view)
+{
+    float center[3];
+    mat4TransformPoint(model, mesh.center, center);
+    float scale = sqrtf(model.m[0] * model.m[0] + model.m[1] * model.m[1] + model.m[2] * model.m[2]);
+
+    float dx = center[0] - view.eye[0];
+    float dy = center[1] - view.eye[1];
+    float dz = center[2] - view.eye[2];
+    float distance = sqrtf(dx * dx + dy * dy + dz * dz) - mesh.boundingRadius * scale;
+    if (distance <= 0.0f)
+    {
+        return 0; // Camera inside the bounds
+    }
+
+    float radiusPixels = mesh.radius * scale * view.pixelsPerUnit / distance;
+    int level = 0;
+    while (level + 1 < LOD_COUNT &&
+           radiusPixels * (1.0f - cosf((float)M_PI / (float)mesh.slices[level + 1])) <= LOD_MAX_ERROR_PIXELS)
+    {
+        level++;
+    }
+    return level;
+}
@@ -0,0 +1,129 @@
+/*
+ * Static Mesh Cache
+ *
+ * Tessellates the quadric primitives used by the lamp (cylinders, cones,
+ * disks and spheres) once and keeps the result in GPU buffer objects.
+ * The geometry matches what the GLU quadric functions produce, so the
+ * drawing code can swap gluCylinder()/gluSphere()/gluDisk() calls for a
+ * single drawMesh() without changing the lamp's appearance.
+ *
+ * Each lamp primitive also comes as a short LOD chain; selectLod() picks
+ * the coarsest level that still looks round at the part's screen size.
+ * Chains can also be built from prepared vertex data, such as the
+ * compile-time tables of tessellation.h, which skips tessellation.
+ *
+ * Meshes created in a core-profile context also get a vertex array
+ * object that feeds the generic attributes below, since the conventional
+ * vertex and normal arrays do not exist there; drawMesh() uses it.
+ */
+
+#ifndef MESH_H
+#define MESH_H
+
+#include "opengl.h"
+#include "matrix.h"
+
+// Generic attribute locations of a mesh's vertex array object
+const GLuint MESH_POSITION_ATTRIBUTE = 0;
+const GLuint MESH_NORMAL_ATTRIBUTE = 1;
+
+// A tessellated primitive stored in buffer objects
+struct Mesh
+{
+    GLuint vertexBuffer; // Interleaved position (xyz) + normal (xyz)
+    GLuint indexBuffer;  // 0 when the mesh is drawn without indices
+    GLuint vertexArray;  // Generic attributes for core profiles, else 0
+    GLenum mode;         // Primitive type (GL_TRIANGLES, GL_TRIANGLE_STRIP, ...)
+    GLsizei count;       // Number of indices, or vertices if not indexed
+};
+
+// Equivalent of gluCylinder(quad, baseRadius, topRadius, height, slices, 1)
+Mesh createCylinderMesh(float baseRadius, float topRadius, float height, int slices);
+
+// Equivalent of gluDisk(quad, 0.0f, radius, slices, 1)
+Mesh createDiskMesh(float radius, int slices);
+
+// Equivalent of gluSphere(quad, radius, slices, stacks)
+Mesh createSphereMesh(float radius, int slices, int stacks);
+
+// Square grid in the XZ-plane facing +Y, centered at the origin
+Mesh createGridMesh(float size, int divisions);
+
+void drawMesh(const Mesh &mesh);
+void drawMeshInstanced(const Mesh &mesh, GLsizei instanceCount);
+void deleteMesh(Mesh &mesh);
+
+// Detail levels per primitive; level 0 is the full tessellation and each
+// further level halves the slice (and stack) count
+const int LOD_COUNT = 3;
+
+// Fewest slices a level may have; below this a disk stops looking round
+const int LOD_MIN_SLICES = 6;
+
+// Slices (or stacks) of a detail level
+constexpr int lodSlices(int slices, int level)
+{
+    return (slices >> level) < LOD_MIN_SLICES ? LOD_MIN_SLICES : slices >> level;
+}
+
+// Largest silhouette error (pixels) a coarser level may introduce
+const float LOD_MAX_ERROR_PIXELS = 0.5f;
+
+// One primitive tessellated at every detail level
+struct LodMesh
+{
+    Mesh levels[LOD_COUNT];
+    int slices[LOD_COUNT]; // Slices of each level
+    float radius;          // Largest radius of the round cross-section
+    float center[3];       // Bounding sphere in mesh coordinates
+    float boundingRadius;
+};
+
+// Camera inputs for LOD selection
+struct LodView
+{
+    float eye[3];        // Camera position (world space)
+    float pixelsPerUnit; // Viewport height / (2 tan(fovy / 2))
+};
+
+// LOD chains of the quadric primitives; slices (and stacks) are level 0
+LodMesh createCylinderLod(float baseRadius, float topRadius, float height, int slices);
+LodMesh createDiskLod(float radius, int slices);
+LodMesh createSphereLod(float radius, int slices, int stacks);
+
+// Vertex data of one detail level, tessellated beforehand
+struct MeshData
+{
+    GLenum mode;
+    const GLfloat *vertices; // Interleaved position (xyz) + normal (xyz)
+    int vertexFloats;
+    const GLuint *indices; // NULL when drawn without indices
+    int indexCount;
+    int slices;
+};
+
+// The same chains uploaded from prepared levels (finest first) in the
+// layout of the functions above
+LodMesh createCylinderLod(const MeshData levels[LOD_COUNT], float baseRadius, float topRadius, float height);
+LodMesh createDiskLod(const MeshData levels[LOD_COUNT], float radius);
+LodMesh createSphereLod(const MeshData levels[LOD_COUNT], float radius);
+void deleteLodMesh(LodMesh &mesh);
+
+// Coarsest level whose silhouette stays within LOD_MAX_ERROR_PIXELS
+// when drawn with the given model-to-world matrix (uniform scale only)
+int selectLod(const LodMesh &mesh, const Mat4 &model, const LodView &view);
+
+// Every primitive the lamp is built from
+struct LampMeshes
+{
+    LodMesh baseSide;  // Cylinder wall of the base
+    LodMesh baseCap;   // Disk closing the top of the base
+    LodMesh lowerArm;  // Lower arm cylinder
+    LodMesh upperArm;  // Upper arm cylinder
+    LodMesh joint;     // Sphere shared by all three joints
+    LodMesh shadeCone; // Tapered lampshade wall
+    LodMesh shadeCap;  // Disk closing the narrow end of the shade
+    LodMesh shadeGlow; // Unlit disk at the shade opening
+};
+
+#endif // MESH_H
@@ -0,0 +1,42 @@
+/*
+ * Common OpenGL include
+ *
+ * Every translation unit includes GL through this header so that the
+ * buffer object and shader entry points (GL 1.5+) are declared consistently.
+ */
+
+#ifndef OPENGL_H
+#define OPENGL_H
+
+#define GL_GLEXT_PROTOTYPES
+#include <GL/glut.h>
+#include <GL/glext.h>
+
+#include <cstdio>
+
+// True if the current context reports at least the given GL version
+inline bool isGLVersionAtLeast(int major, int minor)
+{
+    const char *version = (const char *)glGetString(GL_VERSION);
+    int contextMajor = 0;
+    int contextMinor = 0;
+    if (version == NULL || sscanf(version, "%d.%d", &contextMajor, &contextMinor) != 2)
+    {
+        return false;
+    }
+    return contextMajor > major || (contextMajor == major && contextMinor >= minor);
+}
+
+// True if the current context is a core profile (no fixed-function state)
+inline bool isCoreProfileContext()
+{
+    if (!isGLVersionAtLeast(3, 2))
+    {
+        return false;
+    }
+    GLint profileMask = 0;
+    glGetIntegerv(GL_CONTEXT_PROFILE_MASK, &profileMask);
+    return (profileMask & GL_CONTEXT_CORE_PROFILE_BIT) != 0;
+}
+
+#endif // OPENGL_H
@@ -0,0 +1,221 @@
+/*
+ * Hop Physics - implementation
+ *
+ * State is the base position and the center-of-mass velocity. The joint
+ * servos move the center of mass relative to the base; whatever of that
+ * motion the table does not resist moves the base instead, so the base
+ * velocity is always the center-of-mass velocity minus the arm's share.
+ * Contact impulses act on the whole lamp, which makes the total mass
+ * drop out: only the mass ratios below matter.
+ */
+
+#include "physics.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Share of the lamp's mass in each part (sums to 1)
+static const float BASE_MASS = 0.45f;
+static const float LOWER_ARM_MASS = 0.15f;
+static const float UPPER_ARM_MASS = 0.12f;
+static const float LAMPSHADE_MASS = 0.28f;
+
+static const float GRAVITY = 45.0f;         // Scene units per second squared
+static const float FRICTION = 0.8f;         // Coulomb coefficient of base on table
+static const float SERVO_FREQUENCY = 9.0f;  // Servo natural frequency (Hz)
+static const float SERVO_DAMPING = 1.0f;    // Damping ratio (1 = critical)
+
+// Longest stretch of wall-clock time simulated in one update (as in playback)
+static const float MAX_CATCH_UP = 0.25f;
+
+// Below these a standing lamp is considered settled
+static const float REST_ANGLE = 1e-3f; // Servo error (degrees)
+static const float REST_RATE = 1e-2f;  // Joint speed (degrees/s)
+static const float REST_SPEED = 1e-4f; // Base sliding speed (units/s)
+
+static float degreesToRadians(float degrees)
+{
+    return degrees * (float)M_PI / 180.0f;
+}
+
+/**
+ * Center of mass of the lamp relative to its base, in world axes
+ * The pitch joints all turn about the base's X-axis, so the parts lie in
+ * the base's (z, y) plane: a link at angle t from +Y points along
+ * (sin t, cos t), as in solveLookAt().
+ */
+static void centerOfMass(const LampJoints &joints, float offset[3])
+{
+    float a1 = degreesToRadians(joints.lowerArmAngle);
+    float a2 = a1 + degreesToRadians(joints.upperArmAngle);
+    float a3 = a2 + degreesToRadians(joints.lampshadeAngle);
+
+    const LampDimensions &d = lampDimensions;
+    float elbowZ = d.lowerArmLength * sinf(a1);
+    float elbowY = d.baseHeight + d.lowerArmLength * cosf(a1);
+    float wristZ = elbowZ + d.upperArmLength * sinf(a2);
+    float wristY = elbowY + d.upperArmLength * cosf(a2);
+
+    // Distance from the shade joint to the lampshade's center of mass
+    float shadeCenter = lampJointRadius(d) + d.lampshadeHeight * 0.5f;
+
+    float z = LOWER_ARM_MASS * 0.5f * elbowZ + UPPER_ARM_MASS * 0.5f * (elbowZ + wristZ) +
+              LAMPSHADE_MASS * (wristZ + shadeCenter * sinf(a3));
+    float y = BASE_MASS * 0.5f * d.baseHeight + LOWER_ARM_MASS * 0.5f * (d.baseHeight + elbowY) +
+              UPPER_ARM_MASS * 0.5f * (elbowY + wristY) + LAMPSHADE_MASS * (wristY + shadeCenter * cosf(a3));
+
+    float heading = degreesToRadians(joints.baseRotation);
+    offset[0] = z * sinf(heading);
+    offset[1] = y;
+    offset[2] = z * cosf(heading);
+}
+
+/**
+ * Semi-implicit PD servo: velocity first, then the angle with the new
+ * velocity; a joint driven into its limit stops there
+ */
+static void stepServo(float &angle, float &rate, float target, float low, float high)
+{
+    const float omega = 2.0f * (float)M_PI * SERVO_FREQUENCY;
+    float acceleration = omega * omega * (target - angle) - 2.0f * SERVO_DAMPING * omega * rate;
+    rate += acceleration * PHYSICS_TIMESTEP;
+    angle += rate * PHYSICS_TIMESTEP;
+    if (angle < low || angle > high)
+    {
+        angle = std::max(low, std::min(angle, high));
+        rate = 0.0f;
+    }
+}
+
+static bool servoSettled(float angle, float rate, float target)
+{
+    return fabsf(target - angle) < REST_ANGLE && fabsf(rate) < REST_RATE;
+}
+
+void resetLampBody(LampBody &body, const LampJoints &joints, float x, float z, float tableHalfSize)
+{
+    LampJoints zero = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+    body.joints = joints;
+    body.jointVelocities = zero;
+    body.position[0] = x;
+    body.position[1] = 0.0f;
+    body.position[2] = z;
+    body.comVelocity[0] = body.comVelocity[1] = body.comVelocity[2] = 0.0f;
+    centerOfMass(joints, body.comOffset);
+    body.tableHalfSize = tableHalfSize;
+    body.accumulator = 0.0f;
+    body.grounded = true;
+    body.landings = 0;
+}
+
+int takePhysicsSubsteps(LampBody &body, float elapsedSeconds)
+{
+    body.accumulator += std::min(elapsedSeconds, MAX_CATCH_UP);
+    int substeps = (int)(body.accumulator / PHYSICS_TIMESTEP);
+    body.accumulator -= substeps * PHYSICS_TIMESTEP;
+    return substeps;
+}
+
+/**
+ * One substep: servos, gravity, table contact, then the base moves
+ * The contact is speculative: if the base would end the step below the
+ * table, an impulse brings it exactly onto the surface (no bounce), and
+ * friction removes up to FRICTION times that impulse of sliding. The
+ * base leaves the table by itself once the arm decelerates faster than
+ * gravity, because the table cannot pull.
+ * @param body - Lamp to advance
+ * @param target - Pose the servos aim for
+ */
+void stepLampBody(LampBody &body, const LampJoints &target)
+{
+    const float dt = PHYSICS_TIMESTEP;
+    const float noLimit = 1e30f;
+    LampJoints &joints = body.joints;
+    LampJoints &rates = body.jointVelocities;
+    stepServo(joints.baseRotation, rates.baseRotation, target.baseRotation, -noLimit, noLimit);
+    stepServo(joints.lowerArmAngle, rates.lowerArmAngle, target.lowerArmAngle, LOWER_ARM_MIN, LOWER_ARM_MAX);
+    stepServo(joints.upperArmAngle, rates.upperArmAngle, target.upperArmAngle, UPPER_ARM_MIN, UPPER_ARM_MAX);
+    stepServo(joints.lampshadeAngle, rates.lampshadeAngle, target.lampshadeAngle, LAMPSHADE_MIN, LAMPSHADE_MAX);
+    stepServo(joints.lampshadeRotation, rates.lampshadeRotation, target.lampshadeRotation, -noLimit, noLimit);
+
+    // Base velocity: the center of mass moves freely, the arm's part of
+    // that motion is taken off (a finite difference, so the center of
+    // mass stays exactly on its integrated path)
+    float offset[3];
+    centerOfMass(joints, offset);
+    body.comVelocity[1] -= GRAVITY * dt;
+    float armVelocity[3];
+    float baseVelocity[3];
+    for (int i = 0; i < 3; i++)
+    {
+        armVelocity[i] = (offset[i] - body.comOffset[i]) / dt;
+        baseVelocity[i] = body.comVelocity[i] - armVelocity[i];
+        body.comOffset[i] = offset[i];
+    }
+
+    float height = body.position[1] + baseVelocity[1] * dt;
+    bool wasGrounded = body.grounded;
+    bool overTable = fabsf(body.position[0]) <= body.tableHalfSize && fabsf(body.position[2]) <= body.tableHalfSize;
+    body.grounded = overTable && height < 0.0f;
+    if (body.grounded)
+    {
+        float normal = -height / dt; // Velocity change that lands on the surface
+        baseVelocity[1] += normal;
+
+        float sliding = sqrtf(baseVelocity[0] * baseVelocity[0] + baseVelocity[2] * baseVelocity[2]);
+        if (sliding > 0.0f)
+        {
+            float friction = std::min(sliding, FRICTION * normal) / sliding;
+            baseVelocity[0] -= baseVelocity[0] * friction;
+            baseVelocity[2] -= baseVelocity[2] * friction;
+        }
+
+        // The impulse acts on the whole lamp
+        for (int i = 0; i < 3; i++)
+        {
+            body.comVelocity[i] = baseVelocity[i] + armVelocity[i];
+        }
+        if (!wasGrounded)
+        {
+            body.landings++;
+        }
+    }
+
+    for (int i = 0; i < 3; i++)
+    {
+        body.position[i] += baseVelocity[i] * dt;
+    }
+    if (body.grounded)
+    {
+        body.position[1] = 0.0f; // Rounding only
+    }
+
+    // Settle: snap the last fraction of a degree so a still lamp stops
+    // changing and the scene can stop redrawing
+    bool still = fabsf(baseVelocity[0]) < REST_SPEED && fabsf(baseVelocity[2]) < REST_SPEED;
+    if (body.grounded && still && servoSettled(joints.baseRotation, rates.baseRotation, target.baseRotation) &&
+        servoSettled(joints.lowerArmAngle, rates.lowerArmAngle, target.lowerArmAngle) &&
+        servoSettled(joints.upperArmAngle, rates.upperArmAngle, target.upperArmAngle) &&
+        servoSettled(joints.lampshadeAngle, rates.lampshadeAngle, target.lampshadeAngle) &&
+        servoSettled(joints.lampshadeRotation, rates.lampshadeRotation, target.lampshadeRotation))
+    {
+        LampJoints zero = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+        joints = target;
+        rates = zero;
+        centerOfMass(joints, body.comOffset);
+        body.comVelocity[0] = body.comVelocity[1] = body.comVelocity[2] = 0.0f;
+    }
+}
+
+/**
+ * A settled body stays exactly where it is: the servos have no error to
+ * correct and gravity is cancelled by the table in the same substep
+ */
+bool lampBodyAtRest(const LampBody &body, const LampJoints &target)
+{
+    const LampJoints &rates = body.jointVelocities;
+    return body.grounded && lampJointsEqual(body.joints, target) && rates.baseRotation == 0.0f &&
+           rates.lowerArmAngle == 0.0f && rates.upperArmAngle == 0.0f && rates.lampshadeAngle == 0.0f &&
+           rates.lampshadeRotation == 0.0f && body.comVelocity[0] == 0.0f && body.comVelocity[1] == 0.0f &&
+           body.comVelocity[2] == 0.0f;
+}
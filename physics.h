@@ -0,0 +1,56 @@
+/*
+ * Hop Physics
+ *
+ * Lets the lamp really leave the table. In physics mode the joints are
+ * servos that chase a commanded pose (the clip, the arrow keys or the
+ * look-at solver) instead of being set directly, and the lamp as a whole
+ * is a body under gravity standing on the table top: flinging the arm up
+ * and stopping it hard lifts the base, and it lands wherever the arm's
+ * momentum carried it.
+ *
+ * The model is kept cheap enough for hundreds of lamps: the parts are
+ * point masses on the arm plane, the joints are driven by critically
+ * damped PD servos, and the table is one contact plane with Coulomb
+ * friction resolved as a velocity impulse. Everything is integrated with
+ * semi-implicit (symplectic) Euler at a fixed substep, so the motion
+ * does not depend on how often frames are drawn. The lamp stays upright:
+ * it does not tumble, and turning the base mid-air is allowed. Past the
+ * table's edge there is nothing to land on.
+ */
+
+#ifndef PHYSICS_H
+#define PHYSICS_H
+
+#include "animation.h"
+#include "lamp.h"
+
+// Substeps per playback step, and their length (240 Hz)
+const int PHYSICS_SUBSTEPS = 2;
+const float PHYSICS_TIMESTEP = ANIMATION_TIMESTEP / PHYSICS_SUBSTEPS;
+
+struct LampBody
+{
+    LampJoints joints;          // Current joint angles (degrees)
+    LampJoints jointVelocities; // Degrees per second
+    float position[3];          // Base translation; y = 0 stands on the table
+    float comVelocity[3];       // Velocity of the whole lamp's center of mass
+    float comOffset[3];         // Center of mass relative to the base
+    float tableHalfSize;        // The table holds the base where |x|, |z| <= this
+    float accumulator;          // Elapsed time not yet consumed by substeps
+    bool grounded;              // The table pushed on the base in the last substep
+    int landings;               // Touchdowns after a flight
+};
+
+// Stand the lamp still on a square table at (x, 0, z) in the given pose
+void resetLampBody(LampBody &body, const LampJoints &joints, float x, float z, float tableHalfSize);
+
+// Add wall-clock time; returns how many substeps are now due
+int takePhysicsSubsteps(LampBody &body, float elapsedSeconds);
+
+// Advance one PHYSICS_TIMESTEP with the servos aiming at target
+void stepLampBody(LampBody &body, const LampJoints &target);
+
+// True if the body no longer moves while the target stays the same
+bool lampBodyAtRest(const LampBody &body, const LampJoints &target);
+
+#endif // PHYSICS_H
@@ -0,0 +1,218 @@
+/*
+ * GPU Click Selection - implementation
+ */
+
+#include "picking.h"
+
+#include "shader.h"
+
+bool createPickBuffer(PickBuffer &pick, bool coreProfile)
+{
+    pick.framebuffer = 0;
+    pick.idBuffer = 0;
+    pick.depthBuffer = 0;
+    pick.pixelBuffer = 0;
+    pick.fence = 0;
+    pick.program = 0;
+    pick.view = mat4Identity();
+
+    if (!isGLVersionAtLeast(3, 2))
+    {
+        return false;
+    }
+    pick.program = createPickProgram(coreProfile);
+    if (pick.program == 0)
+    {
+        return false;
+    }
+    pick.modelViewLocation = glGetUniformLocation(pick.program, "modelViewMatrix");
+    pick.projectionLocation = glGetUniformLocation(pick.program, "projectionMatrix");
+    pick.instancedLocation = glGetUniformLocation(pick.program, "instanced");
+    pick.objectIdLocation = glGetUniformLocation(pick.program, "objectId");
+    pick.partJointLocation = glGetUniformLocation(pick.program, "partJoint");
+    pick.partInstancesLocation = glGetUniformLocation(pick.program, "partInstances");
+    pick.matrixLocation = glGetAttribLocation(pick.program, "instanceMatrix");
+    pick.indexLocation = glGetAttribLocation(pick.program, "instanceIndex");
+
+    glGenRenderbuffers(1, &pick.idBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, pick.idBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_R32UI, 1, 1);
+    glGenRenderbuffers(1, &pick.depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, pick.depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, 1, 1);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    GLint previousFramebuffer = 0;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+    glGenFramebuffers(1, &pick.framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, pick.framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, pick.idBuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, pick.depthBuffer);
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+
+    glGenBuffers(1, &pick.pixelBuffer);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pick.pixelBuffer);
+    glBufferData(GL_PIXEL_PACK_BUFFER, sizeof(GLuint), NULL, GL_STREAM_READ);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    if (!complete)
+    {
+        deletePickBuffer(pick);
+        return false;
+    }
+    return true;
+}
+
+void deletePickBuffer(PickBuffer &pick)
+{
+    if (pick.fence != 0)
+    {
+        glDeleteSync(pick.fence);
+        pick.fence = 0;
+    }
+    glDeleteBuffers(1, &pick.pixelBuffer);
+    glDeleteFramebuffers(1, &pick.framebuffer);
+    glDeleteRenderbuffers(1, &pick.depthBuffer);
+    glDeleteRenderbuffers(1, &pick.idBuffer);
+    glDeleteProgram(pick.program);
+    pick.pixelBuffer = 0;
+    pick.framebuffer = 0;
+    pick.depthBuffer = 0;
+    pick.idBuffer = 0;
+    pick.program = 0;
+}
+
+bool pickPending(const PickBuffer &pick)
+{
+    return pick.fence != 0;
+}
+
+/**
+ * Bind the 1x1 target and a projection that enlarges one pixel to fill it
+ * The pixel's center in normalized device coordinates goes to the
+ * origin and its extent to [-1, 1], so the fragment the target samples
+ * is the one the camera pass drew at that pixel.
+ * @param projection - Eye-to-clip matrix of the camera pass
+ * @param view - World-to-eye matrix of the camera pass
+ * @param x - Window X of the pixel, from the left
+ * @param y - Window Y of the pixel, from the bottom
+ * @param width - Viewport width of the camera pass
+ * @param height - Viewport height of the camera pass
+ */
+void beginPickPass(PickBuffer &pick, const Mat4 &projection, const Mat4 &view, int x, int y, int width,
+                   int height)
+{
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &pick.previousFramebuffer);
+    glGetIntegerv(GL_VIEWPORT, pick.previousViewport);
+    glBindFramebuffer(GL_FRAMEBUFFER, pick.framebuffer);
+    glViewport(0, 0, 1, 1);
+    const GLuint background[4] = {PICK_NONE, 0, 0, 0};
+    glClearBufferuiv(GL_COLOR, 0, background);
+    glClear(GL_DEPTH_BUFFER_BIT);
+
+    Mat4 pixel = mat4Identity();
+    pixel.m[0] = (float)width;
+    pixel.m[5] = (float)height;
+    pixel.m[12] = (float)(width - 2 * x - 1);
+    pixel.m[13] = (float)(height - 2 * y - 1);
+    Mat4 pickProjection = mat4Multiply(pixel, projection);
+
+    pick.view = view;
+    glUseProgram(pick.program);
+    glUniformMatrix4fv(pick.projectionLocation, 1, GL_FALSE, pickProjection.m);
+    setPickId(pick, PICK_NONE);
+}
+
+/**
+ * Copy the ID into the pixel buffer and fence the copy
+ * The copy is queued like a draw; nothing here waits for it.
+ */
+void endPickPass(PickBuffer &pick)
+{
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pick.pixelBuffer);
+    glReadPixels(0, 0, 1, 1, GL_RED_INTEGER, GL_UNSIGNED_INT, (GLvoid *)0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    if (pick.fence != 0)
+    {
+        glDeleteSync(pick.fence); // Superseded by this pass
+    }
+    pick.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    glUseProgram(0);
+    glBindFramebuffer(GL_FRAMEBUFFER, pick.previousFramebuffer);
+    glViewport(pick.previousViewport[0], pick.previousViewport[1], pick.previousViewport[2],
+               pick.previousViewport[3]);
+}
+
+void setPickId(const PickBuffer &pick, unsigned int id)
+{
+    glUniform1i(pick.instancedLocation, 0);
+    glUniform1ui(pick.objectIdLocation, id);
+}
+
+/**
+ * Draw a mesh with view * model as its modelview matrix (the pass keeps
+ * uniform matrices in either profile)
+ * @param mesh - Mesh to draw
+ * @param model - Mesh-to-world matrix
+ */
+void drawPickMesh(const PickBuffer &pick, const Mesh &mesh, const Mat4 &model)
+{
+    Mat4 modelView = mat4Multiply(pick.view, model);
+    glUniformMatrix4fv(pick.modelViewLocation, 1, GL_FALSE, modelView.m);
+    drawMesh(mesh);
+}
+
+/**
+ * Switch to instanced draws; the modelview matrix becomes the view alone
+ * since the instance matrices are world matrices
+ * @param firstId - ID of joint 0 of the part's first lamp
+ * @param partJoint - Joint of the part's first instance in each lamp
+ * @param partInstances - Instances of the part per lamp
+ */
+void setPickInstancing(const PickBuffer &pick, unsigned int firstId, int partJoint, int partInstances)
+{
+    glUniformMatrix4fv(pick.modelViewLocation, 1, GL_FALSE, pick.view.m);
+    glUniform1i(pick.instancedLocation, 1);
+    glUniform1ui(pick.objectIdLocation, firstId);
+    glUniform1ui(pick.partJointLocation, (GLuint)partJoint);
+    glUniform1ui(pick.partInstancesLocation, (GLuint)partInstances);
+}
+
+/**
+ * Check the fence without waiting and map the result once it signaled
+ * The first check flushes, so the fence is certain to reach the GPU
+ * even if no other command follows.
+ * @param id - Receives the picked ID
+ * @return true if id was stored and the readback is finished
+ */
+bool pollPickResult(PickBuffer &pick, unsigned int &id)
+{
+    if (pick.fence == 0)
+    {
+        return false;
+    }
+    GLenum status = glClientWaitSync(pick.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    if (status == GL_TIMEOUT_EXPIRED)
+    {
+        return false;
+    }
+    glDeleteSync(pick.fence);
+    pick.fence = 0;
+
+    id = PICK_NONE;
+    if (status == GL_WAIT_FAILED)
+    {
+        return true;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pick.pixelBuffer);
+    const GLuint *pixel = (const GLuint *)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, sizeof(GLuint), GL_MAP_READ_BIT);
+    if (pixel != NULL)
+    {
+        id = *pixel;
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    return true;
+}
@@ -0,0 +1,101 @@
+/*
+ * GPU Click Selection
+ *
+ * Clicking a part selects its joint. Instead of intersecting a ray with
+ * every lamp on the CPU, the scene is drawn once more into a 1x1 unsigned
+ * integer target whose projection covers only the pixel under the
+ * cursor, with each fragment writing the pick ID of its lamp and joint;
+ * the depth test leaves the frontmost part. Instanced crowd lamps get
+ * their IDs on the GPU from the instance index, so the pass costs the
+ * same few draw calls as the crowd itself.
+ *
+ * The pixel is read back asynchronously: glReadPixels() copies it into a
+ * pixel buffer object and a fence marks the copy. The result is mapped
+ * only after the fence has signaled, polled without blocking, so neither
+ * the click nor the frame that draws the pick pass waits for the GPU.
+ */
+
+#ifndef PICKING_H
+#define PICKING_H
+
+#include "opengl.h"
+#include "matrix.h"
+#include "mesh.h"
+
+// Pick IDs: PICK_NONE where nothing was drawn, otherwise
+// 1 + lamp * PICK_JOINT_COUNT + joint, with lamp 0 the main lamp, crowd
+// lamp i at i + 1 and joints numbered like JointSelection in main.cpp
+const unsigned int PICK_NONE = 0;
+const unsigned int PICK_JOINT_COUNT = 4;
+
+inline unsigned int pickId(int lamp, int joint)
+{
+    return 1 + (unsigned int)lamp * PICK_JOINT_COUNT + (unsigned int)joint;
+}
+
+inline int pickedLamp(unsigned int id)
+{
+    return (int)((id - 1) / PICK_JOINT_COUNT);
+}
+
+inline int pickedJoint(unsigned int id)
+{
+    return (int)((id - 1) % PICK_JOINT_COUNT);
+}
+
+struct PickBuffer
+{
+    GLuint framebuffer;
+    GLuint idBuffer;    // GL_R32UI renderbuffer, 1x1
+    GLuint depthBuffer; // 1x1
+    GLuint pixelBuffer; // GL_PIXEL_PACK_BUFFER receiving the ID
+    GLsync fence;       // Marks the readback in flight, 0 if none
+    GLuint program;
+    GLint modelViewLocation;
+    GLint projectionLocation;
+    GLint instancedLocation;
+    GLint objectIdLocation;
+    GLint partJointLocation;
+    GLint partInstancesLocation;
+    GLint matrixLocation; // mat4 instance attribute, four locations
+    GLint indexLocation;  // Instance index in lamp order (float attribute)
+    Mat4 view; // World-to-eye matrix of the pass being drawn
+    GLint previousFramebuffer;
+    GLint previousViewport[4];
+};
+
+// Create the target, pixel buffer and program (GL 3.2+ for fences);
+// false if unsupported
+bool createPickBuffer(PickBuffer &pick, bool coreProfile);
+void deletePickBuffer(PickBuffer &pick);
+
+// True while a pick pass has been drawn but its result not yet read
+bool pickPending(const PickBuffer &pick);
+
+// Draw the following pick draws into the pick target: the window pixel
+// (x, y), origin bottom left, of a width x height view with the camera's
+// projection and view. Leaves the pick program bound.
+void beginPickPass(PickBuffer &pick, const Mat4 &projection, const Mat4 &view, int x, int y, int width,
+                   int height);
+
+// Start the readback and restore the framebuffer, viewport and program
+// (current program = 0)
+void endPickPass(PickBuffer &pick);
+
+// ID written by the following drawPickMesh() calls
+void setPickId(const PickBuffer &pick, unsigned int id);
+void drawPickMesh(const PickBuffer &pick, const Mesh &mesh, const Mat4 &model);
+
+// Switch to instanced draws, with model matrices and instance indices
+// bound as instance attributes by the caller: instance n of a part drawn
+// partInstances times per lamp writes firstId + (n / partInstances) *
+// PICK_JOINT_COUNT + partJoint + n % partInstances. setPickId() switches
+// back.
+void setPickInstancing(const PickBuffer &pick, unsigned int firstId, int partJoint, int partInstances);
+
+// Without blocking: false while the readback is in flight (or if none
+// was started), otherwise stores the picked ID (PICK_NONE for
+// background) and returns true
+bool pollPickResult(PickBuffer &pick, unsigned int &id);
+
+#endif // PICKING_H
@@ -0,0 +1,303 @@
+/*
+ * Batched Lamp Kinematics - implementation
+ *
+ * Holds the scalar, SSE2 and NEON kernels and the run-time dispatch; the
+ * AVX2 kernel needs different compiler flags and lives in posebatch_avx.cpp.
+ */
+
+#include "posebatch.h"
+
+#include "posebatch_kernel.h"
+
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// One lamp at a time with the C library's sinf()/cosf()
+struct ScalarOps
+{
+    typedef float F;
+    static const int WIDTH = 1;
+
+    static F load(const float *p) { return *p; }
+    static void store(float *p, F v) { *p = v; }
+    static F set(float v) { return v; }
+    static F add(F a, F b) { return a + b; }
+    static F sub(F a, F b) { return a - b; }
+    static F mul(F a, F b) { return a * b; }
+    static F madd(F a, F b, F c) { return a * b + c; }
+    static void sincos(F x, F &s, F &c)
+    {
+        s = sinf(x);
+        c = cosf(x);
+    }
+};
+
+#if defined(__SSE2__)
+struct Sse2Ops
+{
+    typedef __m128 F;
+    typedef __m128i I;
+    static const int WIDTH = 4;
+
+    static F load(const float *p) { return _mm_loadu_ps(p); }
+    static void store(float *p, F v) { _mm_storeu_ps(p, v); }
+    static F set(float v) { return _mm_set1_ps(v); }
+    static F add(F a, F b) { return _mm_add_ps(a, b); }
+    static F sub(F a, F b) { return _mm_sub_ps(a, b); }
+    static F mul(F a, F b) { return _mm_mul_ps(a, b); }
+    static F madd(F a, F b, F c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+
+    static F andF(F a, F b) { return _mm_and_ps(a, b); }
+    static F andnotF(F a, F b) { return _mm_andnot_ps(a, b); }
+    static F xorF(F a, F b) { return _mm_xor_ps(a, b); }
+    static F asFloat(I a) { return _mm_castsi128_ps(a); }
+    static I truncate(F a) { return _mm_cvttps_epi32(a); }
+    static F toFloat(I a) { return _mm_cvtepi32_ps(a); }
+    static I iset(int v) { return _mm_set1_epi32(v); }
+    static I iadd(I a, I b) { return _mm_add_epi32(a, b); }
+    static I isub(I a, I b) { return _mm_sub_epi32(a, b); }
+    static I iand(I a, I b) { return _mm_and_si128(a, b); }
+    static I iandnot(I a, I b) { return _mm_andnot_si128(a, b); }
+    static I ieq(I a, I b) { return _mm_cmpeq_epi32(a, b); }
+    static I shiftToSign(I a) { return _mm_slli_epi32(a, 29); }
+    static F select(I mask, F a, F b)
+    {
+        F m = _mm_castsi128_ps(mask);
+        return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b));
+    }
+    static void sincos(F x, F &s, F &c) { vectorSincos<Sse2Ops>(x, s, c); }
+};
+#endif
+
+#if defined(__ARM_NEON)
+struct NeonOps
+{
+    typedef float32x4_t F;
+    typedef int32x4_t I;
+    static const int WIDTH = 4;
+
+    static F load(const float *p) { return vld1q_f32(p); }
+    static void store(float *p, F v) { vst1q_f32(p, v); }
+    static F set(float v) { return vdupq_n_f32(v); }
+    static F add(F a, F b) { return vaddq_f32(a, b); }
+    static F sub(F a, F b) { return vsubq_f32(a, b); }
+    static F mul(F a, F b) { return vmulq_f32(a, b); }
+    static F madd(F a, F b, F c) { return vmlaq_f32(c, a, b); }
+
+    static uint32x4_t bits(F a) { return vreinterpretq_u32_f32(a); }
+    static F andF(F a, F b) { return vreinterpretq_f32_u32(vandq_u32(bits(a), bits(b))); }
+    static F andnotF(F a, F b) { return vreinterpretq_f32_u32(vbicq_u32(bits(b), bits(a))); }
+    static F xorF(F a, F b) { return vreinterpretq_f32_u32(veorq_u32(bits(a), bits(b))); }
+    static F asFloat(I a) { return vreinterpretq_f32_s32(a); }
+    static I truncate(F a) { return vcvtq_s32_f32(a); }
+    static F toFloat(I a) { return vcvtq_f32_s32(a); }
+    static I iset(int v) { return vdupq_n_s32(v); }
+    static I iadd(I a, I b) { return vaddq_s32(a, b); }
+    static I isub(I a, I b) { return vsubq_s32(a, b); }
+    static I iand(I a, I b) { return vandq_s32(a, b); }
+    static I iandnot(I a, I b) { return vbicq_s32(b, a); }
+    static I ieq(I a, I b) { return vreinterpretq_s32_u32(vceqq_s32(a, b)); }
+    static I shiftToSign(I a) { return vshlq_n_s32(a, 29); }
+    static F select(I mask, F a, F b) { return vbslq_f32(vreinterpretq_u32_s32(mask), a, b); }
+    static void sincos(F x, F &s, F &c) { vectorSincos<NeonOps>(x, s, c); }
+};
+#endif
+
+void resizeLampBatch(LampBatch &batch, size_t count)
+{
+    batch.count = count;
+    batch.x.resize(count, 0.0f);
+    batch.z.resize(count, 0.0f);
+    batch.heading.resize(count, 0.0f);
+    batch.scale.resize(count, 1.0f);
+    batch.baseRotation.resize(count, 0.0f);
+    batch.lowerArmAngle.resize(count, 0.0f);
+    batch.upperArmAngle.resize(count, 0.0f);
+    batch.lampshadeAngle.resize(count, 0.0f);
+    batch.lampshadeRotation.resize(count, 0.0f);
+}
+
+void setLampBatchPlacement(LampBatch &batch, size_t index, float x, float z, float heading, float scale)
+{
+    batch.x[index] = x;
+    batch.z[index] = z;
+    batch.heading[index] = heading;
+    batch.scale[index] = scale;
+}
+
+void setLampBatchJoints(LampBatch &batch, size_t index, const LampJoints &joints)
+{
+    batch.baseRotation[index] = joints.baseRotation;
+    batch.lowerArmAngle[index] = joints.lowerArmAngle;
+    batch.upperArmAngle[index] = joints.upperArmAngle;
+    batch.lampshadeAngle[index] = joints.lampshadeAngle;
+    batch.lampshadeRotation[index] = joints.lampshadeRotation;
+}
+
+Mat4 lampPoseMatrix(const LampPoseBatch &poses, PosePart part, size_t index)
+{
+    Mat4 matrix;
+    for (int column = 0; column < 4; column++)
+    {
+        for (int row = 0; row < 3; row++)
+        {
+            matrix.m[column * 4 + row] = poses.matrix[part][column * 3 + row][index];
+        }
+        matrix.m[column * 4 + 3] = column == 3 ? 1.0f : 0.0f;
+    }
+    return matrix;
+}
+
+bool poseKernelSupported(PoseKernel kernel)
+{
+    switch (kernel)
+    {
+    case POSE_KERNEL_SCALAR:
+        return true;
+#if defined(__SSE2__)
+    case POSE_KERNEL_SSE2:
+        return true;
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+    case POSE_KERNEL_AVX2:
+        return avx2PoseKernelBuilt() && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+#if defined(__ARM_NEON)
+    case POSE_KERNEL_NEON:
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+
+PoseKernel bestPoseKernel()
+{
+    static const PoseKernel preference[] = {POSE_KERNEL_AVX2, POSE_KERNEL_NEON, POSE_KERNEL_SSE2};
+    for (size_t i = 0; i < sizeof(preference) / sizeof(preference[0]); i++)
+    {
+        if (poseKernelSupported(preference[i]))
+        {
+            return preference[i];
+        }
+    }
+    return POSE_KERNEL_SCALAR;
+}
+
+const char *poseKernelName(PoseKernel kernel)
+{
+    static const char *const names[POSE_KERNEL_COUNT] = {"scalar", "SSE2", "AVX2", "NEON"};
+    return kernel >= 0 && kernel < POSE_KERNEL_COUNT ? names[kernel] : "unknown";
+}
+
+void resizeLampPoseBatch(LampPoseBatch &poses, size_t count)
+{
+    if (poses.count == count)
+    {
+        return;
+    }
+    poses.count = count;
+    for (int part = 0; part < POSE_PART_COUNT; part++)
+    {
+        for (int k = 0; k < POSE_MATRIX_FLOATS; k++)
+        {
+            poses.matrix[part][k].assign(count, 0.0f);
+        }
+    }
+    for (int axis = 0; axis < 3; axis++)
+    {
+        poses.spotPosition[axis].assign(count, 0.0f);
+        poses.spotDirection[axis].assign(count, 0.0f);
+    }
+}
+
+/**
+ * Evaluate lamps [begin, end) of the batch
+ * The chosen kernel handles whole vectors; the scalar kernel finishes
+ * the lamps left over.
+ * @param kernel - Implementation to use (see poseKernelSupported())
+ */
+static void evaluateLampPoses(PoseKernel kernel, const LampBatch &batch, LampPoseBatch &poses, size_t begin,
+                              size_t end)
+{
+    if (begin >= end)
+    {
+        return;
+    }
+
+    PoseKernelArgs args;
+    const std::vector<float> *inputs[POSE_IN_COUNT] = {
+        &batch.x, &batch.z, &batch.heading, &batch.scale, &batch.baseRotation, &batch.lowerArmAngle,
+        &batch.upperArmAngle, &batch.lampshadeAngle, &batch.lampshadeRotation};
+    for (int i = 0; i < POSE_IN_COUNT; i++)
+    {
+        args.in[i] = &(*inputs[i])[0];
+    }
+    for (int part = 0; part < POSE_PART_COUNT; part++)
+    {
+        for (int k = 0; k < POSE_MATRIX_FLOATS; k++)
+        {
+            args.out[part * POSE_MATRIX_FLOATS + k] = &poses.matrix[part][k][0];
+        }
+    }
+    for (int axis = 0; axis < 3; axis++)
+    {
+        args.out[POSE_OUT_SPOT_POSITION + axis] = &poses.spotPosition[axis][0];
+        args.out[POSE_OUT_SPOT_DIRECTION + axis] = &poses.spotDirection[axis][0];
+    }
+    args.baseHeight = lampDimensions.baseHeight;
+    args.lowerArmLength = lampDimensions.lowerArmLength;
+    args.upperArmLength = lampDimensions.upperArmLength;
+    args.spotOffset = lampSpotOffset(lampDimensions);
+
+    size_t done = begin;
+    switch (kernel)
+    {
+#if defined(__SSE2__)
+    case POSE_KERNEL_SSE2:
+        done = poseKernel<Sse2Ops>(args, begin, end);
+        break;
+#endif
+    case POSE_KERNEL_AVX2:
+        done = computeLampPosesAvx2(args, begin, end);
+        break;
+#if defined(__ARM_NEON)
+    case POSE_KERNEL_NEON:
+        done = poseKernel<NeonOps>(args, begin, end);
+        break;
+#endif
+    default:
+        break;
+    }
+    poseKernel<ScalarOps>(args, done, end);
+}
+
+// CPU features cannot change while running
+static PoseKernel defaultPoseKernel()
+{
+    static const PoseKernel kernel = bestPoseKernel();
+    return kernel;
+}
+
+void computeLampPoses(const LampBatch &batch, LampPoseBatch &poses)
+{
+    resizeLampPoseBatch(poses, batch.count);
+    evaluateLampPoses(defaultPoseKernel(), batch, poses, 0, batch.count);
+}
+
+void computeLampPosesWith(PoseKernel kernel, const LampBatch &batch, LampPoseBatch &poses)
+{
+    resizeLampPoseBatch(poses, batch.count);
+    evaluateLampPoses(kernel, batch, poses, 0, batch.count);
+}
+
+void computeLampPosesRange(const LampBatch &batch, LampPoseBatch &poses, size_t begin, size_t end)
+{
+    evaluateLampPoses(defaultPoseKernel(), batch, poses, begin, end);
+}
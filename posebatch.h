@@ -0,0 +1,106 @@
+/*
+ * Batched Lamp Kinematics
+ *
+ * Structure-of-arrays counterpart of computeLampPose() for many lamps at
+ * once. Placements and joint angles are stored one array per field, and
+ * every output matrix element is an array of its own, so a SIMD kernel
+ * (AVX2+FMA, SSE2 or NEON, chosen at run time) evaluates 8 or 4 lamps
+ * per instruction. A scalar loop covers the tail and other CPUs.
+ *
+ * The lamp only turns about Y at its root and about X along the arm, so
+ * every part matrix has a closed form in the sines and cosines of five
+ * angles: the kernel never multiplies 4x4 matrices.
+ */
+
+#ifndef POSEBATCH_H
+#define POSEBATCH_H
+
+#include "lamp.h"
+#include "matrix.h"
+
+#include <cstddef>
+#include <vector>
+
+// Part matrices produced per lamp, in LampPose order
+enum PosePart
+{
+    POSE_BASE = 0,
+    POSE_LOWER_JOINT,
+    POSE_LOWER_ARM,
+    POSE_UPPER_JOINT,
+    POSE_UPPER_ARM,
+    POSE_SHADE_JOINT,
+    POSE_LAMPSHADE,
+    POSE_PART_COUNT
+};
+
+// Floats stored per part matrix: the top three rows of a column-major
+// Mat4 (m[0..2], m[4..6], m[8..10], m[12..14]); the bottom row is 0 0 0 1
+const int POSE_MATRIX_FLOATS = 12;
+
+// Kernel implementations; only some are built or supported on a given CPU
+enum PoseKernel
+{
+    POSE_KERNEL_SCALAR = 0,
+    POSE_KERNEL_SSE2,
+    POSE_KERNEL_AVX2,
+    POSE_KERNEL_NEON,
+    POSE_KERNEL_COUNT
+};
+
+// Inputs for N lamps
+struct LampBatch
+{
+    size_t count;
+
+    // Placement on the table: translate(x, 0, z) * rotateY(heading) * scale
+    std::vector<float> x;
+    std::vector<float> z;
+    std::vector<float> heading; // Degrees
+    std::vector<float> scale;
+
+    // LampJoints, one array per field (degrees)
+    std::vector<float> baseRotation;
+    std::vector<float> lowerArmAngle;
+    std::vector<float> upperArmAngle;
+    std::vector<float> lampshadeAngle;
+    std::vector<float> lampshadeRotation;
+};
+
+// World-space results for N lamps
+struct LampPoseBatch
+{
+    size_t count;
+
+    // matrix[part][k][i] is element k (see POSE_MATRIX_FLOATS) of lamp i
+    std::vector<float> matrix[POSE_PART_COUNT][POSE_MATRIX_FLOATS];
+    std::vector<float> spotPosition[3];
+    std::vector<float> spotDirection[3]; // Unit length regardless of scale
+};
+
+// Resize to count lamps, keeping existing ones; new lamps stand at the
+// origin with unit scale and zero joints
+void resizeLampBatch(LampBatch &batch, size_t count);
+void setLampBatchPlacement(LampBatch &batch, size_t index, float x, float z, float heading, float scale);
+void setLampBatchJoints(LampBatch &batch, size_t index, const LampJoints &joints);
+
+// Lamp index's world matrix of one part as a full Mat4
+Mat4 lampPoseMatrix(const LampPoseBatch &poses, PosePart part, size_t index);
+
+// Evaluate every lamp with the fastest supported kernel, or a given one
+// (which must be supported); poses is resized to match
+void computeLampPoses(const LampBatch &batch, LampPoseBatch &poses);
+void computeLampPosesWith(PoseKernel kernel, const LampBatch &batch, LampPoseBatch &poses);
+
+// Evaluate lamps [begin, end) only, e.g. one chunk per thread; poses must
+// already hold batch.count lamps. Chunks starting at multiples of 8 keep
+// every SIMD width on whole vectors.
+void resizeLampPoseBatch(LampPoseBatch &poses, size_t count);
+void computeLampPosesRange(const LampBatch &batch, LampPoseBatch &poses, size_t begin, size_t end);
+
+// Kernel availability (built in and supported by this CPU) and names
+bool poseKernelSupported(PoseKernel kernel);
+PoseKernel bestPoseKernel();
+const char *poseKernelName(PoseKernel kernel);
+
+#endif // POSEBATCH_H
@@ -0,0 +1,67 @@
+/*
+ * Batched Lamp Kinematics - AVX2 kernel
+ *
+ * Built with -mavx2 -mfma (see the Makefile) and only called after a
+ * run-time CPU check, so the rest of the program stays runnable on any
+ * x86-64. Without those flags the file compiles to a stub.
+ */
+
+#include "posebatch_kernel.h"
+
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+
+struct Avx2Ops
+{
+    typedef __m256 F;
+    typedef __m256i I;
+    static const int WIDTH = 8;
+
+    static F load(const float *p) { return _mm256_loadu_ps(p); }
+    static void store(float *p, F v) { _mm256_storeu_ps(p, v); }
+    static F set(float v) { return _mm256_set1_ps(v); }
+    static F add(F a, F b) { return _mm256_add_ps(a, b); }
+    static F sub(F a, F b) { return _mm256_sub_ps(a, b); }
+    static F mul(F a, F b) { return _mm256_mul_ps(a, b); }
+    static F madd(F a, F b, F c) { return _mm256_fmadd_ps(a, b, c); }
+
+    static F andF(F a, F b) { return _mm256_and_ps(a, b); }
+    static F andnotF(F a, F b) { return _mm256_andnot_ps(a, b); }
+    static F xorF(F a, F b) { return _mm256_xor_ps(a, b); }
+    static F asFloat(I a) { return _mm256_castsi256_ps(a); }
+    static I truncate(F a) { return _mm256_cvttps_epi32(a); }
+    static F toFloat(I a) { return _mm256_cvtepi32_ps(a); }
+    static I iset(int v) { return _mm256_set1_epi32(v); }
+    static I iadd(I a, I b) { return _mm256_add_epi32(a, b); }
+    static I isub(I a, I b) { return _mm256_sub_epi32(a, b); }
+    static I iand(I a, I b) { return _mm256_and_si256(a, b); }
+    static I iandnot(I a, I b) { return _mm256_andnot_si256(a, b); }
+    static I ieq(I a, I b) { return _mm256_cmpeq_epi32(a, b); }
+    static I shiftToSign(I a) { return _mm256_slli_epi32(a, 29); }
+    static F select(I mask, F a, F b) { return _mm256_blendv_ps(b, a, _mm256_castsi256_ps(mask)); }
+    static void sincos(F x, F &s, F &c) { vectorSincos<Avx2Ops>(x, s, c); }
+};
+
+size_t computeLampPosesAvx2(const PoseKernelArgs &args, size_t begin, size_t end)
+{
+    return poseKernel<Avx2Ops>(args, begin, end);
+}
+
+bool avx2PoseKernelBuilt()
+{
+    return true;
+}
+
+#else
+
+size_t computeLampPosesAvx2(const PoseKernelArgs &, size_t begin, size_t)
+{
+    return begin;
+}
+
+bool avx2PoseKernelBuilt()
+{
+    return false;
+}
+
+#endif
@@ -0,0 +1,233 @@
+/*
+ * Batched Lamp Kinematics - kernel template
+ *
+ * Private to posebatch.cpp and posebatch_avx.cpp. The kernel is written
+ * once against a small "Ops" interface (one struct per instruction set)
+ * and instantiated in each translation unit with that unit's compiler
+ * flags. Everything here has internal linkage and calls nothing from
+ * the standard library, so code compiled for AVX2 can never be picked
+ * by the linker for a CPU without it.
+ *
+ * An Ops struct provides:
+ *   F, I                  float and int32 vector types, WIDTH lanes
+ *   load, store, set      unaligned load/store, broadcast
+ *   add, sub, mul, madd   madd(a, b, c) = a * b + c
+ *   sincos(x, s, c)       radians; vectorSincos<Ops> for SIMD types
+ *   and the bit operations vectorSincos() needs (see below)
+ */
+
+#ifndef POSEBATCH_KERNEL_H
+#define POSEBATCH_KERNEL_H
+
+#include "posebatch.h"
+
+// Raw array pointers of one LampBatch / LampPoseBatch pair
+enum
+{
+    POSE_IN_X = 0,
+    POSE_IN_Z,
+    POSE_IN_HEADING,
+    POSE_IN_SCALE,
+    POSE_IN_BASE,
+    POSE_IN_LOWER_ARM,
+    POSE_IN_UPPER_ARM,
+    POSE_IN_SHADE,
+    POSE_IN_SHADE_SPIN,
+    POSE_IN_COUNT
+};
+const int POSE_OUT_SPOT_POSITION = POSE_PART_COUNT * POSE_MATRIX_FLOATS;
+const int POSE_OUT_SPOT_DIRECTION = POSE_OUT_SPOT_POSITION + 3;
+const int POSE_OUT_COUNT = POSE_OUT_SPOT_DIRECTION + 3;
+
+struct PoseKernelArgs
+{
+    const float *in[POSE_IN_COUNT];
+    float *out[POSE_OUT_COUNT];
+    float baseHeight; // lampDimensions, read once per call
+    float lowerArmLength;
+    float upperArmLength;
+    float spotOffset;
+};
+
+// AVX2 kernel from posebatch_avx.cpp: evaluates whole vectors of 8 from
+// begin on and returns the first lamp left over (begin when the file was
+// built without AVX2 support)
+size_t computeLampPosesAvx2(const PoseKernelArgs &args, size_t begin, size_t end);
+bool avx2PoseKernelBuilt();
+
+/**
+ * sin and cos of every lane at once (Cephes single precision)
+ * Reduces by multiples of pi/4, evaluates both minimax polynomials on
+ * [-pi/4, pi/4] and picks/negates per octant. Accurate to about 1e-7
+ * for |x| < 8192, far beyond any joint angle.
+ * Ops also needs: andF, andnotF (~a & b), xorF, asFloat (bit cast),
+ * truncate/toFloat (float <-> int32), iset, iadd, isub, iand, iandnot,
+ * ieq (all-ones lane mask), shiftToSign (<< 29) and select(mask, a, b).
+ */
+template <class Ops>
+static inline void vectorSincos(typename Ops::F x, typename Ops::F &sine, typename Ops::F &cosine)
+{
+    typedef typename Ops::F F;
+    typedef typename Ops::I I;
+
+    // Work on |x|; sin is odd, cos even
+    F signMask = Ops::set(-0.0f);
+    F sineSign = Ops::andF(x, signMask);
+    x = Ops::andnotF(signMask, x);
+
+    // Octant j, rounded up to even so the remainder is in [-pi/4, pi/4]
+    I j = Ops::truncate(Ops::mul(x, Ops::set(1.27323954473516f)));
+    j = Ops::iand(Ops::iadd(j, Ops::iset(1)), Ops::iset(~1));
+    F y = Ops::toFloat(j);
+
+    // x - j * pi/4 in three parts to keep the bits of pi/4 that float drops
+    x = Ops::madd(y, Ops::set(-0.78515625f), x);
+    x = Ops::madd(y, Ops::set(-2.4187564849853515625e-4f), x);
+    x = Ops::madd(y, Ops::set(-3.77489497744594108e-8f), x);
+
+    sineSign = Ops::xorF(sineSign, Ops::asFloat(Ops::shiftToSign(Ops::iand(j, Ops::iset(4)))));
+    F cosineSign = Ops::asFloat(Ops::shiftToSign(Ops::iandnot(Ops::isub(j, Ops::iset(2)), Ops::iset(4))));
+    I sinePoly = Ops::ieq(Ops::iand(j, Ops::iset(2)), Ops::iset(0));
+
+    F z = Ops::mul(x, x);
+    F c = Ops::madd(Ops::set(2.443315711809948e-5f), z, Ops::set(-1.388731625493765e-3f));
+    c = Ops::madd(c, z, Ops::set(4.166664568298827e-2f));
+    c = Ops::madd(c, Ops::mul(z, z), Ops::madd(z, Ops::set(-0.5f), Ops::set(1.0f)));
+    F s = Ops::madd(Ops::set(-1.9515295891e-4f), z, Ops::set(8.3321608736e-3f));
+    s = Ops::madd(s, z, Ops::set(-1.6666654611e-1f));
+    s = Ops::madd(Ops::mul(s, z), x, x);
+
+    sine = Ops::xorF(Ops::select(sinePoly, s, c), sineSign);
+    cosine = Ops::xorF(Ops::select(sinePoly, c, s), cosineSign);
+}
+
+// Rotation columns of rotateY(heading + base) * scale * rotateX(pitch)
+template <class Ops>
+struct PoseFrame
+{
+    typename Ops::F column0[3];
+    typename Ops::F column1[3];
+    typename Ops::F column2[3];
+};
+
+template <class Ops>
+static inline void pitchedFrame(typename Ops::F scaledCos, typename Ops::F scaledSin, typename Ops::F scale,
+                                typename Ops::F pitchCos, typename Ops::F pitchSin, PoseFrame<Ops> &frame)
+{
+    typename Ops::F zero = Ops::set(0.0f);
+    frame.column0[0] = scaledCos;
+    frame.column0[1] = zero;
+    frame.column0[2] = Ops::sub(zero, scaledSin);
+    frame.column1[0] = Ops::mul(scaledSin, pitchSin);
+    frame.column1[1] = Ops::mul(scale, pitchCos);
+    frame.column1[2] = Ops::mul(scaledCos, pitchSin);
+    frame.column2[0] = Ops::mul(scaledSin, pitchCos);
+    frame.column2[1] = Ops::sub(zero, Ops::mul(scale, pitchSin));
+    frame.column2[2] = Ops::mul(scaledCos, pitchCos);
+}
+
+template <class Ops>
+static inline void storeMatrix(const PoseKernelArgs &args, int part, size_t i, const PoseFrame<Ops> &frame,
+                               const typename Ops::F origin[3])
+{
+    float *const *out = args.out + part * POSE_MATRIX_FLOATS;
+    for (int row = 0; row < 3; row++)
+    {
+        Ops::store(out[row] + i, frame.column0[row]);
+        Ops::store(out[3 + row] + i, frame.column1[row]);
+        Ops::store(out[6 + row] + i, frame.column2[row]);
+        Ops::store(out[9 + row] + i, origin[row]);
+    }
+}
+
+/**
+ * Evaluate lamps [begin, end) in steps of Ops::WIDTH
+ * In the base's frame every pivot lies in the (y, z) plane: it is the
+ * previous pivot plus segment length * (cos a, sin a), a being the summed
+ * pitch so far, and a pivot (y, z) lands in the world at
+ *   (x + scale sin(t) z, scale y, z0 + scale cos(t) z),  t = heading + base.
+ * @return First lamp not evaluated (the tail shorter than one vector)
+ */
+template <class Ops>
+static size_t poseKernel(const PoseKernelArgs &args, size_t begin, size_t end)
+{
+    typedef typename Ops::F F;
+    const F toRadians = Ops::set((float)M_PI / 180.0f);
+    const F zero = Ops::set(0.0f);
+    const F lowerY = Ops::set(args.baseHeight);
+    const F lowerLength = Ops::set(args.lowerArmLength);
+    const F upperLength = Ops::set(args.upperArmLength);
+    const F spotOffset = Ops::set(args.spotOffset);
+
+    size_t i = begin;
+    for (; i + Ops::WIDTH <= end; i += Ops::WIDTH)
+    {
+        F rootX = Ops::load(args.in[POSE_IN_X] + i);
+        F rootZ = Ops::load(args.in[POSE_IN_Z] + i);
+        F scale = Ops::load(args.in[POSE_IN_SCALE] + i);
+        F turn = Ops::add(Ops::load(args.in[POSE_IN_HEADING] + i), Ops::load(args.in[POSE_IN_BASE] + i));
+        F pitch1 = Ops::load(args.in[POSE_IN_LOWER_ARM] + i);
+        F pitch2 = Ops::add(pitch1, Ops::load(args.in[POSE_IN_UPPER_ARM] + i));
+        F pitch3 = Ops::add(pitch2, Ops::load(args.in[POSE_IN_SHADE] + i));
+
+        F turnSin, turnCos, sin1, cos1, sin2, cos2, sin3, cos3, spinSin, spinCos;
+        Ops::sincos(Ops::mul(turn, toRadians), turnSin, turnCos);
+        Ops::sincos(Ops::mul(pitch1, toRadians), sin1, cos1);
+        Ops::sincos(Ops::mul(pitch2, toRadians), sin2, cos2);
+        Ops::sincos(Ops::mul(pitch3, toRadians), sin3, cos3);
+        Ops::sincos(Ops::mul(Ops::load(args.in[POSE_IN_SHADE_SPIN] + i), toRadians), spinSin, spinCos);
+
+        F scaledCos = Ops::mul(scale, turnCos);
+        F scaledSin = Ops::mul(scale, turnSin);
+
+        // Pivots in the base's (y, z) plane
+        F upperY = Ops::madd(cos1, lowerLength, lowerY);
+        F upperZ = Ops::mul(sin1, lowerLength);
+        F shadeY = Ops::madd(cos2, upperLength, upperY);
+        F shadeZ = Ops::madd(sin2, upperLength, upperZ);
+        F spotY = Ops::madd(cos3, spotOffset, shadeY);
+        F spotZ = Ops::madd(sin3, spotOffset, shadeZ);
+
+        F rootOrigin[3] = {rootX, zero, rootZ};
+        F lowerOrigin[3] = {rootX, Ops::mul(scale, lowerY), rootZ};
+        F upperOrigin[3] = {Ops::madd(scaledSin, upperZ, rootX), Ops::mul(scale, upperY),
+                            Ops::madd(scaledCos, upperZ, rootZ)};
+        F shadeOrigin[3] = {Ops::madd(scaledSin, shadeZ, rootX), Ops::mul(scale, shadeY),
+                            Ops::madd(scaledCos, shadeZ, rootZ)};
+
+        PoseFrame<Ops> frame;
+        pitchedFrame<Ops>(scaledCos, scaledSin, scale, Ops::set(1.0f), zero, frame);
+        storeMatrix<Ops>(args, POSE_BASE, i, frame, rootOrigin);
+        storeMatrix<Ops>(args, POSE_LOWER_JOINT, i, frame, lowerOrigin);
+
+        pitchedFrame<Ops>(scaledCos, scaledSin, scale, cos1, sin1, frame);
+        storeMatrix<Ops>(args, POSE_LOWER_ARM, i, frame, lowerOrigin);
+        storeMatrix<Ops>(args, POSE_UPPER_JOINT, i, frame, upperOrigin);
+
+        pitchedFrame<Ops>(scaledCos, scaledSin, scale, cos2, sin2, frame);
+        storeMatrix<Ops>(args, POSE_UPPER_ARM, i, frame, upperOrigin);
+        storeMatrix<Ops>(args, POSE_SHADE_JOINT, i, frame, shadeOrigin);
+
+        // Lampshade: tilt, then spin about its own Y-axis
+        pitchedFrame<Ops>(scaledCos, scaledSin, scale, cos3, sin3, frame);
+        for (int row = 0; row < 3; row++)
+        {
+            F x = frame.column0[row];
+            F zAxis = frame.column2[row];
+            frame.column0[row] = Ops::sub(Ops::mul(spinCos, x), Ops::mul(spinSin, zAxis));
+            frame.column2[row] = Ops::madd(spinSin, x, Ops::mul(spinCos, zAxis));
+        }
+        storeMatrix<Ops>(args, POSE_LAMPSHADE, i, frame, shadeOrigin);
+
+        // The light sits on the shade axis and shines along it
+        Ops::store(args.out[POSE_OUT_SPOT_POSITION] + i, Ops::madd(scaledSin, spotZ, rootX));
+        Ops::store(args.out[POSE_OUT_SPOT_POSITION + 1] + i, Ops::mul(scale, spotY));
+        Ops::store(args.out[POSE_OUT_SPOT_POSITION + 2] + i, Ops::madd(scaledCos, spotZ, rootZ));
+        Ops::store(args.out[POSE_OUT_SPOT_DIRECTION] + i, Ops::mul(turnSin, sin3));
+        Ops::store(args.out[POSE_OUT_SPOT_DIRECTION + 1] + i, cos3);
+        Ops::store(args.out[POSE_OUT_SPOT_DIRECTION + 2] + i, Ops::mul(turnCos, sin3));
+    }
+    return i;
+}
+
+#endif // POSEBATCH_KERNEL_H
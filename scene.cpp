@@ -0,0 +1,311 @@
+/*
+ * Scene Description File - implementation
+ */
+
+#include "scene.h"
+
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+// Spotlight of the original setupLighting()
+static const SpotlightSettings DEFAULT_SPOTLIGHT = {
+    {3.0f, 2.5f, 1.5f, 1.0f}, // Warm yellow-white
+    {2.0f, 2.0f, 2.0f, 1.0f}, // White highlights
+    15.0f,                    // Moderate falloff
+    60.0f,
+    {0.5f, 0.02f, 0.005f}};
+
+static const float DEFAULT_TABLE_SIZE = 20.0f;
+
+// GL_SHININESS and GL_SPOT_EXPONENT accept at most this
+static const float MAX_GL_EXPONENT = 128.0f;
+
+// Names of the material slots in the file, in MaterialId order
+static const char *const MATERIAL_NAMES[MATERIAL_COUNT] = {"base", "arm", "joint", "shade", "table"};
+
+void defaultScene(SceneDescription &scene)
+{
+    scene.lamp = DEFAULT_LAMP_DIMENSIONS;
+    for (int i = 0; i < MATERIAL_COUNT; i++)
+    {
+        scene.materials[i] = getDefaultMaterial((MaterialId)i);
+    }
+    scene.spotlight = DEFAULT_SPOTLIGHT;
+    scene.tableSize = DEFAULT_TABLE_SIZE;
+}
+
+// Both checks fail NaN and infinity as well
+static bool allPositive(const float *values, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (!(values[i] > 0.0f) || !std::isfinite(values[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool noneNegative(const float *values, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (!(values[i] >= 0.0f) || !std::isfinite(values[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// MaterialId of a name in the file, MATERIAL_COUNT if unknown
+static int findMaterial(const char *name)
+{
+    int id = 0;
+    while (id < MATERIAL_COUNT && strcmp(MATERIAL_NAMES[id], name) != 0)
+    {
+        id++;
+    }
+    return id;
+}
+
+/**
+ * Parse one non-empty line into scene
+ * @return NULL, or what is wrong with the line
+ */
+static const char *parseSceneLine(const char *text, SceneDescription &scene)
+{
+    char extra;
+    char name[16];
+    float v[7];
+    LampDimensions &lamp = scene.lamp;
+    SpotlightSettings &spot = scene.spotlight;
+
+    if (sscanf(text, "base %f %f %c", &v[0], &v[1], &extra) == 2)
+    {
+        if (!allPositive(v, 2))
+        {
+            return "base dimensions must be positive";
+        }
+        lamp.baseRadius = v[0];
+        lamp.baseHeight = v[1];
+    }
+    else if (sscanf(text, "arms %f %f %f %c", &v[0], &v[1], &v[2], &extra) == 3)
+    {
+        if (!allPositive(v, 3))
+        {
+            return "arm dimensions must be positive";
+        }
+        lamp.armRadius = v[0];
+        lamp.lowerArmLength = v[1];
+        lamp.upperArmLength = v[2];
+    }
+    else if (sscanf(text, "shade %f %f %c", &v[0], &v[1], &extra) == 2)
+    {
+        if (!allPositive(v, 2))
+        {
+            return "shade dimensions must be positive";
+        }
+        lamp.lampshadeRadius = v[0];
+        lamp.lampshadeHeight = v[1];
+    }
+    else if (sscanf(text, "table %f %c", &v[0], &extra) == 1)
+    {
+        if (!allPositive(v, 1))
+        {
+            return "table size must be positive";
+        }
+        scene.tableSize = v[0];
+    }
+    else if (sscanf(text, "material %15s %f %f %f %f %f %f %f %c", name, &v[0], &v[1], &v[2], &v[3], &v[4], &v[5],
+                    &v[6], &extra) == 8)
+    {
+        int id = findMaterial(name);
+        if (id == MATERIAL_COUNT)
+        {
+            return "unknown material (base, arm, joint, shade or table)";
+        }
+        if (!noneNegative(v, 7) || v[6] > MAX_GL_EXPONENT)
+        {
+            return "material colors must not be negative, shininess 0-128";
+        }
+        Material &material = scene.materials[id];
+        for (int c = 0; c < 3; c++)
+        {
+            material.ambientDiffuse[c] = v[c];
+            material.specular[c] = v[3 + c];
+        }
+        material.ambientDiffuse[3] = 1.0f;
+        material.specular[3] = 1.0f;
+        material.shininess = v[6];
+    }
+    else if (sscanf(text, "spotlight %f %f %c", &v[0], &v[1], &extra) == 2)
+    {
+        if (!(v[0] > 0.0f && v[0] <= 90.0f) || !(v[1] >= 0.0f && v[1] <= MAX_GL_EXPONENT))
+        {
+            return "spotlight cutoff must be 0-90 degrees, exponent 0-128";
+        }
+        spot.cutoff = v[0];
+        spot.exponent = v[1];
+    }
+    else if (sscanf(text, "attenuation %f %f %f %c", &v[0], &v[1], &v[2], &extra) == 3)
+    {
+        if (!noneNegative(v, 3) || v[0] + v[1] + v[2] <= 0.0f)
+        {
+            return "attenuation must not be negative or all zero";
+        }
+        std::copy(v, v + 3, spot.attenuation);
+    }
+    else if (sscanf(text, "spot_color %f %f %f %f %f %f %c", &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &extra) ==
+             6)
+    {
+        if (!noneNegative(v, 6))
+        {
+            return "spotlight colors must not be negative";
+        }
+        std::copy(v, v + 3, spot.diffuse);
+        std::copy(v + 3, v + 6, spot.specular);
+    }
+    else
+    {
+        return "expected base, arms, shade, table, material, spotlight, attenuation or spot_color";
+    }
+    return NULL;
+}
+
+bool loadSceneFile(const char *path, SceneDescription &scene)
+{
+    FILE *in = fopen(path, "r");
+    if (in == NULL)
+    {
+        std::cerr << "Cannot open " << path << std::endl;
+        return false;
+    }
+
+    SceneDescription loaded;
+    defaultScene(loaded);
+
+    char line[256];
+    int lineNumber = 0;
+    const char *error = NULL;
+    while (error == NULL && fgets(line, sizeof(line), in) != NULL)
+    {
+        lineNumber++;
+        line[strcspn(line, "#\r\n")] = '\0'; // Comments may follow the values
+        char *text = line + strspn(line, " \t");
+        if (*text != '\0')
+        {
+            error = parseSceneLine(text, loaded);
+        }
+    }
+    fclose(in);
+
+    if (error != NULL)
+    {
+        std::cerr << path << ":" << lineNumber << ": " << error << std::endl;
+        return false;
+    }
+    scene = loaded;
+    return true;
+}
+
+static bool sameSpotlight(const SpotlightSettings &a, const SpotlightSettings &b)
+{
+    return std::equal(a.diffuse, a.diffuse + 4, b.diffuse) && std::equal(a.specular, a.specular + 4, b.specular) &&
+           a.exponent == b.exponent && a.cutoff == b.cutoff &&
+           std::equal(a.attenuation, a.attenuation + 3, b.attenuation);
+}
+
+unsigned int sceneChanges(const SceneDescription &a, const SceneDescription &b)
+{
+    unsigned int changes = 0;
+    if (!lampDimensionsEqual(a.lamp, b.lamp))
+    {
+        changes |= SCENE_LAMP;
+    }
+    for (int i = 0; i < MATERIAL_COUNT; i++)
+    {
+        if (!materialsEqual(a.materials[i], b.materials[i]))
+        {
+            changes |= SCENE_MATERIALS;
+        }
+    }
+    if (!sameSpotlight(a.spotlight, b.spotlight))
+    {
+        changes |= SCENE_SPOTLIGHT;
+    }
+    if (a.tableSize != b.tableSize)
+    {
+        changes |= SCENE_TABLE;
+    }
+    return changes;
+}
+
+/**
+ * Watch the directory holding the file for finished writes and renames
+ * @param path - Scene file; its directory must exist
+ */
+bool startSceneWatch(SceneWatch &watch, const char *path)
+{
+    std::string file = path;
+    size_t slash = file.rfind('/');
+    std::string directory = slash == std::string::npos ? "." : slash == 0 ? "/" : file.substr(0, slash);
+    watch.name = slash == std::string::npos ? file : file.substr(slash + 1);
+
+    watch.fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watch.fd < 0)
+    {
+        std::cerr << "Cannot watch " << path << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    if (inotify_add_watch(watch.fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+    {
+        std::cerr << "Cannot watch " << directory << ": " << strerror(errno) << std::endl;
+        stopSceneWatch(watch);
+        return false;
+    }
+    return true;
+}
+
+void stopSceneWatch(SceneWatch &watch)
+{
+    if (watch.fd >= 0)
+    {
+        close(watch.fd);
+        watch.fd = -1;
+    }
+}
+
+bool sceneFileChanged(SceneWatch &watch)
+{
+    if (watch.fd < 0)
+    {
+        return false;
+    }
+
+    // Events are variable length, each followed by its NUL-padded name
+    alignas(struct inotify_event) char buffer[4096];
+    bool changed = false;
+    ssize_t length;
+    while ((length = read(watch.fd, buffer, sizeof(buffer))) > 0)
+    {
+        for (char *next = buffer; next < buffer + length;)
+        {
+            const struct inotify_event *event = (const struct inotify_event *)next;
+            if (event->len > 0 && watch.name == event->name)
+            {
+                changed = true;
+            }
+            next += sizeof(struct inotify_event) + event->len;
+        }
+    }
+    return changed;
+}
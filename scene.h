@@ -0,0 +1,85 @@
+/*
+ * Scene Description File
+ *
+ * The lamp's dimensions, the material table, the spotlight and the table
+ * size can be read from a text file instead of the built-in defaults.
+ * Every line sets one group; groups the file leaves out keep their
+ * defaults:
+ *   # comment, also after the values of a line
+ *   base <radius> <height>
+ *   arms <radius> <lower length> <upper length>
+ *   shade <radius> <height>
+ *   table <size>
+ *   material <base|arm|joint|shade|table> <r> <g> <b> <specular r> <g> <b> <shininess>
+ *   spotlight <cutoff degrees> <exponent>
+ *   attenuation <constant> <linear> <quadratic>
+ *   spot_color <r> <g> <b> <specular r> <g> <b>
+ *
+ * The file can be watched with inotify while the program runs. The
+ * watch is on the file's directory, so editors that save by writing a
+ * new file and renaming it over the old one are noticed as well.
+ * Applying an edit is up to the caller: sceneChanges() tells which
+ * groups differ, so only the meshes and material slots those groups feed
+ * need to be rebuilt.
+ */
+
+#ifndef SCENE_H
+#define SCENE_H
+
+#include "lamp.h"
+#include "material.h"
+
+#include <string>
+
+struct SpotlightSettings
+{
+    float diffuse[4];
+    float specular[4];
+    float exponent;
+    float cutoff;         // Cone half-angle in degrees, also the shadow frustum
+    float attenuation[3]; // Constant, linear, quadratic
+};
+
+struct SceneDescription
+{
+    LampDimensions lamp;
+    Material materials[MATERIAL_COUNT];
+    SpotlightSettings spotlight;
+    float tableSize; // Edge length of the square table
+};
+
+// Groups of a scene that differ between two descriptions
+enum SceneChange
+{
+    SCENE_LAMP = 1,      // Lamp dimensions: part meshes, kinematics, shadows
+    SCENE_MATERIALS = 2, // One or more material slots
+    SCENE_SPOTLIGHT = 4, // Spotlight color, cone or attenuation
+    SCENE_TABLE = 8      // Table size: table meshes and lightmap extent
+};
+
+// Built-in scene
+void defaultScene(SceneDescription &scene);
+
+// Read a scene file over the defaults; false (with a message) if it is
+// missing or invalid, leaving scene untouched
+bool loadSceneFile(const char *path, SceneDescription &scene);
+
+// SceneChange bits of everything that differs
+unsigned int sceneChanges(const SceneDescription &a, const SceneDescription &b);
+
+// Change notification for one scene file
+struct SceneWatch
+{
+    int fd;           // Non-blocking inotify descriptor, -1 when not watching
+    std::string name; // File name within the watched directory
+};
+
+// Start watching; false (with a message) if inotify is unavailable
+bool startSceneWatch(SceneWatch &watch, const char *path);
+void stopSceneWatch(SceneWatch &watch);
+
+// Drain pending events without blocking; true if any of them was a
+// finished write to (or a rename onto) the file
+bool sceneFileChanged(SceneWatch &watch);
+
+#endif // SCENE_H
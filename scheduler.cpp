@@ -0,0 +1,50 @@
+/*
+ * Frame Scheduler - implementation
+ */
+
+#include "scheduler.h"
+
+#include "opengl.h"
+
+static bool sceneDirty = false;
+static bool postRedisplay = true;
+static unsigned long changeCount = 0;
+
+/**
+ * Request a redraw, posting at most one redisplay per frame
+ */
+void markSceneDirty()
+{
+    changeCount++;
+    if (!sceneDirty)
+    {
+        sceneDirty = true;
+        if (postRedisplay)
+        {
+            glutPostRedisplay();
+        }
+    }
+}
+
+bool isSceneDirty()
+{
+    return sceneDirty;
+}
+
+unsigned long sceneChangeCount()
+{
+    return changeCount;
+}
+
+/**
+ * Clear the dirty flag; later changes schedule the next frame
+ */
+void frameRendered()
+{
+    sceneDirty = false;
+}
+
+void setRedisplayPosting(bool enabled)
+{
+    postRedisplay = enabled;
+}
@@ -0,0 +1,31 @@
+/*
+ * Frame Scheduler
+ *
+ * Rendering is event driven: a frame is only drawn when scene state
+ * (joints, camera, lighting) actually changed, or when the window system
+ * asks for a repaint. Between redraws no idle callback is registered, so
+ * the GLUT main loop blocks waiting for events instead of spinning.
+ */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+// Flag the scene as changed; any number of calls before the next frame
+// result in a single redraw
+void markSceneDirty();
+
+// True while a redraw has been requested but not yet rendered
+bool isSceneDirty();
+
+// Number of markSceneDirty() calls so far; a frame that requests its own
+// successor can tell from it whether anything else asked for a redraw
+unsigned long sceneChangeCount();
+
+// Called by the display callback once a frame has been submitted
+void frameRendered();
+
+// Headless runs have no GLUT loop to post redisplays to; they poll
+// isSceneDirty() and draw the frames themselves
+void setRedisplayPosting(bool enabled);
+
+#endif // SCHEDULER_H
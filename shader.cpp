@@ -0,0 +1,606 @@
+/*
+ * GLSL Shader Helpers - implementation
+ */
+
+#include "shader.h"
+
+#include "lights.h"
+#include "material.h"
+#include "mesh.h"
+#include "picking.h"
+#include "shadow.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+// --------------------------------------------------------------------
+// Per-pixel lighting program (GLSL 1.20, compatibility built-ins)
+// Light and material parameters come from the regular glLight*() and
+// glMaterial*() state, so setupLighting() drives both shading paths.
+// --------------------------------------------------------------------
+static const char *PER_PIXEL_VERTEX_SOURCE =
+    "#version 120\n"
+    "varying vec3 eyePosition;\n"
+    "varying vec3 eyeNormal;\n"
+    "void main()\n"
+    "{\n"
+    "    eyePosition = vec3(gl_ModelViewMatrix * gl_Vertex);\n"
+    "    eyeNormal = gl_NormalMatrix * gl_Normal;\n"
+    "    gl_Position = ftransform();\n"
+    "}\n";
+
+// Fixed-function lighting equation for one light (non-local viewer),
+// shared by every lit program. Expects the eyePosition varying and a
+// LightParameters type: the built-in gl_LightSourceParameters (see
+// fragmentSourceWithHeader()), or the core program's own copy of it.
+#define SHADE_LIGHT_GLSL                                                                                        \
+    "vec4 shadeLight(LightParameters light, vec4 ambient, vec4 diffuse, vec4 specular,\n"                       \
+    "                float shininess, vec3 normal)\n"                                                           \
+    "{\n"                                                                                                       \
+    "    vec3 toLight;\n"                                                                                       \
+    "    float attenuation = 1.0;\n"                                                                            \
+    "    if (light.position.w == 0.0)\n"                                                                        \
+    "    {\n"                                                                                                   \
+    "        toLight = normalize(light.position.xyz);\n"                                                        \
+    "    }\n"                                                                                                   \
+    "    else\n"                                                                                                \
+    "    {\n"                                                                                                   \
+    "        toLight = light.position.xyz - eyePosition;\n"                                                     \
+    "        float d = length(toLight);\n"                                                                      \
+    "        toLight /= d;\n"                                                                                   \
+    "        attenuation = 1.0 / (light.constantAttenuation + light.linearAttenuation * d +\n"                  \
+    "                             light.quadraticAttenuation * d * d);\n"                                       \
+    "        if (light.spotCutoff <= 90.0)\n"                                                                   \
+    "        {\n"                                                                                               \
+    "            float spotCos = dot(-toLight, normalize(light.spotDirection));\n"                              \
+    "            attenuation *= spotCos >= light.spotCosCutoff ? pow(spotCos, light.spotExponent) : 0.0;\n"     \
+    "        }\n"                                                                                               \
+    "    }\n"                                                                                                   \
+    "\n"                                                                                                        \
+    "    vec4 color = light.ambient * ambient;\n"                                                               \
+    "    float nDotL = dot(normal, toLight);\n"                                                                 \
+    "    if (nDotL > 0.0)\n"                                                                                    \
+    "    {\n"                                                                                                   \
+    "        vec3 halfVector = normalize(toLight + vec3(0.0, 0.0, 1.0));\n"                                     \
+    "        color += nDotL * light.diffuse * diffuse;\n"                                                       \
+    "        color += pow(max(dot(normal, halfVector), 0.0), shininess) * light.specular * specular;\n"         \
+    "    }\n"                                                                                                   \
+    "    return attenuation * color;\n"                                                                         \
+    "}\n"
+
+// Material parameters from the material uniform buffer (see material.h).
+// Defines materialAmbientDiffuse(), materialSpecular() and
+// materialShininess().
+#define MATERIAL_BLOCK_GLSL                                                                                     \
+    "struct MaterialParameters\n"                                                                               \
+    "{\n"                                                                                                       \
+    "    vec4 ambientDiffuse;\n"                                                                                \
+    "    vec4 specular;\n"                                                                                      \
+    "    float shininess;\n"                                                                                    \
+    "};\n"                                                                                                      \
+    "layout(std140) uniform MaterialBlock\n"                                                                    \
+    "{\n"                                                                                                       \
+    "    MaterialParameters materials[5];\n"                                                                    \
+    "};\n"                                                                                                      \
+    "uniform int materialIndex;\n"                                                                              \
+    "vec4 materialAmbientDiffuse() { return materials[materialIndex].ambientDiffuse; }\n"                       \
+    "vec4 materialSpecular() { return materials[materialIndex].specular; }\n"                                   \
+    "float materialShininess() { return materials[materialIndex].shininess; }\n"
+
+// The same from the uniform buffer when built with USE_MATERIAL_BLOCK and
+// the driver supports it, from gl_FrontMaterial otherwise
+#define MATERIAL_GLSL                                                                                           \
+    "#if defined(USE_MATERIAL_BLOCK) && !defined(GL_ARB_uniform_buffer_object)\n"                               \
+    "#undef USE_MATERIAL_BLOCK\n"                                                                               \
+    "#endif\n"                                                                                                  \
+    "#ifdef USE_MATERIAL_BLOCK\n" MATERIAL_BLOCK_GLSL                                                           \
+    "#else\n"                                                                                                   \
+    "vec4 materialAmbientDiffuse() { return gl_FrontMaterial.diffuse; }\n"                                      \
+    "vec4 materialSpecular() { return gl_FrontMaterial.specular; }\n"                                           \
+    "float materialShininess() { return gl_FrontMaterial.shininess; }\n"                                        \
+    "#endif\n"
+static_assert(MATERIAL_COUNT == 5, "MATERIAL_BLOCK_GLSL array size must match MATERIAL_COUNT");
+
+// Spotlight shadow lookup (see shadow.h), filtered over a
+// (2 * pcfRadius + 1)^2 kernel. Loop bounds are constant because GLSL 1.20
+// requires it; MAX_PCF_RADIUS must match.
+#define SHADOW_GLSL                                                                                             \
+    "uniform bool shadowsEnabled;\n"                                                                            \
+    "uniform sampler2DShadow shadowMap;\n"                                                                      \
+    "uniform mat4 shadowMatrix;\n"                                                                              \
+    "uniform float shadowTexelSize;\n"                                                                          \
+    "uniform int pcfRadius;\n"                                                                                  \
+    "float spotShadow(vec3 position)\n"                                                                         \
+    "{\n"                                                                                                       \
+    "    if (!shadowsEnabled)\n"                                                                                \
+    "    {\n"                                                                                                   \
+    "        return 1.0;\n"                                                                                     \
+    "    }\n"                                                                                                   \
+    "    vec4 coord = shadowMatrix * vec4(position, 1.0);\n"                                                    \
+    "    if (coord.w <= 0.0)\n"                                                                                 \
+    "    {\n"                                                                                                   \
+    "        return 1.0;\n"                                                                                     \
+    "    }\n"                                                                                                   \
+    "    coord.xyz /= coord.w;\n"                                                                               \
+    "    float lit = 0.0;\n"                                                                                    \
+    "    float taps = 0.0;\n"                                                                                   \
+    "    for (int y = -3; y <= 3; y++)\n"                                                                       \
+    "    {\n"                                                                                                   \
+    "        for (int x = -3; x <= 3; x++)\n"                                                                   \
+    "        {\n"                                                                                               \
+    "            if (abs(x) <= pcfRadius && abs(y) <= pcfRadius)\n"                                             \
+    "            {\n"                                                                                           \
+    "                vec2 offset = vec2(float(x), float(y)) * shadowTexelSize;\n"                               \
+    "                lit += shadow2D(shadowMap, vec3(coord.xy + offset, coord.z)).r;\n"                         \
+    "                taps += 1.0;\n"                                                                            \
+    "            }\n"                                                                                           \
+    "        }\n"                                                                                               \
+    "    }\n"                                                                                                   \
+    "    return lit / taps;\n"                                                                                  \
+    "}\n"
+static_assert(MAX_PCF_RADIUS == 3, "SHADOW_GLSL loop bounds must match MAX_PCF_RADIUS");
+
+// Clustered spotlights (see lights.h): find this fragment's cluster from
+// its window position and eye depth, then shade the lights on its list.
+// Textures are read at texel centers with nearest filtering, so float
+// coordinates address entries exactly. Expects the eyePosition varying.
+#define CLUSTERED_LIGHTS_GLSL                                                                                   \
+    "uniform bool clusteredLightsEnabled;\n"                                                                    \
+    "uniform sampler2D lightData;\n"                                                                            \
+    "uniform sampler2D lightGrid;\n"                                                                            \
+    "uniform sampler2D lightIndices;\n"                                                                         \
+    "uniform vec2 clusterTileSize;\n"                                                                           \
+    "uniform float clusterSliceScale;\n"                                                                        \
+    "uniform float clusterSliceBias;\n"                                                                         \
+    "uniform float lightIndexRows;\n"                                                                           \
+    "vec4 texelAt(sampler2D map, vec2 texel, vec2 size)\n"                                                      \
+    "{\n"                                                                                                       \
+    "    return texture2D(map, (texel + 0.5) / size);\n"                                                        \
+    "}\n"                                                                                                       \
+    "vec3 shadeClusteredLights(vec3 diffuse, vec3 specular, float shininess, vec3 normal)\n"                    \
+    "{\n"                                                                                                       \
+    "    vec3 color = vec3(0.0);\n"                                                                             \
+    "    if (!clusteredLightsEnabled)\n"                                                                        \
+    "    {\n"                                                                                                   \
+    "        return color;\n"                                                                                   \
+    "    }\n"                                                                                                   \
+    "    vec2 tile = min(floor(gl_FragCoord.xy / clusterTileSize), vec2(31.0, 17.0));\n"                        \
+    "    float slice = floor(log(-eyePosition.z) * clusterSliceScale + clusterSliceBias) + 1.0;\n"              \
+    "    slice = clamp(slice, 0.0, 31.0);\n"                                                                    \
+    "    vec2 cluster = texelAt(lightGrid, vec2(tile.y * 32.0 + tile.x, slice), vec2(576.0, 32.0)).rg;\n"       \
+    "    for (int i = 0; i < 64; i++)\n"                                                                        \
+    "    {\n"                                                                                                   \
+    "        if (float(i) >= cluster.y)\n"                                                                      \
+    "        {\n"                                                                                               \
+    "            break;\n"                                                                                      \
+    "        }\n"                                                                                               \
+    "        float entry = cluster.x + float(i);\n"                                                             \
+    "        vec2 entryTexel = vec2(mod(entry, 1024.0), floor(entry / 1024.0));\n"                              \
+    "        float light = texelAt(lightIndices, entryTexel, vec2(1024.0, lightIndexRows)).r;\n"                \
+    "        vec4 positionRange = texelAt(lightData, vec2(0.0, light), vec2(3.0, 1024.0));\n"                   \
+    "        vec4 directionCutoff = texelAt(lightData, vec2(1.0, light), vec2(3.0, 1024.0));\n"                 \
+    "        vec4 colorExponent = texelAt(lightData, vec2(2.0, light), vec2(3.0, 1024.0));\n"                   \
+    "\n"                                                                                                        \
+    "        vec3 toLight = positionRange.xyz - eyePosition;\n"                                                 \
+    "        float d = length(toLight);\n"                                                                      \
+    "        toLight /= d;\n"                                                                                   \
+    "        float spotCos = dot(-toLight, directionCutoff.xyz);\n"                                             \
+    "        float nDotL = dot(normal, toLight);\n"                                                             \
+    "        if (d >= positionRange.w || spotCos < directionCutoff.w || nDotL <= 0.0)\n"                        \
+    "        {\n"                                                                                               \
+    "            continue;\n"                                                                                   \
+    "        }\n"                                                                                               \
+    "        // Smooth fade to zero at the range, so cluster lists can stop there\n"                            \
+    "        float fade = 1.0 - (d * d) / (positionRange.w * positionRange.w);\n"                               \
+    "        float attenuation = fade * fade * pow(spotCos, colorExponent.w);\n"                                \
+    "        vec3 halfVector = normalize(toLight + vec3(0.0, 0.0, 1.0));\n"                                     \
+    "        float highlight = pow(max(dot(normal, halfVector), 0.0), shininess);\n"                            \
+    "        color += attenuation * colorExponent.rgb * (nDotL * diffuse + highlight * specular);\n"            \
+    "    }\n"                                                                                                   \
+    "    return color;\n"                                                                                       \
+    "}\n"
+static_assert(CLUSTER_TILES_X == 32 && CLUSTER_TILES_Y == 18 && CLUSTER_SLICES == 32,
+              "CLUSTERED_LIGHTS_GLSL grid constants must match lights.h");
+static_assert(MAX_CLUSTER_LIGHTS == 64 && MAX_SPOT_LIGHTS == 1024 && LIGHT_INDEX_WIDTH == 1024,
+              "CLUSTERED_LIGHTS_GLSL loop bound and texture sizes must match lights.h");
+
+static const char *PER_PIXEL_FRAGMENT_SOURCE =
+    "varying vec3 eyePosition;\n"
+    "varying vec3 eyeNormal;\n"
+    "uniform bool spotlightEnabled;\n"
+    "uniform vec4 highlightEmission;\n"
+    "\n" MATERIAL_GLSL
+    "\n" SHADOW_GLSL
+    "\n" SHADE_LIGHT_GLSL
+    "\n" CLUSTERED_LIGHTS_GLSL
+    "\n"
+    "void main()\n"
+    "{\n"
+    "    vec3 normal = normalize(eyeNormal);\n"
+    "    vec4 diffuse = materialAmbientDiffuse();\n"
+    "    vec4 specular = materialSpecular();\n"
+    "    float shininess = materialShininess();\n"
+    "    vec4 color = gl_LightModel.ambient * diffuse;\n"
+    "    color += shadeLight(gl_LightSource[0], diffuse, diffuse, specular, shininess, normal);\n"
+    "    if (spotlightEnabled)\n"
+    "    {\n"
+    "        color += spotShadow(eyePosition) *\n"
+    "                 shadeLight(gl_LightSource[1], diffuse, diffuse, specular, shininess, normal);\n"
+    "    }\n"
+    "    color.rgb += shadeClusteredLights(diffuse.rgb, specular.rgb, shininess, normal);\n"
+    "    color.rgb += highlightEmission.rgb;\n"
+    "    gl_FragColor = vec4(clamp(color.rgb, 0.0, 1.0), diffuse.a);\n"
+    "}\n";
+
+// --------------------------------------------------------------------
+// Instanced lamp program: per-instance model matrix and color come from
+// vertex attributes with divisor 1; the color replaces the ambient and
+// diffuse material like GL_COLOR_MATERIAL does in the fixed pipeline.
+// --------------------------------------------------------------------
+static const char *INSTANCED_VERTEX_SOURCE =
+    "#version 120\n"
+    "attribute mat4 instanceMatrix;\n"
+    "attribute vec4 instanceColor;\n"
+    "varying vec3 eyePosition;\n"
+    "varying vec3 eyeNormal;\n"
+    "varying vec4 materialColor;\n"
+    "void main()\n"
+    "{\n"
+    "    vec4 eye = gl_ModelViewMatrix * (instanceMatrix * gl_Vertex);\n"
+    "    eyePosition = eye.xyz;\n"
+    "    // Instance matrices only scale uniformly, so no inverse-transpose\n"
+    "    eyeNormal = mat3(gl_ModelViewMatrix) * (mat3(instanceMatrix) * gl_Normal);\n"
+    "    materialColor = instanceColor;\n"
+    "    gl_Position = gl_ProjectionMatrix * eye;\n"
+    "}\n";
+
+static const char *INSTANCED_FRAGMENT_SOURCE =
+    "varying vec3 eyePosition;\n"
+    "varying vec3 eyeNormal;\n"
+    "varying vec4 materialColor;\n"
+    "uniform bool spotlightEnabled;\n"
+    "\n" MATERIAL_GLSL
+    "\n" SHADOW_GLSL
+    "\n" SHADE_LIGHT_GLSL
+    "\n" CLUSTERED_LIGHTS_GLSL
+    "\n"
+    "void main()\n"
+    "{\n"
+    "    vec3 normal = normalize(eyeNormal);\n"
+    "    vec4 specular = materialSpecular();\n"
+    "    float shininess = materialShininess();\n"
+    "    vec4 color = gl_LightModel.ambient * materialColor;\n"
+    "    color += shadeLight(gl_LightSource[0], materialColor, materialColor, specular, shininess, normal);\n"
+    "    if (spotlightEnabled)\n"
+    "    {\n"
+    "        color += spotShadow(eyePosition) *\n"
+    "                 shadeLight(gl_LightSource[1], materialColor, materialColor, specular, shininess, normal);\n"
+    "    }\n"
+    "    color.rgb += shadeClusteredLights(materialColor.rgb, specular.rgb, shininess, normal);\n"
+    "    gl_FragColor = vec4(clamp(color.rgb, 0.0, 1.0), materialColor.a);\n"
+    "}\n";
+
+// --------------------------------------------------------------------
+// Core-profile lighting program (GLSL 3.30, no built-in state)
+// The same lights and materials as the per-pixel program: the matrices
+// and the fixed-function light parameters are plain uniforms, materials
+// always come from the uniform buffer, and unlit draws (the glow) use
+// unlitColor instead of glColor.
+// --------------------------------------------------------------------
+static const char *CORE_VERTEX_SOURCE =
+    "#version 330 core\n"
+    "layout(location = 0) in vec3 position;\n"
+    "layout(location = 1) in vec3 normal;\n"
+    "uniform mat4 modelViewMatrix;\n"
+    "uniform mat4 projectionMatrix;\n"
+    "out vec3 eyePosition;\n"
+    "out vec3 eyeNormal;\n"
+    "void main()\n"
+    "{\n"
+    "    vec4 eye = modelViewMatrix * vec4(position, 1.0);\n"
+    "    eyePosition = eye.xyz;\n"
+    "    // Part matrices only scale uniformly, so no inverse-transpose\n"
+    "    eyeNormal = mat3(modelViewMatrix) * normal;\n"
+    "    gl_Position = projectionMatrix * eye;\n"
+    "}\n";
+static_assert(MESH_POSITION_ATTRIBUTE == 0 && MESH_NORMAL_ATTRIBUTE == 1,
+              "CORE_VERTEX_SOURCE and createMeshProgram() attribute locations must match mesh.h");
+
+static const char *CORE_FRAGMENT_SOURCE =
+    "#version 330 core\n"
+    "in vec3 eyePosition;\n"
+    "in vec3 eyeNormal;\n"
+    "out vec4 fragColor;\n"
+    "struct LightParameters\n"
+    "{\n"
+    "    vec4 ambient;\n"
+    "    vec4 diffuse;\n"
+    "    vec4 specular;\n"
+    "    vec4 position;\n"
+    "    vec3 spotDirection;\n"
+    "    float spotExponent;\n"
+    "    float spotCutoff;\n"
+    "    float spotCosCutoff;\n"
+    "    float constantAttenuation;\n"
+    "    float linearAttenuation;\n"
+    "    float quadraticAttenuation;\n"
+    "};\n"
+    "uniform LightParameters lightSource[2];\n"
+    "uniform vec4 sceneAmbient;\n"
+    "uniform bool spotlightEnabled;\n"
+    "uniform bool lit;\n"
+    "uniform vec4 unlitColor;\n"
+    "uniform vec4 highlightEmission;\n"
+    "\n" MATERIAL_BLOCK_GLSL
+    "\n" SHADE_LIGHT_GLSL
+    "\n"
+    "void main()\n"
+    "{\n"
+    "    if (!lit)\n"
+    "    {\n"
+    "        fragColor = unlitColor;\n"
+    "        return;\n"
+    "    }\n"
+    "    vec3 normal = normalize(eyeNormal);\n"
+    "    vec4 diffuse = materialAmbientDiffuse();\n"
+    "    vec4 specular = materialSpecular();\n"
+    "    float shininess = materialShininess();\n"
+    "    vec4 color = sceneAmbient * diffuse;\n"
+    "    color += shadeLight(lightSource[0], diffuse, diffuse, specular, shininess, normal);\n"
+    "    if (spotlightEnabled)\n"
+    "    {\n"
+    "        color += shadeLight(lightSource[1], diffuse, diffuse, specular, shininess, normal);\n"
+    "    }\n"
+    "    color.rgb += highlightEmission.rgb;\n"
+    "    fragColor = vec4(clamp(color.rgb, 0.0, 1.0), diffuse.a);\n"
+    "}\n";
+
+// --------------------------------------------------------------------
+// Pick program (GLSL 1.30 or 3.30 core): writes the pick ID of every
+// fragment (picking.h) to an unsigned integer attachment. Instanced
+// crowd draws derive the ID from each instance's index in lamp order;
+// the header supplies the vertex position for the context's profile.
+// --------------------------------------------------------------------
+static const char *PICK_VERTEX_SOURCE =
+    "in mat4 instanceMatrix;\n"
+    "in float instanceIndex;\n"
+    "uniform mat4 modelViewMatrix;\n"
+    "uniform mat4 projectionMatrix;\n"
+    "uniform bool instanced;\n"
+    "uniform uint objectId;      // Instanced: ID of the first lamp's base\n"
+    "uniform uint partJoint;     // Instanced: joint of the part's first instance\n"
+    "uniform uint partInstances; // Instanced: instances per lamp\n"
+    "flat out uint pickId;\n"
+    "void main()\n"
+    "{\n"
+    "    vec4 position = MESH_POSITION;\n"
+    "    pickId = objectId;\n"
+    "    if (instanced)\n"
+    "    {\n"
+    "        position = instanceMatrix * position;\n"
+    "        uint index = uint(instanceIndex);\n"
+    "        pickId += (index / partInstances) * 4u + partJoint + index % partInstances;\n"
+    "    }\n"
+    "    gl_Position = projectionMatrix * (modelViewMatrix * position);\n"
+    "}\n";
+static_assert(PICK_JOINT_COUNT == 4, "PICK_VERTEX_SOURCE ID stride must match PICK_JOINT_COUNT");
+
+static const char *PICK_FRAGMENT_SOURCE =
+    "flat in uint pickId;\n"
+    "out uint fragId;\n"
+    "void main()\n"
+    "{\n"
+    "    fragId = pickId;\n"
+    "}\n";
+
+// --------------------------------------------------------------------
+// Temporal anti-aliasing resolve (GLSL 1.30 or 3.30 core): blends this
+// frame, drawn with a sub-pixel jitter, into the accumulated history.
+// The history is reprojected through the depth buffer for camera motion
+// and clamped to the current 3x3 neighborhood, which bounds ghosting
+// where objects moved. Drawn as the grid mesh spanning [-1, 1] in x/z.
+// --------------------------------------------------------------------
+static const char *TEMPORAL_VERTEX_SOURCE =
+    "out vec2 screenUv;\n"
+    "void main()\n"
+    "{\n"
+    "    vec4 corner = MESH_POSITION;\n"
+    "    screenUv = corner.xz * 0.5 + 0.5;\n"
+    "    gl_Position = vec4(corner.xz, 0.0, 1.0);\n"
+    "}\n";
+
+static const char *TEMPORAL_FRAGMENT_SOURCE =
+    "in vec2 screenUv;\n"
+    "out vec4 fragColor;\n"
+    "uniform sampler2D currentColor;\n"
+    "uniform sampler2D currentDepth;\n"
+    "uniform sampler2D historyColor;\n"
+    "uniform mat4 reprojection;   // Unjittered clip space -> previous frame's clip space\n"
+    "uniform vec2 jitter;         // This frame's jitter in texture coordinates\n"
+    "uniform float historyWeight; // 0 without usable history\n"
+    "void main()\n"
+    "{\n"
+    "    // The jittered image shows the unjittered point screenUv at uv\n"
+    "    vec2 uv = screenUv + jitter;\n"
+    "    vec3 current = texture(currentColor, uv).rgb;\n"
+    "    vec2 texel = 1.0 / vec2(textureSize(currentColor, 0));\n"
+    "    vec3 low = current;\n"
+    "    vec3 high = current;\n"
+    "    for (int y = -1; y <= 1; y++)\n"
+    "    {\n"
+    "        for (int x = -1; x <= 1; x++)\n"
+    "        {\n"
+    "            vec3 neighbor = texture(currentColor, uv + vec2(x, y) * texel).rgb;\n"
+    "            low = min(low, neighbor);\n"
+    "            high = max(high, neighbor);\n"
+    "        }\n"
+    "    }\n"
+    "    float depth = texture(currentDepth, uv).r;\n"
+    "    vec4 previous = reprojection * vec4(vec3(screenUv, depth) * 2.0 - 1.0, 1.0);\n"
+    "    vec2 historyUv = previous.xy / previous.w * 0.5 + 0.5;\n"
+    "    float weight = historyWeight;\n"
+    "    if (any(lessThan(historyUv, vec2(0.0))) || any(greaterThan(historyUv, vec2(1.0))))\n"
+    "    {\n"
+    "        weight = 0.0; // Newly uncovered by the camera\n"
+    "    }\n"
+    "    vec3 history = clamp(texture(historyColor, historyUv).rgb, low, high);\n"
+    "    fragColor = vec4(mix(current, history, weight), 1.0);\n"
+    "}\n";
+
+/**
+ * Compile a single shader stage
+ * @param type - GL_VERTEX_SHADER or GL_FRAGMENT_SHADER
+ * @param source - GLSL source code
+ * @return Shader handle, or 0 if compilation failed
+ */
+static GLuint compileShader(GLenum type, const char *source)
+{
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+
+    GLint status = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if (status != GL_TRUE)
+    {
+        GLint length = 0;
+        glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+        std::vector<GLchar> log(length + 1, '\0');
+        glGetShaderInfoLog(shader, length, NULL, &log[0]);
+        std::cerr << "Shader compile error: " << &log[0] << std::endl;
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+/**
+ * Compile and link a vertex + fragment shader program
+ * @param vertexSource - GLSL vertex shader source
+ * @param fragmentSource - GLSL fragment shader source
+ * @return Program handle, or 0 if compiling or linking failed
+ */
+GLuint createProgram(const char *vertexSource, const char *fragmentSource)
+{
+    GLuint vertexShader = compileShader(GL_VERTEX_SHADER, vertexSource);
+    GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentSource);
+    if (vertexShader == 0 || fragmentShader == 0)
+    {
+        glDeleteShader(vertexShader);
+        glDeleteShader(fragmentShader);
+        return 0;
+    }
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertexShader);
+    glAttachShader(program, fragmentShader);
+    glLinkProgram(program);
+
+    // Shaders are reference counted by the program once attached
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+
+    GLint status = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (status != GL_TRUE)
+    {
+        GLint length = 0;
+        glGetProgramiv(program, GL_INFO_LOG_LENGTH, &length);
+        std::vector<GLchar> log(length + 1, '\0');
+        glGetProgramInfoLog(program, length, NULL, &log[0]);
+        std::cerr << "Shader link error: " << &log[0] << std::endl;
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+/**
+ * Prefix a fragment shader body with the GLSL version, the built-in light
+ * type for SHADE_LIGHT_GLSL and, if requested, the uniform buffer
+ * extension used for MATERIAL_GLSL
+ */
+static std::string fragmentSourceWithHeader(const char *body, bool materialBlock)
+{
+    std::string source = "#version 120\n"
+                         "#define LightParameters gl_LightSourceParameters\n";
+    if (materialBlock)
+    {
+        source += "#extension GL_ARB_uniform_buffer_object : enable\n"
+                  "#define USE_MATERIAL_BLOCK\n";
+    }
+    return source + body;
+}
+
+/**
+ * Build the instanced lamp program
+ * Attributes "instanceMatrix" (mat4, four locations) and "instanceColor"
+ * must be fed with a divisor of 1.
+ * @param materialBlock - Read specular/shininess from the material
+ *                        uniform buffer (check with bindMaterialBlock())
+ */
+GLuint createInstancedLightingProgram(bool materialBlock)
+{
+    std::string fragmentSource = fragmentSourceWithHeader(INSTANCED_FRAGMENT_SOURCE, materialBlock);
+    return createProgram(INSTANCED_VERTEX_SOURCE, fragmentSource.c_str());
+}
+
+/**
+ * Build the per-pixel lighting program
+ * Uniform "spotlightEnabled" mirrors the GL_LIGHT1 enable state, which
+ * shaders cannot query directly, and "highlightEmission" the selection
+ * tint (see setHighlighted()). Both lighting programs read the
+ * spotlight shadow uniforms set by setShadowUniforms().
+ * @param materialBlock - As for createInstancedLightingProgram()
+ */
+GLuint createPerPixelLightingProgram(bool materialBlock)
+{
+    std::string fragmentSource = fragmentSourceWithHeader(PER_PIXEL_FRAGMENT_SOURCE, materialBlock);
+    return createProgram(PER_PIXEL_VERTEX_SOURCE, fragmentSource.c_str());
+}
+
+/**
+ * Build the core-profile lighting program (GLSL 3.30)
+ * Needs the material uniform buffer; bind it with bindMaterialBlock().
+ */
+GLuint createCoreLightingProgram()
+{
+    return createProgram(CORE_VERTEX_SOURCE, CORE_FRAGMENT_SOURCE);
+}
+
+/**
+ * Build a program for mesh.h meshes in either profile: GLSL 1.30 with the
+ * position in gl_Vertex, or 3.30 core with MESH_POSITION_ATTRIBUTE. The
+ * vertex shader reads it as MESH_POSITION; the fragment shader's only
+ * output goes to color attachment 0.
+ * @param coreProfile - Build for a core-profile context
+ */
+static GLuint createMeshProgram(const char *vertexBody, const char *fragmentBody, bool coreProfile)
+{
+    std::string version = coreProfile ? "#version 330 core\n" : "#version 130\n";
+    std::string position = coreProfile ? "layout(location = 0) in vec3 meshPosition;\n"
+                                         "#define MESH_POSITION vec4(meshPosition, 1.0)\n"
+                                       : "#define MESH_POSITION gl_Vertex\n";
+    std::string vertexSource = version + position + vertexBody;
+    std::string fragmentSource = version + fragmentBody;
+    return createProgram(vertexSource.c_str(), fragmentSource.c_str());
+}
+
+/**
+ * Build the pick program
+ * @param coreProfile - Build for a core-profile context
+ */
+GLuint createPickProgram(bool coreProfile)
+{
+    return createMeshProgram(PICK_VERTEX_SOURCE, PICK_FRAGMENT_SOURCE, coreProfile);
+}
+
+/**
+ * Build the temporal anti-aliasing resolve program
+ * @param coreProfile - Build for a core-profile context
+ */
+GLuint createTemporalResolveProgram(bool coreProfile)
+{
+    return createMeshProgram(TEMPORAL_VERTEX_SOURCE, TEMPORAL_FRAGMENT_SOURCE, coreProfile);
+}
@@ -0,0 +1,41 @@
+/*
+ * GLSL Shader Helpers
+ *
+ * Compiles and links shader programs, and provides the optional
+ * per-pixel lighting program that evaluates the fixed-function lights
+ * (GL_LIGHT0 ambient fill + GL_LIGHT1 spotlight) for every fragment,
+ * plus an instanced variant of it for drawing crowds of lamps. Both
+ * also shade the clustered spotlights of lights.h. The core-profile
+ * renderer has its own copy of the lighting program without built-in
+ * state, click selection a program that writes pick IDs, and temporal
+ * anti-aliasing its resolve program.
+ */
+
+#ifndef SHADER_H
+#define SHADER_H
+
+#include "opengl.h"
+
+// Compile and link a program; returns 0 and logs the error on failure
+GLuint createProgram(const char *vertexSource, const char *fragmentSource);
+
+// Per-pixel version of the fixed-function lighting set up by setupLighting().
+// With materialBlock, specular/shininess come from the material uniform
+// buffer (indexed by "materialIndex") if the driver supports it.
+GLuint createPerPixelLightingProgram(bool materialBlock);
+
+// Same lighting for instanced lamps with per-instance matrix and color
+GLuint createInstancedLightingProgram(bool materialBlock);
+
+// GLSL 3.30 core version of the per-pixel lighting with uniform matrices
+// and lights (see corerenderer.h); materials from the uniform buffer
+GLuint createCoreLightingProgram();
+
+// ID pass for click selection (see picking.h); GLSL 1.30 in a
+// compatibility context, 3.30 in a core one
+GLuint createPickProgram(bool coreProfile);
+
+// Temporal anti-aliasing resolve (see antialias.h), same GLSL versions
+GLuint createTemporalResolveProgram(bool coreProfile);
+
+#endif // SHADER_H
@@ -0,0 +1,224 @@
+/*
+ * Spotlight Shadow Map - implementation
+ */
+
+#include "shadow.h"
+
+#include <cmath>
+
+// Light frustum depth range; the light sits inside the lampshade, so the
+// near plane has to be close
+static const float SHADOW_NEAR = 0.05f;
+static const float SHADOW_FAR = 50.0f;
+
+/**
+ * Create a depth texture with hardware depth comparison and a
+ * depth-only framebuffer around it
+ * @param size - Resolution (square)
+ * @param pcfRadius - Kernel radius, clamped to [0, MAX_PCF_RADIUS]
+ */
+bool createShadowMap(ShadowMap &shadow, int size, int pcfRadius)
+{
+    shadow.framebuffer = 0;
+    shadow.depthTexture = 0;
+    shadow.size = size;
+    shadow.pcfRadius = pcfRadius < 0 ? 0 : (pcfRadius > MAX_PCF_RADIUS ? MAX_PCF_RADIUS : pcfRadius);
+    shadow.lightView = mat4Identity();
+    shadow.lightProjection = mat4Identity();
+    shadow.valid = false;
+    shadow.casterRevision = 0;
+
+    if (!isGLVersionAtLeast(3, 0))
+    {
+        return false;
+    }
+
+    // Outside the map counts as lit: border depth 1.0 never occludes
+    const GLfloat border[] = {1.0f, 1.0f, 1.0f, 1.0f};
+    glGenTextures(1, &shadow.depthTexture);
+    glBindTexture(GL_TEXTURE_2D, shadow.depthTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, size, size, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+    glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, border);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    GLint previousFramebuffer = 0;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+    glGenFramebuffers(1, &shadow.framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, shadow.framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, shadow.depthTexture, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+
+    if (!complete)
+    {
+        deleteShadowMap(shadow);
+        return false;
+    }
+
+    // Stays bound on its own unit; only the GLSL programs sample it
+    glActiveTexture(GL_TEXTURE0 + SHADOW_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, shadow.depthTexture);
+    glActiveTexture(GL_TEXTURE0);
+    return true;
+}
+
+void deleteShadowMap(ShadowMap &shadow)
+{
+    glDeleteFramebuffers(1, &shadow.framebuffer);
+    glDeleteTextures(1, &shadow.depthTexture);
+    shadow.framebuffer = 0;
+    shadow.depthTexture = 0;
+    shadow.valid = false;
+}
+
+void invalidateShadowMap(ShadowMap &shadow)
+{
+    shadow.valid = false;
+}
+
+static bool sameVector(const float a[3], const float b[3])
+{
+    return a[0] == b[0] && a[1] == b[1] && a[2] == b[2];
+}
+
+/**
+ * Render the depth pass from the spotlight if anything it depends on
+ * changed; otherwise keep the cached depth texture
+ * @param lightPosition - Spotlight position (world space)
+ * @param lightDirection - Spotlight axis (world space)
+ * @param cutoffDegrees - Spot cutoff; the light frustum covers the cone
+ * @param casterRevision - Changes whenever caster geometry changes
+ * @param drawCasters - Draws the casters (modelview = light view)
+ */
+bool updateShadowMap(ShadowMap &shadow, const float lightPosition[3], const float lightDirection[3],
+                     float cutoffDegrees, unsigned int casterRevision, void (*drawCasters)())
+{
+    if (shadow.framebuffer == 0)
+    {
+        return false;
+    }
+    if (shadow.valid && shadow.casterRevision == casterRevision && sameVector(shadow.lightPosition, lightPosition) &&
+        sameVector(shadow.lightDirection, lightDirection))
+    {
+        return false;
+    }
+
+    for (int i = 0; i < 3; i++)
+    {
+        shadow.lightPosition[i] = lightPosition[i];
+        shadow.lightDirection[i] = lightDirection[i];
+    }
+    shadow.casterRevision = casterRevision;
+    shadow.valid = true;
+
+    // Any up vector not parallel to the spot axis works
+    const float center[3] = {lightPosition[0] + lightDirection[0], lightPosition[1] + lightDirection[1],
+                             lightPosition[2] + lightDirection[2]};
+    const float yUp[3] = {0.0f, 1.0f, 0.0f};
+    const float xUp[3] = {1.0f, 0.0f, 0.0f};
+    float length = sqrtf(lightDirection[0] * lightDirection[0] + lightDirection[1] * lightDirection[1] +
+                         lightDirection[2] * lightDirection[2]);
+    bool vertical = fabsf(lightDirection[1]) > 0.99f * length;
+    shadow.lightView = mat4LookAt(lightPosition, center, vertical ? xUp : yUp);
+    shadow.lightProjection = mat4Perspective(2.0f * cutoffDegrees, 1.0f, SHADOW_NEAR, SHADOW_FAR);
+
+    GLint previousFramebuffer = 0;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, shadow.framebuffer);
+
+    // The depth texture must not be sampled while it is being written
+    glActiveTexture(GL_TEXTURE0 + SHADOW_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE0);
+
+    glPushAttrib(GL_VIEWPORT_BIT | GL_ENABLE_BIT | GL_COLOR_BUFFER_BIT | GL_POLYGON_BIT);
+    glViewport(0, 0, shadow.size, shadow.size);
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glDisable(GL_LIGHTING);
+    glDisable(GL_BLEND);
+    glEnable(GL_DEPTH_TEST);
+    // Slope-scaled bias against self-shadowing acne
+    glEnable(GL_POLYGON_OFFSET_FILL);
+    glPolygonOffset(2.0f, 4.0f);
+    glClear(GL_DEPTH_BUFFER_BIT);
+
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadMatrixf(shadow.lightProjection.m);
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadMatrixf(shadow.lightView.m);
+
+    drawCasters();
+
+    glPopMatrix();
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+    glPopAttrib();
+
+    glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+    glActiveTexture(GL_TEXTURE0 + SHADOW_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, shadow.depthTexture);
+    glActiveTexture(GL_TEXTURE0);
+    return true;
+}
+
+ShadowUniforms getShadowUniforms(GLuint program)
+{
+    ShadowUniforms uniforms;
+    uniforms.enabled = glGetUniformLocation(program, "shadowsEnabled");
+    uniforms.matrix = glGetUniformLocation(program, "shadowMatrix");
+    uniforms.texelSize = glGetUniformLocation(program, "shadowTexelSize");
+    uniforms.pcfRadius = glGetUniformLocation(program, "pcfRadius");
+
+    GLint sampler = glGetUniformLocation(program, "shadowMap");
+    if (sampler >= 0)
+    {
+        glUseProgram(program);
+        glUniform1i(sampler, SHADOW_TEXTURE_UNIT);
+        glUseProgram(0);
+    }
+    return uniforms;
+}
+
+/**
+ * Upload the eye-space-to-shadow-map matrix and filter settings
+ * The matrix is bias * lightProjection * lightView * inverse(cameraView),
+ * so shaders can go straight from their eye positions to map coordinates.
+ */
+void setShadowUniforms(GLuint program, const ShadowUniforms &uniforms, const ShadowMap &shadow, bool enabled,
+                       const Mat4 &cameraView)
+{
+    if (program == 0 || uniforms.enabled < 0)
+    {
+        return;
+    }
+
+    glUseProgram(program);
+    bool active = enabled && shadow.valid;
+    glUniform1i(uniforms.enabled, active ? 1 : 0);
+    if (active)
+    {
+        // Clip space [-1, 1] to texture space [0, 1]
+        Mat4 matrix = mat4Identity();
+        mat4Translate(matrix, 0.5f, 0.5f, 0.5f);
+        mat4Scale(matrix, 0.5f, 0.5f, 0.5f);
+        matrix = mat4Multiply(matrix, shadow.lightProjection);
+        matrix = mat4Multiply(matrix, shadow.lightView);
+        matrix = mat4Multiply(matrix, mat4InverseRigid(cameraView));
+
+        glUniformMatrix4fv(uniforms.matrix, 1, GL_FALSE, matrix.m);
+        glUniform1f(uniforms.texelSize, 1.0f / shadow.size);
+        glUniform1i(uniforms.pcfRadius, shadow.pcfRadius);
+    }
+    glUseProgram(0);
+}
@@ -0,0 +1,69 @@
+/*
+ * Spotlight Shadow Map
+ *
+ * Depth map rendered from GL_LIGHT1 and sampled with percentage-closer
+ * filtering by the GLSL lighting programs. The depth pass is cached: it
+ * only runs again when the light transform or the shadow casters
+ * change, so static views cost one texture lookup per fragment.
+ */
+
+#ifndef SHADOW_H
+#define SHADOW_H
+
+#include "opengl.h"
+#include "matrix.h"
+
+// Texture unit the shadow map stays bound to
+const GLenum SHADOW_TEXTURE_UNIT = 1;
+
+// Largest PCF kernel radius (taps = (2r + 1)^2, each a bilinear 2x2 compare)
+const int MAX_PCF_RADIUS = 3;
+
+struct ShadowMap
+{
+    GLuint framebuffer;
+    GLuint depthTexture;
+    int size;      // Width and height in texels
+    int pcfRadius; // 0 = single (bilinear) tap
+
+    Mat4 lightView;
+    Mat4 lightProjection;
+
+    // What the depth texture currently holds
+    bool valid;
+    float lightPosition[3];
+    float lightDirection[3];
+    unsigned int casterRevision;
+};
+
+// Uniform locations of the shadow inputs in one program
+struct ShadowUniforms
+{
+    GLint enabled;
+    GLint matrix;
+    GLint texelSize;
+    GLint pcfRadius;
+};
+
+// Create the depth texture and framebuffer (GL 3.0+); false if unsupported
+bool createShadowMap(ShadowMap &shadow, int size, int pcfRadius);
+void deleteShadowMap(ShadowMap &shadow);
+
+// Re-render the depth map if the light or casters changed since the last
+// update. drawCasters() draws every caster with the current modelview
+// as world-to-light. Returns true if the depth pass ran.
+bool updateShadowMap(ShadowMap &shadow, const float lightPosition[3], const float lightDirection[3],
+                     float cutoffDegrees, unsigned int casterRevision, void (*drawCasters)());
+
+// Force the next updateShadowMap() to re-render
+void invalidateShadowMap(ShadowMap &shadow);
+
+// Query a program's shadow uniforms and point its sampler at the shadow unit
+ShadowUniforms getShadowUniforms(GLuint program);
+
+// Upload this frame's shadow state to a program (binds it temporarily);
+// cameraView is the world-to-eye matrix the program's eye positions use
+void setShadowUniforms(GLuint program, const ShadowUniforms &uniforms, const ShadowMap &shadow, bool enabled,
+                       const Mat4 &cameraView);
+
+#endif // SHADOW_H
@@ -0,0 +1,354 @@
+/*
+ * Frame-Time Instrumentation - implementation
+ *
+ * GPU timing records a GL_TIMESTAMP query at the start of every section
+ * and at the end of the frame. Queries for up to QUERY_FRAMES frames are
+ * in flight at once; results are only read once the driver reports them
+ * available, so measuring never blocks rendering.
+ */
+
+#include "stats.h"
+
+#include "opengl.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <fstream>
+#include <string>
+
+typedef std::chrono::steady_clock Clock;
+
+static const int QUERY_FRAMES = 4;                     // Frames of queries in flight
+static const int QUERIES_PER_FRAME = SECTION_COUNT + 1; // Section starts + frame end
+
+// A frame whose CPU timings are known but whose GPU queries may be pending
+struct PendingFrame
+{
+    FrameSample sample;
+    bool inFlight;
+    int stampCount;                        // Timestamp queries issued
+    int stampSection[QUERIES_PER_FRAME];   // Section started by each stamp (-1 = frame end)
+    GLuint queries[QUERIES_PER_FRAME];
+};
+
+static const char *SECTION_NAMES[SECTION_COUNT] = {"Lighting", "Shadows", "Table", "Lamps", "Resolve", "Overlay"};
+static const char *CULL_GROUP_NAMES[CULL_GROUP_COUNT] = {"lamps", "table tiles"};
+static const char *CULL_GROUP_COLUMNS[CULL_GROUP_COUNT] = {"lamps", "tiles"};
+
+static bool timerQueriesAvailable = false;
+static PendingFrame pendingFrames[QUERY_FRAMES];
+static FrameSample completedSample;
+static unsigned long frameCounter = 0;
+static unsigned long oldestInFlight = 0; // First frame number not yet completed
+
+static PendingFrame *currentFrame = NULL;
+static int currentSection = -1;
+static Clock::time_point frameStart;
+static Clock::time_point sectionStart;
+
+static std::ofstream csvFile;
+
+static double millisecondsBetween(Clock::time_point start, Clock::time_point end)
+{
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+static void clearSample(FrameSample &sample)
+{
+    sample.frame = 0;
+    sample.cpuMs = 0.0;
+    sample.gpuMs = -1.0;
+    for (int i = 0; i < SECTION_COUNT; i++)
+    {
+        sample.cpuSectionMs[i] = 0.0;
+        sample.gpuSectionMs[i] = -1.0;
+    }
+    sample.drawCalls = 0;
+    for (int i = 0; i < CULL_GROUP_COUNT; i++)
+    {
+        sample.cullTested[i] = 0;
+        sample.cullRejected[i] = 0;
+    }
+}
+
+/**
+ * Write one completed sample as a CSV row (empty fields for missing GPU data)
+ */
+static void writeCsvRow(const FrameSample &sample)
+{
+    if (!csvFile.is_open())
+    {
+        return;
+    }
+    csvFile << sample.frame << ',' << sample.cpuMs << ',';
+    if (sample.gpuMs >= 0.0)
+    {
+        csvFile << sample.gpuMs;
+    }
+    for (int i = 0; i < SECTION_COUNT; i++)
+    {
+        csvFile << ',' << sample.cpuSectionMs[i];
+    }
+    for (int i = 0; i < SECTION_COUNT; i++)
+    {
+        csvFile << ',';
+        if (sample.gpuSectionMs[i] >= 0.0)
+        {
+            csvFile << sample.gpuSectionMs[i];
+        }
+    }
+    csvFile << ',' << sample.drawCalls;
+    for (int i = 0; i < CULL_GROUP_COUNT; i++)
+    {
+        csvFile << ',' << sample.cullTested[i] << ',' << sample.cullRejected[i];
+    }
+    csvFile << '\n';
+}
+
+static void completeFrame(PendingFrame &pending)
+{
+    pending.inFlight = false;
+    completedSample = pending.sample;
+    writeCsvRow(completedSample);
+    oldestInFlight = pending.sample.frame + 1;
+}
+
+/**
+ * Read back the GPU timestamps of a frame and derive section durations
+ * @param wait - Block until results are ready instead of polling
+ * @return true if the frame was completed
+ */
+static bool collectFrame(PendingFrame &pending, bool wait)
+{
+    if (pending.stampCount == 0)
+    {
+        completeFrame(pending);
+        return true;
+    }
+
+    // Queries complete in order, so the last one signals the whole frame
+    if (!wait)
+    {
+        GLuint available = GL_FALSE;
+        glGetQueryObjectuiv(pending.queries[pending.stampCount - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available != GL_TRUE)
+        {
+            return false;
+        }
+    }
+
+    GLuint64 stamps[QUERIES_PER_FRAME];
+    for (int i = 0; i < pending.stampCount; i++)
+    {
+        glGetQueryObjectui64v(pending.queries[i], GL_QUERY_RESULT, &stamps[i]);
+    }
+    for (int i = 0; i + 1 < pending.stampCount; i++)
+    {
+        double &sectionMs = pending.sample.gpuSectionMs[pending.stampSection[i]];
+        sectionMs = std::max(sectionMs, 0.0) + (double)(stamps[i + 1] - stamps[i]) / 1.0e6;
+    }
+    pending.sample.gpuMs = (double)(stamps[pending.stampCount - 1] - stamps[0]) / 1.0e6;
+    completeFrame(pending);
+    return true;
+}
+
+/**
+ * Complete in-flight frames, oldest first, whose results are ready
+ */
+static void collectFinishedFrames(bool wait)
+{
+    while (oldestInFlight < frameCounter)
+    {
+        PendingFrame &pending = pendingFrames[oldestInFlight % QUERY_FRAMES];
+        if (!pending.inFlight || pending.sample.frame != oldestInFlight)
+        {
+            oldestInFlight++;
+            continue;
+        }
+        if (!collectFrame(pending, wait))
+        {
+            return;
+        }
+    }
+}
+
+static void issueTimestamp(int section)
+{
+    if (!timerQueriesAvailable || currentFrame == NULL || currentFrame->stampCount >= QUERIES_PER_FRAME)
+    {
+        return;
+    }
+    glQueryCounter(currentFrame->queries[currentFrame->stampCount], GL_TIMESTAMP);
+    currentFrame->stampSection[currentFrame->stampCount] = section;
+    currentFrame->stampCount++;
+}
+
+/**
+ * Allocate timestamp queries for every frame slot
+ */
+void initFrameStats()
+{
+    clearSample(completedSample);
+    timerQueriesAvailable = isGLVersionAtLeast(3, 3);
+    for (int i = 0; i < QUERY_FRAMES; i++)
+    {
+        pendingFrames[i].inFlight = false;
+        pendingFrames[i].stampCount = 0;
+        if (timerQueriesAvailable)
+        {
+            glGenQueries(QUERIES_PER_FRAME, pendingFrames[i].queries);
+        }
+    }
+}
+
+/**
+ * Open a CSV file and write the header row
+ * @param path - Output file, truncated if it exists
+ */
+bool openStatsCsv(const char *path)
+{
+    csvFile.open(path, std::ios::out | std::ios::trunc);
+    if (!csvFile.is_open())
+    {
+        return false;
+    }
+
+    csvFile << "frame,cpu_ms,gpu_ms";
+    const char *suffixes[2] = {"_cpu_ms", "_gpu_ms"};
+    for (int kind = 0; kind < 2; kind++)
+    {
+        for (int i = 0; i < SECTION_COUNT; i++)
+        {
+            std::string name = SECTION_NAMES[i];
+            for (size_t c = 0; c < name.size(); c++)
+            {
+                name[c] = (char)tolower(name[c]);
+            }
+            csvFile << ',' << name << suffixes[kind];
+        }
+    }
+    csvFile << ",draw_calls";
+    for (int i = 0; i < CULL_GROUP_COUNT; i++)
+    {
+        csvFile << ',' << CULL_GROUP_COLUMNS[i] << "_tested," << CULL_GROUP_COLUMNS[i] << "_culled";
+    }
+    csvFile << '\n';
+    return true;
+}
+
+/**
+ * Wait for outstanding GPU results, write them and close the CSV file
+ */
+void closeStatsCsv()
+{
+    if (!csvFile.is_open())
+    {
+        return;
+    }
+    collectFinishedFrames(true);
+    csvFile.close();
+}
+
+/**
+ * Start timing a frame (call at the top of the display callback)
+ */
+void beginFrameStats()
+{
+    collectFinishedFrames(false);
+
+    // GPU more than QUERY_FRAMES behind: give up on the oldest frame's
+    // GPU timing rather than stalling on it
+    PendingFrame &pending = pendingFrames[frameCounter % QUERY_FRAMES];
+    if (pending.inFlight)
+    {
+        pending.stampCount = 0;
+        completeFrame(pending);
+    }
+
+    clearSample(pending.sample);
+    pending.sample.frame = frameCounter;
+    pending.stampCount = 0;
+    pending.inFlight = true;
+    currentFrame = &pending;
+    currentSection = -1;
+    frameStart = Clock::now();
+    sectionStart = frameStart;
+}
+
+/**
+ * Close the running section (if any) and start timing another one
+ */
+void beginSection(FrameSection section)
+{
+    if (currentFrame == NULL)
+    {
+        return;
+    }
+    Clock::time_point now = Clock::now();
+    if (currentSection >= 0)
+    {
+        currentFrame->sample.cpuSectionMs[currentSection] += millisecondsBetween(sectionStart, now);
+    }
+    currentSection = section;
+    sectionStart = now;
+    issueTimestamp(section);
+}
+
+/**
+ * Finish the frame; GPU timings are collected on a later frame
+ */
+void endFrameStats()
+{
+    if (currentFrame == NULL)
+    {
+        return;
+    }
+    Clock::time_point now = Clock::now();
+    if (currentSection >= 0)
+    {
+        currentFrame->sample.cpuSectionMs[currentSection] += millisecondsBetween(sectionStart, now);
+    }
+    currentFrame->sample.cpuMs = millisecondsBetween(frameStart, now);
+    issueTimestamp(-1);
+
+    if (currentFrame->stampCount == 0)
+    {
+        completeFrame(*currentFrame);
+    }
+    currentFrame = NULL;
+    currentSection = -1;
+    frameCounter++;
+}
+
+void countDrawCalls(int count)
+{
+    if (currentFrame != NULL)
+    {
+        currentFrame->sample.drawCalls += count;
+    }
+}
+
+void countCulling(CullGroup group, int tested, int rejected)
+{
+    if (currentFrame != NULL)
+    {
+        currentFrame->sample.cullTested[group] += tested;
+        currentFrame->sample.cullRejected[group] += rejected;
+    }
+}
+
+const FrameSample &lastFrameSample()
+{
+    return completedSample;
+}
+
+const char *frameSectionName(FrameSection section)
+{
+    return SECTION_NAMES[section];
+}
+
+const char *cullGroupName(CullGroup group)
+{
+    return CULL_GROUP_NAMES[group];
+}
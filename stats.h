@@ -0,0 +1,70 @@
+/*
+ * Frame-Time Instrumentation
+ *
+ * Measures every rendered frame: CPU time per section and in total,
+ * GPU time per section from timestamp queries, and the number of draw
+ * calls issued. GPU results are collected a few frames later without
+ * stalling the pipeline. Completed samples can be streamed to a CSV file.
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+// Parts of a frame that are timed separately
+enum FrameSection
+{
+    SECTION_LIGHTING = 0, // Camera, forward kinematics and light setup
+    SECTION_SHADOWS,      // Shadow depth pass (zero while cached)
+    SECTION_TABLE,        // Table surface
+    SECTION_LAMPS,        // Lamp hierarchy (and crowd)
+    SECTION_RESOLVE,      // Anti-aliasing resolve (zero when off)
+    SECTION_OVERLAY,      // 2D text overlay
+    SECTION_COUNT
+};
+
+// Kinds of objects tested against the view frustum
+enum CullGroup
+{
+    CULL_LAMPS = 0,   // Main lamp and crowd lamps
+    CULL_TABLE_TILES, // Table surface tiles
+    CULL_GROUP_COUNT
+};
+
+struct FrameSample
+{
+    unsigned long frame;                // Frame number, starting at 0
+    double cpuMs;                       // CPU time from beginFrameStats() to endFrameStats()
+    double gpuMs;                       // GPU time for the same span, < 0 if unavailable
+    double cpuSectionMs[SECTION_COUNT]; // CPU time per section
+    double gpuSectionMs[SECTION_COUNT]; // GPU time per section, < 0 if unavailable
+    int drawCalls;                      // Draw calls issued during the frame
+    int cullTested[CULL_GROUP_COUNT];   // Objects tested against the frustum
+    int cullRejected[CULL_GROUP_COUNT]; // Of those, outside and not drawn
+};
+
+// Create GPU timer queries (needs a current context; GPU times stay
+// unavailable on contexts without GL 3.3 timer queries)
+void initFrameStats();
+
+// Stream every completed sample to a CSV file; returns false on error
+bool openStatsCsv(const char *path);
+void closeStatsCsv();
+
+void beginFrameStats();
+void beginSection(FrameSection section); // Also ends the previous section
+void endFrameStats();
+
+// Add to the current frame's draw call count
+void countDrawCalls(int count);
+
+// Add frustum test results to the current frame
+void countCulling(CullGroup group, int tested, int rejected);
+
+// Most recent frame whose GPU timings have been collected
+const FrameSample &lastFrameSample();
+
+// Section names for overlays and CSV headers
+const char *frameSectionName(FrameSection section);
+const char *cullGroupName(CullGroup group);
+
+#endif // STATS_H
@@ -0,0 +1,369 @@
+/*
+ * Compile-Time Tessellation
+ *
+ * The lamp's primitives are fully determined by its dimension constants
+ * and fixed slice counts, so the compiler can produce their vertex data.
+ * Each constexpr function below returns one element of a primitive's
+ * interleaved position/normal array (or of its index list) from the
+ * element's position alone; the *Table() templates expand them over an
+ * index list into an aggregate. Stored in a constexpr variable the table
+ * is plain read-only data, uploaded as is. The runtime tessellators in
+ * mesh.cpp fill their arrays from the same functions, so both paths
+ * produce identical meshes in the GLU quadric layout.
+ *
+ * C++11 constexpr functions are a single return statement, hence the
+ * recursion in place of loops. Trigonometry is a Taylor series in double
+ * precision, accurate to well below a float's resolution.
+ */
+
+#ifndef TESSELLATION_H
+#define TESSELLATION_H
+
+#include "mesh.h"
+
+// Floats per interleaved vertex: position (xyz) + normal (xyz)
+constexpr int VERTEX_FLOATS = 6;
+
+constexpr double TESSELLATION_PI = 3.14159265358979323846;
+
+// ------------------------------------------------------------------------
+// constexpr math
+// ------------------------------------------------------------------------
+
+// Sum of the remaining Taylor terms, each derived from the previous one
+constexpr double sineSeries(double xSquared, double term, int n, int terms)
+{
+    return terms == 0 ? 0.0
+                      : term + sineSeries(xSquared, -term * xSquared / ((2 * n + 2) * (2 * n + 3)), n + 1, terms - 1);
+}
+
+constexpr double cosineSeries(double xSquared, double term, int n, int terms)
+{
+    return terms == 0 ? 0.0
+                      : term + cosineSeries(xSquared, -term * xSquared / ((2 * n + 1) * (2 * n + 2)), n + 1, terms - 1);
+}
+
+// Bring an angle in [0, 2 pi] into [-pi, pi], where 12 terms converge
+constexpr double reduceAngle(double x)
+{
+    return x > TESSELLATION_PI ? x - 2.0 * TESSELLATION_PI : x;
+}
+
+constexpr double constexprSine(double x)
+{
+    return sineSeries(reduceAngle(x) * reduceAngle(x), reduceAngle(x), 0, 12);
+}
+
+constexpr double constexprCosine(double x)
+{
+    return cosineSeries(reduceAngle(x) * reduceAngle(x), 1.0, 0, 12);
+}
+
+// Newton iteration; x must not be negative
+constexpr double sqrtIteration(double x, double guess, int iterations)
+{
+    return iterations == 0 || guess == 0.0 ? guess : sqrtIteration(x, 0.5 * (guess + x / guess), iterations - 1);
+}
+
+constexpr double constexprSqrt(double x)
+{
+    return sqrtIteration(x, x > 1.0 ? x : 1.0, 40);
+}
+
+// Angle of slice i around the Z-axis; the last slice wraps exactly onto
+// the first to avoid a seam
+constexpr double sliceAngle(int i, int slices)
+{
+    return 2.0 * TESSELLATION_PI * (double)(i % slices) / (double)slices;
+}
+
+// ------------------------------------------------------------------------
+// Cylinder: triangle strip along +Z, bottom and top vertex per slice
+// ------------------------------------------------------------------------
+
+constexpr int cylinderFloats(int slices)
+{
+    return (slices + 1) * 2 * VERTEX_FLOATS;
+}
+
+// Side normals tilt toward +Z when the cylinder narrows (cone)
+constexpr double cylinderSlant(float baseRadius, float topRadius, float height)
+{
+    return constexprSqrt((double)height * height + (double)(baseRadius - topRadius) * (baseRadius - topRadius));
+}
+
+constexpr float cylinderComponent(float baseRadius, float topRadius, float height, double angle, bool top,
+                                  int component)
+{
+    return component == 0   ? (float)((top ? topRadius : baseRadius) * constexprSine(angle))
+           : component == 1 ? (float)((top ? topRadius : baseRadius) * constexprCosine(angle))
+           : component == 2 ? (top ? height : 0.0f)
+           : component == 3
+               ? (float)(constexprSine(angle) * height / cylinderSlant(baseRadius, topRadius, height))
+           : component == 4
+               ? (float)(constexprCosine(angle) * height / cylinderSlant(baseRadius, topRadius, height))
+               : (float)((baseRadius - topRadius) / cylinderSlant(baseRadius, topRadius, height));
+}
+
+// Element index of createCylinderMesh()'s vertex array
+constexpr float cylinderFloat(float baseRadius, float topRadius, float height, int slices, int index)
+{
+    return cylinderComponent(baseRadius, topRadius, height, sliceAngle(index / VERTEX_FLOATS / 2, slices),
+                             (index / VERTEX_FLOATS) % 2 == 1, index % VERTEX_FLOATS);
+}
+
+// ------------------------------------------------------------------------
+// Disk: triangle fan in the XY-plane facing +Z, counter-clockwise
+// ------------------------------------------------------------------------
+
+constexpr int diskFloats(int slices)
+{
+    return (slices + 2) * VERTEX_FLOATS;
+}
+
+constexpr float diskComponent(float radius, double angle, bool center, int component)
+{
+    return component == 5   ? 1.0f
+           : center         ? 0.0f
+           : component == 0 ? (float)(radius * constexprSine(angle))
+           : component == 1 ? (float)(radius * constexprCosine(angle))
+                            : 0.0f;
+}
+
+// Element index of createDiskMesh()'s vertex array: the center, then
+// the rim from slice `slices` down to 0, like gluDisk()
+constexpr float diskFloat(float radius, int slices, int index)
+{
+    return diskComponent(radius, sliceAngle(slices - (index / VERTEX_FLOATS - 1), slices), index < VERTEX_FLOATS,
+                         index % VERTEX_FLOATS);
+}
+
+// ------------------------------------------------------------------------
+// Sphere: indexed triangles, rings from the +Z pole to the -Z pole
+// ------------------------------------------------------------------------
+
+constexpr int sphereFloats(int slices, int stacks)
+{
+    return (stacks + 1) * (slices + 1) * VERTEX_FLOATS;
+}
+
+constexpr int sphereIndexCount(int slices, int stacks)
+{
+    return stacks * slices * 6;
+}
+
+// Normal component of the vertex at ring angle phi and slice angle
+constexpr double sphereNormal(double phi, double angle, int axis)
+{
+    return axis == 0 ? constexprSine(angle) * constexprSine(phi)
+           : axis == 1 ? constexprCosine(angle) * constexprSine(phi)
+                       : constexprCosine(phi);
+}
+
+constexpr float sphereComponent(float radius, double phi, double angle, int component)
+{
+    return component < 3 ? (float)(sphereNormal(phi, angle, component) * radius)
+                         : (float)sphereNormal(phi, angle, component - 3);
+}
+
+// Element index of createSphereMesh()'s vertex array
+constexpr float sphereFloat(float radius, int slices, int stacks, int index)
+{
+    return sphereComponent(radius, TESSELLATION_PI * (double)(index / VERTEX_FLOATS / (slices + 1)) / (double)stacks,
+                           sliceAngle(index / VERTEX_FLOATS % (slices + 1), slices), index % VERTEX_FLOATS);
+}
+
+// Two triangles per quad: (upper, lower, upper + 1), (upper + 1, lower, lower + 1)
+constexpr GLuint sphereQuadIndex(GLuint upper, GLuint lower, int corner)
+{
+    return corner == 0 ? upper : corner == 1 || corner == 4 ? lower : corner == 5 ? lower + 1 : upper + 1;
+}
+
+// Element index of createSphereMesh()'s index list
+constexpr GLuint sphereIndex(int slices, int index)
+{
+    return sphereQuadIndex((GLuint)(index / 6 / slices * (slices + 1) + index / 6 % slices),
+                           (GLuint)((index / 6 / slices + 1) * (slices + 1) + index / 6 % slices), index % 6);
+}
+
+// ------------------------------------------------------------------------
+// Tables
+// ------------------------------------------------------------------------
+
+template <int... I> struct IndexList
+{
+    typedef IndexList type;
+};
+
+template <class First, class Second> struct JoinIndexLists;
+
+template <int... First, int... Second> struct JoinIndexLists<IndexList<First...>, IndexList<Second...>>
+{
+    typedef IndexList<First..., (int)sizeof...(First) + Second...> type;
+};
+
+// IndexList<0, 1, ..., N - 1>, built by halves so the template nesting
+// stays logarithmic in N
+template <int N>
+struct MakeIndexList : JoinIndexLists<typename MakeIndexList<N / 2>::type, typename MakeIndexList<N - N / 2>::type>
+{
+};
+
+template <> struct MakeIndexList<0>
+{
+    typedef IndexList<> type;
+};
+
+template <> struct MakeIndexList<1>
+{
+    typedef IndexList<0> type;
+};
+
+template <int N> struct VertexTable
+{
+    GLfloat values[N];
+};
+
+template <int N> struct IndexTable
+{
+    GLuint values[N];
+};
+
+template <int Slices, int... I>
+constexpr VertexTable<sizeof...(I)> expandCylinder(float baseRadius, float topRadius, float height, IndexList<I...>)
+{
+    return VertexTable<sizeof...(I)>{{cylinderFloat(baseRadius, topRadius, height, Slices, I)...}};
+}
+
+template <int Slices, int... I> constexpr VertexTable<sizeof...(I)> expandDisk(float radius, IndexList<I...>)
+{
+    return VertexTable<sizeof...(I)>{{diskFloat(radius, Slices, I)...}};
+}
+
+template <int Slices, int Stacks, int... I>
+constexpr VertexTable<sizeof...(I)> expandSphere(float radius, IndexList<I...>)
+{
+    return VertexTable<sizeof...(I)>{{sphereFloat(radius, Slices, Stacks, I)...}};
+}
+
+template <int Slices, int... I> constexpr IndexTable<sizeof...(I)> expandSphereIndices(IndexList<I...>)
+{
+    return IndexTable<sizeof...(I)>{{sphereIndex(Slices, I)...}};
+}
+
+// Equivalent of createCylinderMesh(baseRadius, topRadius, height, Slices)
+template <int Slices>
+constexpr VertexTable<cylinderFloats(Slices)> cylinderTable(float baseRadius, float topRadius, float height)
+{
+    return expandCylinder<Slices>(baseRadius, topRadius, height,
+                                  typename MakeIndexList<cylinderFloats(Slices)>::type());
+}
+
+// Equivalent of createDiskMesh(radius, Slices)
+template <int Slices> constexpr VertexTable<diskFloats(Slices)> diskTable(float radius)
+{
+    return expandDisk<Slices>(radius, typename MakeIndexList<diskFloats(Slices)>::type());
+}
+
+// Equivalent of createSphereMesh(radius, Slices, Stacks): vertices and indices
+template <int Slices, int Stacks> constexpr VertexTable<sphereFloats(Slices, Stacks)> sphereTable(float radius)
+{
+    return expandSphere<Slices, Stacks>(radius, typename MakeIndexList<sphereFloats(Slices, Stacks)>::type());
+}
+
+template <int Slices, int Stacks> constexpr IndexTable<sphereIndexCount(Slices, Stacks)> sphereIndexTable()
+{
+    return expandSphereIndices<Slices>(typename MakeIndexList<sphereIndexCount(Slices, Stacks)>::type());
+}
+
+// ------------------------------------------------------------------------
+// LOD chains: every level of createCylinderLod() and friends
+// ------------------------------------------------------------------------
+
+static_assert(LOD_COUNT == 3, "the LOD tables below list one member per level");
+
+template <int Slices> struct CylinderLodTable
+{
+    VertexTable<cylinderFloats(lodSlices(Slices, 0))> level0;
+    VertexTable<cylinderFloats(lodSlices(Slices, 1))> level1;
+    VertexTable<cylinderFloats(lodSlices(Slices, 2))> level2;
+};
+
+template <int Slices> struct DiskLodTable
+{
+    VertexTable<diskFloats(lodSlices(Slices, 0))> level0;
+    VertexTable<diskFloats(lodSlices(Slices, 1))> level1;
+    VertexTable<diskFloats(lodSlices(Slices, 2))> level2;
+};
+
+template <int Slices, int Stacks> struct SphereLodTable
+{
+    VertexTable<sphereFloats(lodSlices(Slices, 0), lodSlices(Stacks, 0))> level0;
+    VertexTable<sphereFloats(lodSlices(Slices, 1), lodSlices(Stacks, 1))> level1;
+    VertexTable<sphereFloats(lodSlices(Slices, 2), lodSlices(Stacks, 2))> level2;
+    IndexTable<sphereIndexCount(lodSlices(Slices, 0), lodSlices(Stacks, 0))> indices0;
+    IndexTable<sphereIndexCount(lodSlices(Slices, 1), lodSlices(Stacks, 1))> indices1;
+    IndexTable<sphereIndexCount(lodSlices(Slices, 2), lodSlices(Stacks, 2))> indices2;
+};
+
+template <int Slices>
+constexpr CylinderLodTable<Slices> cylinderLodTable(float baseRadius, float topRadius, float height)
+{
+    return CylinderLodTable<Slices>{cylinderTable<lodSlices(Slices, 0)>(baseRadius, topRadius, height),
+                                    cylinderTable<lodSlices(Slices, 1)>(baseRadius, topRadius, height),
+                                    cylinderTable<lodSlices(Slices, 2)>(baseRadius, topRadius, height)};
+}
+
+template <int Slices> constexpr DiskLodTable<Slices> diskLodTable(float radius)
+{
+    return DiskLodTable<Slices>{diskTable<lodSlices(Slices, 0)>(radius), diskTable<lodSlices(Slices, 1)>(radius),
+                                diskTable<lodSlices(Slices, 2)>(radius)};
+}
+
+template <int Slices, int Stacks> constexpr SphereLodTable<Slices, Stacks> sphereLodTable(float radius)
+{
+    return SphereLodTable<Slices, Stacks>{sphereTable<lodSlices(Slices, 0), lodSlices(Stacks, 0)>(radius),
+                                          sphereTable<lodSlices(Slices, 1), lodSlices(Stacks, 1)>(radius),
+                                          sphereTable<lodSlices(Slices, 2), lodSlices(Stacks, 2)>(radius),
+                                          sphereIndexTable<lodSlices(Slices, 0), lodSlices(Stacks, 0)>(),
+                                          sphereIndexTable<lodSlices(Slices, 1), lodSlices(Stacks, 1)>(),
+                                          sphereIndexTable<lodSlices(Slices, 2), lodSlices(Stacks, 2)>()};
+}
+
+// Describe one level of a table for createCylinderLod() and friends
+template <int N> MeshData meshData(GLenum mode, const VertexTable<N> &vertices, int slices)
+{
+    MeshData data = {mode, vertices.values, N, NULL, 0, slices};
+    return data;
+}
+
+template <int N, int M>
+MeshData meshData(GLenum mode, const VertexTable<N> &vertices, const IndexTable<M> &indices, int slices)
+{
+    MeshData data = {mode, vertices.values, N, indices.values, M, slices};
+    return data;
+}
+
+template <int Slices> void describeLevels(const CylinderLodTable<Slices> &table, MeshData levels[LOD_COUNT])
+{
+    levels[0] = meshData(GL_TRIANGLE_STRIP, table.level0, lodSlices(Slices, 0));
+    levels[1] = meshData(GL_TRIANGLE_STRIP, table.level1, lodSlices(Slices, 1));
+    levels[2] = meshData(GL_TRIANGLE_STRIP, table.level2, lodSlices(Slices, 2));
+}
+
+template <int Slices> void describeLevels(const DiskLodTable<Slices> &table, MeshData levels[LOD_COUNT])
+{
+    levels[0] = meshData(GL_TRIANGLE_FAN, table.level0, lodSlices(Slices, 0));
+    levels[1] = meshData(GL_TRIANGLE_FAN, table.level1, lodSlices(Slices, 1));
+    levels[2] = meshData(GL_TRIANGLE_FAN, table.level2, lodSlices(Slices, 2));
+}
+
+template <int Slices, int Stacks>
+void describeLevels(const SphereLodTable<Slices, Stacks> &table, MeshData levels[LOD_COUNT])
+{
+    levels[0] = meshData(GL_TRIANGLES, table.level0, table.indices0, lodSlices(Slices, 0));
+    levels[1] = meshData(GL_TRIANGLES, table.level1, table.indices1, lodSlices(Slices, 1));
+    levels[2] = meshData(GL_TRIANGLES, table.level2, table.indices2, lodSlices(Slices, 2));
+}
+
+#endif // TESSELLATION_H
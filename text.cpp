@@ -0,0 +1,298 @@
+/*
+ * Batched Bitmap Text - implementation
+ *
+ * The atlas is made by drawing each glyph with glutBitmapCharacter into
+ * a framebuffer and reading it back, so batched text is pixel-identical
+ * to the per-glyph glBitmap path it replaces.
+ */
+
+#include "text.h"
+
+#include "stats.h"
+
+#include <GL/freeglut_ext.h> // glutBitmapHeight
+
+#include <algorithm>
+
+static const int FIRST_GLYPH = 32; // Space
+static const int LAST_GLYPH = 126; // Tilde
+static const int GLYPH_COUNT = LAST_GLYPH - FIRST_GLYPH + 1;
+static const int ATLAS_COLUMNS = 16;
+
+// Margin around each glyph cell; must cover the font's bitmap origin
+// offsets (descenders, overhangs), which GLUT does not expose
+static const int GLYPH_PADDING = 8;
+
+struct GlyphInfo
+{
+    int advance;  // Horizontal pen movement in pixels
+    int atlasX;   // Lower-left corner of the cell in the atlas
+    int atlasY;
+};
+
+struct FontAtlas
+{
+    GLuint texture;
+    int width;
+    int height;
+    int cellHeight;
+    GlyphInfo glyphs[GLYPH_COUNT];
+};
+
+static FontAtlas atlas = {0, 0, 0, 0, {}};
+static void *glutFallbackFont = NULL; // Set when the atlas could not be built
+
+/**
+ * Rasterize glyphs FIRST_GLYPH..LAST_GLYPH of a GLUT bitmap font into an
+ * alpha texture, one padded cell per glyph
+ * @param font - GLUT bitmap font, e.g. GLUT_BITMAP_HELVETICA_18
+ */
+bool createFontAtlas(void *font)
+{
+    if (!isGLVersionAtLeast(3, 0))
+    {
+        glutFallbackFont = font;
+        return false;
+    }
+
+    int maxAdvance = 0;
+    for (int i = 0; i < GLYPH_COUNT; i++)
+    {
+        atlas.glyphs[i].advance = glutBitmapWidth(font, FIRST_GLYPH + i);
+        maxAdvance = std::max(maxAdvance, atlas.glyphs[i].advance);
+    }
+    int cellWidth = maxAdvance + 2 * GLYPH_PADDING;
+    atlas.cellHeight = glutBitmapHeight(font) + 2 * GLYPH_PADDING;
+    atlas.width = ATLAS_COLUMNS * cellWidth;
+    atlas.height = ((GLYPH_COUNT + ATLAS_COLUMNS - 1) / ATLAS_COLUMNS) * atlas.cellHeight;
+
+    // Scratch framebuffer with a single color attachment
+    GLint previousFramebuffer = 0;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+    GLuint colorBuffer = 0;
+    GLuint framebuffer = 0;
+    glGenRenderbuffers(1, &colorBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, atlas.width, atlas.height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    std::vector<GLubyte> pixels(atlas.width * atlas.height);
+    if (complete)
+    {
+        glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT | GL_COLOR_BUFFER_BIT | GL_VIEWPORT_BIT | GL_PIXEL_MODE_BIT);
+        glDisable(GL_LIGHTING);
+        glDisable(GL_DEPTH_TEST);
+        glDisable(GL_BLEND);
+        glDisable(GL_TEXTURE_2D);
+        glViewport(0, 0, atlas.width, atlas.height);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
+
+        for (int i = 0; i < GLYPH_COUNT; i++)
+        {
+            GlyphInfo &glyph = atlas.glyphs[i];
+            glyph.atlasX = (i % ATLAS_COLUMNS) * cellWidth;
+            glyph.atlasY = (i / ATLAS_COLUMNS) * atlas.cellHeight;
+            // Pen position, in window coordinates independent of matrices
+            glWindowPos2i(glyph.atlasX + GLYPH_PADDING, glyph.atlasY + GLYPH_PADDING);
+            glutBitmapCharacter(font, FIRST_GLYPH + i);
+        }
+
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, atlas.width, atlas.height, GL_RED, GL_UNSIGNED_BYTE, &pixels[0]);
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        glPopAttrib();
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteRenderbuffers(1, &colorBuffer);
+    if (!complete)
+    {
+        glutFallbackFont = font;
+        return false;
+    }
+
+    glGenTextures(1, &atlas.texture);
+    glBindTexture(GL_TEXTURE_2D, atlas.texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA8, atlas.width, atlas.height, 0, GL_ALPHA, GL_UNSIGNED_BYTE, &pixels[0]);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return true;
+}
+
+/**
+ * Start submitting this frame's lines
+ */
+void beginText(TextOverlay &overlay)
+{
+    overlay.lineCount = 0;
+}
+
+/**
+ * Submit a line; only marks the layout dirty if it differs from the
+ * line submitted in the same position last time
+ * @param x - Left edge in window pixels
+ * @param y - Baseline in window pixels from the bottom of the window
+ * @param text - Text to draw (characters outside ASCII 32-126 are skipped)
+ */
+void addText(TextOverlay &overlay, float x, float y, const std::string &text)
+{
+    size_t index = overlay.lineCount++;
+    if (index == overlay.lines.size())
+    {
+        overlay.lines.push_back(TextLine());
+        overlay.dirty = true;
+    }
+
+    TextLine &line = overlay.lines[index];
+    if (line.x != x || line.y != y || line.text != text)
+    {
+        line.x = x;
+        line.y = y;
+        line.text = text;
+        overlay.dirty = true;
+    }
+}
+
+/**
+ * Rebuild the vertex buffer from the submitted lines: two triangles per
+ * glyph with interleaved position and texture coordinates
+ */
+static void layoutText(TextOverlay &overlay)
+{
+    std::vector<GLfloat> vertices;
+    float invWidth = 1.0f / atlas.width;
+    float invHeight = 1.0f / atlas.height;
+
+    for (size_t l = 0; l < overlay.lines.size(); l++)
+    {
+        const TextLine &line = overlay.lines[l];
+        float penX = line.x;
+        for (size_t c = 0; c < line.text.size(); c++)
+        {
+            int code = (unsigned char)line.text[c];
+            if (code < FIRST_GLYPH || code > LAST_GLYPH)
+            {
+                continue;
+            }
+            const GlyphInfo &glyph = atlas.glyphs[code - FIRST_GLYPH];
+            int cellWidth = glyph.advance + 2 * GLYPH_PADDING;
+
+            float x0 = penX - GLYPH_PADDING;
+            float y0 = line.y - GLYPH_PADDING;
+            float x1 = x0 + cellWidth;
+            float y1 = y0 + atlas.cellHeight;
+            float u0 = glyph.atlasX * invWidth;
+            float v0 = glyph.atlasY * invHeight;
+            float u1 = (glyph.atlasX + cellWidth) * invWidth;
+            float v1 = (glyph.atlasY + atlas.cellHeight) * invHeight;
+
+            const GLfloat quad[] = {x0, y0, u0, v0, x1, y0, u1, v0, x1, y1, u1, v1,
+                                    x0, y0, u0, v0, x1, y1, u1, v1, x0, y1, u0, v1};
+            vertices.insert(vertices.end(), quad, quad + 24);
+            penX += glyph.advance;
+        }
+    }
+
+    if (overlay.vertexBuffer == 0)
+    {
+        glGenBuffers(1, &overlay.vertexBuffer);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, overlay.vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat), vertices.empty() ? NULL : &vertices[0],
+                 GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    overlay.vertexCount = (GLsizei)(vertices.size() / 4);
+    overlay.dirty = false;
+}
+
+/**
+ * Per-glyph path used when no atlas exists
+ */
+static void drawTextWithGlut(const TextOverlay &overlay)
+{
+    for (size_t l = 0; l < overlay.lineCount; l++)
+    {
+        const TextLine &line = overlay.lines[l];
+        glRasterPos2f(line.x, line.y);
+        for (char c : line.text)
+        {
+            glutBitmapCharacter(glutFallbackFont, c);
+        }
+        countDrawCalls((int)line.text.size());
+    }
+}
+
+/**
+ * Draw every submitted line with a single draw call
+ */
+void drawTextOverlay(TextOverlay &overlay)
+{
+    // Lines dropped since the last frame also change the layout
+    if (overlay.lineCount != overlay.lines.size())
+    {
+        overlay.lines.resize(overlay.lineCount);
+        overlay.dirty = true;
+    }
+
+    if (atlas.texture == 0)
+    {
+        if (glutFallbackFont != NULL)
+        {
+            drawTextWithGlut(overlay);
+        }
+        return;
+    }
+
+    if (overlay.dirty)
+    {
+        layoutText(overlay);
+    }
+    if (overlay.vertexCount == 0)
+    {
+        return;
+    }
+
+    // Alpha test discards the empty cell padding like glBitmap skips
+    // unset bits, so overlapping cells never hide each other's glyphs
+    glPushAttrib(GL_ENABLE_BIT | GL_COLOR_BUFFER_BIT);
+    glEnable(GL_TEXTURE_2D);
+    glEnable(GL_ALPHA_TEST);
+    glAlphaFunc(GL_GREATER, 0.0f);
+    glBindTexture(GL_TEXTURE_2D, atlas.texture);
+
+    glBindBuffer(GL_ARRAY_BUFFER, overlay.vertexBuffer);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glVertexPointer(2, GL_FLOAT, 4 * sizeof(GLfloat), (const GLvoid *)0);
+    glTexCoordPointer(2, GL_FLOAT, 4 * sizeof(GLfloat), (const GLvoid *)(2 * sizeof(GLfloat)));
+    glDrawArrays(GL_TRIANGLES, 0, overlay.vertexCount);
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    countDrawCalls(1);
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glPopAttrib();
+}
+
+void deleteTextOverlay(TextOverlay &overlay)
+{
+    glDeleteBuffers(1, &overlay.vertexBuffer);
+    overlay.vertexBuffer = 0;
+    overlay.vertexCount = 0;
+    overlay.lines.clear();
+    overlay.lineCount = 0;
+    overlay.dirty = true;
+}
@@ -0,0 +1,49 @@
+/*
+ * Batched Bitmap Text
+ *
+ * Rasterizes a GLUT bitmap font into an atlas texture once, then draws
+ * text as textured quads. Every line of a TextOverlay goes into one
+ * vertex buffer drawn with a single call, and the buffer is only rebuilt
+ * when a line's text or position changes.
+ */
+
+#ifndef TEXT_H
+#define TEXT_H
+
+#include "opengl.h"
+
+#include <string>
+#include <vector>
+
+struct TextLine
+{
+    float x;          // Left edge in window pixels
+    float y;          // Baseline in window pixels
+    std::string text;
+};
+
+// Lines submitted between beginText() and drawTextOverlay()
+struct TextOverlay
+{
+    std::vector<TextLine> lines; // Layout currently in the vertex buffer
+    size_t lineCount;            // Lines submitted since beginText()
+    bool dirty;                  // Submitted lines differ from the buffer
+    GLuint vertexBuffer;
+    GLsizei vertexCount;
+};
+
+// Build the atlas for a GLUT bitmap font (needs GLUT and a current
+// context). Returns false if framebuffers are unavailable; text is then
+// drawn glyph by glyph with glutBitmapCharacter instead.
+bool createFontAtlas(void *font);
+
+void beginText(TextOverlay &overlay);
+void addText(TextOverlay &overlay, float x, float y, const std::string &text);
+
+// Draw all lines in the current color; expects a pixel-aligned 2D
+// projection. Draws nothing if neither atlas nor GLUT fonts are set up.
+void drawTextOverlay(TextOverlay &overlay);
+
+void deleteTextOverlay(TextOverlay &overlay);
+
+#endif // TEXT_H